@@ -89,6 +89,110 @@
    void what##_array_resize(what##_array_t *a,                 \
                             size_t n, uint8_t fill);
 
+//
+// Compact array template used for object items: the count and limit
+// are stored in a header in front of the elements so the array is a
+// single pointer in its owner and an empty array allocates nothing
+//
+
+#define DEFINE_COMPACT_ARRAY(what)                             \
+   static void what##_array_realloc(what##_array_t *a,         \
+                                    uint32_t limit)            \
+   {                                                           \
+      const bool fresh = (a->data == NULL);                    \
+      a->data = xrealloc(a->data, sizeof(what##_array_data_t)  \
+                         + (limit * sizeof(what##_t)));        \
+      if (fresh)                                               \
+         a->data->count = 0;                                   \
+      a->data->limit = limit;                                  \
+   }                                                           \
+                                                               \
+   what##_t *what##_array_alloc(what##_array_t *a)             \
+   {                                                           \
+      if (unlikely(a->data == NULL))                           \
+         what##_array_realloc(a, 1);                           \
+      else if (a->data->count == a->data->limit)               \
+         what##_array_realloc(a, a->data->limit * 2);          \
+                                                               \
+      return &(a->data->items[a->data->count++]);              \
+   }                                                           \
+                                                               \
+   void what##_array_add(what##_array_t *a, what##_t t)        \
+   {                                                           \
+      *what##_array_alloc(a) = t;                              \
+   }                                                           \
+                                                               \
+   void what##_array_resize(what##_array_t *a,                 \
+                            size_t n, uint8_t fill)            \
+   {                                                           \
+      if (n == 0) {                                            \
+         what##_array_free(a);                                 \
+         return;                                               \
+      }                                                        \
+                                                               \
+      size_t valid = 0;                                        \
+      if (a->data == NULL)                                     \
+         what##_array_realloc(a, n);                           \
+      else {                                                   \
+         valid = MIN(a->data->count, a->data->limit);          \
+         if (n > a->data->limit) {                             \
+            const size_t limit = MAX(n, a->data->limit * 2);   \
+            what##_array_realloc(a, limit);                    \
+         }                                                     \
+      }                                                        \
+                                                               \
+      if (n > valid)                                           \
+         memset(a->data->items + valid, fill,                  \
+                (n - valid) * sizeof(what##_t));               \
+      a->data->count = n;                                      \
+   }                                                           \
+                                                               \
+   void what##_array_free(what##_array_t *a)                   \
+   {                                                           \
+      free(a->data);                                           \
+      a->data = NULL;                                          \
+   }                                                           \
+
+#define DECLARE_COMPACT_ARRAY(what)                            \
+   typedef struct {                                            \
+      uint32_t count;                                          \
+      uint32_t limit;                                          \
+      what##_t items[0];                                       \
+   } what##_array_data_t;                                      \
+                                                               \
+   typedef struct {                                            \
+      what##_array_data_t *data;                               \
+   } what##_array_t;                                           \
+                                                               \
+   void what##_array_add(what##_array_t *a, what##_t t);       \
+   what##_t *what##_array_alloc(what##_array_t *a);            \
+   void what##_array_resize(what##_array_t *a,                 \
+                            size_t n, uint8_t fill);           \
+   void what##_array_free(what##_array_t *a);                  \
+                                                               \
+   __attribute__ ((unused))                                    \
+   static inline unsigned what##_array_count(                  \
+      const what##_array_t *a)                                 \
+   {                                                           \
+      return (a->data == NULL) ? 0 : a->data->count;           \
+   }                                                           \
+                                                               \
+   __attribute__ ((unused))                                    \
+   static inline what##_t *what##_array_nth_ptr(               \
+      what##_array_t *a, unsigned n)                           \
+   {                                                           \
+      assert(n < what##_array_count(a));                       \
+      return &(a->data->items[n]);                             \
+   }                                                           \
+                                                               \
+   __attribute__ ((unused))                                    \
+   static inline what##_t what##_array_nth(what##_array_t *a,  \
+                                           unsigned n)         \
+   {                                                           \
+      assert(n < what##_array_count(a));                       \
+      return a->data->items[n];                                \
+   }                                                           \
+
 #define DECLARE_AND_DEFINE_ARRAY(what) \
    DECLARE_ARRAY(what)                 \
    DEFINE_ARRAY(what)
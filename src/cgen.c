@@ -23,6 +23,7 @@
 #include "util.h"
 #include "phase.h"
 #include "lib.h"
+#include "fbuf.h"
 #include "common.h"
 #include "vcode.h"
 #include "array.h"
@@ -32,11 +33,13 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <limits.h>
 #include <unistd.h>
 #include <sys/stat.h>
 
 #include <llvm-c/Core.h>
+#include <llvm-c/BitReader.h>
 #include <llvm-c/BitWriter.h>
 #include <llvm-c/ExecutionEngine.h>
 #include <llvm-c/Analysis.h>
@@ -44,6 +47,20 @@
 #include <llvm-c/Transforms/IPO.h>
 #include <llvm-c/Transforms/PassManagerBuilder.h>
 #include <llvm-c/TargetMachine.h>
+#include <llvm-c/Linker.h>
+
+#if LLVM_HAS_LLJIT
+#include <llvm-c/Error.h>
+#include <llvm-c/LLJIT.h>
+#include <llvm-c/Orc.h>
+#endif
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include <stdio.h>
+#include <inttypes.h>
 
 #undef NDEBUG
 #include <assert.h>
@@ -57,6 +74,7 @@
 /* ========================================================================= */
 
 #define MAX_STATIC_NETS    256
+#define INLINE_THRESHOLD   225
 
 /* ========================================================================= */
 /* -- PRIVATE MACROS ------------------------------------------------------- */
@@ -76,23 +94,66 @@ typedef struct {
   size_t             param_base;
   LLVMValueRef      *locals;
   loc_t              last_loc;
+
+  // Processes sharing code with other instances access signals and
+  // variables in the enclosing unit through a table of pointers
+  const vcode_global_ref_t *refs;
+  int                       nrefs;
+  LLVMValueRef              ref_table;
+  LLVMValueRef             *ref_values;
 } cgen_ctx_t;
 
 typedef struct {
   LLVMValueRef size;
   LLVMValueRef resolution;
+  LLVMValueRef resolution_vec;
   uint32_t     count;
   uint32_t     flags;
 } size_list_t;
 
 DECLARE_AND_DEFINE_ARRAY(size_list)
 
+typedef struct {
+  netid_t      nid;
+  LLVMValueRef data;
+  LLVMValueRef size_list;
+  uint32_t     nparts;
+  LLVMValueRef name;
+} static_init_t;
+
+DECLARE_AND_DEFINE_ARRAY(static_init)
+
+typedef struct {
+  vcode_unit_t        unit;
+  LLVMValueRef        body;
+  vcode_global_ref_t *refs;
+  int                 nrefs;
+} shared_proc_t;
+
+typedef struct {
+  vcode_unit_t   unit;
+  uint32_t       hash;
+  bool           visited;
+  shared_proc_t *shared;
+} proc_shape_t;
+
+typedef struct {
+  const char           *bitcode;
+  size_t                size;
+  int                   index;
+  int                   nshards;
+  LLVMTargetMachineRef  tm_ref;
+  char                 *obj_path;
+  char                 *error;
+} cgen_shard_t;
+
 typedef enum {
   FUNC_ATTR_NOUNWIND,
   FUNC_ATTR_NORETURN,
   FUNC_ATTR_READONLY,
   FUNC_ATTR_NOCAPTURE,
   FUNC_ATTR_BYVAL,
+  FUNC_ATTR_NOALIAS,
 
   FUNC_ATTR_DLLEXPORT,    // Should be last
 } func_attr_t;
@@ -130,9 +191,22 @@ static void cgen_append_size_list(size_list_array_t *list, vcode_type_t elem,
   const vcode_res_fn_t *resolution,
   size_t *res_elem);
 static LLVMValueRef cgen_array_pointer(LLVMValueRef array);
+static bool cgen_bitcode_path(tree_t context, char *path, size_t len);
 static void cgen_block(int block, cgen_ctx_t *ctx);
+static void cgen_cache_copy(const char *from, const char *to);
+static bool cgen_cache_fetch(tree_t top, uint64_t key, int jobs);
+static bool cgen_cache_key(tree_t top, vcode_unit_t vcode,
+  const char *triple, int jobs, uint64_t *key);
+static uint64_t cgen_cache_mix(uint64_t hash, const void *data, size_t len);
+static bool cgen_cache_mix_file(uint64_t *hash, const char *path);
+static char *cgen_cache_bitcode_path(uint64_t key);
+static const char *cgen_cache_dir(void);
+static char *cgen_cache_path(uint64_t key, int index);
+static void cgen_cache_store(tree_t top, uint64_t key, char **obj_paths,
+  int jobs);
 static void cgen_code(cgen_ctx_t *ctx);
 static void cgen_coverage_state(tree_t t);
+static void cgen_diagnostic(LLVMDiagnosticInfoRef info, void *context);
 static LLVMValueRef cgen_display_struct(cgen_ctx_t *ctx, int hops);
 static LLVMTypeRef cgen_display_type(vcode_unit_t unit);
 static LLVMValueRef cgen_display_upref(int hops, cgen_ctx_t *ctx);
@@ -141,16 +215,34 @@ static void cgen_find_implib_deps(ident_t unit_name, ident_list_t **deps);
 #endif /* IMPLIB_REQUIRED */
 static void cgen_free_context(cgen_ctx_t *ctx);
 static void cgen_function(LLVMTypeRef display_type);
+static LLVMCodeGenOptLevel cgen_code_gen_level(void);
 static LLVMValueRef cgen_get_arg(int op, int arg, cgen_ctx_t *ctx);
 static LLVMValueRef cgen_get_var(vcode_var_t var, cgen_ctx_t *ctx);
+static LLVMValueRef cgen_global(LLVMTypeRef type, const char *name,
+  bool define);
 static LLVMValueRef cgen_hint_str(int op);
+static void cgen_import_bitcode(tree_t top);
+static bool cgen_import_enabled(tree_t top);
+static bool cgen_import_ok(LLVMValueRef fn, int limit);
+static bool cgen_import_operand_ok(LLVMValueRef value);
+static void cgen_import_prune(LLVMModuleRef m);
+static int cgen_import_select(LLVMModuleRef m, int limit);
 static bool cgen_is_uarray_struct(LLVMValueRef meta);
+#if LLVM_HAS_LLJIT
+static void cgen_jit(tree_t top, LLVMTargetMachineRef tm_ref);
+static void cgen_jit_check(LLVMErrorRef error, const char *what);
+static void *cgen_jit_lookup(const char *name);
+#endif
 static void cgen_jump_table(cgen_ctx_t *ctx);
+static void cgen_link(tree_t top, char **obj_paths, int nobjs);
 static void cgen_link_arg(const char *fmt, ...);
 static void cgen_locals(cgen_ctx_t *ctx);
 static LLVMValueRef cgen_location(cgen_ctx_t *ctx);
+static LLVMValueRef cgen_malloc(LLVMTypeRef type, LLVMValueRef count,
+  const char *name);
 static const char *cgen_memcpy_name(const char *kind, int width);
-static void cgen_native(tree_t top, LLVMTargetMachineRef tm_ref);
+static void cgen_native(tree_t top, LLVMTargetMachineRef tm_ref, int jobs,
+  bool use_cache, uint64_t cache_key);
 static void cgen_net_flag(int op, net_flags_t flag, cgen_ctx_t *ctx);
 static LLVMTypeRef cgen_net_id_type(void);
 static void cgen_net_mapping_table(vcode_signal_t sig, int offset,
@@ -200,6 +292,7 @@ static void cgen_op_image(int op, cgen_ctx_t *ctx);
 static void cgen_op_image_map(int op, cgen_ctx_t *ctx);
 static void cgen_op_index(int op, cgen_ctx_t *ctx);
 static void cgen_op_index_check(int op, cgen_ctx_t *ctx);
+static void cgen_op_intrinsic(int op, cgen_ctx_t *ctx);
 static void cgen_op_jump(int i, cgen_ctx_t *ctx);
 static void cgen_op_last_event(int op, cgen_ctx_t *ctx);
 static void cgen_op_load(int op, cgen_ctx_t *ctx);
@@ -245,17 +338,34 @@ static void cgen_op_wait(int op, cgen_ctx_t *ctx);
 static void cgen_op_wrap(int op, cgen_ctx_t *ctx);
 static void cgen_op_xnor(int op, cgen_ctx_t *ctx);
 static void cgen_op_xor(int op, cgen_ctx_t *ctx);
-static void cgen_optimise(void);
+static char *cgen_object_path(ident_t unit_name, int index, int jobs);
+static void cgen_optimise(LLVMModuleRef m);
 static void cgen_params(cgen_ctx_t *ctx);
 static void cgen_pcall_suspend(LLVMValueRef state, LLVMBasicBlockRef cont_bb,
   cgen_ctx_t *ctx);
 static LLVMValueRef cgen_pointer_to_arg_data(int op, int arg, cgen_ctx_t *ctx);
 static void cgen_procedure(LLVMTypeRef display_type);
+static int cgen_proc_shape_cmp(const void *a, const void *b);
 static void cgen_process(vcode_unit_t code);
+static void cgen_process_body(cgen_ctx_t *ctx, LLVMValueRef reset_arg);
+static void cgen_process_instance(vcode_unit_t code, shared_proc_t *shared);
+static LLVMValueRef cgen_ref_value(cgen_ctx_t *ctx, vcode_ref_kind_t kind,
+  int32_t handle);
 static const char *cgen_reg_name(vcode_reg_t r);
 static void cgen_reset_function(tree_t top);
+static LLVMValueRef cgen_resolution_fn(const vcode_res_elem_t *rdata);
+static LLVMValueRef cgen_resolution_vec_wrapper(const vcode_res_elem_t *rdata);
 static LLVMValueRef cgen_resolution_wrapper(const vcode_res_elem_t *rdata);
+static void cgen_save_bitcode(tree_t top);
 static void cgen_sched_process(LLVMValueRef after);
+static void cgen_shard_declare(LLVMValueRef value);
+static void *cgen_shard_main(void *arg);
+static void cgen_shard_partition(LLVMModuleRef m, int index, int nshards);
+static void cgen_shards(tree_t top, LLVMTargetMachineRef tm_ref, int jobs,
+  char **obj_paths);
+static LLVMValueRef cgen_shared_process_body(shared_proc_t *shared);
+static void cgen_shared_processes(vcode_unit_t top);
+static void cgen_shared_processes_free(void);
 static void cgen_shared_variables(void);
 static LLVMValueRef cgen_signal_nets(vcode_signal_t sig);
 static char *cgen_signal_nets_name(vcode_signal_t sig);
@@ -264,10 +374,14 @@ static LLVMValueRef cgen_signature(ident_t name, vcode_type_t result,
   LLVMTypeRef display_type,
   const vcode_type_t *vparams,
   size_t nparams);
+static void cgen_single_image(tree_t top);
 static void cgen_size_list(size_list_array_t *list, vcode_type_t type,
   const vcode_res_fn_t *resolution, size_t *res_elem);
 static void cgen_state_struct(cgen_ctx_t *ctx);
 static LLVMTypeRef cgen_state_type(cgen_ctx_t *ctx);
+static int cgen_static_initial_cmp(const void *a, const void *b);
+static LLVMValueRef cgen_static_initial_data(LLVMValueRef value);
+static void cgen_static_initial_table(void);
 static LLVMValueRef cgen_subprogram_arg(int op, int arg, cgen_ctx_t *ctx);
 static void cgen_subprograms(vcode_unit_t vcode);
 static LLVMValueRef cgen_support_fn(const char *name);
@@ -276,6 +390,8 @@ static void cgen_tmp_stack(void);
 static void cgen_top(tree_t t, vcode_unit_t vcode);
 static LLVMTypeRef cgen_type(vcode_type_t type);
 static LLVMValueRef cgen_uarray_dim(LLVMValueRef meta, int dim);
+static void cgen_unit_bitcode_path(ident_t unit_name, char *path,
+  size_t len);
 #if 0
 static void debug_dump(LLVMValueRef ptr, LLVMValueRef len);
 static void debug_out(LLVMValueRef val);
@@ -311,6 +427,22 @@ static size_t max_link_args = 0;
 
 static hash_t *string_pool = NULL;
 
+static LLVMTargetDataRef data_layout = NULL;
+static bool static_initial = false;
+static static_init_array_t static_inits = { 0, NULL };
+
+static unsigned cache_hits = 0;
+static unsigned cache_misses = 0;
+
+static proc_shape_t *proc_shapes = NULL;
+static int n_proc_shapes = 0;
+static hash_t *shared_procs = NULL;
+
+#if LLVM_HAS_LLJIT
+// The JIT owns the generated code and so lives until the process exits
+static LLVMOrcLLJITRef lljit = NULL;
+#endif
+
 /* ========================================================================= */
 /* -- EXPORTED DATA -------------------------------------------------------- */
 /* ========================================================================= */
@@ -334,47 +466,62 @@ cgen (
     fatal("cannot generate code for %s", tree_kind_str(kind));
   }
 
-  module = LLVMModuleCreateWithName(istr(tree_ident(top)));
-  builder = LLVMCreateBuilder();
-
   LLVMInitializeNativeTarget();
   LLVMInitializeNativeAsmPrinter();
 
   char *def_triple = LLVMGetDefaultTargetTriple();
-  char *error;
-  LLVMTargetRef target_ref;
-  if (LLVMGetTargetFromTriple(def_triple, &target_ref, &error)) {
-    fatal("failed to get LLVM target for %s: %s", def_triple, error);
-  }
 
-  LLVMCodeGenOptLevel code_gen_level;
-  switch (opt_get_int("optimise"))
-  {
-    case 0:
-      {
-        code_gen_level = LLVMCodeGenLevelNone;
-      }
-      break;
+  bool jit = opt_get_int("jit");
+  if (jit && (getenv("NVC_FOREIGN_OBJ") != NULL)) {
+    warnf("NVC_FOREIGN_OBJ requires linking a shared library: "
+      "ignoring --jit");
+    jit = false;
+  }
+
+  // Each shard is optimised separately when generating code in parallel
+  const int jobs = jit ? 1 : MAX(opt_get_int("jobs"), 1);
+
+  // Object code is only cached in a directory given with --cache-dir and
+  // units linked with their packages depend on more than their own
+  // intermediate code so are never cached
+  uint64_t cache_key = 0;
+  const bool use_cache = (opt_get_str("cache-dir") != NULL) && !jit
+    && !tree_attr_int(top, single_image_i, 0)
+    && !opt_get_int("dump-llvm")
+    && cgen_cache_key(top, vcode, def_triple, jobs, &cache_key);
+
+  if (use_cache) {
+    const bool hit = cgen_cache_fetch(top, cache_key, jobs);
+    if (hit) {
+      cache_hits++;
+    } else {
+      cache_misses++;
+    }
 
-    case 1:
-      {
-        code_gen_level = LLVMCodeGenLevelLess;
-      }
-      break;
+    if (opt_get_int("verbose")) {
+      notef("object cache: %u hit%s, %u miss%s", cache_hits,
+        (cache_hits == 1) ? "" : "s", cache_misses,
+        (cache_misses == 1) ? "" : "es");
+    }
 
-    case 3:
-      {
-        code_gen_level = LLVMCodeGenLevelAggressive;
-      }
-      break;
+    if (hit) {
+      LLVMDisposeMessage(def_triple);
+      return;
+    }
+  }
 
-    default:
-      code_gen_level = LLVMCodeGenLevelDefault;
+  module = LLVMModuleCreateWithName(istr(tree_ident(top)));
+  builder = LLVMCreateBuilder();
+
+  char *error;
+  LLVMTargetRef target_ref;
+  if (LLVMGetTargetFromTriple(def_triple, &target_ref, &error)) {
+    fatal("failed to get LLVM target for %s: %s", def_triple, error);
   }
 
   LLVMTargetMachineRef tm_ref =
     LLVMCreateTargetMachine(target_ref, def_triple, "", "",
-      code_gen_level,
+      cgen_code_gen_level(),
       LLVMRelocPIC,
       LLVMCodeModelDefault);
 
@@ -389,12 +536,18 @@ cgen (
   char *layout LOCAL = LLVMCopyStringRepOfTargetData(data_ref);
   LLVMSetDataLayout(module, layout);
 
+  data_layout = data_ref;
+
   string_pool = hash_new(128, true);
 
   cgen_tmp_stack();
 
   cgen_top(top, vcode);
 
+  if (tree_attr_int(top, single_image_i, 0)) {
+    cgen_single_image(top);
+  }
+
   if (opt_get_int("dump-llvm")) {
     LLVMDumpModule(module);
   }
@@ -403,17 +556,41 @@ cgen (
     fatal("LLVM verification failed");
   }
 
-  cgen_optimise();
-  cgen_native(top, tm_ref);
+  if (cgen_import_enabled(top)) {
+    cgen_import_bitcode(top);
+  }
+
+  if (jobs == 1) {
+    cgen_optimise(module);
+  }
+
+  if ((kind != T_ELAB) && !jit) {
+    // Keep the optimised code so small subprograms can be inlined into
+    // designs that use this package
+    cgen_save_bitcode(top);
+  }
+
+#if LLVM_HAS_LLJIT
+  if (jit) {
+    // The JIT takes ownership of the target machine
+    cgen_jit(top, tm_ref);
+  } else {
+    cgen_native(top, tm_ref, jobs, use_cache, cache_key);
+    LLVMDisposeTargetMachine(tm_ref);
+  }
+#else
+  cgen_native(top, tm_ref, jobs, use_cache, cache_key);
+  LLVMDisposeTargetMachine(tm_ref);
+#endif
 
   hash_free(string_pool);
 
   LLVMDisposeModule(module);
   LLVMDisposeBuilder(builder);
-  LLVMDisposeTargetMachine(tm_ref);
 #if LLVM_HAS_CREATE_TARGET_DATA_LAYOUT
   LLVMDisposeTargetData(data_ref);
 #endif
+  data_layout = NULL;
   LLVMDisposeMessage(def_triple);
 } /* cgen() */
 
@@ -441,7 +618,7 @@ cgen_add_func_attr (
 #if LLVM_NEW_ATTRIBUTE_API
   const char *names[] =
   {
-    "nounwind", "noreturn", "readonly", "nocapture", "byval"
+    "nounwind", "noreturn", "readonly", "nocapture", "byval", "noalias"
   };
   assert(attr < ARRAY_LEN(names));
 
@@ -462,7 +639,8 @@ cgen_add_func_attr (
     LLVMNoReturnAttribute,
     LLVMReadOnlyAttribute,
     LLVMNoCaptureAttribute,
-    LLVMByValAttribute
+    LLVMByValAttribute,
+    LLVMNoAliasAttribute
   };
   assert(attr < ARRAY_LEN(llvm_attrs));
 
@@ -523,6 +701,10 @@ cgen_append_size_list (
       cgen_resolution_wrapper(&(resolution->element[*res_elem]));
     if (resolution->element[*res_elem].kind == RES_RECORD) {
       result->flags |= R_RECORD;
+      result->resolution_vec = LLVMConstNull(llvm_void_ptr());
+    } else {
+      result->resolution_vec =
+        cgen_resolution_vec_wrapper(&(resolution->element[*res_elem]));
     }
     if (resolution->element[*res_elem].boundary) {
       result->flags |= R_BOUNDARY;
@@ -531,6 +713,7 @@ cgen_append_size_list (
     ++(*res_elem);
   } else {
     result->resolution = LLVMConstNull(llvm_void_ptr());
+    result->resolution_vec = LLVMConstNull(llvm_void_ptr());
   }
 } /* cgen_append_size_list() */
 
@@ -551,6 +734,33 @@ cgen_array_pointer (
 
 /* ------------------------------------------------------------------------- */
 
+static bool
+cgen_bitcode_path (
+  tree_t  context,
+  char   *path,
+  size_t  len
+) {
+  // Find the bitcode saved for a package or package body in a context item
+  if (tree_kind(context) != T_USE) {
+    return (false);
+  }
+
+  ident_t name = tree_ident(context);
+  lib_t lib = lib_find(ident_until(name, '.'), true);
+
+  const int kind = lib_index_kind(lib, name);
+  if ((kind != T_PACKAGE) && (kind != T_PACK_BODY)) {
+    return (false);
+  }
+
+  char *bc_name LOCAL = xasprintf("_%s.bc", istr(name));
+  lib_realpath(lib, bc_name, path, len);
+
+  return (access(path, R_OK) == 0);
+} /* cgen_bitcode_path() */
+
+/* ------------------------------------------------------------------------- */
+
 static void
 cgen_block (
   int         block,
@@ -572,6 +782,234 @@ cgen_block (
 
 /* ------------------------------------------------------------------------- */
 
+static char *
+cgen_cache_bitcode_path (
+  uint64_t key
+) {
+  return (xasprintf("%s" PATH_SEP "_NVC_CACHE.%016" PRIx64 ".bc",
+    cgen_cache_dir(), key));
+} /* cgen_cache_bitcode_path() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+cgen_cache_copy (
+  const char *from,
+  const char *to
+) {
+  // Copy to a temporary file first so a concurrent reader never sees a
+  // partially written object
+  char *tmp LOCAL = xasprintf("%s.%d.tmp", to, getpid());
+
+  FILE *in = fopen(from, "rb");
+  if (in == NULL) {
+    fatal_errno("%s", from);
+  }
+
+  FILE *out = fopen(tmp, "wb");
+  if (out == NULL) {
+    fatal_errno("%s", tmp);
+  }
+
+  char buf[16384];
+  size_t nread;
+  while ((nread = fread(buf, 1, sizeof(buf), in)) > 0) {
+    if (fwrite(buf, 1, nread, out) != nread) {
+      fatal_errno("%s", tmp);
+    }
+  }
+
+  fclose(in);
+  if (fclose(out) != 0) {
+    fatal_errno("%s", tmp);
+  }
+
+  if (rename(tmp, to) != 0) {
+    fatal_errno("rename: %s", to);
+  }
+} /* cgen_cache_copy() */
+
+/* ------------------------------------------------------------------------- */
+
+static const char *
+cgen_cache_dir (
+  void
+) {
+  const char *dir = opt_get_str("cache-dir");
+  make_dir(dir);
+
+  return (dir);
+} /* cgen_cache_dir() */
+
+/* ------------------------------------------------------------------------- */
+
+static bool
+cgen_cache_fetch (
+  tree_t   top,
+  uint64_t key,
+  int      jobs
+) {
+  for (int i = 0; i < jobs; i++) {
+    char *cached LOCAL = cgen_cache_path(key, i);
+    if (access(cached, R_OK) != 0) {
+      return (false);
+    }
+  }
+
+  if (tree_kind(top) != T_ELAB) {
+    // Restore the bitcode saved with the objects so designs never inline
+    // code from a different version of this unit left in the library
+    char bc_path[PATH_MAX];
+    cgen_unit_bitcode_path(tree_ident(top), bc_path, sizeof(bc_path));
+
+    char *cached_bc LOCAL = cgen_cache_bitcode_path(key);
+    if (access(cached_bc, R_OK) == 0) {
+      cgen_cache_copy(cached_bc, bc_path);
+    } else if ((remove(bc_path) != 0) && (errno != ENOENT)) {
+      fatal_errno("%s", bc_path);
+    }
+  }
+
+  char *obj_paths[jobs];
+  for (int i = 0; i < jobs; i++) {
+    char *cached LOCAL = cgen_cache_path(key, i);
+
+    obj_paths[i] = cgen_object_path(tree_ident(top), i, jobs);
+    cgen_cache_copy(cached, obj_paths[i]);
+  }
+
+  cgen_link(top, obj_paths, jobs);
+
+  return (true);
+} /* cgen_cache_fetch() */
+
+/* ------------------------------------------------------------------------- */
+
+static bool
+cgen_cache_key (
+  tree_t        top,
+  vcode_unit_t  vcode,
+  const char   *triple,
+  int           jobs,
+  uint64_t     *key
+) {
+  // The key covers everything the object code depends on: the serialised
+  // intermediate code for the unit and its children, the compiler
+  // version, the target, the optimisation level and the number of shards
+  fbuf_t *fbuf = fbuf_open_digest();
+  vcode_write(vcode, fbuf);
+  uint64_t hash = fbuf_digest(fbuf);
+  fbuf_close(fbuf);
+
+  if (cgen_import_enabled(top)) {
+    // Code inlined from packages is part of the object too so the unit
+    // is not cached if any of it cannot be read
+    const int ncontext = tree_contexts(top);
+    for (int i = 0; i < ncontext; i++) {
+      char path[PATH_MAX];
+      if (cgen_bitcode_path(tree_context(top, i), path, sizeof(path))
+          && !cgen_cache_mix_file(&hash, path)) {
+        return (false);
+      }
+    }
+
+    const int32_t limit = opt_get_int("inline-limit");
+    hash = cgen_cache_mix(hash, &limit, sizeof(limit));
+  }
+
+  const char *name = istr(tree_ident(top));
+  const int32_t params[] = { opt_get_int("optimise"), jobs };
+
+  hash = cgen_cache_mix(hash, name, strlen(name));
+  hash = cgen_cache_mix(hash, PACKAGE_VERSION, strlen(PACKAGE_VERSION));
+  hash = cgen_cache_mix(hash, triple, strlen(triple));
+  hash = cgen_cache_mix(hash, params, sizeof(params));
+
+  *key = hash;
+  return (true);
+} /* cgen_cache_key() */
+
+/* ------------------------------------------------------------------------- */
+
+static uint64_t
+cgen_cache_mix (
+  uint64_t    hash,
+  const void *data,
+  size_t      len
+) {
+  // 64-bit FNV-1a
+  const uint8_t *bytes = data;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= bytes[i];
+    hash *= UINT64_C(1099511628211);
+  }
+
+  return (hash);
+} /* cgen_cache_mix() */
+
+/* ------------------------------------------------------------------------- */
+
+static bool
+cgen_cache_mix_file (
+  uint64_t   *hash,
+  const char *path
+) {
+  FILE *in = fopen(path, "rb");
+  if (in == NULL) {
+    return (false);
+  }
+
+  char buf[16384];
+  size_t nread;
+  while ((nread = fread(buf, 1, sizeof(buf), in)) > 0) {
+    *hash = cgen_cache_mix(*hash, buf, nread);
+  }
+
+  const bool ok = !ferror(in);
+  fclose(in);
+
+  return (ok);
+} /* cgen_cache_mix_file() */
+
+/* ------------------------------------------------------------------------- */
+
+static char *
+cgen_cache_path (
+  uint64_t key,
+  int      index
+) {
+  return (xasprintf("%s" PATH_SEP "_NVC_CACHE.%016" PRIx64 ".%d."
+    LLVM_OBJ_EXT, cgen_cache_dir(), key, index));
+} /* cgen_cache_path() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+cgen_cache_store (
+  tree_t     top,
+  uint64_t   key,
+  char     **obj_paths,
+  int        jobs
+) {
+  // The bitcode is stored first as fetching only checks for the objects
+  if (tree_kind(top) != T_ELAB) {
+    char bc_path[PATH_MAX];
+    cgen_unit_bitcode_path(tree_ident(top), bc_path, sizeof(bc_path));
+
+    if (access(bc_path, R_OK) == 0) {
+      char *cached_bc LOCAL = cgen_cache_bitcode_path(key);
+      cgen_cache_copy(bc_path, cached_bc);
+    }
+  }
+
+  for (int i = 0; i < jobs; i++) {
+    char *cached LOCAL = cgen_cache_path(key, i);
+    cgen_cache_copy(obj_paths[i], cached);
+  }
+} /* cgen_cache_store() */
+
+/* ------------------------------------------------------------------------- */
+
 static void
 cgen_code (
   cgen_ctx_t *ctx
@@ -585,11 +1023,39 @@ cgen_code (
 
 /* ------------------------------------------------------------------------- */
 
+static LLVMCodeGenOptLevel
+cgen_code_gen_level (
+  void
+) {
+  switch (opt_get_int("optimise"))
+  {
+    case 0:
+      {
+        return (LLVMCodeGenLevelNone);
+      }
+
+    case 1:
+      {
+        return (LLVMCodeGenLevelLess);
+      }
+
+    case 3:
+      {
+        return (LLVMCodeGenLevelAggressive);
+      }
+
+    default:
+      return (LLVMCodeGenLevelDefault);
+  }
+} /* cgen_code_gen_level() */
+
+/* ------------------------------------------------------------------------- */
+
 static void
 cgen_coverage_state (
   tree_t t
 ) {
-  const int stmt_tags = tree_attr_int(t, ident_new("stmt_tags"), 0);
+  const int stmt_tags = tree_attr_int(t, stmt_tags_i, 0);
 
   if (stmt_tags > 0) {
     LLVMTypeRef type = LLVMArrayType(LLVMInt32Type(), stmt_tags);
@@ -598,7 +1064,7 @@ cgen_coverage_state (
     cgen_add_func_attr(var, FUNC_ATTR_DLLEXPORT, -1);
   }
 
-  const int cond_tags = tree_attr_int(t, ident_new("cond_tags"), 0);
+  const int cond_tags = tree_attr_int(t, cond_tags_i, 0);
   if (cond_tags > 0) {
     LLVMTypeRef type = LLVMArrayType(LLVMInt32Type(), stmt_tags);
     LLVMValueRef var = LLVMAddGlobal(module, type, "cover_conds");
@@ -609,6 +1075,21 @@ cgen_coverage_state (
 
 /* ------------------------------------------------------------------------- */
 
+static void
+cgen_diagnostic (
+  LLVMDiagnosticInfoRef  info,
+  void                  *context
+) {
+  // Keep the first error instead of letting LLVM exit the process
+  char **message = context;
+
+  if ((LLVMGetDiagInfoSeverity(info) == LLVMDSError) && (*message == NULL)) {
+    *message = LLVMGetDiagInfoDescription(info);
+  }
+} /* cgen_diagnostic() */
+
+/* ------------------------------------------------------------------------- */
+
 static LLVMValueRef
 cgen_display_struct (
   cgen_ctx_t *ctx,
@@ -794,6 +1275,7 @@ cgen_free_context (
   free(ctx->regs);
   free(ctx->blocks);
   free(ctx->locals);
+  free(ctx->ref_values);
 } /* cgen_free_context() */
 
 /* ------------------------------------------------------------------------- */
@@ -870,10 +1352,14 @@ cgen_get_var (
 
   if (var_depth == 0) {
     // Shared global variable
-    const char *name = safe_symbol(istr(vcode_var_name(var)));
-    value = LLVMGetNamedGlobal(module, name);
-    if (value == NULL) {
-      fatal_trace("missing LLVM global for %s", istr(vcode_var_name(var)));
+    if (ctx->refs != NULL) {
+      value = cgen_ref_value(ctx, VCODE_REF_VAR, var);
+    } else {
+      const char *name = safe_symbol(istr(vcode_var_name(var)));
+      value = LLVMGetNamedGlobal(module, name);
+      if (value == NULL) {
+        fatal_trace("missing LLVM global for %s", istr(vcode_var_name(var)));
+      }
     }
   } else if (my_depth == var_depth) {
     // Variable is inside current context
@@ -908,6 +1394,37 @@ cgen_get_var (
 
 /* ------------------------------------------------------------------------- */
 
+static LLVMValueRef
+cgen_global (
+  LLVMTypeRef  type,
+  const char  *name,
+  bool         define
+) {
+  // When several units are generated into the same module an earlier unit
+  // may already have declared this global
+  LLVMValueRef global = LLVMGetNamedGlobal(module, name);
+  if (global == NULL) {
+    return (LLVMAddGlobal(module, type, name));
+  } else if (!define) {
+    return (global);
+  } else if (LLVMGetInitializer(global) != NULL) {
+    fatal_trace("duplicate definition of LLVM global %s", name);
+  } else if (LLVMGetElementType(LLVMTypeOf(global)) == type) {
+    return (global);
+  }
+
+  // The declaration has a different type to the definition: replace all
+  // uses with a cast of the new global
+  LLVMValueRef def = LLVMAddGlobal(module, type, "");
+  LLVMReplaceAllUsesWith(global, LLVMConstBitCast(def, LLVMTypeOf(global)));
+  LLVMDeleteGlobal(global);
+  LLVMSetValueName(def, name);
+
+  return (def);
+} /* cgen_global() */
+
+/* ------------------------------------------------------------------------- */
+
 static LLVMValueRef
 cgen_hint_str (
   int op
@@ -939,6 +1456,256 @@ cgen_hint_str (
 
 /* ------------------------------------------------------------------------- */
 
+static void
+cgen_import_bitcode (
+  tree_t top
+) {
+  // Link the optimised code for small package subprograms called by the
+  // design into the module with available_externally linkage: LLVM can
+  // then inline them but any remaining calls still go to the definition
+  // in the package's shared library
+  const int limit = opt_get_int("inline-limit");
+  int nimported = 0;
+
+  const int ncontext = tree_contexts(top);
+  for (int i = 0; i < ncontext; i++) {
+    char path[PATH_MAX];
+    if (!cgen_bitcode_path(tree_context(top, i), path, sizeof(path))) {
+      continue;
+    }
+
+    char *error;
+    LLVMMemoryBufferRef bitcode;
+    if (LLVMCreateMemoryBufferWithContentsOfFile(path, &bitcode, &error)) {
+      warnf("cannot read %s: %s", path, error);
+      LLVMDisposeMessage(error);
+      continue;
+    }
+
+    // A library written by a different LLVM may contain bitcode this one
+    // cannot read: skip it rather than failing the elaboration
+    LLVMContextRef llvm_ctx = LLVMGetGlobalContext();
+    LLVMDiagnosticHandler old_handler =
+      LLVMContextGetDiagnosticHandler(llvm_ctx);
+    void *old_context = LLVMContextGetDiagnosticContext(llvm_ctx);
+
+    char *message = NULL;
+    LLVMContextSetDiagnosticHandler(llvm_ctx, cgen_diagnostic, &message);
+
+    LLVMModuleRef m = NULL;
+    const bool failed = LLVMParseBitcode2(bitcode, &m) || (message != NULL);
+    LLVMDisposeMemoryBuffer(bitcode);
+
+    LLVMContextSetDiagnosticHandler(llvm_ctx, old_handler, old_context);
+
+    if (failed) {
+      if (m != NULL) {
+        LLVMDisposeModule(m);
+      }
+      warnf("cannot parse LLVM bitcode in %s: %s", path,
+        (message != NULL) ? message : "unknown error");
+      if (message != NULL) {
+        LLVMDisposeMessage(message);
+      }
+      continue;
+    }
+
+    const int count = cgen_import_select(m, limit);
+    if (count == 0) {
+      LLVMDisposeModule(m);
+      continue;
+    }
+
+    // Consumes the source module
+    if (LLVMLinkModules2(module, m)) {
+      fatal("failed to link LLVM bitcode from %s", path);
+    }
+
+    nimported += count;
+  }
+
+  if (opt_get_int("verbose")) {
+    notef("imported %d package subprogram%s for inlining", nimported,
+      (nimported == 1) ? "" : "s");
+  }
+} /* cgen_import_bitcode() */
+
+/* ------------------------------------------------------------------------- */
+
+static bool
+cgen_import_enabled (
+  tree_t top
+) {
+  // A single image already contains the package code
+  return ((tree_kind(top) == T_ELAB)
+    && (opt_get_int("inline-limit") > 0)
+    && (opt_get_int("optimise") > 0)
+    && !tree_attr_int(top, single_image_i, 0));
+} /* cgen_import_enabled() */
+
+/* ------------------------------------------------------------------------- */
+
+static bool
+cgen_import_ok (
+  LLVMValueRef fn,
+  int          limit
+) {
+  int size = 0;
+  for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(fn);
+    bb != NULL;
+    bb = LLVMGetNextBasicBlock(bb)) {
+    for (LLVMValueRef insn = LLVMGetFirstInstruction(bb);
+      insn != NULL;
+      insn = LLVMGetNextInstruction(insn)) {
+      if (++size > limit) {
+        return (false);
+      }
+
+      const int nops = LLVMGetNumOperands(insn);
+      for (int i = 0; i < nops; i++) {
+        if (!cgen_import_operand_ok(LLVMGetOperand(insn, i))) {
+          return (false);
+        }
+      }
+    }
+  }
+
+  return (true);
+} /* cgen_import_ok() */
+
+/* ------------------------------------------------------------------------- */
+
+static bool
+cgen_import_operand_ok (
+  LLVMValueRef value
+) {
+  if (LLVMIsAGlobalValue(value)) {
+    // A copy of a private function or of mutable state private to the
+    // package would not be the same object as the one in the package
+    const LLVMLinkage linkage = LLVMGetLinkage(value);
+    if ((linkage == LLVMInternalLinkage) || (linkage == LLVMPrivateLinkage)) {
+      return (LLVMIsAGlobalVariable(value) && LLVMIsGlobalConstant(value));
+    }
+  } else if (LLVMIsAConstantExpr(value)) {
+    const int nops = LLVMGetNumOperands(value);
+    for (int i = 0; i < nops; i++) {
+      if (!cgen_import_operand_ok(LLVMGetOperand(value, i))) {
+        return (false);
+      }
+    }
+  }
+
+  return (true);
+} /* cgen_import_operand_ok() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+cgen_import_prune (
+  LLVMModuleRef m
+) {
+  // Delete private functions and variables no longer referenced once the
+  // subprograms that are not imported have been reduced to declarations
+  bool changed;
+  do {
+    changed = false;
+
+    LLVMValueRef fn = LLVMGetFirstFunction(m);
+    while (fn != NULL) {
+      LLVMValueRef next = LLVMGetNextFunction(fn);
+
+      const LLVMLinkage linkage = LLVMGetLinkage(fn);
+      const bool local =
+        (linkage == LLVMInternalLinkage) || (linkage == LLVMPrivateLinkage);
+
+      if (local && (LLVMGetFirstUse(fn) == NULL)) {
+        LLVMDeleteFunction(fn);
+        changed = true;
+      }
+
+      fn = next;
+    }
+
+    LLVMValueRef global = LLVMGetFirstGlobal(m);
+    while (global != NULL) {
+      LLVMValueRef next = LLVMGetNextGlobal(global);
+
+      const LLVMLinkage linkage = LLVMGetLinkage(global);
+      const bool local =
+        (linkage == LLVMInternalLinkage) || (linkage == LLVMPrivateLinkage);
+
+      if (local && (LLVMGetFirstUse(global) == NULL)) {
+        LLVMDeleteGlobal(global);
+        changed = true;
+      }
+
+      global = next;
+    }
+  } while (changed);
+} /* cgen_import_prune() */
+
+/* ------------------------------------------------------------------------- */
+
+static int
+cgen_import_select (
+  LLVMModuleRef m,
+  int           limit
+) {
+  // Keep definitions of the subprograms the design calls which are small
+  // enough to inline and reduce everything else to declarations
+  int count = 0;
+
+  LLVMValueRef fn = LLVMGetFirstFunction(m);
+  while (fn != NULL) {
+    LLVMValueRef next = LLVMGetNextFunction(fn);
+
+    const LLVMLinkage linkage = LLVMGetLinkage(fn);
+    const bool local =
+      (linkage == LLVMInternalLinkage) || (linkage == LLVMPrivateLinkage);
+
+    if (!LLVMIsDeclaration(fn) && !local) {
+      LLVMValueRef use = LLVMGetNamedFunction(module, LLVMGetValueName(fn));
+
+      if ((use != NULL) && LLVMIsDeclaration(use)
+          && cgen_import_ok(fn, limit)) {
+        LLVMSetLinkage(fn, LLVMAvailableExternallyLinkage);
+        count++;
+      } else {
+        cgen_shard_declare(fn);
+      }
+    }
+
+    fn = next;
+  }
+
+  // Constants may be folded into the design but package variables and
+  // signals must be shared with the package
+  LLVMValueRef global = LLVMGetFirstGlobal(m);
+  while (global != NULL) {
+    LLVMValueRef next = LLVMGetNextGlobal(global);
+
+    const LLVMLinkage linkage = LLVMGetLinkage(global);
+    const bool local =
+      (linkage == LLVMInternalLinkage) || (linkage == LLVMPrivateLinkage);
+
+    if (!LLVMIsDeclaration(global) && !local) {
+      if (LLVMIsGlobalConstant(global)) {
+        LLVMSetLinkage(global, LLVMAvailableExternallyLinkage);
+      } else {
+        cgen_shard_declare(global);
+      }
+    }
+
+    global = next;
+  }
+
+  cgen_import_prune(m);
+
+  return (count);
+} /* cgen_import_select() */
+
+/* ------------------------------------------------------------------------- */
+
 static bool
 cgen_is_uarray_struct (
   LLVMValueRef meta
@@ -948,6 +1715,87 @@ cgen_is_uarray_struct (
 
 /* ------------------------------------------------------------------------- */
 
+#if LLVM_HAS_LLJIT
+static void
+cgen_jit (
+  tree_t               top,
+  LLVMTargetMachineRef tm_ref
+) {
+  // Compile the module in memory instead of writing an object file and
+  // running the system linker: the runtime looks up symbols in the JIT
+  // before searching the loaded libraries
+  assert(lljit == NULL);
+
+  LLVMOrcLLJITBuilderRef jit_builder = LLVMOrcCreateLLJITBuilder();
+  LLVMOrcLLJITBuilderSetJITTargetMachineBuilder(jit_builder,
+    LLVMOrcJITTargetMachineBuilderCreateFromTargetMachine(tm_ref));
+  cgen_jit_check(LLVMOrcCreateLLJIT(&lljit, jit_builder), "create JIT");
+
+  // Runtime support functions and package subprograms are resolved from
+  // the symbols already present in the process
+  LLVMOrcDefinitionGeneratorRef generator;
+  cgen_jit_check(LLVMOrcCreateDynamicLibrarySearchGeneratorForProcess(
+    &generator, LLVMOrcLLJITGetGlobalPrefix(lljit), NULL, NULL),
+    "create JIT symbol generator");
+
+  LLVMOrcJITDylibRef dylib = LLVMOrcLLJITGetMainJITDylib(lljit);
+  LLVMOrcJITDylibAddGenerator(dylib, generator);
+
+  // The JIT requires the module to be owned by its own context so make a
+  // copy through the bitcode writer
+  LLVMOrcThreadSafeContextRef tsctx = LLVMOrcCreateNewThreadSafeContext();
+  LLVMMemoryBufferRef bitcode = LLVMWriteBitcodeToMemoryBuffer(module);
+
+  LLVMModuleRef jit_module;
+  if (LLVMParseBitcodeInContext2(LLVMOrcThreadSafeContextGetContext(tsctx),
+    bitcode, &jit_module)) {
+    fatal("failed to load %s into JIT", istr(tree_ident(top)));
+  }
+
+  LLVMDisposeMemoryBuffer(bitcode);
+
+  LLVMOrcThreadSafeModuleRef tsm =
+    LLVMOrcCreateNewThreadSafeModule(jit_module, tsctx);
+  LLVMOrcDisposeThreadSafeContext(tsctx);
+
+  cgen_jit_check(LLVMOrcLLJITAddLLVMIRModule(lljit, dylib, tsm),
+    "add module to JIT");
+
+  jit_register_module(tree_ident(top), cgen_jit_lookup);
+} /* cgen_jit() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+cgen_jit_check (
+  LLVMErrorRef  error,
+  const char   *what
+) {
+  if (error != NULL) {
+    char *msg = LLVMGetErrorMessage(error);
+    fatal("failed to %s: %s", what, msg);
+  }
+} /* cgen_jit_check() */
+
+/* ------------------------------------------------------------------------- */
+
+static void *
+cgen_jit_lookup (
+  const char *name
+) {
+  uint64_t addr;
+  LLVMErrorRef error = LLVMOrcLLJITLookup(lljit, &addr, name);
+  if (error != NULL) {
+    LLVMConsumeError(error);
+    return (NULL);
+  }
+
+  return ((void *)(uintptr_t)addr);
+} /* cgen_jit_lookup() */
+
+/* ------------------------------------------------------------------------- */
+#endif
+
 static void
 cgen_jump_table (
   cgen_ctx_t *ctx
@@ -1068,6 +1916,35 @@ cgen_location (
 
 /* ------------------------------------------------------------------------- */
 
+static LLVMValueRef
+cgen_malloc (
+  LLVMTypeRef  type,
+  LLVMValueRef count,
+  const char  *name
+) {
+  // LLVMBuildMalloc declares malloc with a 32-bit size which the
+  // optimiser can combine with a following memset into a call to calloc
+  // that does not match its declaration and so cannot be read back from
+  // bitcode: call malloc with a size_t argument instead
+  LLVMTypeRef size_type = LLVMIntPtrType(data_layout);
+
+  LLVMValueRef bytes = LLVMBuildTruncOrBitCast(builder, LLVMSizeOf(type),
+    size_type, "");
+  if (count != NULL) {
+    LLVMValueRef count_ext = LLVMBuildZExtOrBitCast(builder, count,
+      size_type, "");
+    bytes = LLVMBuildMul(builder, bytes, count_ext, "");
+  }
+
+  LLVMValueRef args[] = { bytes };
+  LLVMValueRef mem = LLVMBuildCall(builder, llvm_fn("malloc"), args,
+    ARRAY_LEN(args), "");
+
+  return (LLVMBuildPointerCast(builder, mem, LLVMPointerType(type, 0), name));
+} /* cgen_malloc() */
+
+/* ------------------------------------------------------------------------- */
+
 static const char *
 cgen_memcpy_name (
   const char *kind,
@@ -1085,21 +1962,41 @@ cgen_memcpy_name (
 static void
 cgen_native (
   tree_t               top,
-  LLVMTargetMachineRef tm_ref
-) {
-  ident_t unit_name = tree_ident(top);
-  char *obj_name LOCAL = xasprintf("_%s." LLVM_OBJ_EXT, istr(unit_name));
-
-  char obj_path[PATH_MAX];
+  LLVMTargetMachineRef tm_ref,
+  int                  jobs,
+  bool                 use_cache,
+  uint64_t             cache_key
+) {
+  char *obj_paths[jobs];
+  if (jobs > 1) {
+    cgen_shards(top, tm_ref, jobs, obj_paths);
+  } else {
+    obj_paths[0] = cgen_object_path(tree_ident(top), 0, 1);
 
-  lib_realpath(lib_work(), obj_name, obj_path, sizeof(obj_path));
+    char *error;
+    if (LLVMTargetMachineEmitToFile(tm_ref, module, obj_paths[0],
+      LLVMObjectFile, &error)) {
+      fatal("Failed to write object file: %s", error);
+    }
+  }
 
-  char *error;
-  if (LLVMTargetMachineEmitToFile(tm_ref, module, obj_path,
-    LLVMObjectFile, &error)) {
-    fatal("Failed to write object file: %s", error);
+  if (use_cache) {
+    cgen_cache_store(top, cache_key, obj_paths, jobs);
   }
 
+  cgen_link(top, obj_paths, jobs);
+} /* cgen_native() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+cgen_link (
+  tree_t   top,
+  char   **obj_paths,
+  int      nobjs
+) {
+  ident_t unit_name = tree_ident(top);
+
   max_link_args = 64;
   link_args = xmalloc(sizeof(char *) * max_link_args);
   n_link_args = 0;
@@ -1119,13 +2016,32 @@ cgen_native (
   cgen_link_arg("-shared");
 #endif
 
+#if !defined __APPLE__ && !defined IMPLIB_REQUIRED
+  if (tree_attr_int(top, single_image_i, 0)) {
+    // All symbols are resolved within the image so bind them eagerly and
+    // directly rather than through the PLT
+#ifdef LINKER_PATH
+    cgen_link_arg("-z");
+    cgen_link_arg("now");
+    cgen_link_arg("-Bsymbolic");
+#else
+    cgen_link_arg("-Wl,-z,now");
+    cgen_link_arg("-Wl,-Bsymbolic");
+#endif
+  }
+#endif
+
   char *fname LOCAL = xasprintf("_%s." DLL_EXT, istr(unit_name));
   char so_path[PATH_MAX];
   lib_realpath(lib_work(), fname, so_path, PATH_MAX);
 
   cgen_link_arg("-o");
   cgen_link_arg("%s", so_path);
-  cgen_link_arg("%s", obj_path);
+
+  for (int i = 0; i < nobjs; i++) {
+    cgen_link_arg("%s", obj_paths[i]);
+    free(obj_paths[i]);
+  }
 
 #if IMPLIB_REQUIRED
   char *impname LOCAL = xasprintf("_%s.lib", istr(unit_name));
@@ -1179,7 +2095,7 @@ cgen_native (
   }
   free(link_args);
   link_args = NULL;
-} /* cgen_native() */
+} /* cgen_link() */
 
 /* ------------------------------------------------------------------------- */
 
@@ -1831,6 +2747,12 @@ cgen_op (
       }
       break;
 
+    case VCODE_OP_INTRINSIC:
+      {
+        cgen_op_intrinsic(i, ctx);
+      }
+      break;
+
     default:
       fatal("cannot generate code for vcode op %s", vcode_op_string(op));
   }
@@ -3191,44 +4113,128 @@ cgen_op_index_check (
 
   LLVMValueRef null = LLVMBuildICmp(builder, LLVMIntSLT, high, low, "null");
 
-  for (int i = 0; i < 2; i++) {
-    LLVMValueRef value =
-      LLVMBuildZExt(builder, cgen_get_arg(op, i, ctx), int32, "");
+  for (int i = 0; i < 2; i++) {
+    LLVMValueRef value =
+      LLVMBuildZExt(builder, cgen_get_arg(op, i, ctx), int32, "");
+
+    LLVMValueRef above =
+      LLVMBuildICmp(builder, LLVMIntSGE, value, min, "above");
+    LLVMValueRef below =
+      LLVMBuildICmp(builder, LLVMIntSLE, value, max, "below");
+
+    LLVMValueRef in =
+      LLVMBuildOr(builder, LLVMBuildAnd(builder, above, below, ""),
+        null, "in");
+
+    LLVMBasicBlockRef pass_bb = LLVMAppendBasicBlock(ctx->fn, "bounds_pass");
+    LLVMBasicBlockRef fail_bb = LLVMAppendBasicBlock(ctx->fn, "bounds_fail");
+
+    LLVMBuildCondBr(builder, in, pass_bb, fail_bb);
+
+    LLVMPositionBuilderAtEnd(builder, fail_bb);
+
+    LLVMValueRef args[] =
+    {
+      value,
+      min,
+      max,
+      llvm_int32(vcode_get_subkind(op)),
+      cgen_location(ctx),
+      LLVMConstNull(llvm_char_ptr())
+    };
+
+    LLVMBuildCall(builder, llvm_fn("_bounds_fail"), args,
+      ARRAY_LEN(args), "");
+
+    LLVMBuildUnreachable(builder);
+
+    LLVMPositionBuilderAtEnd(builder, pass_bb);
+  }
+} /* cgen_op_index_check() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+cgen_op_intrinsic (
+  int         op,
+  cgen_ctx_t *ctx
+) {
+  // Try the native implementation in the runtime first and only call
+  // the VHDL function when that declines the arguments
+
+  vcode_reg_t result = vcode_get_result(op);
+  vcode_type_t rtype = vcode_reg_type(result);
+  const bool is_array = vtype_kind(rtype) == VCODE_TYPE_UARRAY;
+
+  LLVMTypeRef uarray_ptr =
+    LLVMPointerType(llvm_uarray_type(LLVMInt8Type(), 1), 0);
+
+  LLVMValueRef arrays[2] =
+  {
+    LLVMConstNull(uarray_ptr),
+    LLVMConstNull(uarray_ptr)
+  };
+  LLVMValueRef scalars[2] = { llvm_int32(0), llvm_int32(0) };
+
+  const int nargs = vcode_count_args(op);
+  for (int i = 0; i < nargs; i++) {
+    if (vcode_reg_kind(vcode_get_arg(op, i)) == VCODE_TYPE_UARRAY) {
+      arrays[i] = LLVMBuildPointerCast(builder,
+          cgen_subprogram_arg(op, i, ctx), uarray_ptr, "");
+    } else {
+      scalars[i] = LLVMBuildIntCast(builder, cgen_get_arg(op, i, ctx),
+          LLVMInt32Type(), "");
+    }
+  }
+
+  LLVMTypeRef tmp_type = is_array ? cgen_type(rtype) : LLVMInt32Type();
+  LLVMValueRef tmp = LLVMBuildAlloca(builder, tmp_type, "intrinsic");
+
+  LLVMValueRef args[] =
+  {
+    llvm_int32(vcode_get_intrinsic(op)),
+    arrays[0],
+    arrays[1],
+    scalars[0],
+    scalars[1],
+    llvm_void_cast(tmp)
+  };
+  LLVMValueRef handled = LLVMBuildCall(builder, llvm_fn("_ieee_intrinsic"),
+      args, ARRAY_LEN(args), "handled");
+
+  LLVMBasicBlockRef fast_bb = LLVMAppendBasicBlock(ctx->fn, "intrinsic_fast");
+  LLVMBasicBlockRef slow_bb = LLVMAppendBasicBlock(ctx->fn, "intrinsic_slow");
+  LLVMBasicBlockRef join_bb = LLVMAppendBasicBlock(ctx->fn, "intrinsic_join");
 
-    LLVMValueRef above =
-      LLVMBuildICmp(builder, LLVMIntSGE, value, min, "above");
-    LLVMValueRef below =
-      LLVMBuildICmp(builder, LLVMIntSLE, value, max, "below");
+  LLVMValueRef is_handled =
+    LLVMBuildICmp(builder, LLVMIntNE, handled, llvm_int8(0), "");
+  LLVMBuildCondBr(builder, is_handled, fast_bb, slow_bb);
 
-    LLVMValueRef in =
-      LLVMBuildOr(builder, LLVMBuildAnd(builder, above, below, ""),
-        null, "in");
+  LLVMPositionBuilderAtEnd(builder, fast_bb);
 
-    LLVMBasicBlockRef pass_bb = LLVMAppendBasicBlock(ctx->fn, "bounds_pass");
-    LLVMBasicBlockRef fail_bb = LLVMAppendBasicBlock(ctx->fn, "bounds_fail");
+  LLVMValueRef fast = LLVMBuildLoad(builder, tmp, "");
+  if (!is_array) {
+    fast = LLVMBuildIntCast(builder, fast, cgen_type(rtype), "");
+  }
+  LLVMBuildBr(builder, join_bb);
 
-    LLVMBuildCondBr(builder, in, pass_bb, fail_bb);
+  LLVMPositionBuilderAtEnd(builder, slow_bb);
 
-    LLVMPositionBuilderAtEnd(builder, fail_bb);
+  cgen_op_fcall(op, false, ctx);
+  LLVMValueRef slow = ctx->regs[result];
+  LLVMBuildBr(builder, join_bb);
 
-    LLVMValueRef args[] =
-    {
-      value,
-      min,
-      max,
-      llvm_int32(vcode_get_subkind(op)),
-      cgen_location(ctx),
-      LLVMConstNull(llvm_char_ptr())
-    };
+  LLVMPositionBuilderAtEnd(builder, join_bb);
 
-    LLVMBuildCall(builder, llvm_fn("_bounds_fail"), args,
-      ARRAY_LEN(args), "");
+  LLVMValueRef phi = LLVMBuildPhi(builder, LLVMTypeOf(slow),
+      cgen_reg_name(result));
 
-    LLVMBuildUnreachable(builder);
+  LLVMValueRef values[] = { fast, slow };
+  LLVMBasicBlockRef bbs[] = { fast_bb, slow_bb };
+  LLVMAddIncoming(phi, values, bbs, 2);
 
-    LLVMPositionBuilderAtEnd(builder, pass_bb);
-  }
-} /* cgen_op_index_check() */
+  ctx->regs[result] = phi;
+} /* cgen_op_intrinsic() */
 
 /* ------------------------------------------------------------------------- */
 
@@ -3487,7 +4493,11 @@ cgen_op_nets (
 
   vcode_reg_t result = vcode_get_result(op);
 
-  ctx->regs[result] = cgen_signal_nets(sig);
+  if (ctx->refs != NULL) {
+    ctx->regs[result] = cgen_ref_value(ctx, VCODE_REF_SIGNAL, sig);
+  } else {
+    ctx->regs[result] = cgen_signal_nets(sig);
+  }
   LLVMSetValueName(ctx->regs[result], cgen_reg_name(result));
 } /* cgen_op_nets() */
 
@@ -3504,10 +4514,10 @@ cgen_op_new (
   LLVMTypeRef lltype = cgen_type(vtype_pointed(vcode_reg_type(result)));
 
   if (vcode_count_args(op) == 0) {
-    ctx->regs[result] = LLVMBuildMalloc(builder, lltype, name);
+    ctx->regs[result] = cgen_malloc(lltype, NULL, name);
   } else {
     LLVMValueRef length = cgen_get_arg(op, 0, ctx);
-    ctx->regs[result] = LLVMBuildArrayMalloc(builder, lltype, length, name);
+    ctx->regs[result] = cgen_malloc(lltype, length, name);
   }
 } /* cgen_op_new() */
 
@@ -3967,7 +4977,44 @@ cgen_op_set_initial (
     LLVMSetUnnamedAddr(name_ll, true);
   }
 
-  if ((size_list.count == 1) && (size_list.items[0].flags == 0)) {
+  LLVMValueRef static_data = NULL;
+  if (static_initial) {
+    static_data = cgen_static_initial_data(cgen_get_arg(op, 0, ctx));
+  }
+
+  if (static_data != NULL) {
+    // Initial value is known at compile time: add an entry to the
+    // static initial value table read by the runtime at startup
+    LLVMValueRef items[size_list.count];
+    for (unsigned i = 0; i < size_list.count; i++) {
+      LLVMValueRef fields[] =
+      {
+        size_list.items[i].size,
+        llvm_int32(size_list.items[i].count),
+        llvm_void_cast(size_list.items[i].resolution),
+        llvm_int32(size_list.items[i].flags),
+        llvm_void_cast(size_list.items[i].resolution_vec)
+      };
+      items[i] = LLVMConstStruct(fields, ARRAY_LEN(fields), false);
+    }
+
+    const char *list_name LOCAL = xasprintf("%s.size_list", sig_name);
+    LLVMTypeRef list_type =
+      LLVMArrayType(llvm_size_list_type(), size_list.count);
+    LLVMValueRef list_ll = LLVMAddGlobal(module, list_type, list_name);
+    LLVMSetGlobalConstant(list_ll, true);
+    LLVMSetInitializer(list_ll,
+      LLVMConstArray(llvm_size_list_type(), items, size_list.count));
+    LLVMSetLinkage(list_ll, LLVMPrivateLinkage);
+    LLVMSetUnnamedAddr(list_ll, true);
+
+    static_init_t *init = static_init_array_alloc(&static_inits);
+    init->nid = nid;
+    init->data = static_data;
+    init->size_list = cgen_array_pointer(list_ll);
+    init->nparts = size_list.count;
+    init->name = llvm_void_cast(name_ll);
+  } else if ((size_list.count == 1) && (size_list.items[0].flags == 0)) {
     LLVMValueRef args[] =
     {
       llvm_int32(nid),
@@ -3975,6 +5022,7 @@ cgen_op_set_initial (
       size_list.items[0].size,
       llvm_int32(size_list.items[0].count),
       llvm_void_cast(size_list.items[0].resolution),
+      llvm_void_cast(size_list.items[0].resolution_vec),
       llvm_void_cast(name_ll)
     };
     LLVMBuildCall(builder, llvm_fn("_set_initial_1"), args,
@@ -3997,6 +5045,8 @@ cgen_op_set_initial (
         LLVMBuildStructGEP(builder, elemptr, 2, ""));
       LLVMBuildStore(builder, llvm_int32(size_list.items[i].flags),
         LLVMBuildStructGEP(builder, elemptr, 3, ""));
+      LLVMBuildStore(builder, size_list.items[i].resolution_vec,
+        LLVMBuildStructGEP(builder, elemptr, 4, ""));
     }
 
     LLVMValueRef args[] =
@@ -4314,9 +5364,30 @@ cgen_op_xor (
 
 /* ------------------------------------------------------------------------- */
 
+static char *
+cgen_object_path (
+  ident_t unit_name,
+  int     index,
+  int     jobs
+) {
+  char *obj_name LOCAL;
+  if (jobs > 1) {
+    obj_name = xasprintf("_%s.%d." LLVM_OBJ_EXT, istr(unit_name), index);
+  } else {
+    obj_name = xasprintf("_%s." LLVM_OBJ_EXT, istr(unit_name));
+  }
+
+  char *path = xmalloc(PATH_MAX);
+  lib_realpath(lib_work(), obj_name, path, PATH_MAX);
+
+  return (path);
+} /* cgen_object_path() */
+
+/* ------------------------------------------------------------------------- */
+
 static void
 cgen_optimise (
-  void
+  LLVMModuleRef m
 ) {
   LLVMPassManagerRef pass_mgr = LLVMCreatePassManager();
 
@@ -4327,9 +5398,24 @@ cgen_optimise (
 
   LLVMPassManagerBuilderRef builder = LLVMPassManagerBuilderCreate();
   LLVMPassManagerBuilderSetOptLevel(builder, opt_get_int("optimise"));
+
+  // Subprograms imported from package bitcode are only useful if they
+  // are inlined: other modules are optimised without the inliner as
+  // before
+  for (LLVMValueRef fn = LLVMGetFirstFunction(m);
+    fn != NULL;
+    fn = LLVMGetNextFunction(fn)) {
+    if (!LLVMIsDeclaration(fn)
+        && (LLVMGetLinkage(fn) == LLVMAvailableExternallyLinkage)) {
+      LLVMPassManagerBuilderUseInlinerWithThreshold(builder,
+        INLINE_THRESHOLD);
+      break;
+    }
+  }
+
   LLVMPassManagerBuilderPopulateModulePassManager(builder, pass_mgr);
 
-  LLVMRunPassManager(pass_mgr, module);
+  LLVMRunPassManager(pass_mgr, m);
 
   LLVMDisposePassManager(pass_mgr);
   LLVMPassManagerBuilderDispose(builder);
@@ -4451,7 +5537,7 @@ cgen_procedure (
 
   LLVMPositionBuilderAtEnd(builder, alloc_bb);
 
-  LLVMValueRef new_state = LLVMBuildMalloc(builder, state_type, "new_state");
+  LLVMValueRef new_state = cgen_malloc(state_type, NULL, "new_state");
 
   LLVMValueRef state_ptr = LLVMBuildStructGEP(builder, new_state, 0, "");
   LLVMBuildStore(builder, llvm_int32(0), state_ptr);
@@ -4485,6 +5571,19 @@ cgen_procedure (
 
 /* ------------------------------------------------------------------------- */
 
+static int
+cgen_proc_shape_cmp (
+  const void *a,
+  const void *b
+) {
+  const uint32_t ha = ((const proc_shape_t *)a)->hash;
+  const uint32_t hb = ((const proc_shape_t *)b)->hash;
+
+  return ((ha > hb) - (ha < hb));
+} /* cgen_proc_shape_cmp() */
+
+/* ------------------------------------------------------------------------- */
+
 static void
 cgen_process (
   vcode_unit_t code
@@ -4499,43 +5598,170 @@ cgen_process (
   cgen_add_func_attr(fn, FUNC_ATTR_NOUNWIND, -1);
   cgen_add_func_attr(fn, FUNC_ATTR_DLLEXPORT, -1);
 
-  LLVMBasicBlockRef entry_bb = LLVMAppendBasicBlock(fn, "entry");
-  LLVMBasicBlockRef reset_bb = LLVMAppendBasicBlock(fn, "reset");
-  LLVMBasicBlockRef jump_bb = LLVMAppendBasicBlock(fn, "jump_table");
-
   cgen_ctx_t ctx =
   {
     .fn = fn
   };
   cgen_state_struct(&ctx);
-  cgen_alloc_context(&ctx);
+  cgen_process_body(&ctx, LLVMGetParam(fn, 0));
+} /* cgen_process() */
 
-  // If the parameter is non-zero jump to the init block
+/* ------------------------------------------------------------------------- */
+
+static void
+cgen_process_body (
+  cgen_ctx_t   *ctx,
+  LLVMValueRef  reset_arg
+) {
+  LLVMBasicBlockRef entry_bb = LLVMAppendBasicBlock(ctx->fn, "entry");
+  LLVMBasicBlockRef reset_bb = LLVMAppendBasicBlock(ctx->fn, "reset");
+  LLVMBasicBlockRef jump_bb = LLVMAppendBasicBlock(ctx->fn, "jump_table");
+
+  cgen_alloc_context(ctx);
 
   LLVMPositionBuilderAtEnd(builder, entry_bb);
-  LLVMValueRef reset = LLVMBuildICmp(builder, LLVMIntNE, LLVMGetParam(fn, 0),
+
+  if (ctx->refs != NULL) {
+    // Load the pointers for this instance once on entry
+    ctx->ref_values = xmalloc(ctx->nrefs * sizeof(LLVMValueRef));
+    for (int i = 0; i < ctx->nrefs; i++) {
+      LLVMTypeRef type;
+      if (ctx->refs[i].kind == VCODE_REF_SIGNAL) {
+        type = LLVMPointerType(cgen_net_id_type(), 0);
+      } else {
+        type = LLVMPointerType(cgen_type(vcode_var_type(ctx->refs[i].handle)),
+          0);
+      }
+
+      LLVMValueRef index[] = { llvm_int32(i) };
+      LLVMValueRef ptr = LLVMBuildGEP(builder, ctx->ref_table, index,
+        ARRAY_LEN(index), "");
+      ctx->ref_values[i] =
+        LLVMBuildPointerCast(builder, LLVMBuildLoad(builder, ptr, ""),
+          type, "");
+    }
+  }
+
+  // If the parameter is non-zero jump to the init block
+
+  LLVMValueRef reset = LLVMBuildICmp(builder, LLVMIntNE, reset_arg,
       llvm_int32(0), "reset");
   LLVMBuildCondBr(builder, reset, reset_bb, jump_bb);
 
   LLVMPositionBuilderAtEnd(builder, reset_bb);
 
-  LLVMValueRef state_ptr = LLVMBuildStructGEP(builder, ctx.state, 0, "");
+  LLVMValueRef state_ptr = LLVMBuildStructGEP(builder, ctx->state, 0, "");
   LLVMBuildStore(builder, llvm_int32(1), state_ptr);
 
-  LLVMValueRef pcall_ptr = LLVMBuildStructGEP(builder, ctx.state, 1, "");
+  LLVMValueRef pcall_ptr = LLVMBuildStructGEP(builder, ctx->state, 1, "");
   LLVMBuildStore(builder, LLVMConstNull(llvm_void_ptr()), pcall_ptr);
 
   // Schedule the process to run immediately
   cgen_sched_process(llvm_int64(0));
 
-  LLVMBuildBr(builder, ctx.blocks[0]);
+  LLVMBuildBr(builder, ctx->blocks[0]);
 
   LLVMPositionBuilderAtEnd(builder, jump_bb);
-  cgen_jump_table(&ctx);
+  cgen_jump_table(ctx);
 
-  cgen_code(&ctx);
-  cgen_free_context(&ctx);
-} /* cgen_process() */
+  cgen_code(ctx);
+  cgen_free_context(ctx);
+} /* cgen_process_body() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+cgen_process_instance (
+  vcode_unit_t   code,
+  shared_proc_t *shared
+) {
+  if (shared->body == NULL) {
+    shared->body = cgen_shared_process_body(shared);
+  }
+
+  vcode_select_unit(code);
+
+  // Each instance keeps its own process function and state but calls the
+  // shared body with a table of the signals and variables it uses
+
+  LLVMTypeRef pargs[] = { LLVMInt32Type() };
+  LLVMTypeRef ftype = LLVMFunctionType(LLVMVoidType(), pargs, 1, false);
+  const char *name = safe_symbol(istr(vcode_unit_name()));
+  LLVMValueRef fn = LLVMAddFunction(module, name, ftype);
+  cgen_add_func_attr(fn, FUNC_ATTR_NOUNWIND, -1);
+  cgen_add_func_attr(fn, FUNC_ATTR_DLLEXPORT, -1);
+
+  cgen_ctx_t ctx =
+  {
+    .fn = fn
+  };
+  cgen_state_struct(&ctx);
+
+  vcode_global_ref_t *refs = NULL;
+  const int nrefs = vcode_unit_global_refs(code, &refs);
+  assert(nrefs == shared->nrefs);
+
+  LLVMValueRef table_ptr;
+  if (nrefs > 0) {
+    LLVMValueRef *init LOCAL = xmalloc(nrefs * sizeof(LLVMValueRef));
+    for (int i = 0; i < nrefs; i++) {
+      LLVMValueRef global;
+      if (refs[i].kind == VCODE_REF_SIGNAL) {
+        char *nets_name LOCAL = cgen_signal_nets_name(refs[i].handle);
+        global = LLVMGetNamedGlobal(module, nets_name);
+      } else {
+        ident_t var_name = vcode_var_name(refs[i].handle);
+        global = LLVMGetNamedGlobal(module, safe_symbol(istr(var_name)));
+      }
+
+      assert(global != NULL);
+      init[i] = LLVMConstBitCast(global, llvm_void_ptr());
+    }
+
+    char *table_name LOCAL = xasprintf("%s.refs", istr(vcode_unit_name()));
+    LLVMValueRef table = LLVMAddGlobal(module,
+      LLVMArrayType(llvm_void_ptr(), nrefs), safe_symbol(table_name));
+    LLVMSetInitializer(table, LLVMConstArray(llvm_void_ptr(), init, nrefs));
+    LLVMSetGlobalConstant(table, true);
+    LLVMSetLinkage(table, LLVMPrivateLinkage);
+
+    table_ptr = cgen_array_pointer(table);
+  } else {
+    table_ptr = LLVMConstNull(LLVMPointerType(llvm_void_ptr(), 0));
+  }
+
+  free(refs);
+
+  LLVMPositionBuilderAtEnd(builder, LLVMAppendBasicBlock(fn, "entry"));
+
+  LLVMTypeRef state_type =
+    LLVMTypeOf(LLVMGetParam(shared->body, 1));
+
+  LLVMValueRef args[] = {
+    LLVMGetParam(fn, 0),
+    LLVMBuildPointerCast(builder, ctx.state, state_type, ""),
+    table_ptr
+  };
+  LLVMBuildCall(builder, shared->body, args, ARRAY_LEN(args), "");
+  LLVMBuildRetVoid(builder);
+} /* cgen_process_instance() */
+
+/* ------------------------------------------------------------------------- */
+
+static LLVMValueRef
+cgen_ref_value (
+  cgen_ctx_t       *ctx,
+  vcode_ref_kind_t  kind,
+  int32_t           handle
+) {
+  for (int i = 0; i < ctx->nrefs; i++) {
+    if ((ctx->refs[i].kind == kind) && (ctx->refs[i].handle == handle)) {
+      return (ctx->ref_values[i]);
+    }
+  }
+
+  fatal_trace("missing shared process reference %d", handle);
+} /* cgen_ref_value() */
 
 /* ------------------------------------------------------------------------- */
 
@@ -4610,6 +5836,173 @@ cgen_reset_function (
 
 /* ------------------------------------------------------------------------- */
 
+static LLVMValueRef
+cgen_resolution_fn (
+  const vcode_res_elem_t *rdata
+) {
+  const bool is_record = vtype_kind(rdata->type) == VCODE_TYPE_RECORD;
+
+  LLVMValueRef rfn = cgen_signature(rdata->name, rdata->type, NULL, NULL, 0);
+  if (rfn == NULL) {
+    // The resolution function is not visible yet e.g. because it
+    // is declared in another package
+    vcode_type_t rtype = is_record ? vtype_pointer(rdata->type) : rdata->type;
+    vcode_type_t args[] =
+    {
+      vtype_uarray(1, rdata->type, vtype_int(0, INT32_MAX))
+    };
+    rfn = cgen_signature(rdata->name, rtype, NULL, args, 1);
+  }
+
+  return (rfn);
+} /* cgen_resolution_fn() */
+
+/* ------------------------------------------------------------------------- */
+
+static LLVMValueRef
+cgen_resolution_vec_wrapper (
+  const vcode_res_elem_t *rdata
+) {
+  // Resolves a whole group with one call from the runtime: the drivers
+  // are passed as a matrix of n rows each containing length elements
+  // and the resolution function is applied to every column
+
+  char *buf LOCAL = xasprintf("%s_resolution_vec", istr(rdata->name));
+
+  const char *wrapper_name = safe_symbol(buf);
+  LLVMValueRef fn = LLVMGetNamedFunction(module, wrapper_name);
+
+  if (fn != NULL) {
+    return (llvm_void_cast(fn));    // Already generated wrapper
+  }
+  assert(vtype_kind(rdata->type) != VCODE_TYPE_RECORD);
+
+  LLVMTypeRef elem_type = cgen_type(rdata->type);
+  LLVMTypeRef pointer_type = LLVMPointerType(elem_type, 0);
+  LLVMTypeRef uarray_type = llvm_uarray_type(elem_type, 1);
+
+  LLVMTypeRef args[] =
+  {
+    pointer_type,
+    LLVMInt32Type(),
+    LLVMInt32Type(),
+    pointer_type
+  };
+  fn = LLVMAddFunction(module, wrapper_name,
+      LLVMFunctionType(LLVMVoidType(), args,
+      ARRAY_LEN(args), false));
+
+  LLVMBasicBlockRef saved_bb = LLVMGetInsertBlock(builder);
+
+  LLVMBasicBlockRef entry_bb = LLVMAppendBasicBlock(fn, "entry");
+  LLVMBasicBlockRef test_bb = LLVMAppendBasicBlock(fn, "elem_test");
+  LLVMBasicBlockRef body_bb = LLVMAppendBasicBlock(fn, "elem_body");
+  LLVMBasicBlockRef copy_test_bb = LLVMAppendBasicBlock(fn, "copy_test");
+  LLVMBasicBlockRef copy_body_bb = LLVMAppendBasicBlock(fn, "copy_body");
+  LLVMBasicBlockRef call_bb = LLVMAppendBasicBlock(fn, "call");
+  LLVMBasicBlockRef exit_bb = LLVMAppendBasicBlock(fn, "exit");
+
+  LLVMPositionBuilderAtEnd(builder, entry_bb);
+
+  LLVMValueRef rfn = cgen_resolution_fn(rdata);
+
+  LLVMValueRef drivers = LLVMGetParam(fn, 0);
+  LLVMValueRef n_drivers = LLVMGetParam(fn, 1);
+  LLVMValueRef length = LLVMGetParam(fn, 2);
+  LLVMValueRef result = LLVMGetParam(fn, 3);
+
+  // The column array passed to the resolution function is reused for
+  // every element
+
+  LLVMValueRef column = LLVMBuildArrayAlloca(builder, elem_type,
+      n_drivers, "column");
+
+  LLVMTypeRef field_types[LLVMCountStructElementTypes(uarray_type)];
+  LLVMGetStructElementTypes(uarray_type, field_types);
+
+  LLVMTypeRef dim_struct = LLVMGetElementType(field_types[1]);
+  LLVMValueRef dim_array = LLVMGetUndef(field_types[1]);
+
+  LLVMValueRef left = llvm_int32(rdata->ileft);
+  LLVMValueRef right = LLVMBuildAdd(builder, left,
+      LLVMBuildSub(builder, n_drivers, llvm_int32(1), ""), "right");
+  LLVMValueRef dir = llvm_int1(RANGE_TO);
+
+  LLVMValueRef d = LLVMGetUndef(dim_struct);
+  d = LLVMBuildInsertValue(builder, d, left, 0, "");
+  d = LLVMBuildInsertValue(builder, d, right, 1, "");
+  d = LLVMBuildInsertValue(builder, d, dir, 2, "");
+
+  dim_array = LLVMBuildInsertValue(builder, dim_array, d, 0, "");
+
+  LLVMValueRef wrapped = LLVMBuildAlloca(builder, uarray_type, "");
+  LLVMBuildStore(builder, column, LLVMBuildStructGEP(builder, wrapped, 0, ""));
+  LLVMBuildStore(builder, dim_array,
+    LLVMBuildStructGEP(builder, wrapped, 1, ""));
+
+  LLVMValueRef i = LLVMBuildAlloca(builder, LLVMInt32Type(), "i");
+  LLVMValueRef j = LLVMBuildAlloca(builder, LLVMInt32Type(), "j");
+
+  LLVMBuildStore(builder, llvm_int32(0), i);
+  LLVMBuildBr(builder, test_bb);
+
+  // Loop over each element of the group
+
+  LLVMPositionBuilderAtEnd(builder, test_bb);
+
+  LLVMValueRef i_loaded = LLVMBuildLoad(builder, i, "i");
+  LLVMValueRef i_done = LLVMBuildICmp(builder, LLVMIntUGE, i_loaded,
+      length, "i_done");
+  LLVMBuildCondBr(builder, i_done, exit_bb, body_bb);
+
+  LLVMPositionBuilderAtEnd(builder, body_bb);
+
+  LLVMBuildStore(builder, llvm_int32(0), j);
+  LLVMBuildBr(builder, copy_test_bb);
+
+  // Gather the value of this element from each driver
+
+  LLVMPositionBuilderAtEnd(builder, copy_test_bb);
+
+  LLVMValueRef j_loaded = LLVMBuildLoad(builder, j, "j");
+  LLVMValueRef j_done = LLVMBuildICmp(builder, LLVMIntUGE, j_loaded,
+      n_drivers, "j_done");
+  LLVMBuildCondBr(builder, j_done, call_bb, copy_body_bb);
+
+  LLVMPositionBuilderAtEnd(builder, copy_body_bb);
+
+  LLVMValueRef index = LLVMBuildAdd(builder,
+      LLVMBuildMul(builder, j_loaded, length, ""), i_loaded, "index");
+  LLVMValueRef src_ptr = LLVMBuildGEP(builder, drivers, &index, 1, "");
+  LLVMValueRef dst_ptr = LLVMBuildGEP(builder, column, &j_loaded, 1, "");
+  LLVMBuildStore(builder, LLVMBuildLoad(builder, src_ptr, ""), dst_ptr);
+
+  LLVMBuildStore(builder,
+    LLVMBuildAdd(builder, j_loaded, llvm_int32(1), ""), j);
+  LLVMBuildBr(builder, copy_test_bb);
+
+  // Resolve this element
+
+  LLVMPositionBuilderAtEnd(builder, call_bb);
+
+  LLVMValueRef r = LLVMBuildCall(builder, rfn, &wrapped, 1, "");
+  LLVMValueRef result_ptr = LLVMBuildGEP(builder, result, &i_loaded, 1, "");
+  LLVMBuildStore(builder, r, result_ptr);
+
+  LLVMBuildStore(builder,
+    LLVMBuildAdd(builder, i_loaded, llvm_int32(1), ""), i);
+  LLVMBuildBr(builder, test_bb);
+
+  LLVMPositionBuilderAtEnd(builder, exit_bb);
+  LLVMBuildRetVoid(builder);
+
+  LLVMPositionBuilderAtEnd(builder, saved_bb);
+
+  return (llvm_void_cast(fn));
+} /* cgen_resolution_vec_wrapper() */
+
+/* ------------------------------------------------------------------------- */
+
 static LLVMValueRef
 cgen_resolution_wrapper (
   const vcode_res_elem_t *rdata
@@ -4642,20 +6035,10 @@ cgen_resolution_wrapper (
 
   LLVMBasicBlockRef saved_bb = LLVMGetInsertBlock(builder);
 
-  LLVMBasicBlockRef entry_bb = LLVMAppendBasicBlock(fn, "entry");
-  LLVMPositionBuilderAtEnd(builder, entry_bb);
-
-  LLVMValueRef rfn = cgen_signature(rdata->name, rdata->type, NULL, NULL, 0);
-  if (rfn == NULL) {
-    // The resolution function is not visible yet e.g. because it
-    // is declared in another package
-    vcode_type_t rtype = is_record ? vtype_pointer(rdata->type) : rdata->type;
-    vcode_type_t args[] =
-    {
-      vtype_uarray(1, rdata->type, vtype_int(0, INT32_MAX))
-    };
-    rfn = cgen_signature(rdata->name, rtype, NULL, args, 1);
-  }
+  LLVMBasicBlockRef entry_bb = LLVMAppendBasicBlock(fn, "entry");
+  LLVMPositionBuilderAtEnd(builder, entry_bb);
+
+  LLVMValueRef rfn = cgen_resolution_fn(rdata);
 
   LLVMTypeRef field_types[LLVMCountStructElementTypes(uarray_type)];
   LLVMGetStructElementTypes(uarray_type, field_types);
@@ -4698,6 +6081,20 @@ cgen_resolution_wrapper (
 
 /* ------------------------------------------------------------------------- */
 
+static void
+cgen_save_bitcode (
+  tree_t top
+) {
+  char path[PATH_MAX];
+  cgen_unit_bitcode_path(tree_ident(top), path, sizeof(path));
+
+  if (LLVMWriteBitcodeToFile(module, path) != 0) {
+    fatal("failed to write LLVM bitcode to %s", path);
+  }
+} /* cgen_save_bitcode() */
+
+/* ------------------------------------------------------------------------- */
+
 static void
 cgen_sched_process (
   LLVMValueRef after
@@ -4709,6 +6106,399 @@ cgen_sched_process (
 
 /* ------------------------------------------------------------------------- */
 
+static void
+cgen_shard_declare (
+  LLVMValueRef value
+) {
+  // Replace a definition owned by another shard with an external
+  // declaration of the same name
+  char *name LOCAL = xstrdup(LLVMGetValueName(value));
+  LLVMModuleRef m = LLVMGetGlobalParent(value);
+  LLVMTypeRef type = LLVMGetElementType(LLVMTypeOf(value));
+
+  LLVMValueRef decl;
+  if (LLVMIsAFunction(value)) {
+    decl = LLVMAddFunction(m, "", type);
+  } else {
+    decl = LLVMAddGlobal(m, type, "");
+    LLVMSetGlobalConstant(decl, LLVMIsGlobalConstant(value));
+  }
+
+  LLVMSetVisibility(decl, LLVMGetVisibility(value));
+  LLVMReplaceAllUsesWith(value, decl);
+
+  if (LLVMIsAFunction(value)) {
+    LLVMDeleteFunction(value);
+  } else {
+    LLVMDeleteGlobal(value);
+  }
+
+  LLVMSetValueName(decl, name);
+} /* cgen_shard_declare() */
+
+/* ------------------------------------------------------------------------- */
+
+static void *
+cgen_shard_main (
+  void *arg
+) {
+  cgen_shard_t *shard = arg;
+
+  // Each shard has its own context so the threads share no LLVM state
+  LLVMContextRef context = LLVMContextCreate();
+  LLVMMemoryBufferRef bitcode = LLVMCreateMemoryBufferWithMemoryRange(
+    shard->bitcode, shard->size, "", false);
+
+  LLVMModuleRef m;
+  if (LLVMParseBitcodeInContext2(context, bitcode, &m)) {
+    shard->error = xstrdup("cannot read bitcode");
+  } else {
+    cgen_shard_partition(m, shard->index, shard->nshards);
+    cgen_optimise(m);
+
+    char *error;
+    if (LLVMTargetMachineEmitToFile(shard->tm_ref, m, shard->obj_path,
+      LLVMObjectFile, &error)) {
+      shard->error = xstrdup(error);
+      LLVMDisposeMessage(error);
+    }
+
+    LLVMDisposeModule(m);
+  }
+
+  LLVMDisposeMemoryBuffer(bitcode);
+  LLVMContextDispose(context);
+
+  return (NULL);
+} /* cgen_shard_main() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+cgen_shard_partition (
+  LLVMModuleRef m,
+  int           index,
+  int           nshards
+) {
+  // Assign each function to the least loaded shard measured in basic
+  // blocks: every shard starts from the same module so all agree on the
+  // assignment without communicating
+  size_t load[nshards];
+  for (int i = 0; i < nshards; i++) {
+    load[i] = 0;
+  }
+
+  LLVMValueRef fn = LLVMGetFirstFunction(m);
+  while (fn != NULL) {
+    LLVMValueRef next = LLVMGetNextFunction(fn);
+
+    // Functions imported from packages for inlining are kept everywhere
+    const LLVMLinkage linkage = LLVMGetLinkage(fn);
+    const bool local =
+      (linkage == LLVMInternalLinkage) || (linkage == LLVMPrivateLinkage)
+      || (linkage == LLVMAvailableExternallyLinkage);
+
+    if (!LLVMIsDeclaration(fn) && !local) {
+      int best = 0;
+      for (int i = 1; i < nshards; i++) {
+        if (load[i] < load[best]) {
+          best = i;
+        }
+      }
+
+      load[best] += LLVMCountBasicBlocks(fn);
+
+      if (best != index) {
+        cgen_shard_declare(fn);
+      }
+    }
+
+    fn = next;
+  }
+
+  // Local functions are only kept by the shards that still call them so
+  // code imported for inlining is not optimised again in every shard
+  bool changed;
+  do {
+    changed = false;
+
+    fn = LLVMGetFirstFunction(m);
+    while (fn != NULL) {
+      LLVMValueRef next = LLVMGetNextFunction(fn);
+
+      const LLVMLinkage linkage = LLVMGetLinkage(fn);
+      const bool local =
+        (linkage == LLVMInternalLinkage) || (linkage == LLVMPrivateLinkage)
+        || (linkage == LLVMAvailableExternallyLinkage);
+
+      if (local && !LLVMIsDeclaration(fn) && (LLVMGetFirstUse(fn) == NULL)) {
+        LLVMDeleteFunction(fn);
+        changed = true;
+      }
+
+      fn = next;
+    }
+  } while (changed);
+
+  // Global variables with external linkage are all defined by the first
+  // shard while local constants are duplicated where used
+  if (index > 0) {
+    LLVMValueRef global = LLVMGetFirstGlobal(m);
+    while (global != NULL) {
+      LLVMValueRef next = LLVMGetNextGlobal(global);
+
+      if (!LLVMIsDeclaration(global)
+          && (LLVMGetLinkage(global) == LLVMExternalLinkage)) {
+        cgen_shard_declare(global);
+      }
+
+      global = next;
+    }
+  }
+} /* cgen_shard_partition() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+cgen_shards (
+  tree_t               top,
+  LLVMTargetMachineRef tm_ref,
+  int                  jobs,
+  char               **obj_paths
+) {
+  // Mutable state private to a unit must be visible to the functions that
+  // use it in the other shards
+  for (LLVMValueRef global = LLVMGetFirstGlobal(module);
+    global != NULL;
+    global = LLVMGetNextGlobal(global)) {
+    const LLVMLinkage linkage = LLVMGetLinkage(global);
+    const bool local =
+      (linkage == LLVMInternalLinkage) || (linkage == LLVMPrivateLinkage);
+
+    if (local && !LLVMIsGlobalConstant(global)) {
+      if (*LLVMGetValueName(global) == '\0') {
+        LLVMSetValueName(global, "shard_state");
+      }
+      LLVMSetLinkage(global, LLVMExternalLinkage);
+      LLVMSetVisibility(global, LLVMHiddenVisibility);
+    }
+  }
+
+  LLVMMemoryBufferRef bitcode = LLVMWriteBitcodeToMemoryBuffer(module);
+
+  char *triple = LLVMGetTargetMachineTriple(tm_ref);
+  char *cpu = LLVMGetTargetMachineCPU(tm_ref);
+  char *features = LLVMGetTargetMachineFeatureString(tm_ref);
+
+  cgen_shard_t shards[jobs];
+  for (int i = 0; i < jobs; i++) {
+    obj_paths[i] = cgen_object_path(tree_ident(top), i, jobs);
+
+    shards[i].bitcode  = LLVMGetBufferStart(bitcode);
+    shards[i].size     = LLVMGetBufferSize(bitcode);
+    shards[i].index    = i;
+    shards[i].nshards  = jobs;
+    shards[i].obj_path = obj_paths[i];
+    shards[i].error    = NULL;
+    shards[i].tm_ref   =
+      LLVMCreateTargetMachine(LLVMGetTargetMachineTarget(tm_ref),
+        triple, cpu, features,
+        cgen_code_gen_level(),
+        LLVMRelocPIC,
+        LLVMCodeModelDefault);
+  }
+
+#ifdef HAVE_PTHREAD
+  pthread_t threads[jobs];
+  for (int i = 0; i < jobs; i++) {
+    const int err =
+      pthread_create(&(threads[i]), NULL, cgen_shard_main, &(shards[i]));
+    if (err != 0) {
+      fatal("pthread_create: %s", strerror(err));
+    }
+  }
+
+  for (int i = 0; i < jobs; i++) {
+    pthread_join(threads[i], NULL);
+  }
+#else
+  for (int i = 0; i < jobs; i++) {
+    cgen_shard_main(&(shards[i]));
+  }
+#endif
+
+  for (int i = 0; i < jobs; i++) {
+    if (shards[i].error != NULL) {
+      fatal("Failed to write object file for shard %d: %s", i,
+        shards[i].error);
+    }
+    LLVMDisposeTargetMachine(shards[i].tm_ref);
+  }
+
+  LLVMDisposeMessage(triple);
+  LLVMDisposeMessage(cpu);
+  LLVMDisposeMessage(features);
+  LLVMDisposeMemoryBuffer(bitcode);
+} /* cgen_shards() */
+
+/* ------------------------------------------------------------------------- */
+
+static LLVMValueRef
+cgen_shared_process_body (
+  shared_proc_t *shared
+) {
+  vcode_select_unit(shared->unit);
+
+  cgen_ctx_t ctx =
+  {
+    .refs  = shared->refs,
+    .nrefs = shared->nrefs
+  };
+
+  LLVMTypeRef state_type = cgen_state_type(&ctx);
+  LLVMTypeRef pargs[] = {
+    LLVMInt32Type(),
+    LLVMPointerType(state_type, 0),
+    LLVMPointerType(llvm_void_ptr(), 0)
+  };
+  LLVMTypeRef ftype =
+    LLVMFunctionType(LLVMVoidType(), pargs, ARRAY_LEN(pargs), false);
+
+  char *name LOCAL = xasprintf("%s.shared", istr(vcode_unit_name()));
+  LLVMValueRef fn = LLVMAddFunction(module, safe_symbol(name), ftype);
+  LLVMSetVisibility(fn, LLVMHiddenVisibility);
+  cgen_add_func_attr(fn, FUNC_ATTR_NOUNWIND, -1);
+
+  // Each instance passes its own state and reference table so stores to
+  // process variables cannot change the signals and variables it refers
+  // to: this lets them be kept in registers as when the net IDs and
+  // state are constants
+  cgen_add_func_attr(fn, FUNC_ATTR_NOALIAS, 2);
+  cgen_add_func_attr(fn, FUNC_ATTR_NOALIAS, 3);
+
+  ctx.fn = fn;
+  ctx.state = LLVMGetParam(fn, 1);
+  ctx.ref_table = LLVMGetParam(fn, 2);
+
+  // Processes with no references still need a non-NULL table so the
+  // body is generated in shared mode
+  static const vcode_global_ref_t no_refs[1];
+  if (ctx.refs == NULL) {
+    ctx.refs = no_refs;
+  }
+
+  cgen_process_body(&ctx, LLVMGetParam(fn, 0));
+
+  return (fn);
+} /* cgen_shared_process_body() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+cgen_shared_processes (
+  vcode_unit_t top
+) {
+  // Find processes that generate identical code apart from the signals
+  // and variables they reference, for example from repeated instances of
+  // the same architecture with the same generics, so the code can be
+  // generated once and shared between them
+
+  n_proc_shapes = 0;
+  for (vcode_unit_t it = vcode_unit_child(top);
+    it != NULL;
+    it = vcode_unit_next(it)) {
+    vcode_select_unit(it);
+    if (vcode_unit_kind() == VCODE_UNIT_PROCESS) {
+      n_proc_shapes++;
+    }
+  }
+
+  proc_shapes = xcalloc(n_proc_shapes * sizeof(proc_shape_t));
+
+  int nth = 0;
+  for (vcode_unit_t it = vcode_unit_child(top);
+    it != NULL;
+    it = vcode_unit_next(it)) {
+    vcode_select_unit(it);
+    if (vcode_unit_kind() == VCODE_UNIT_PROCESS) {
+      proc_shapes[nth].unit = it;
+      proc_shapes[nth].hash = vcode_unit_hash(it);
+      nth++;
+    }
+  }
+
+  qsort(proc_shapes, n_proc_shapes, sizeof(proc_shape_t),
+    cgen_proc_shape_cmp);
+
+  shared_procs = hash_new(64, true);
+
+  int nshared = 0;
+  for (int i = 0; i < n_proc_shapes; i++) {
+    if (proc_shapes[i].visited) {
+      continue;
+    }
+
+    proc_shapes[i].visited = true;
+
+    shared_proc_t *shared = NULL;
+    for (int j = i + 1;
+      (j < n_proc_shapes) && (proc_shapes[j].hash == proc_shapes[i].hash);
+      j++) {
+      if (proc_shapes[j].visited) {
+        continue;
+      } else if (!vcode_unit_equivalent(proc_shapes[i].unit,
+                   proc_shapes[j].unit)) {
+        continue;
+      }
+
+      if (shared == NULL) {
+        shared = xcalloc(sizeof(shared_proc_t));
+        shared->unit = proc_shapes[i].unit;
+        shared->nrefs = vcode_unit_global_refs(shared->unit, &(shared->refs));
+
+        proc_shapes[i].shared = shared;
+        hash_put(shared_procs, proc_shapes[i].unit, shared);
+        nshared++;
+      }
+
+      proc_shapes[j].visited = true;
+      proc_shapes[j].shared = shared;
+      hash_put(shared_procs, proc_shapes[j].unit, shared);
+      nshared++;
+    }
+  }
+
+  if (opt_get_int("verbose") && (nshared > 0)) {
+    notef("%d of %d processes share code", nshared, n_proc_shapes);
+  }
+} /* cgen_shared_processes() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+cgen_shared_processes_free (
+  void
+) {
+  // Each group is owned by its first member so walk backwards to avoid
+  // touching a group after it has been freed
+  for (int i = n_proc_shapes - 1; i >= 0; i--) {
+    shared_proc_t *shared = proc_shapes[i].shared;
+    if ((shared != NULL) && (shared->unit == proc_shapes[i].unit)) {
+      free(shared->refs);
+      free(shared);
+    }
+  }
+
+  free(proc_shapes);
+  proc_shapes = NULL;
+  n_proc_shapes = 0;
+
+  hash_free(shared_procs);
+  shared_procs = NULL;
+} /* cgen_shared_processes_free() */
+
+/* ------------------------------------------------------------------------- */
+
 static void
 cgen_shared_variables (
   void
@@ -4720,8 +6510,11 @@ cgen_shared_variables (
 
     LLVMTypeRef type = cgen_type(vcode_var_type(var));
     const char *name = safe_symbol(istr(vcode_var_name(var)));
-    LLVMValueRef global = LLVMAddGlobal(module, type, name);
+    LLVMValueRef global = cgen_global(type, name, !vcode_var_extern(var));
     if (vcode_var_extern(var)) {
+      if (LLVMGetInitializer(global) != NULL) {
+        continue;   // Already defined by another unit in this module
+      }
 #ifdef IMPLIB_REQUIRED
       LLVMSetDLLStorageClass(global, LLVMDLLImportStorageClass);
 #endif
@@ -4777,9 +6570,12 @@ cgen_signals (
     LLVMTypeRef nid_type = cgen_net_id_type();
     LLVMTypeRef map_type = LLVMArrayType(nid_type, nnets);
 
-    LLVMValueRef map_var = LLVMAddGlobal(module, map_type, buf);
-    if (vcode_signal_extern(i)) {
-      LLVMSetLinkage(map_var, LLVMExternalLinkage);
+    const bool is_extern = vcode_signal_extern(i);
+    LLVMValueRef map_var = cgen_global(map_type, buf, !is_extern);
+    if (is_extern) {
+      if (LLVMGetInitializer(map_var) == NULL) {
+        LLVMSetLinkage(map_var, LLVMExternalLinkage);
+      }
     } else {
       if ((nnets <= MAX_STATIC_NETS) && (nnets > 0) &&
         (nets[0] != NETID_INVALID)) {
@@ -4873,6 +6669,63 @@ cgen_signature (
 
 /* ------------------------------------------------------------------------- */
 
+static void
+cgen_single_image (
+  tree_t top
+) {
+  // Generate code for every package the design depends on into the same
+  // module so that the whole design links into one shared object
+  const int ncontext = tree_contexts(top);
+  for (int i = 0; i < ncontext; i++) {
+    tree_t c = tree_context(top, i);
+    if (tree_kind(c) != T_USE) {
+      continue;
+    }
+
+    ident_t name = tree_ident(c);
+    lib_t lib = lib_find(ident_until(name, '.'), true);
+
+    const int kind = lib_index_kind(lib, name);
+    if ((kind != T_PACKAGE) && (kind != T_PACK_BODY)) {
+      continue;
+    }
+
+    vcode_unit_t vu = vcode_find_unit(name);
+    if (vu == NULL) {
+      char *vcode_name LOCAL = vcode_file_name(name);
+      fbuf_t *f = lib_fbuf_open(lib, vcode_name, FBUF_IN);
+      if (f == NULL) {
+        char *so_name LOCAL = xasprintf("_%s." DLL_EXT, istr(name));
+        char so_path[PATH_MAX];
+        lib_realpath(lib, so_name, so_path, sizeof(so_path));
+
+        if (access(so_path, F_OK) == 0) {
+          fatal("cannot include %s in a single image as its intermediate "
+            "code is missing: reanalyse the package", istr(name));
+        }
+
+        continue;   // Package does not need any code
+      }
+
+      vcode_read(f);
+      fbuf_close(f);
+
+      if ((vu = vcode_find_unit(name)) == NULL) {
+        fatal("missing vcode unit for %s", istr(name));
+      }
+    }
+
+    tree_t unit = lib_get(lib, name);
+    if (unit == NULL) {
+      fatal("cannot find unit %s", istr(name));
+    }
+
+    cgen_top(unit, vu);
+  }
+} /* cgen_single_image() */
+
+/* ------------------------------------------------------------------------- */
+
 static void
 cgen_size_list (
   size_list_array_t    *list,
@@ -4971,6 +6824,151 @@ cgen_state_type (
 
 /* ------------------------------------------------------------------------- */
 
+static int
+cgen_static_initial_cmp (
+  const void *a,
+  const void *b
+) {
+  const static_init_t *sa = a;
+  const static_init_t *sb = b;
+
+  return ((sa->nid > sb->nid) - (sa->nid < sb->nid));
+} /* cgen_static_initial_cmp() */
+
+/* ------------------------------------------------------------------------- */
+
+static LLVMValueRef
+cgen_static_initial_data (
+  LLVMValueRef value
+) {
+  // Returns the constant initialiser for a signal's initial value or
+  // NULL if it is not known at compile time
+
+  if (!LLVMIsConstant(value)) {
+    return (NULL);
+  } else if (LLVMGetTypeKind(LLVMTypeOf(value)) != LLVMPointerTypeKind) {
+    return (value);    // Scalar constant
+  }
+
+  LLVMValueRef global = value;
+  if (LLVMIsAConstantExpr(value)) {
+    // Only accept a pointer to the start of a constant array
+    if (LLVMGetConstOpcode(value) != LLVMGetElementPtr) {
+      return (NULL);
+    }
+
+    const int nops = LLVMGetNumOperands(value);
+    for (int i = 1; i < nops; i++) {
+      LLVMValueRef index = LLVMGetOperand(value, i);
+      if (!LLVMIsAConstantInt(index) ||
+        (LLVMConstIntGetZExtValue(index) != 0)) {
+        return (NULL);
+      }
+    }
+
+    global = LLVMGetOperand(value, 0);
+  }
+
+  if (!LLVMIsAGlobalVariable(global) || !LLVMIsGlobalConstant(global)) {
+    return (NULL);
+  }
+
+  return (LLVMGetInitializer(global));
+} /* cgen_static_initial_data() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+cgen_static_initial_table (
+  void
+) {
+  // The initial values are concatenated in net order into a single
+  // read-only blob which the runtime copies into place with one memcpy
+  // and each table entry gives the offset of a signal within the blob
+
+  const unsigned count = static_inits.count;
+
+  qsort(static_inits.items, count, sizeof(static_init_t),
+    cgen_static_initial_cmp);
+
+  LLVMTypeRef entry_fields[] =
+  {
+    LLVMInt32Type(),
+    LLVMInt32Type(),
+    LLVMInt32Type(),
+    LLVMPointerType(llvm_size_list_type(), 0),
+    llvm_void_ptr()
+  };
+  LLVMTypeRef entry_type =
+    LLVMStructType(entry_fields, ARRAY_LEN(entry_fields), false);
+
+  LLVMValueRef *blob LOCAL = xmalloc(sizeof(LLVMValueRef) * count * 2);
+  LLVMValueRef *entries LOCAL = xmalloc(sizeof(LLVMValueRef) * count);
+
+  unsigned nblob = 0;
+  uint64_t offset = 0;
+  for (unsigned i = 0; i < count; i++) {
+    const static_init_t *init = &(static_inits.items[i]);
+
+    LLVMValueRef fields[] =
+    {
+      llvm_int32(init->nid),
+      llvm_int32(offset),
+      llvm_int32(init->nparts),
+      init->size_list,
+      init->name
+    };
+    entries[i] = LLVMConstStruct(fields, ARRAY_LEN(fields), false);
+
+    blob[nblob++] = init->data;
+
+    // Keep each signal's storage aligned to eight bytes
+    const uint64_t size =
+      LLVMABISizeOfType(data_layout, LLVMTypeOf(init->data));
+    const uint64_t padding = (8 - (size % 8)) % 8;
+    if (padding > 0) {
+      blob[nblob++] = LLVMConstNull(LLVMArrayType(LLVMInt8Type(), padding));
+    }
+
+    offset += size + padding;
+  }
+
+  if (offset > INT32_MAX) {
+    fatal("static initial values for design are too large");
+  }
+
+  LLVMValueRef data_init = LLVMConstStruct(blob, nblob, true);
+  LLVMValueRef data = LLVMAddGlobal(module, LLVMTypeOf(data_init),
+      "_initial_data");
+  LLVMSetGlobalConstant(data, true);
+  LLVMSetInitializer(data, data_init);
+  LLVMSetAlignment(data, 8);
+  cgen_add_func_attr(data, FUNC_ATTR_DLLEXPORT, -1);
+
+  LLVMValueRef table = LLVMAddGlobal(module,
+      LLVMArrayType(entry_type, count), "_initial_table");
+  LLVMSetGlobalConstant(table, true);
+  LLVMSetInitializer(table, LLVMConstArray(entry_type, entries, count));
+  cgen_add_func_attr(table, FUNC_ATTR_DLLEXPORT, -1);
+
+  LLVMValueRef size = LLVMAddGlobal(module, LLVMInt32Type(), "_initial_size");
+  LLVMSetGlobalConstant(size, true);
+  LLVMSetInitializer(size, llvm_int32(offset));
+  cgen_add_func_attr(size, FUNC_ATTR_DLLEXPORT, -1);
+
+  LLVMValueRef nentries =
+    LLVMAddGlobal(module, LLVMInt32Type(), "_initial_count");
+  LLVMSetGlobalConstant(nentries, true);
+  LLVMSetInitializer(nentries, llvm_int32(count));
+  cgen_add_func_attr(nentries, FUNC_ATTR_DLLEXPORT, -1);
+
+  free(static_inits.items);
+  static_inits.items = NULL;
+  static_inits.count = 0;
+} /* cgen_static_initial_table() */
+
+/* ------------------------------------------------------------------------- */
+
 static LLVMValueRef
 cgen_subprogram_arg (
   int         op,
@@ -5011,6 +7009,12 @@ cgen_subprograms (
       case VCODE_UNIT_PROCEDURE:
       case VCODE_UNIT_FUNCTION:
         {
+          LLVMValueRef fn = LLVMGetNamedFunction(module,
+              safe_symbol(istr(vcode_unit_name())));
+          if ((fn != NULL) && (LLVMCountBasicBlocks(fn) > 0)) {
+            break;   // Already generated for another unit in this module
+          }
+
           cgen_subprograms(it);
           if ((display == NULL) && needs_display) {
             display = cgen_display_type(vcode);
@@ -5027,7 +7031,17 @@ cgen_subprograms (
       case VCODE_UNIT_PROCESS:
         {
           cgen_subprograms(it);
-          cgen_process(it);
+
+          shared_proc_t *shared = NULL;
+          if (shared_procs != NULL) {
+            shared = hash_get(shared_procs, it);
+          }
+
+          if (shared != NULL) {
+            cgen_process_instance(it, shared);
+          } else {
+            cgen_process(it);
+          }
         }
         break;
 
@@ -5105,6 +7119,7 @@ cgen_support_fn (
       LLVMInt32Type(),
       LLVMInt32Type(),
       llvm_void_ptr(),
+      llvm_void_ptr(),
       LLVMPointerType(LLVMInt8Type(), 0)
     };
     fn = LLVMAddFunction(module, "_set_initial_1",
@@ -5200,6 +7215,11 @@ cgen_support_fn (
     fn = LLVMAddFunction(module, "llvm.pow.f64",
         LLVMFunctionType(LLVMDoubleType(),
         args, ARRAY_LEN(args), false));
+  } else if (strcmp(name, "malloc") == 0) {
+    LLVMTypeRef args[] = { LLVMIntPtrType(data_layout) };
+    fn = LLVMAddFunction(module, "malloc",
+        LLVMFunctionType(llvm_void_ptr(),
+        args, ARRAY_LEN(args), false));
   } else if (strcmp(name, "llvm.memset.p0i8.i32") == 0) {
     LLVMTypeRef args[] =
     {
@@ -5343,6 +7363,19 @@ cgen_support_fn (
     fn = LLVMAddFunction(module, "_bit_vec_op",
         LLVMFunctionType(LLVMVoidType(),
         args, ARRAY_LEN(args), false));
+  } else if (strcmp(name, "_ieee_intrinsic") == 0) {
+    LLVMTypeRef args[] =
+    {
+      LLVMInt32Type(),
+      LLVMPointerType(llvm_uarray_type(LLVMInt8Type(), 1), 0),
+      LLVMPointerType(llvm_uarray_type(LLVMInt8Type(), 1), 0),
+      LLVMInt32Type(),
+      LLVMInt32Type(),
+      llvm_void_ptr()
+    };
+    fn = LLVMAddFunction(module, "_ieee_intrinsic",
+        LLVMFunctionType(LLVMInt8Type(),
+        args, ARRAY_LEN(args), false));
   } else if (strcmp(name, "_test_net_flag") == 0) {
     LLVMTypeRef args[] =
     {
@@ -5445,8 +7478,23 @@ cgen_top (
   cgen_coverage_state(t);
   cgen_shared_variables();
   cgen_signals();
+
+  // Signals in the elaborated design with constant initial values are
+  // placed in a static table rather than set by the reset function
+  static_initial = (tree_kind(t) == T_ELAB);
   cgen_reset_function(t);
-  cgen_subprograms(vcode);
+  if (static_initial) {
+    cgen_static_initial_table();
+    static_initial = false;
+  }
+
+  if (tree_kind(t) == T_ELAB) {
+    cgen_shared_processes(vcode);
+    cgen_subprograms(vcode);
+    cgen_shared_processes_free();
+  } else {
+    cgen_subprograms(vcode);
+  }
 } /* cgen_top() */
 
 /* ------------------------------------------------------------------------- */
@@ -5548,6 +7596,18 @@ cgen_uarray_dim (
 
 /* ------------------------------------------------------------------------- */
 
+static void
+cgen_unit_bitcode_path (
+  ident_t  unit_name,
+  char    *path,
+  size_t   len
+) {
+  char *bc_name LOCAL = xasprintf("_%s.bc", istr(unit_name));
+  lib_realpath(lib_work(), bc_name, path, len);
+} /* cgen_unit_bitcode_path() */
+
+/* ------------------------------------------------------------------------- */
+
 #if 0
 static void
 debug_dump (
@@ -5701,7 +7761,8 @@ llvm_size_list_type (
     LLVMInt32Type(),
     LLVMInt32Type(),
     llvm_void_ptr(),
-    LLVMInt32Type()
+    LLVMInt32Type(),
+    llvm_void_ptr()
   };
 
   return (LLVMStructType(struct_elems, ARRAY_LEN(struct_elems), false));
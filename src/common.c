@@ -303,14 +303,17 @@ call_builtin (
     decl = tree_new(T_FUNC_DECL);
     tree_set_ident(decl, name_i);
     tree_add_attr_str(decl, builtin_i, ident_new(builtin));
-  }
 
-  struct decl_cache *c = xmalloc(sizeof(struct decl_cache));
-  c->next = cache;
-  c->bname = bname;
-  c->decl = decl;
+    // Kept for the life of the process even if every call is folded
+    tree_add_gc_root(decl);
+
+    struct decl_cache *c = xmalloc(sizeof(struct decl_cache));
+    c->next = cache;
+    c->bname = bname;
+    c->decl = decl;
 
-  cache = c;
+    cache = c;
+  }
 
   tree_t call = tree_new(T_FCALL);
   tree_set_ident(call, name_i);
@@ -876,7 +879,6 @@ intern_strings (
   fst_dir_i = ident_new("fst_dir");
   scope_pop_i = ident_new("scope_pop");
   partial_map_i = ident_new("partial_map");
-  fst_data_i = ident_new("fst_data");
   std_logic_i = ident_new("IEEE.STD_LOGIC_1164.STD_LOGIC");
   std_ulogic_i = ident_new("IEEE.STD_LOGIC_1164.STD_ULOGIC");
   std_bit_i = ident_new("STD.STANDARD.BIT");
@@ -888,7 +890,6 @@ intern_strings (
   unsigned_i = ident_new("IEEE.NUMERIC_STD.UNSIGNED");
   foreign_i = ident_new("FOREIGN");
   nested_i = ident_new("nested");
-  drives_all_i = ident_new("drives_all");
   driver_init_i = ident_new("driver_init");
   static_i = ident_new("static");
   mangled_i = ident_new("mangled");
@@ -906,6 +907,11 @@ intern_strings (
   std_i = ident_new("STD");
   nnets_i = ident_new("nnets");
   thunk_i = ident_new("thunk");
+  single_image_i = ident_new("single_image");
+  is_report_i = ident_new("is_report");
+  returned_i = ident_new("returned");
+  stmt_tags_i = ident_new("stmt_tags");
+  cond_tags_i = ident_new("cond_tags");
 } /* intern_strings() */
 
 /* ------------------------------------------------------------------------- */
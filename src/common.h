@@ -167,7 +167,6 @@ GLOBAL ident_t inst_name_i;
 GLOBAL ident_t fst_dir_i;
 GLOBAL ident_t scope_pop_i;
 GLOBAL ident_t partial_map_i;
-GLOBAL ident_t fst_data_i;
 GLOBAL ident_t std_logic_i;
 GLOBAL ident_t std_ulogic_i;
 GLOBAL ident_t std_bool_i;
@@ -179,7 +178,6 @@ GLOBAL ident_t unsigned_i;
 GLOBAL ident_t signed_i;
 GLOBAL ident_t foreign_i;
 GLOBAL ident_t nested_i;
-GLOBAL ident_t drives_all_i;
 GLOBAL ident_t driver_init_i;
 GLOBAL ident_t GLOBAL_i;
 GLOBAL ident_t mangled_i;
@@ -198,6 +196,11 @@ GLOBAL ident_t simple_name_i;
 GLOBAL ident_t std_i;
 GLOBAL ident_t nnets_i;
 GLOBAL ident_t thunk_i;
+GLOBAL ident_t single_image_i;
+GLOBAL ident_t is_report_i;
+GLOBAL ident_t returned_i;
+GLOBAL ident_t stmt_tags_i;
+GLOBAL ident_t cond_tags_i;
 
 void intern_strings();
 
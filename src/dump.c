@@ -193,7 +193,7 @@ void
 dump_nets (
   tree_t top
 ) {
-  net_hash = hash_new(2048, false);
+  net_hash = hash_new_kind(2048, false, HASH_INTEGER);
 
   const int ndecls = tree_decls(top);
   for (int i = 0; i < ndecls; i++) {
@@ -205,7 +205,7 @@ dump_nets (
 
     const int nnets = tree_nets(d);
     for (int j = 0; j < nnets; j++) {
-      hash_put(net_hash, (const void *) (uintptr_t) (tree_net(d, j) + 1), d);
+      hash_put(net_hash, HASH_INT_KEY(tree_net(d, j)), d);
     }
   }
 
@@ -634,7 +634,7 @@ dump_decl (
   }
   printf(";");
 
-  if (tree_attr_int(t, ident_new("returned"), 0)) {
+  if (tree_attr_int(t, returned_i, 0)) {
     syntax(" -- returned");
   }
 
@@ -920,8 +920,7 @@ dump_group_fn (
   tree_t d;
 
   while ((tmp = k++),
-    (d = hash_get_nth(net_hash,
-    (const void *) (uintptr_t) (first + 1), &tmp))) {
+    (d = hash_get_nth(net_hash, HASH_INT_KEY(first), &tmp))) {
     if (k == 1) {
       char buf[64];
       checked_sprintf(buf, sizeof(buf), "%d..%d", first, first + length - 1);
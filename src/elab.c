@@ -24,6 +24,7 @@
 #include "util.h"
 #include "common.h"
 #include "rt/cover.h"
+#include "hash.h"
 
 #include <ctype.h>
 #include <assert.h>
@@ -83,13 +84,6 @@ typedef struct map_list {
   tree_t           name;
 } map_list_t;
 
-typedef struct copy_list copy_list_t;
-
-struct copy_list {
-  copy_list_t *next;
-  tree_t       tree;
-};
-
 typedef struct {
   lib_t   lib;
   ident_t name;
@@ -127,6 +121,7 @@ static bool elab_compatible_map(tree_t comp, tree_t entity, char *what,
 static void elab_context_walk_fn(ident_t name, int kind, void *context);
 static tree_t elab_copy(tree_t t);
 static void elab_copy_context(tree_t src, const elab_ctx_t *ctx);
+static hash_t *elab_copy_set(tree_t t);
 static bool elab_copy_trees(tree_t t, void *context);
 static void elab_decls(tree_t t, const elab_ctx_t *ctx);
 static tree_t elab_default_binding(tree_t inst, lib_t *new_lib,
@@ -242,6 +237,10 @@ elab (
     cover_tag(e);
   }
 
+  if (opt_get_int("single-image")) {
+    tree_add_attr_int(e, single_image_i, 1);
+  }
+
   for (generic_list_t *it = generic_override; it != NULL; it = it->next) {
     if (!it->used) {
       warnf("generic value for %s not used", istr(it->name));
@@ -369,14 +368,10 @@ elab_build_copy_list (
   tree_t t,
   void  *context
 ) {
-  copy_list_t **list = context;
+  hash_t *set = context;
 
   if (elab_should_copy(t)) {
-    copy_list_t *new = xmalloc(sizeof(copy_list_t));
-    new->tree = t;
-    new->next = *list;
-
-    *list = new;
+    hash_put(set, t, t);
   }
 } /* elab_build_copy_list() */
 
@@ -465,22 +460,11 @@ static tree_t
 elab_copy (
   tree_t t
 ) {
-  copy_list_t *copy_list = NULL;
+  hash_t *copy_set = elab_copy_set(t);
 
-  tree_visit(t, elab_build_copy_list, &copy_list);
+  tree_t copy = tree_copy(t, elab_copy_trees, copy_set, false);
 
-  // For achitectures, also make a copy of the entity ports
-  if (tree_kind(t) == T_ARCH) {
-    tree_visit(tree_ref(t), elab_build_copy_list, &copy_list);
-  }
-
-  tree_t copy = tree_copy(t, elab_copy_trees, copy_list);
-
-  while (copy_list != NULL) {
-    copy_list_t *tmp = copy_list->next;
-    free(copy_list);
-    copy_list = tmp;
-  }
+  hash_free(copy_set);
 
   return (copy);
 } /* elab_copy() */
@@ -522,22 +506,30 @@ elab_copy_context (
 
 /* ------------------------------------------------------------------------- */
 
+static hash_t *
+elab_copy_set (
+  tree_t t
+) {
+  hash_t *set = hash_new(256, true);
+
+  tree_visit(t, elab_build_copy_list, set);
+
+  // For achitectures, also make a copy of the entity ports
+  if (tree_kind(t) == T_ARCH) {
+    tree_visit(tree_ref(t), elab_build_copy_list, set);
+  }
+
+  return (set);
+} /* elab_copy_set() */
+
+/* ------------------------------------------------------------------------- */
+
 static bool
 elab_copy_trees (
   tree_t t,
   void  *context
 ) {
-  copy_list_t *list = context;
-
-  if (elab_should_copy(t)) {
-    for ( ; list != NULL; list = list->next) {
-      if (list->tree == t) {
-        return (true);
-      }
-    }
-  }
-
-  return (false);
+  return (elab_should_copy(t) && (hash_get(context, t) != NULL));
 } /* elab_copy_trees() */
 
 /* ------------------------------------------------------------------------- */
@@ -763,8 +755,28 @@ elab_for_generate (
 
   range_bounds(tree_range(t, 0), &low, &high);
 
+  // Nothing is elaborated for a null range so the body is not checked
+  // either: it may only be valid for values of the generate parameter
+  if (low > high) {
+    return;
+  }
+
+  // Simplify and check the parts of the body that do not depend on the
+  // generate parameter once: each iteration then only copies, folds and
+  // checks the trees that reference the parameter or need a separate
+  // copy per instance and shares the rest with this template
+
+  simplify(t, EVAL_LOWER);
+  bounds_check(t);
+
+  if (eval_errors() > 0) {
+    return;
+  }
+
+  hash_t *copy_set = elab_copy_set(t);
+
   for (int64_t i = low; i <= high; i++) {
-    tree_t copy = elab_copy(t);
+    tree_t copy = tree_copy(t, elab_copy_trees, copy_set, true);
 
     tree_t genvar = tree_ref(copy);
 
@@ -783,6 +795,7 @@ elab_for_generate (
     tree_rewrite(copy, rewrite_refs, &params);
     simplify(copy, EVAL_LOWER);
     bounds_check(copy);
+    tree_copy_unrestrict(copy);
 
     if (eval_errors() > 0) {
       break;
@@ -806,6 +819,8 @@ elab_for_generate (
     elab_stmts(copy, &new_ctx);
     elab_pop_scope(&new_ctx);
   }
+
+  hash_free(copy_set);
 } /* elab_for_generate() */
 
 /* ------------------------------------------------------------------------- */
@@ -2987,7 +2987,9 @@ eval_vcode (
 
       case VCODE_OP_FCALL:
       case VCODE_OP_NESTED_FCALL:
+      case VCODE_OP_INTRINSIC:
         {
+          // Intrinsics are folded by evaluating the VHDL definition
           if (state->flags & EVAL_FCALL) {
             eval_op_fcall(i, state);
           } else {
@@ -23,6 +23,7 @@
 #include "util.h"
 #include "fbuf.h"
 #include "fastlz.h"
+#include "lz4.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -32,6 +33,10 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 /* System Inclusions */
 
 /* Project Inclusions */
@@ -42,6 +47,9 @@
 
 #define SPILL_SIZE    65536
 #define BLOCK_SIZE    (SPILL_SIZE - (SPILL_SIZE / 16))
+#define CODEC_MAGIC   0xf0
+#define MAX_THREADS   4
+#define MAX_INFLIGHT  (2 * MAX_THREADS)
 
 /* ========================================================================= */
 /* -- PRIVATE MACROS ------------------------------------------------------- */
@@ -51,24 +59,44 @@
 /* -- PRIVATE TYPEDEFS ----------------------------------------------------- */
 /* ========================================================================= */
 
+typedef struct block block_t;
+
 /* ========================================================================= */
 /* -- PRIVATE STRUCTURES --------------------------------------------------- */
 /* ========================================================================= */
 
+struct block {
+  fbuf_codec_t codec;
+  uint8_t     *in;
+  size_t       inlen;
+  uint8_t     *out;
+  int          outlen;
+  bool         queued;
+  bool         done;
+  block_t     *next;
+  block_t     *qnext;
+};
+
 struct fbuf {
-  fbuf_mode_t mode;
-  char       *fname;
-  FILE       *file;
-  uint8_t    *wbuf;
-  size_t      wpend;
-  uint8_t    *rbuf;
-  size_t      rptr;
-  size_t      ravail;
-  size_t      roff;
-  uint8_t    *rmap;
-  size_t      maplen;
-  fbuf_t     *next;
-  fbuf_t     *prev;
+  fbuf_mode_t  mode;
+  fbuf_codec_t codec;
+  char        *fname;
+  FILE        *file;
+  uint8_t     *wbuf;
+  size_t       wpend;
+  uint8_t     *rbuf;
+  size_t       rptr;
+  size_t       ravail;
+  size_t       roff;
+  uint8_t     *rmap;
+  size_t       maplen;
+  bool         rheap;
+  block_t     *pending;
+  block_t     *pending_tail;
+  unsigned     npending;
+  uint64_t     digest;
+  fbuf_t      *next;
+  fbuf_t      *prev;
 };
 
 /* ========================================================================= */
@@ -79,8 +107,16 @@ struct fbuf {
 /* -- STATIC FUNCTION PROTOTYPES ------------------------------------------- */
 /* ========================================================================= */
 
+static void fbuf_compress(block_t *b);
+static void fbuf_drain(fbuf_t *f, unsigned keep);
+static fbuf_t *fbuf_link(fbuf_t *f);
 static void fbuf_maybe_flush(fbuf_t *f, size_t more, bool finish);
 static void fbuf_maybe_read(fbuf_t *f, size_t more);
+static bool fbuf_pool_start(void);
+#ifdef HAVE_PTHREAD
+static void *fbuf_worker(void *arg);
+#endif
+static void fbuf_write_block(fbuf_t *f, const uint8_t *data, int len);
 
 /* ========================================================================= */
 /* -- PRIVATE DATA --------------------------------------------------------- */
@@ -88,6 +124,22 @@ static void fbuf_maybe_read(fbuf_t *f, size_t more);
 
 static fbuf_t *open_list = NULL;
 
+static const char *codec_names[] = { "fastlz", "lz4", "none" };
+
+#ifdef HAVE_PTHREAD
+// Workers shared by all output files that compress full blocks while
+// the caller carries on serialising
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t  work;
+  pthread_cond_t  done;
+  block_t        *head;
+  block_t        *tail;
+  int             nthreads;
+  pid_t           pid;
+} pool;
+#endif
+
 /* ========================================================================= */
 /* -- EXPORTED DATA -------------------------------------------------------- */
 /* ========================================================================= */
@@ -105,7 +157,7 @@ fbuf_cleanup (
   void
 ) {
   for (fbuf_t *it = open_list; it != NULL; it = it->next) {
-    if (it->mode == FBUF_OUT) {
+    if ((it->mode == FBUF_OUT) && (it->file != NULL)) {
       fclose(it->file);
       remove(it->fname);
     }
@@ -119,8 +171,14 @@ fbuf_close (
   fbuf_t *f
 ) {
   if (f->rmap != NULL) {
-    unmap_file((void *) f->rmap, f->maplen);
-    free(f->rbuf);
+    if (f->rheap) {
+      free(f->rmap);
+    } else {
+      unmap_file((void *) f->rmap, f->maplen);
+    }
+    if (f->codec != FBUF_CODEC_NONE) {
+      free(f->rbuf);
+    }
   }
 
   if (f->wbuf != NULL) {
@@ -151,6 +209,45 @@ fbuf_close (
 
 /* ------------------------------------------------------------------------- */
 
+bool
+fbuf_codec_parse (
+  const char   *str,
+  fbuf_codec_t *codec
+) {
+  for (size_t i = 0; i < ARRAY_LEN(codec_names); i++) {
+    if (strcmp(str, codec_names[i]) == 0) {
+      *codec = i;
+      return (true);
+    }
+  }
+
+  return (false);
+} /* fbuf_codec_parse() */
+
+/* ------------------------------------------------------------------------- */
+
+const char *
+fbuf_codec_str (
+  fbuf_codec_t codec
+) {
+  assert(codec < ARRAY_LEN(codec_names));
+  return (codec_names[codec]);
+} /* fbuf_codec_str() */
+
+/* ------------------------------------------------------------------------- */
+
+uint64_t
+fbuf_digest (
+  fbuf_t *f
+) {
+  assert((f->mode == FBUF_OUT) && (f->file == NULL));
+
+  fbuf_maybe_flush(f, BLOCK_SIZE, true);
+  return (f->digest);
+} /* fbuf_digest() */
+
+/* ------------------------------------------------------------------------- */
+
 const char *
 fbuf_file_name (
   fbuf_t *f
@@ -162,8 +259,9 @@ fbuf_file_name (
 
 fbuf_t *
 fbuf_open (
-  const char *file,
-  fbuf_mode_t mode
+  const char  *file,
+  fbuf_mode_t  mode,
+  fbuf_codec_t codec
 ) {
   fbuf_t *f = NULL;
 
@@ -183,6 +281,14 @@ fbuf_open (
         f->rbuf = NULL;
         f->wbuf = xmalloc(SPILL_SIZE);
         f->wpend = 0;
+        f->codec = codec;
+        f->pending = NULL;
+        f->pending_tail = NULL;
+        f->npending = 0;
+
+        if (fputc(CODEC_MAGIC | codec, h) == EOF) {
+          fatal("fputc failed");
+        }
       }
       break;
 
@@ -206,27 +312,112 @@ fbuf_open (
 
         f->file = NULL;
         f->rmap = rmap;
-        f->rbuf = xmalloc(SPILL_SIZE);
         f->rptr = 0;
         f->roff = 0;
-        f->ravail = 0;
         f->maplen = buf.st_size;
+        f->rheap = false;
         f->wbuf = NULL;
+        f->pending = NULL;
+        f->codec = FBUF_CODEC_FASTLZ;
+
+        // Files written before the codec byte was added start with the
+        // high byte of a fastlz block size which is always zero
+        const uint8_t magic = (f->maplen > 0) ? f->rmap[0] : 0;
+        if ((magic & CODEC_MAGIC) == CODEC_MAGIC) {
+          if ((magic & ~CODEC_MAGIC) >= ARRAY_LEN(codec_names)) {
+            fatal("file %s has unknown compression format %x", file, magic);
+          }
+          f->codec = magic & ~CODEC_MAGIC;
+          f->roff = 1;
+        }
+
+        if (f->codec == FBUF_CODEC_NONE) {
+          // Read fields directly from the mapping
+          f->rbuf = f->rmap + f->roff;
+          f->ravail = f->maplen - f->roff;
+        } else {
+          f->rbuf = xmalloc(SPILL_SIZE);
+          f->ravail = 0;
+        }
       }
       break;
   }
 
   f->fname = strdup(file);
   f->mode = mode;
-  f->next = open_list;
-  f->prev = NULL;
 
-  if (open_list != NULL) {
-    open_list->prev = f;
+  return (fbuf_link(f));
+} /* fbuf_open() */
+
+/* ------------------------------------------------------------------------- */
+
+fbuf_t *
+fbuf_open_digest (
+  void
+) {
+  // Output is hashed as it is flushed rather than written anywhere
+  fbuf_t *f = xmalloc(sizeof(struct fbuf));
+
+  f->file = NULL;
+  f->rmap = NULL;
+  f->rbuf = NULL;
+  f->wbuf = xmalloc(SPILL_SIZE);
+  f->wpend = 0;
+  f->codec = FBUF_CODEC_NONE;
+  f->pending = NULL;
+  f->pending_tail = NULL;
+  f->npending = 0;
+  f->digest = UINT64_C(14695981039346656037);
+  f->fname = NULL;
+  f->mode = FBUF_OUT;
+
+  return (fbuf_link(f));
+} /* fbuf_open_digest() */
+
+/* ------------------------------------------------------------------------- */
+
+fbuf_t *
+fbuf_snapshot (
+  fbuf_t *f
+) {
+  assert(f->mode == FBUF_IN);
+
+  // Copy the unread part of the file into memory so the snapshot stays
+  // valid after the original is closed or the file is rewritten
+  fbuf_t *s = xmalloc(sizeof(struct fbuf));
+
+  s->file = NULL;
+  s->rheap = true;
+  s->roff = 0;
+  s->wbuf = NULL;
+
+  s->pending = NULL;
+
+  if (f->codec == FBUF_CODEC_NONE) {
+    s->maplen = f->ravail - f->rptr;
+    s->rmap = xmalloc(MAX(s->maplen, 1));
+    s->rbuf = s->rmap;
+    s->rptr = 0;
+    s->ravail = s->maplen;
+
+    memcpy(s->rmap, f->rbuf + f->rptr, s->maplen);
+  } else {
+    s->maplen = f->maplen - f->roff;
+    s->rmap = xmalloc(MAX(s->maplen, 1));
+    s->rbuf = xmalloc(SPILL_SIZE);
+    s->rptr = f->rptr;
+    s->ravail = f->ravail;
+
+    memcpy(s->rmap, f->rmap + f->roff, s->maplen);
+    memcpy(s->rbuf, f->rbuf, f->ravail);
   }
 
-  return (open_list = f);
-} /* fbuf_open() */
+  s->fname = strdup(f->fname);
+  s->mode = FBUF_IN;
+  s->codec = f->codec;
+
+  return (fbuf_link(s));
+} /* fbuf_snapshot() */
 
 /* ------------------------------------------------------------------------- */
 
@@ -258,6 +449,27 @@ read_raw (
 
 /* ------------------------------------------------------------------------- */
 
+void
+read_u32_array (
+  uint32_t *buf,
+  size_t    count,
+  fbuf_t   *f
+) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  // The file encoding matches the host so copy whole blocks at a time
+  const size_t chunk = BLOCK_SIZE / sizeof(uint32_t);
+  for (size_t i = 0; i < count; i += chunk) {
+    read_raw(buf + i, MIN(chunk, count - i) * sizeof(uint32_t), f);
+  }
+#else
+  for (size_t i = 0; i < count; i++) {
+    buf[i] = read_u32(f);
+  }
+#endif
+} /* read_u32_array() */
+
+/* ------------------------------------------------------------------------- */
+
 uint16_t
 read_u16 (
   fbuf_t *f
@@ -347,6 +559,26 @@ write_raw (
 
 /* ------------------------------------------------------------------------- */
 
+void
+write_u32_array (
+  const uint32_t *buf,
+  size_t          count,
+  fbuf_t         *f
+) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  const size_t chunk = BLOCK_SIZE / sizeof(uint32_t);
+  for (size_t i = 0; i < count; i += chunk) {
+    write_raw(buf + i, MIN(chunk, count - i) * sizeof(uint32_t), f);
+  }
+#else
+  for (size_t i = 0; i < count; i++) {
+    write_u32(buf[i], f);
+  }
+#endif
+} /* write_u32_array() */
+
+/* ------------------------------------------------------------------------- */
+
 void
 write_u16 (
   uint16_t s,
@@ -408,6 +640,96 @@ write_u8 (
 /* -- STATIC FUNCTION DEFINITIONS ------------------------------------------ */
 /* ========================================================================= */
 
+static void
+fbuf_compress (
+  block_t *b
+) {
+  // Called from worker threads so must not touch any shared state
+  switch (b->codec)
+  {
+    case FBUF_CODEC_FASTLZ:
+      {
+        b->outlen = fastlz_compress_level(2, b->in, b->inlen, b->out);
+      }
+      break;
+
+    case FBUF_CODEC_LZ4:
+      {
+        b->outlen = LZ4_compress_default((const char *) b->in,
+          (char *) b->out, b->inlen, SPILL_SIZE);
+      }
+      break;
+
+    default:
+      abort();
+  }
+
+  assert((b->outlen > 0) && (b->outlen < SPILL_SIZE));
+} /* fbuf_compress() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+fbuf_drain (
+  fbuf_t  *f,
+  unsigned keep
+) {
+  // Write out compressed blocks in order waiting until no more than
+  // keep blocks are still outstanding
+
+  while (f->pending != NULL) {
+    block_t *b = f->pending;
+
+#ifdef HAVE_PTHREAD
+    if (b->queued) {
+      pthread_mutex_lock(&pool.lock);
+      if (f->npending > keep) {
+        while (!b->done) {
+          pthread_cond_wait(&pool.done, &pool.lock);
+        }
+      }
+      const bool done = b->done;
+      pthread_mutex_unlock(&pool.lock);
+
+      if (!done) {
+        break;
+      }
+    }
+#endif
+
+    fbuf_write_block(f, b->out, b->outlen);
+
+    f->pending = b->next;
+    f->npending--;
+
+    free(b->in);
+    free(b->out);
+    free(b);
+  }
+
+  if (f->pending == NULL) {
+    f->pending_tail = NULL;
+  }
+} /* fbuf_drain() */
+
+/* ------------------------------------------------------------------------- */
+
+static fbuf_t *
+fbuf_link (
+  fbuf_t *f
+) {
+  f->next = open_list;
+  f->prev = NULL;
+
+  if (open_list != NULL) {
+    open_list->prev = f;
+  }
+
+  return (open_list = f);
+} /* fbuf_link() */
+
+/* ------------------------------------------------------------------------- */
+
 static void
 fbuf_maybe_flush (
   fbuf_t *f,
@@ -416,34 +738,79 @@ fbuf_maybe_flush (
 ) {
   assert(more <= BLOCK_SIZE);
   if (f->wpend + more > BLOCK_SIZE) {
-    if (f->wpend < 16) {
+    if ((f->codec == FBUF_CODEC_NONE) && (f->file == NULL)) {
+      // 64-bit FNV-1a
+      for (size_t i = 0; i < f->wpend; i++) {
+        f->digest ^= f->wbuf[i];
+        f->digest *= UINT64_C(1099511628211);
+      }
+
+      f->wpend = 0;
+      return;
+    } else if (f->codec == FBUF_CODEC_NONE) {
+      if ((f->wpend > 0) && (fwrite(f->wbuf, f->wpend, 1, f->file) != 1)) {
+        fatal("fwrite failed");
+      }
+
+      f->wpend = 0;
+      return;
+    }
+
+    if ((f->codec == FBUF_CODEC_FASTLZ) && (f->wpend < 16)) {
       // Write dummy bytes at end to meet fastlz block size requirement
       assert(finish);
       f->wpend = 16;
+    } else if (f->wpend == 0) {
+      assert(finish);
+      fbuf_drain(f, 0);
+      return;
     }
 
-    uint8_t out[SPILL_SIZE];
-    const int ret = fastlz_compress_level(2, f->wbuf, f->wpend, out);
-
-    assert((ret > 0) && (ret < SPILL_SIZE));
+    block_t *b = xmalloc(sizeof(block_t));
+    b->codec = f->codec;
+    b->in = f->wbuf;
+    b->inlen = f->wpend;
+    b->out = xmalloc(SPILL_SIZE);
+    b->queued = false;
+    b->done = false;
+    b->next = NULL;
+    b->qnext = NULL;
+
+    if (f->pending_tail == NULL) {
+      f->pending = b;
+    } else {
+      f->pending_tail->next = b;
+    }
+    f->pending_tail = b;
+    f->npending++;
 
-    const uint8_t blksz[4] =
-    {
-      (ret >> 24) & 0xff,
-      (ret >> 16) & 0xff,
-      (ret >> 8) & 0xff,
-      ret & 0xff
-    };
+    f->wbuf = xmalloc(SPILL_SIZE);
+    f->wpend = 0;
 
-    if (fwrite(blksz, 4, 1, f->file) != 1) {
-      fatal("fwrite failed");
-    }
+    if (!finish && fbuf_pool_start()) {
+#ifdef HAVE_PTHREAD
+      b->queued = true;
 
-    if (fwrite(out, ret, 1, f->file) != 1) {
-      fatal("fwrite failed");
+      pthread_mutex_lock(&pool.lock);
+      if (pool.tail == NULL) {
+        pool.head = b;
+      } else {
+        pool.tail->qnext = b;
+      }
+      pool.tail = b;
+      pthread_cond_signal(&pool.work);
+      pthread_mutex_unlock(&pool.lock);
+#endif
+
+      fbuf_drain(f, MAX_INFLIGHT);
+    } else {
+      // Most files fit in a single block which is cheaper to compress
+      // here than to hand over to a worker
+      fbuf_compress(b);
+      b->done = true;
+
+      fbuf_drain(f, 0);
     }
-
-    f->wpend = 0;
   }
 } /* fbuf_maybe_flush() */
 
@@ -456,9 +823,17 @@ fbuf_maybe_read (
 ) {
   assert(more <= BLOCK_SIZE);
   if (f->rptr + more > f->ravail) {
+    if (f->codec == FBUF_CODEC_NONE) {
+      fatal_trace("read past end of file %s", f->fname);
+    }
+
     const size_t overlap = f->ravail - f->rptr;
     memcpy(f->rbuf, f->rbuf + f->rptr, overlap);
 
+    if (f->roff + sizeof(uint32_t) > f->maplen) {
+      fatal_trace("read past end of compressed file %s", f->fname);
+    }
+
     const uint8_t *blksz_raw = f->rmap + f->roff;
 
     const uint32_t blksz =
@@ -477,12 +852,18 @@ fbuf_maybe_read (
       fatal_trace("read past end of compressed file %s", f->fname);
     }
 
-    const int ret = fastlz_decompress(f->rmap + f->roff,
+    int ret = 0;
+    if (f->codec == FBUF_CODEC_LZ4) {
+      ret = LZ4_decompress_safe((const char *) f->rmap + f->roff,
+        (char *) f->rbuf + overlap, blksz, SPILL_SIZE - overlap);
+    } else {
+      ret = fastlz_decompress(f->rmap + f->roff,
         blksz,
         f->rbuf + overlap,
         SPILL_SIZE - overlap);
+    }
 
-    if (ret == 0) {
+    if (ret <= 0) {
       fatal("file %s has invalid compression format", f->fname);
     }
 
@@ -492,5 +873,107 @@ fbuf_maybe_read (
   }
 } /* fbuf_maybe_read() */
 
+/* ------------------------------------------------------------------------- */
+
+static bool
+fbuf_pool_start (
+  void
+) {
+#ifdef HAVE_PTHREAD
+  // The pool must be recreated in a child process as threads do not
+  // survive fork
+  if (pool.pid == getpid()) {
+    return (pool.nthreads > 0);
+  }
+
+  pool.pid = getpid();
+  pool.head = pool.tail = NULL;
+  // NVC_FBUF_THREADS overrides the number of workers for testing
+  const char *env = getenv("NVC_FBUF_THREADS");
+  if (env != NULL) {
+    pool.nthreads = MIN(atoi(env), MAX_THREADS);
+  } else {
+    pool.nthreads = MIN(sysconf(_SC_NPROCESSORS_ONLN) - 1, MAX_THREADS);
+  }
+
+  if (pool.nthreads <= 0) {
+    pool.nthreads = 0;
+    return (false);
+  }
+
+  pthread_mutex_init(&pool.lock, NULL);
+  pthread_cond_init(&pool.work, NULL);
+  pthread_cond_init(&pool.done, NULL);
+
+  for (int i = 0; i < pool.nthreads; i++) {
+    pthread_t thread;
+    const int err = pthread_create(&thread, NULL, fbuf_worker, NULL);
+    if (err != 0) {
+      fatal("pthread_create: %s", strerror(err));
+    }
+    pthread_detach(thread);
+  }
+
+  return (true);
+#else
+  return (false);
+#endif
+} /* fbuf_pool_start() */
+
+/* ------------------------------------------------------------------------- */
+
+#ifdef HAVE_PTHREAD
+static void *
+fbuf_worker (
+  void *arg
+) {
+  pthread_mutex_lock(&pool.lock);
+  for (;;) {
+    while (pool.head == NULL) {
+      pthread_cond_wait(&pool.work, &pool.lock);
+    }
+
+    block_t *b = pool.head;
+    if ((pool.head = b->qnext) == NULL) {
+      pool.tail = NULL;
+    }
+
+    pthread_mutex_unlock(&pool.lock);
+    fbuf_compress(b);
+    pthread_mutex_lock(&pool.lock);
+
+    b->done = true;
+    pthread_cond_broadcast(&pool.done);
+  }
+
+  return (NULL);
+} /* fbuf_worker() */
+#endif
+
+/* ------------------------------------------------------------------------- */
+
+static void
+fbuf_write_block (
+  fbuf_t        *f,
+  const uint8_t *data,
+  int            len
+) {
+  const uint8_t blksz[4] =
+  {
+    (len >> 24) & 0xff,
+    (len >> 16) & 0xff,
+    (len >> 8) & 0xff,
+    len & 0xff
+  };
+
+  if (fwrite(blksz, 4, 1, f->file) != 1) {
+    fatal("fwrite failed");
+  }
+
+  if (fwrite(data, len, 1, f->file) != 1) {
+    fatal("fwrite failed");
+  }
+} /* fbuf_write_block() */
+
 /* :vi set ts=2 et sw=2: */
 
@@ -21,7 +21,7 @@
 #include "util.h"
 
 //
-// Compressed binary file input/output
+// Binary file input/output with optional compression
 //
 
 typedef struct fbuf fbuf_t;
@@ -31,16 +31,33 @@ typedef enum {
    FBUF_OUT,
 } fbuf_mode_t;
 
-fbuf_t *fbuf_open(const char *file, fbuf_mode_t mode);
+typedef enum {
+   FBUF_CODEC_FASTLZ,
+   FBUF_CODEC_LZ4,
+   FBUF_CODEC_NONE,
+} fbuf_codec_t;
+
+// The codec is only used for output: input files start with a byte
+// recording the codec they were written with
+fbuf_t *fbuf_open(const char *file, fbuf_mode_t mode, fbuf_codec_t codec);
 void fbuf_close(fbuf_t *f);
+fbuf_t *fbuf_snapshot(fbuf_t *f);
+
+// Output that is only hashed: fbuf_digest returns the hash of everything
+// written so far and the buffer must still be closed with fbuf_close
+fbuf_t *fbuf_open_digest(void);
+uint64_t fbuf_digest(fbuf_t *f);
 void fbuf_cleanup(void);
 const char *fbuf_file_name(fbuf_t *f);
+const char *fbuf_codec_str(fbuf_codec_t codec);
+bool fbuf_codec_parse(const char *str, fbuf_codec_t *codec);
 
 void write_u32(uint32_t u, fbuf_t *f);
 void write_u16(uint16_t s, fbuf_t *f);
 void write_u64(uint64_t i, fbuf_t *f);
 void write_u8(uint8_t u, fbuf_t *f);
 void write_raw(const void *buf, size_t len, fbuf_t *f);
+void write_u32_array(const uint32_t *buf, size_t count, fbuf_t *f);
 void write_double(double d, fbuf_t *f);
 
 uint32_t read_u32(fbuf_t *f);
@@ -48,6 +65,7 @@ uint16_t read_u16(fbuf_t *f);
 uint64_t read_u64(fbuf_t *f);
 uint8_t read_u8(fbuf_t *f);
 void read_raw(void *buf, size_t len, fbuf_t *f);
+void read_u32_array(uint32_t *buf, size_t count, fbuf_t *f);
 double read_double(fbuf_t *f);
 
 #endif  // _FBUF_H
@@ -27,6 +27,9 @@
 #include <assert.h>
 
 /* System Inclusions */
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 /* Project Inclusions */
 
@@ -34,24 +37,43 @@
 /* -- PRIVATE DEFINITIONS -------------------------------------------------- */
 /* ========================================================================= */
 
+// Slots are probed a group at a time using one control byte per slot:
+// full slots hold the low seven bits of the key hash so most misses
+// are rejected without touching the key array
+#define GROUP_WIDTH  16
+#define CTRL_EMPTY   0x80
+#define CTRL_DELETED 0xfe
+
 /* ========================================================================= */
 /* -- PRIVATE MACROS ------------------------------------------------------- */
 /* ========================================================================= */
 
+#define CTRL_FULL(c) (((c) & 0x80) == 0)
+#define H2(hash)     ((uint8_t) ((hash) & 0x7f))
+
 /* ========================================================================= */
 /* -- PRIVATE TYPEDEFS ----------------------------------------------------- */
 /* ========================================================================= */
 
+typedef struct hash_slot hash_slot_t;
+
 /* ========================================================================= */
 /* -- PRIVATE STRUCTURES --------------------------------------------------- */
 /* ========================================================================= */
 
+struct hash_slot {
+  const void *key;
+  void       *value;
+};
+
 struct hash {
   unsigned     size;
   unsigned     members;
+  unsigned     deleted;
   bool         replace;
-  void       **values;
-  const void **keys;
+  hash_kind_t  kind;
+  hash_slot_t *slots;
+  uint8_t     *ctrl;
 };
 
 /* ========================================================================= */
@@ -62,7 +84,14 @@ struct hash {
 /* -- STATIC FUNCTION PROTOTYPES ------------------------------------------- */
 /* ========================================================================= */
 
-static inline int hash_slot(hash_t *h, const void *key);
+static void hash_alloc(hash_t *h, unsigned size);
+static unsigned hash_free_slot(hash_t *h, uint64_t hash);
+static inline uint64_t hash_key(hash_t *h, const void *key);
+static inline bool hash_key_eq(hash_t *h, const void *a, const void *b);
+static inline unsigned hash_match(const uint8_t *group, uint8_t byte);
+static void hash_rehash(hash_t *h, unsigned size);
+static void hash_store(hash_t *h, unsigned slot, uint64_t hash,
+  const void *key, void *value);
 
 /* ========================================================================= */
 /* -- PRIVATE DATA --------------------------------------------------------- */
@@ -80,11 +109,56 @@ static inline int hash_slot(hash_t *h, const void *key);
 /* -- EXPORTED FUNCTION DEFINITIONS ---------------------------------------- */
 /* ========================================================================= */
 
+bool
+hash_delete (
+  hash_t     *h,
+  const void *key
+) {
+  const uint64_t hash = hash_key(h, key);
+  const unsigned mask = (h->size / GROUP_WIDTH) - 1;
+
+  bool found = false;
+  unsigned group = (hash >> 7) & mask;
+  for (unsigned step = 1; ; group = (group + step++) & mask) {
+    uint8_t *ctrl = h->ctrl + (group * GROUP_WIDTH);
+    const unsigned empty = hash_match(ctrl, CTRL_EMPTY);
+
+    for (unsigned match = hash_match(ctrl, H2(hash));
+      match != 0;
+      match &= match - 1) {
+      const unsigned slot = (group * GROUP_WIDTH) + __builtin_ctz(match);
+      if (hash_key_eq(h, h->slots[slot].key, key)) {
+        // A probe for any key never continues past a group with an
+        // empty slot so that slot may be reused immediately, but a
+        // multimap must keep later duplicates in insertion order
+        if ((empty != 0) && h->replace) {
+          h->ctrl[slot] = CTRL_EMPTY;
+        } else {
+          h->ctrl[slot] = CTRL_DELETED;
+          h->deleted++;
+        }
+        h->members--;
+        found = true;
+
+        if (h->replace) {
+          return (true);
+        }
+      }
+    }
+
+    if (empty != 0) {
+      return (found);
+    }
+  }
+} /* hash_delete() */
+
+/* ------------------------------------------------------------------------- */
+
 void
 hash_free (
   hash_t *h
 ) {
-  free(h->values);
+  free(h->slots);
   free(h);
 } /* hash_free() */
 
@@ -108,16 +182,33 @@ hash_get_nth (
   const void *key,
   int        *n
 ) {
-  int slot = hash_slot(h, key);
-
-  for ( ; ; slot = (slot + 1) & (h->size - 1)) {
-    if (h->keys[slot] == key) {
-      if (*n == 0) {
-        return (h->values[slot]);
-      } else {
-        --(*n);
+  const uint64_t hash = hash_key(h, key);
+  const unsigned mask = (h->size / GROUP_WIDTH) - 1;
+
+  unsigned group = (hash >> 7) & mask;
+
+  // Slots are filled from the start of a group so fetch those in
+  // parallel with the control bytes rather than after them
+  __builtin_prefetch(&(h->slots[group * GROUP_WIDTH]));
+  __builtin_prefetch(&(h->slots[group * GROUP_WIDTH + 4]));
+
+  for (unsigned step = 1; ; group = (group + step++) & mask) {
+    const uint8_t *ctrl = h->ctrl + (group * GROUP_WIDTH);
+
+    for (unsigned match = hash_match(ctrl, H2(hash));
+      match != 0;
+      match &= match - 1) {
+      const unsigned slot = (group * GROUP_WIDTH) + __builtin_ctz(match);
+      if (hash_key_eq(h, h->slots[slot].key, key)) {
+        if (*n == 0) {
+          return (h->slots[slot].value);
+        } else {
+          --(*n);
+        }
       }
-    } else if (h->keys[slot] == NULL) {
+    }
+
+    if (hash_match(ctrl, CTRL_EMPTY) != 0) {
       return (NULL);
     }
   }
@@ -136,9 +227,9 @@ hash_iter (
 
   while (*now < h->size) {
     const unsigned old = (*now)++;
-    if (h->keys[old] != NULL) {
-      *key = h->keys[old];
-      *value = h->values[old];
+    if (CTRL_FULL(h->ctrl[old])) {
+      *key = h->slots[old].key;
+      *value = h->slots[old].value;
       return (true);
     }
   }
@@ -162,19 +253,27 @@ hash_t *
 hash_new (
   int  size,
   bool replace
+) {
+  return (hash_new_kind(size, replace, HASH_POINTER));
+} /* hash_new() */
+
+/* ------------------------------------------------------------------------- */
+
+hash_t *
+hash_new_kind (
+  int         size,
+  bool        replace,
+  hash_kind_t kind
 ) {
   struct hash *h = xmalloc(sizeof(struct hash));
 
-  h->size = next_power_of_2(size);
-  h->members = 0;
   h->replace = replace;
+  h->kind = kind;
 
-  char *mem = xcalloc(h->size * 2 * sizeof(void *));
-  h->values = (void **) mem;
-  h->keys = (const void **) (mem + (h->size * sizeof(void *)));
+  hash_alloc(h, MAX(next_power_of_2(size), GROUP_WIDTH));
 
   return (h);
-} /* hash_new() */
+} /* hash_new_kind() */
 
 /* ------------------------------------------------------------------------- */
 
@@ -184,45 +283,39 @@ hash_put (
   const void *key,
   void       *value
 ) {
-  if (unlikely(h->members >= h->size / 2)) {
-    // Rebuild the hash table with a larger size
-    // This is expensive so a conservative initial size should be chosen
-
-    const int old_size = h->size;
-    h->size *= 2;
-
-    const void **old_keys = h->keys;
-    void **old_values = h->values;
-
-    char *mem = xcalloc(h->size * 2 * sizeof(void *));
-    h->values = (void **) mem;
-    h->keys = (const void **) (mem + (h->size * sizeof(void *)));
-
-    h->members = 0;
+  const uint64_t hash = hash_key(h, key);
+
+  if (h->replace) {
+    const unsigned mask = (h->size / GROUP_WIDTH) - 1;
+
+    unsigned group = (hash >> 7) & mask;
+    for (unsigned step = 1; ; group = (group + step++) & mask) {
+      const uint8_t *ctrl = h->ctrl + (group * GROUP_WIDTH);
+
+      for (unsigned match = hash_match(ctrl, H2(hash));
+        match != 0;
+        match &= match - 1) {
+        const unsigned slot = (group * GROUP_WIDTH) + __builtin_ctz(match);
+        if (hash_key_eq(h, h->slots[slot].key, key)) {
+          h->slots[slot].value = value;
+          return (true);
+        }
+      }
 
-    for (int i = 0; i < old_size; i++) {
-      if (old_keys[i] != NULL) {
-        hash_put(h, old_keys[i], old_values[i]);
+      if (hash_match(ctrl, CTRL_EMPTY) != 0) {
+        break;
       }
     }
-
-    free(old_values);
   }
 
-  int slot = hash_slot(h, key);
-
-  for ( ; ; slot = (slot + 1) & (h->size - 1)) {
-    if ((h->keys[slot] == key) && h->replace) {
-      h->values[slot] = value;
-      return (true);
-    } else if (h->keys[slot] == NULL) {
-      h->values[slot] = value;
-      h->keys[slot] = key;
-      h->members++;
-      break;
-    }
+  // Keep at least one empty slot in every probe sequence: grow when
+  // mostly full of live entries or just drop tombstones otherwise
+  if (unlikely((h->members + h->deleted + 1) * 8 > h->size * 7)) {
+    hash_rehash(h, (h->members * 2 >= h->size) ? h->size * 2 : h->size);
   }
 
+  hash_store(h, hash_free_slot(h, hash), hash, key, value);
+
   return (false);
 } /* hash_put() */
 
@@ -234,9 +327,9 @@ hash_replace (
   void   *value,
   void   *with
 ) {
-  for (int i = 0; i < h->size; i++) {
-    if (h->values[i] == value) {
-      h->values[i] = with;
+  for (unsigned i = 0; i < h->size; i++) {
+    if (CTRL_FULL(h->ctrl[i]) && (h->slots[i].value == value)) {
+      h->slots[i].value = with;
     }
   }
 } /* hash_replace() */
@@ -249,30 +342,202 @@ hash_replace (
 /* -- STATIC FUNCTION DEFINITIONS ------------------------------------------ */
 /* ========================================================================= */
 
-static inline int
-hash_slot (
+static void
+hash_alloc (
+  hash_t  *h,
+  unsigned size
+) {
+  assert((size % GROUP_WIDTH) == 0);
+
+  h->size = size;
+  h->members = 0;
+  h->deleted = 0;
+
+  char *mem = xmalloc(size * (sizeof(hash_slot_t) + 1));
+  h->slots = (hash_slot_t *) mem;
+  h->ctrl = (uint8_t *) (mem + (size * sizeof(hash_slot_t)));
+
+  memset(h->ctrl, CTRL_EMPTY, size);
+} /* hash_alloc() */
+
+/* ------------------------------------------------------------------------- */
+
+static unsigned
+hash_free_slot (
+  hash_t  *h,
+  uint64_t hash
+) {
+  const unsigned mask = (h->size / GROUP_WIDTH) - 1;
+
+  // Duplicate keys in a multimap must be found in insertion order so
+  // only ever append to the end of the probe sequence
+  unsigned group = (hash >> 7) & mask;
+  for (unsigned step = 1; ; group = (group + step++) & mask) {
+    const uint8_t *ctrl = h->ctrl + (group * GROUP_WIDTH);
+
+    unsigned avail = hash_match(ctrl, CTRL_EMPTY);
+    if (h->replace) {
+      avail |= hash_match(ctrl, CTRL_DELETED);
+    }
+
+    if (avail != 0) {
+      return ((group * GROUP_WIDTH) + __builtin_ctz(avail));
+    }
+  }
+} /* hash_free_slot() */
+
+/* ------------------------------------------------------------------------- */
+
+static inline uint64_t
+hash_key (
   hash_t     *h,
   const void *key
 ) {
-  assert(key != NULL);
+  uint64_t x;
+
+  switch (h->kind) {
+  case HASH_STRING:
+    {
+      // FNV-1a
+      x = UINT64_C(0xcbf29ce484222325);
+      for (const char *p = key; *p != '\0'; p++) {
+        x = (x ^ (unsigned char) *p) * UINT64_C(0x100000001b3);
+      }
+    }
+    break;
 
-  uintptr_t uptr = (uintptr_t) key;
+  case HASH_POINTER:
+    assert(key != NULL);
+    // Fall-through
 
-  // Bottom two bits will always be zero with 32-bit pointers
-  uptr >>= 2;
+  default:
+    x = (uintptr_t) key;
+    break;
+  }
 
-  // Hash function from here:
-  //   http://burtleburtle.net/bob/hash/integer.html
+  // Finaliser from MurmurHash3 so every bit of the key affects both
+  // the control byte and the group index
+  x ^= x >> 33;
+  x *= UINT64_C(0xff51afd7ed558ccd);
+  x ^= x >> 33;
+  x *= UINT64_C(0xc4ceb9fe1a85ec53);
+  x ^= x >> 33;
 
-  uint32_t a = (uint32_t) uptr;
-  a = (a ^ 61) ^ (a >> 16);
-  a = a + (a << 3);
-  a = a ^ (a >> 4);
-  a = a * UINT32_C(0x27d4eb2d);
-  a = a ^ (a >> 15);
+  return (x);
+} /* hash_key() */
 
-  return (a & (h->size - 1));
-} /* hash_slot() */
+/* ------------------------------------------------------------------------- */
 
-/* :vi set ts=2 et sw=2: */
+static inline bool
+hash_key_eq (
+  hash_t     *h,
+  const void *a,
+  const void *b
+) {
+  if (a == b) {
+    return (true);
+  } else if (h->kind == HASH_STRING) {
+    return (strcmp(a, b) == 0);
+  } else {
+    return (false);
+  }
+} /* hash_key_eq() */
+
+/* ------------------------------------------------------------------------- */
+
+static inline unsigned
+hash_match (
+  const uint8_t *group,
+  uint8_t        byte
+) {
+#ifdef __SSE2__
+  const __m128i ctrl = _mm_loadu_si128((const __m128i *) group);
+  return (_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(byte))));
+#else
+  unsigned mask = 0;
+  for (int i = 0; i < GROUP_WIDTH; i++) {
+    if (group[i] == byte) {
+      mask |= (1u << i);
+    }
+  }
+
+  return (mask);
+#endif
+} /* hash_match() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+hash_rehash (
+  hash_t  *h,
+  unsigned size
+) {
+  const unsigned old_size = h->size;
+  hash_slot_t *old_slots = h->slots;
+  uint8_t *old_ctrl = h->ctrl;
 
+  hash_alloc(h, size);
+
+  const unsigned old_mask = (old_size / GROUP_WIDTH) - 1;
+
+  for (unsigned i = 0; i < old_size; i++) {
+    if (!CTRL_FULL(old_ctrl[i])) {
+      continue;
+    }
+
+    const uint64_t hash = hash_key(h, old_slots[i].key);
+
+    if (h->replace) {
+      hash_store(h, hash_free_slot(h, hash), hash, old_slots[i].key,
+        old_slots[i].value);
+      continue;
+    }
+
+    // Move every duplicate of this key across in its original probe
+    // order so hash_get_nth returns values in the same sequence
+    const void *key = old_slots[i].key;
+    unsigned group = (hash >> 7) & old_mask;
+    for (unsigned step = 1; ; group = (group + step++) & old_mask) {
+      uint8_t *ctrl = old_ctrl + (group * GROUP_WIDTH);
+
+      for (unsigned match = hash_match(ctrl, H2(hash));
+        match != 0;
+        match &= match - 1) {
+        const unsigned slot = (group * GROUP_WIDTH) + __builtin_ctz(match);
+        if (hash_key_eq(h, old_slots[slot].key, key)) {
+          hash_store(h, hash_free_slot(h, hash), hash, old_slots[slot].key,
+            old_slots[slot].value);
+          old_ctrl[slot] = CTRL_DELETED;
+        }
+      }
+
+      if (hash_match(ctrl, CTRL_EMPTY) != 0) {
+        break;
+      }
+    }
+  }
+
+  free(old_slots);
+} /* hash_rehash() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+hash_store (
+  hash_t     *h,
+  unsigned    slot,
+  uint64_t    hash,
+  const void *key,
+  void       *value
+) {
+  if (h->ctrl[slot] == CTRL_DELETED) {
+    h->deleted--;
+  }
+
+  h->ctrl[slot] = H2(hash);
+  h->slots[slot].key = key;
+  h->slots[slot].value = value;
+  h->members++;
+} /* hash_store() */
+
+/* :vi set ts=2 et sw=2: */
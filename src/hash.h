@@ -26,12 +26,26 @@ typedef struct hash hash_t;
 
 typedef unsigned hash_iter_t;
 
+typedef enum {
+   HASH_POINTER,   // Compared by address, also used for interned idents
+   HASH_INTEGER,   // Pointer-sized integer cast to a key, may be zero
+   HASH_STRING     // NUL-terminated string compared by value
+} hash_kind_t;
+
 #define HASH_BEGIN 0
 #define HASH_END   UINT_MAX
 
+#define HASH_INT_KEY(x) ((const void *)(uintptr_t)(x))
+
+// If replace is false the table is a multimap and duplicate keys are
+// returned by hash_get_nth in the order they were added
 hash_t *hash_new(int size, bool replace);
+hash_t *hash_new_kind(int size, bool replace, hash_kind_t kind);
 void hash_free(hash_t *h);
 bool hash_put(hash_t *h, const void *key, void *value);
+// Returns true if the key was present: in a multimap every entry with
+// the key is removed
+bool hash_delete(hash_t *h, const void *key);
 void *hash_get(hash_t *h, const void *key);
 void *hash_get_nth(hash_t *h, const void *key, int *n);
 void hash_replace(hash_t *h, void *value, void *with);
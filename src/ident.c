@@ -39,38 +39,29 @@
 /* -- PRIVATE DEFINITIONS -------------------------------------------------- */
 /* ========================================================================= */
 
-#define MAP_DEPTH    3
+#define ARENA_CHUNK  65536
+#define INITIAL_SIZE 4096
 
 /* ========================================================================= */
 /* -- PRIVATE MACROS ------------------------------------------------------- */
 /* ========================================================================= */
 
+#define ALIGN_UP(x, a) (((x) + (a) - 1) & ~((a) - 1))
+
 /* ========================================================================= */
 /* -- PRIVATE TYPEDEFS ----------------------------------------------------- */
 /* ========================================================================= */
 
-typedef struct clist   clist_t;
-typedef struct trie    trie_t;
-
 /* ========================================================================= */
 /* -- PRIVATE STRUCTURES --------------------------------------------------- */
 /* ========================================================================= */
 
-struct clist {
-  char     value;
-  trie_t  *down;
-  clist_t *left;
-  clist_t *right;
-};
-
-struct trie {
-  char     value;
-  uint16_t write_gen;
-  uint16_t depth;
+struct ident {
+  uint32_t hash;
+  uint32_t length;
   uint32_t write_index;
-  trie_t  *up;
-  clist_t *list;
-  trie_t  *map[0];
+  uint16_t write_gen;
+  char     bytes[0];
 };
 
 struct ident_rd_ctx {
@@ -78,6 +69,8 @@ struct ident_rd_ctx {
   size_t   cache_sz;
   size_t   cache_alloc;
   ident_t *cache;
+  size_t   scratch_sz;
+  char    *scratch;
 };
 
 struct ident_wr_ctx {
@@ -86,11 +79,6 @@ struct ident_wr_ctx {
   uint16_t generation;
 };
 
-typedef struct {
-  trie_t  trie;
-  trie_t *map[256];
-} root_t;
-
 /* ========================================================================= */
 /* -- INTERNAL FUNCTION PROTOTYPES ----------------------------------------- */
 /* ========================================================================= */
@@ -99,27 +87,27 @@ typedef struct {
 /* -- STATIC FUNCTION PROTOTYPES ------------------------------------------- */
 /* ========================================================================= */
 
-static trie_t *alloc_node(char ch, trie_t *prev);
-static void build_trie(const char *str, trie_t *prev, trie_t **end);
-static bool ident_glob_walk(const trie_t *i, const char *g,
+static ident_t alloc_ident(const char *str, size_t len, uint32_t hash);
+static uint32_t hash_str(const char *str, size_t len);
+static ident_t intern_str(const char *str, size_t len);
+static bool ident_glob_walk(const char *s, const char *g,
   const char *const end);
-static clist_t *search_node(trie_t *t, char ch);
-static bool search_trie(const char **str, trie_t *t, trie_t **end);
+static ident_t lookup_str(const char *str, size_t len, uint32_t hash,
+  size_t *slot);
+static void rehash_table(void);
 
 /* ========================================================================= */
 /* -- PRIVATE DATA --------------------------------------------------------- */
 /* ========================================================================= */
 
-static root_t root =
-{
-  {
-    .value = '\0',
-    .write_gen = 0,
-    .write_index = 0,
-    .depth = 1,
-    .up = NULL
-  }
-};
+// Interned identifiers are never freed so the string bytes can be
+// bump allocated from large chunks and istr() may return them directly
+static char *arena = NULL;
+static size_t arena_used = ARENA_CHUNK;
+
+static ident_t *table = NULL;
+static size_t table_size = 0;
+static size_t table_used = 0;
 
 /* ========================================================================= */
 /* -- EXPORTED DATA -------------------------------------------------------- */
@@ -154,12 +142,7 @@ icmp (
 ) {
   assert(i != NULL);
 
-  trie_t *result;
-  if (!search_trie(&s, &(root.trie), &result)) {
-    return (false);
-  } else {
-    return (result == i);
-  }
+  return (strcmp(i->bytes, s) == 0);
 } /* icmp() */
 
 /* ------------------------------------------------------------------------- */
@@ -169,12 +152,10 @@ ident_char (
   ident_t  i,
   unsigned n
 ) {
-  if (i == NULL) {
+  if ((i == NULL) || (n >= i->length)) {
     return ('\0');
-  } else if (n == 0) {
-    return (i->value);
   } else {
-    return (ident_char(i->up, n - 1));
+    return (i->bytes[i->length - n - 1]);
   }
 } /* ident_char() */
 
@@ -187,15 +168,7 @@ ident_contains (
 ) {
   assert(i != NULL);
 
-  for (ident_t r = i; r->value != '\0'; r = r->up) {
-    for (const char *p = search; *p != '\0'; p++) {
-      if (r->value == *p) {
-        return (true);
-      }
-    }
-  }
-
-  return (false);
+  return (strpbrk(i->bytes, search) != NULL);
 } /* ident_contains() */
 
 /* ------------------------------------------------------------------------- */
@@ -204,21 +177,16 @@ ident_t
 ident_downcase (
   ident_t i
 ) {
-  // TODO: this could be implemented more efficiently
-
   if (i == NULL) {
     return (NULL);
   }
 
-  char *p = get_fmt_buf(i->depth) + i->depth - 1;
-  *p = '\0';
-
-  trie_t *it;
-  for (it = i; it->value != '\0'; it = it->up) {
-    *(--p) = tolower((int) it->value);
+  char buf[i->length + 1];
+  for (size_t n = 0; n <= i->length; n++) {
+    buf[n] = tolower((int) i->bytes[n]);
   }
 
-  return (ident_new(p));
+  return (intern_str(buf, i->length));
 } /* ident_downcase() */
 
 /* ------------------------------------------------------------------------- */
@@ -230,20 +198,9 @@ ident_from (
 ) {
   assert(i != NULL);
 
-  char buf[i->depth + 1];
-  char *p = buf + i->depth;
-  *p-- = '\0';
-
-  char *from = NULL;
-  while (i->value != '\0') {
-    if (i->value == c) {
-      from = p + 1;
-    }
-    *p-- = i->value;
-    i = i->up;
-  }
+  const char *from = strchr(i->bytes, c);
 
-  return ((from == NULL) ? NULL : ident_new(from));
+  return ((from == NULL) ? NULL : ident_new(from + 1));
 } /* ident_from() */
 
 /* ------------------------------------------------------------------------- */
@@ -260,7 +217,7 @@ ident_glob (
     length = strlen(glob);
   }
 
-  return (ident_glob_walk(i, glob + length - 1, glob));
+  return (ident_glob_walk(i->bytes, glob, glob + length));
 } /* ident_glob() */
 
 /* ------------------------------------------------------------------------- */
@@ -272,8 +229,9 @@ ident_interned (
   assert(str != NULL);
   assert(*str != '\0');
 
-  trie_t *result;
-  return (search_trie(&str, &(root.trie), &result));
+  const size_t len = strlen(str);
+  size_t slot;
+  return (lookup_str(str, len, hash_str(str, len), &slot) != NULL);
 } /* ident_interned() */
 
 /* ------------------------------------------------------------------------- */
@@ -282,11 +240,7 @@ size_t
 ident_len (
   ident_t i
 ) {
-  if ((i == NULL) || (i->value == '\0')) {
-    return (0);
-  } else {
-    return (ident_len(i->up) + 1);
-  }
+  return ((i == NULL) ? 0 : i->length);
 } /* ident_len() */
 
 /* ------------------------------------------------------------------------- */
@@ -366,12 +320,7 @@ ident_new (
   assert(str != NULL);
   assert(*str != '\0');
 
-  trie_t *result;
-  if (!search_trie(&str, &(root.trie), &result)) {
-    build_trie(str, result, &result);
-  }
-
-  return (result);
+  return (intern_str(str, strlen(str)));
 } /* ident_new() */
 
 /* ------------------------------------------------------------------------- */
@@ -388,26 +337,18 @@ ident_prefix (
     return (a);
   }
 
-  trie_t *result;
+  const size_t len = a->length + b->length + ((sep != '\0') ? 1 : 0);
+  char buf[len + 1];
 
+  char *p = buf;
+  memcpy(p, a->bytes, a->length);
+  p += a->length;
   if (sep != '\0') {
-    // Append separator
-    const char sep_str[] = { sep, '\0' };
-    const char *p_sep_str = sep_str;
-    if (!search_trie(&p_sep_str, a, &result)) {
-      build_trie(p_sep_str, result, &result);
-    }
-  } else {
-    result = a;
-  }
-
-  // Append b
-  const char *bstr = istr(b);
-  if (!search_trie(&bstr, result, &result)) {
-    build_trie(bstr, result, &result);
+    *p++ = sep;
   }
+  memcpy(p, b->bytes, b->length + 1);
 
-  return (result);
+  return (intern_str(buf, len));
 } /* ident_prefix() */
 
 /* ------------------------------------------------------------------------- */
@@ -424,29 +365,23 @@ ident_read (
       ctx->cache = xrealloc(ctx->cache, ctx->cache_alloc * sizeof(ident_t));
     }
 
-    trie_t *p = &(root.trie);
+    size_t len = 0;
     char ch;
     while ((ch = read_u8(ctx->file)) != '\0') {
-      trie_t *next = NULL;
-      if (p->depth <= MAP_DEPTH) {
-        next = p->map[(unsigned char) ch];
-      } else {
-        clist_t *it = search_node(p, ch);
-        next = (it != NULL) ? it->down : NULL;
-      }
-
-      if (next != NULL) {
-        p = next;
-      } else {
-        p = alloc_node(ch, p);
+      if (len + 1 == ctx->scratch_sz) {
+        ctx->scratch_sz *= 2;
+        ctx->scratch = xrealloc(ctx->scratch, ctx->scratch_sz);
       }
+      ctx->scratch[len++] = ch;
     }
+    ctx->scratch[len] = '\0';
 
-    if (p == &(root.trie)) {
+    if (len == 0) {
       return (NULL);
     } else {
-      ctx->cache[ctx->cache_sz++] = p;
-      return (p);
+      ident_t i = intern_str(ctx->scratch, len);
+      ctx->cache[ctx->cache_sz++] = i;
+      return (i);
     }
   } else if (likely(index < ctx->cache_sz)) {
     return (ctx->cache[index]);
@@ -468,6 +403,8 @@ ident_read_begin (
   ctx->cache_alloc = 256;
   ctx->cache_sz = 0;
   ctx->cache = xmalloc(ctx->cache_alloc * sizeof(ident_t));
+  ctx->scratch_sz = 256;
+  ctx->scratch = xmalloc(ctx->scratch_sz);
 
   return (ctx);
 } /* ident_read_begin() */
@@ -478,12 +415,24 @@ void
 ident_read_end (
   ident_rd_ctx_t ctx
 ) {
+  free(ctx->scratch);
   free(ctx->cache);
   free(ctx);
 } /* ident_read_end() */
 
 /* ------------------------------------------------------------------------- */
 
+void
+ident_read_rebind (
+  ident_rd_ctx_t ctx,
+  fbuf_t        *f
+) {
+  // Continue reading the same ident stream from a different buffer
+  ctx->file = f;
+} /* ident_read_rebind() */
+
+/* ------------------------------------------------------------------------- */
+
 ident_t
 ident_rfrom (
   ident_t i,
@@ -491,19 +440,9 @@ ident_rfrom (
 ) {
   assert(i != NULL);
 
-  char buf[i->depth + 1];
-  char *p = buf + i->depth;
-  *p-- = '\0';
-
-  while (i->value != '\0') {
-    if (i->value == c) {
-      return (ident_new(p + 1));
-    }
-    *p-- = i->value;
-    i = i->up;
-  }
+  const char *from = strrchr(i->bytes, c);
 
-  return (NULL);
+  return ((from == NULL) ? NULL : ident_new(from + 1));
 } /* ident_rfrom() */
 
 /* ------------------------------------------------------------------------- */
@@ -515,13 +454,9 @@ ident_runtil (
 ) {
   assert(i != NULL);
 
-  for (ident_t r = i; r->value != '\0'; r = r->up) {
-    if (r->value == c) {
-      return (r->up);
-    }
-  }
+  const char *until = strrchr(i->bytes, c);
 
-  return (i);
+  return ((until == NULL) ? i : intern_str(i->bytes, until - i->bytes));
 } /* ident_runtil() */
 
 /* ------------------------------------------------------------------------- */
@@ -534,12 +469,16 @@ ident_strip (
   assert(a != NULL);
   assert(b != NULL);
 
-  while (a->value == b->value && b->value != '\0') {
-    a = a->up;
-    b = b->up;
+  if (b->length > a->length) {
+    return (NULL);
+  }
+
+  const size_t len = a->length - b->length;
+  if (memcmp(a->bytes + len, b->bytes, b->length) != 0) {
+    return (NULL);
   }
 
-  return (b->value == '\0' ? a : NULL);
+  return (intern_str(a->bytes, len));
 } /* ident_strip() */
 
 /* ------------------------------------------------------------------------- */
@@ -553,18 +492,26 @@ ident_suffix_until (
 ) {
   assert(i != NULL);
 
+  // Scan backwards from the end of the string stopping just after
+  // the shared prefix if there is one
+  size_t stop = 0;
+  if ((shared != NULL) && (shared->length < i->length)
+    && (memcmp(i->bytes, shared->bytes, shared->length) == 0)) {
+    stop = shared->length + 1;
+  }
+
   bool escaping = false;
-  ident_t r = i;
-  while (i->value != '\0' && i->up != shared) {
-    if (!escaping && (i->value == c)) {
-      r = i->up;
-    } else if (i->value == escape) {
+  size_t r = i->length;
+  for (size_t n = i->length; n > stop; n--) {
+    const char ch = i->bytes[n - 1];
+    if (!escaping && (ch == c)) {
+      r = n - 1;
+    } else if (ch == escape) {
       escaping = !escaping;
     }
-    i = i->up;
   }
 
-  return (r);
+  return ((r == i->length) ? i : intern_str(i->bytes, r));
 } /* ident_suffix_until() */
 
 /* ------------------------------------------------------------------------- */
@@ -575,19 +522,18 @@ ident_uniq (
 ) {
   static int counter = 0;
 
-  const char *start = prefix;
-  trie_t *end;
+  const size_t len = strlen(prefix);
+  const uint32_t hash = hash_str(prefix, len);
+  size_t slot;
 
-  if (search_trie(&start, &(root.trie), &end)) {
-    const size_t len = strlen(prefix) + 16;
-    char buf[len];
-    snprintf(buf, len, "%s%d", prefix, counter++);
+  if (lookup_str(prefix, len, hash, &slot) != NULL) {
+    const size_t bufsz = len + 16;
+    char buf[bufsz];
+    snprintf(buf, bufsz, "%s%d", prefix, counter++);
 
     return (ident_new(buf));
   } else {
-    trie_t *result;
-    build_trie(start, end, &result);
-    return (result);
+    return (intern_str(prefix, len));
   }
 } /* ident_uniq() */
 
@@ -615,7 +561,7 @@ ident_write (
     write_u32(ident->write_index, ctx->file);
   } else {
     write_u32(UINT32_MAX, ctx->file);
-    write_raw(istr(ident), ident->depth, ctx->file);
+    write_raw(ident->bytes, ident->length + 1, ctx->file);
 
     ident->write_gen = ctx->generation;
     ident->write_index = ctx->next_index++;
@@ -657,103 +603,104 @@ const char *
 istr (
   ident_t ident
 ) {
-  if (ident == NULL) {
-    return (NULL);
-  }
-
-  char *p = get_fmt_buf(ident->depth) + ident->depth - 1;
-  *p = '\0';
-
-  trie_t *it;
-  for (it = ident; it->value != '\0'; it = it->up) {
-    *(--p) = it->value;
-  }
-
-  return (p);
+  return ((ident == NULL) ? NULL : ident->bytes);
 } /* istr() */
 
 /* ========================================================================= */
 /* -- STATIC FUNCTION DEFINITIONS ------------------------------------------ */
 /* ========================================================================= */
 
-static trie_t *
-alloc_node (
-  char    ch,
-  trie_t *prev
+static ident_t
+alloc_ident (
+  const char *str,
+  size_t      len,
+  uint32_t    hash
 ) {
-  const size_t mapsz = (prev->depth < MAP_DEPTH) ? 256 * sizeof(trie_t *) : 0;
+  const size_t size =
+    ALIGN_UP(sizeof(struct ident) + len + 1, sizeof(uint64_t));
 
-  trie_t *t = xmalloc(sizeof(trie_t) + mapsz);
-
-  t->value = ch;
-  t->depth = prev->depth + 1;
-  t->up = prev;
-  t->write_gen = 0;
-  t->list = NULL;
+  ident_t i;
+  if (size > ARENA_CHUNK / 4) {
+    i = xmalloc(size);
+  } else {
+    if (arena_used + size > ARENA_CHUNK) {
+      arena = xmalloc(ARENA_CHUNK);
+      arena_used = 0;
+    }
 
-  if (mapsz > 0) {
-    memset(t->map, '\0', mapsz);
+    i = (ident_t) (arena + arena_used);
+    arena_used += size;
   }
 
-  if (prev->depth <= MAP_DEPTH) {
-    prev->map[(unsigned char) ch] = t;
-  } else {
-    clist_t *c = xmalloc(sizeof(clist_t));
-    c->value = ch;
-    c->down = t;
-    c->left = NULL;
-    c->right = NULL;
-
-    clist_t *it, **where;
-    for (it = prev->list, where = &(prev->list);
-      it != NULL;
-      where = (ch < it->value ? &(it->left) : &(it->right)),
-      it = *where) {
-    }
+  i->hash = hash;
+  i->length = len;
+  i->write_index = 0;
+  i->write_gen = 0;
+  memcpy(i->bytes, str, len);
+  i->bytes[len] = '\0';
+
+  return (i);
+} /* alloc_ident() */
+
+/* ------------------------------------------------------------------------- */
 
-    *where = c;
+static uint32_t
+hash_str (
+  const char *str,
+  size_t      len
+) {
+  // FNV-1a
+  uint32_t hash = 2166136261u;
+  for (size_t n = 0; n < len; n++) {
+    hash = (hash ^ (unsigned char) str[n]) * 16777619u;
   }
 
-  return (t);
-} /* alloc_node() */
+  return (hash);
+} /* hash_str() */
 
 /* ------------------------------------------------------------------------- */
 
-static void
-build_trie (
+static ident_t
+intern_str (
   const char *str,
-  trie_t     *prev,
-  trie_t    **end
+  size_t      len
 ) {
-  assert(*str != '\0');
-  assert(prev != NULL);
+  const uint32_t hash = hash_str(str, len);
 
-  trie_t *t = alloc_node(*str, prev);
+  size_t slot;
+  ident_t i = lookup_str(str, len, hash, &slot);
+  if (i != NULL) {
+    return (i);
+  }
 
-  if (*(++str) == '\0') {
-    *end = t;
-  } else {
-    build_trie(str, t, end);
+  i = alloc_ident(str, len, hash);
+  table[slot] = i;
+
+  // Keep the load factor below one half so probe sequences stay short
+  if (++table_used * 2 > table_size) {
+    rehash_table();
   }
-} /* build_trie() */
+
+  return (i);
+} /* intern_str() */
 
 /* ------------------------------------------------------------------------- */
 
 static bool
 ident_glob_walk (
-  const trie_t     *i,
+  const char       *s,
   const char       *g,
   const char *const end
 ) {
-  if (i->value == '\0') {
-    return (g < end);
-  } else if (g < end) {
+  if (*s == '\0') {
+    return (g == end);
+  } else if (g == end) {
     return (false);
   } else if (*g == '*') {
-    return (ident_glob_walk(i->up, g, end) ||
-           ident_glob_walk(i->up, g - 1, end));
-  } else if (i->value == *g) {
-    return (ident_glob_walk(i->up, g - 1, end));
+    return (ident_glob_walk(s + 1, g, end) ||
+           ident_glob_walk(s + 1, g + 1, end));
+  } else if (*s == *g) {
+    return (ident_glob_walk(s + 1, g + 1, end));
   } else {
     return (false);
   }
@@ -761,55 +708,59 @@ ident_glob_walk (
 
 /* ------------------------------------------------------------------------- */
 
-static clist_t *
-search_node (
-  trie_t *t,
-  char    ch
-) {
-  clist_t *it;
-
-  for (it = t->list;
-    (it != NULL) && (it->value != ch);
-    it = (ch < it->value ? it->left : it->right)) {
+static ident_t
+lookup_str (
+  const char *str,
+  size_t      len,
+  uint32_t    hash,
+  size_t     *slot
+) {
+  if (table == NULL) {
+    table_size = INITIAL_SIZE;
+    table = xcalloc(table_size * sizeof(ident_t));
+  }
+
+  // Linear probing: returns the matching entry or the empty slot
+  // where it should be inserted
+  const size_t mask = table_size - 1;
+  for (size_t n = hash & mask; ; n = (n + 1) & mask) {
+    ident_t i = table[n];
+    if (i == NULL) {
+      *slot = n;
+      return (NULL);
+    } else if ((i->hash == hash) && (i->length == len)
+      && (memcmp(i->bytes, str, len) == 0)) {
+      *slot = n;
+      return (i);
+    }
   }
-
-  return (it);
-} /* search_node() */
+} /* lookup_str() */
 
 /* ------------------------------------------------------------------------- */
 
-static bool
-search_trie (
-  const char **str,
-  trie_t      *t,
-  trie_t     **end
-) {
-  assert(**str != '\0');
-  assert(t != NULL);
-
-  trie_t *next = NULL;
-
-  if (t->depth <= MAP_DEPTH) {
-    next = t->map[(unsigned char) **str];
-  } else {
-    clist_t *it = search_node(t, **str);
-    next = (it != NULL) ? it->down : NULL;
-  }
-
-  if (next == NULL) {
-    *end = t;
-    return (false);
-  } else {
-    (*str)++;
-
-    if (**str == '\0') {
-      *end = next;
-      return (true);
-    } else {
-      return (search_trie(str, next, end));
+static void
+rehash_table (
+  void
+) {
+  const size_t old_size = table_size;
+  ident_t *old_table = table;
+
+  table_size *= 2;
+  table = xcalloc(table_size * sizeof(ident_t));
+
+  const size_t mask = table_size - 1;
+  for (size_t n = 0; n < old_size; n++) {
+    ident_t i = old_table[n];
+    if (i != NULL) {
+      size_t slot = i->hash & mask;
+      while (table[slot] != NULL) {
+        slot = (slot + 1) & mask;
+      }
+      table[slot] = i;
     }
   }
-} /* search_trie() */
 
-/* :vi set ts=2 et sw=2: */
+  free(old_table);
+} /* rehash_table() */
 
+/* :vi set ts=2 et sw=2: */
@@ -78,8 +78,8 @@ bool ident_contains(ident_t i, const char *search);
 ident_t ident_downcase(ident_t i);
 
 // Convert an identifier reference to a NULL-terminated string.
-// This function is quite slow so its use should be avoided except
-// for printing.
+// The result points into the interned string table and remains
+// valid for the lifetime of the program.
 const char *istr(ident_t ident);
 
 ident_wr_ctx_t ident_write_begin(fbuf_t *f);
@@ -89,6 +89,7 @@ void ident_write_end(ident_wr_ctx_t ctx);
 ident_rd_ctx_t ident_read_begin(fbuf_t *f);
 ident_t ident_read(ident_rd_ctx_t ctx);
 void ident_read_end(ident_rd_ctx_t ctx);
+void ident_read_rebind(ident_rd_ctx_t ctx, fbuf_t *f);
 
 typedef struct ident_list ident_list_t;
 
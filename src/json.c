@@ -668,7 +668,7 @@ dump_decl (
     json_append_member(decl, "val", json_mknull());
   }
 
-  if (tree_attr_int(t, ident_new("returned"), 0)) {
+  if (tree_attr_int(t, returned_i, 0)) {
     printf(" -- returned");
   }
 
@@ -24,6 +24,7 @@
 #include "lib.h"
 #include "tree.h"
 #include "common.h"
+#include "hash.h"
 
 #include <assert.h>
 #include <limits.h>
@@ -70,6 +71,7 @@ struct lib_unit {
   tree_kind_t   kind;
   tree_rd_ctx_t read_ctx;
   bool          dirty;
+  bool          checked;
   lib_mtime_t   mtime;
 };
 
@@ -85,8 +87,12 @@ struct lib {
   unsigned     n_units;
   unsigned     units_alloc;
   lib_unit_t  *units;
+  hash_t      *unit_hash;
   lib_index_t *index;
+  hash_t      *index_hash;
+  lib_mtime_t  index_mtime;
   int          lock_fd;
+  fbuf_codec_t codec;
 };
 
 struct lib_list {
@@ -115,8 +121,11 @@ static lib_unit_t *lib_get_aux(lib_t lib, ident_t ident);
 static lib_t lib_init(const char *name, const char *rpath, int lock_fd);
 static lib_unit_t *lib_put_aux(lib_t lib, tree_t unit, tree_rd_ctx_t ctx,
   bool dirty, lib_mtime_t mtime);
-static lib_mtime_t lib_stat_mtime(struct stat *st);
+static void lib_read_format(lib_t lib);
+static void lib_read_index(lib_t lib);
+static void lib_rehash_units(lib_t lib);
 static lib_mtime_t lib_time_to_usecs(time_t t);
+static void lib_unload(tree_t unit);
 static void push_path(const char *path);
 static const char *standard_suffix(vhdl_standard_t std);
 static ident_t upcase_name(const char *name);
@@ -253,7 +262,7 @@ lib_fbuf_open (
   if (lib->path[0] == '\0') {
     return (NULL);
   } else {
-    return (fbuf_open(lib_file_path(lib, name), mode));
+    return (fbuf_open(lib_file_path(lib, name), mode, lib->codec));
   }
 } /* lib_fbuf_open() */
 
@@ -336,6 +345,9 @@ lib_free (
   if (lib->units != NULL) {
     free(lib->units);
   }
+
+  hash_free(lib->unit_hash);
+  hash_free(lib->index_hash);
   free(lib);
 } /* lib_free() */
 
@@ -374,7 +386,8 @@ lib_get_check_stale (
       lu->read_ctx = NULL;
     }
 
-    if (!opt_get_int("ignore-time")) {
+    // Only stat the source file the first time the unit is requested
+    if (!opt_get_int("ignore-time") && !lu->checked) {
       const loc_t *loc = tree_loc(lu->top);
 
       struct stat st;
@@ -384,6 +397,8 @@ lib_get_check_stale (
           "be reanalysed\n(You can use the --ignore-time option to "
           "skip this check)", istr(ident), istr(loc->file));
       }
+
+      lu->checked = true;
     }
 
     return (lu->top);
@@ -401,14 +416,8 @@ lib_index_kind (
 ) {
   assert(lib != NULL);
 
-  lib_index_t *it;
-  for (it = lib->index; it != NULL; it = it->next) {
-    if (it->name == ident) {
-      return (it->kind);
-    }
-  }
-
-  return (T_LAST_TREE_KIND);
+  lib_index_t *it = lib_find_in_index(lib, ident);
+  return ((it != NULL) ? it->kind : T_LAST_TREE_KIND);
 } /* lib_index_kind() */
 
 /* ------------------------------------------------------------------------- */
@@ -560,7 +569,9 @@ lib_new (
   } else {
     file_write_lock(fd);
 
-    const char *marker = PACKAGE_STRING "\n";
+    // The second line records how files in the library are encoded
+    char *marker LOCAL = xasprintf("%s\n%s\n", PACKAGE_STRING,
+      fbuf_codec_str(opt_get_int("lib-format")));
     if (write(fd, marker, strlen(marker)) < 0) {
       fatal_errno("write: %s", path);
     }
@@ -616,6 +627,30 @@ lib_realpath (
 
 /* ------------------------------------------------------------------------- */
 
+void
+lib_reopen_locks (
+  void
+) {
+  // File locks belong to the open file description so a child process
+  // must open the lock file again to avoid sharing locks with its parent
+
+  for (lib_list_t *it = loaded; it != NULL; it = it->next) {
+    lib_t lib = it->item;
+    if (lib->lock_fd == -1) {
+      continue;
+    }
+
+    close(lib->lock_fd);
+
+    const char *lock_path = lib_file_path(lib, "_NVC_LIB");
+    if ((lib->lock_fd = open(lock_path, O_RDONLY)) < 0) {
+      fatal_errno("lib_reopen_locks: %s", lock_path);
+    }
+  }
+} /* lib_reopen_locks() */
+
+/* ------------------------------------------------------------------------- */
+
 void
 lib_save (
   lib_t lib
@@ -625,6 +660,9 @@ lib_save (
   assert(lib->lock_fd != -1);    // Should not be called in unit tests
   file_write_lock(lib->lock_fd);
 
+  // Another process may have added units since the index was read
+  lib_read_index(lib);
+
   for (unsigned n = 0; n < lib->n_units; n++) {
     if (lib->units[n].dirty) {
       const char *name = istr(tree_ident(lib->units[n].top));
@@ -637,6 +675,10 @@ lib_save (
       tree_write_end(ctx);
       fbuf_close(f);
 
+      // Match the time a later lib_sync will find on disk: the name
+      // buffer may have been reused while writing the tree
+      name = istr(tree_ident(lib->units[n].top));
+      (void)lib_stat(lib, name, &(lib->units[n].mtime));
       lib->units[n].dirty = false;
     }
   }
@@ -661,6 +703,8 @@ lib_save (
 
   ident_write_end(ictx);
   fbuf_close(f);
+
+  (void)lib_stat(lib, "_index", &(lib->index_mtime));
   file_unlock(lib->lock_fd);
 } /* lib_save() */
 
@@ -695,6 +739,64 @@ lib_stat (
 
 /* ------------------------------------------------------------------------- */
 
+lib_mtime_t
+lib_stat_mtime (
+  struct stat *st
+) {
+  lib_mtime_t mt = lib_time_to_usecs(st->st_mtime);
+
+#if defined HAVE_STRUCT_STAT_ST_MTIMESPEC_TV_NSEC
+  mt += st->st_mtimespec.tv_nsec / 1000;
+#elif defined HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+  mt += st->st_mtim.tv_nsec / 1000;
+#endif
+  return (mt);
+} /* lib_stat_mtime() */
+
+/* ------------------------------------------------------------------------- */
+
+void
+lib_sync (
+  lib_t lib
+) {
+  // Add units saved by other processes to the in-memory index and
+  // forget any loaded unit they have since replaced on disk
+
+  assert(lib != NULL);
+
+  if (lib->lock_fd == -1) {
+    return;
+  }
+
+  file_read_lock(lib->lock_fd);
+  lib_read_index(lib);
+
+  unsigned wptr = 0;
+  for (unsigned n = 0; n < lib->n_units; n++) {
+    lib_unit_t *lu = &(lib->units[n]);
+
+    lib_mtime_t mt;
+    const char *name = istr(tree_ident(lu->top));
+    if (!lu->dirty && lib_stat(lib, name, &mt) && (mt != lu->mtime)) {
+      if (lu->read_ctx != NULL) {
+        tree_read_end(lu->read_ctx);
+      }
+      continue;
+    }
+
+    lib->units[wptr++] = *lu;
+  }
+
+  if (wptr != lib->n_units) {
+    lib->n_units = wptr;
+    lib_rehash_units(lib);
+  }
+
+  file_unlock(lib->lock_fd);
+} /* lib_sync() */
+
+/* ------------------------------------------------------------------------- */
+
 lib_t
 lib_tmp (
   const char *name
@@ -826,14 +928,7 @@ lib_find_in_index (
   lib_t   lib,
   ident_t name
 ) {
-  lib_index_t *it;
-
-  for (it = lib->index;
-    (it != NULL) && (it->name != name);
-    it = it->next) {
-  }
-
-  return (it);
+  return (hash_get(lib->index_hash, name));
 } /* lib_find_in_index() */
 
 /* ------------------------------------------------------------------------- */
@@ -855,10 +950,9 @@ lib_get_aux (
   }
 
   // Search in the list of already loaded units
-  for (unsigned n = 0; n < lib->n_units; n++) {
-    if (tree_ident(lib->units[n].top) == ident) {
-      return (&(lib->units[n]));
-    }
+  lib_unit_t *unit = hash_get(lib->unit_hash, ident);
+  if (unit != NULL) {
+    return (unit);
   }
 
   if (*(lib->path) == '\0') {  // Temporary library
@@ -868,42 +962,38 @@ lib_get_aux (
   assert(lib->lock_fd != -1);    // Should not be called in unit tests
   file_read_lock(lib->lock_fd);
 
-  // Otherwise search in the filesystem
-  DIR *d = opendir(lib->path);
-  if (d == NULL) {
-    fatal("%s: %s", lib->path, strerror(errno));
+  // The index lists every unit in the library so there is no need to
+  // search the directory, but another process may have saved the unit
+  // since the index was last read
+  lib_mtime_t index_mtime;
+  if ((lib_find_in_index(lib, ident) == NULL)
+      && lib_stat(lib, "_index", &index_mtime)
+      && (index_mtime != lib->index_mtime)) {
+    lib_read_index(lib);
   }
 
-  lib_unit_t *unit = NULL;
-  const char *search = istr(ident);
-  struct dirent *e;
-  while ((e = readdir(d))) {
-    if (strcmp(e->d_name, search) == 0) {
-      fbuf_t *f = lib_fbuf_open(lib, e->d_name, FBUF_IN);
-      tree_rd_ctx_t ctx = tree_read_begin(f, lib_file_path(lib, e->d_name));
-      tree_t top = tree_read(ctx);
-      fbuf_close(f);
-
-      struct stat st;
-      if (stat(lib_file_path(lib, e->d_name), &st) < 0) {
-        fatal_errno("%s", e->d_name);
-      }
+  if (lib_find_in_index(lib, ident) != NULL) {
+    const char *name = istr(ident);
+    fbuf_t *f = lib_fbuf_open(lib, name, FBUF_IN);
+    if (f == NULL) {
+      fatal("library %s corrupt: unit %s present in index but missing "
+        "on disk", istr(lib->name), istr(ident));
+    }
 
-      lib_mtime_t mt = lib_stat_mtime(&st);
+    tree_rd_ctx_t ctx = tree_read_begin(f, lib_file_path(lib, name));
+    tree_t top = tree_read(ctx);
+    fbuf_close(f);
 
-      unit = lib_put_aux(lib, top, ctx, false, mt);
-      break;
+    lib_mtime_t mt;
+    if (!lib_stat(lib, name, &mt)) {
+      fatal_errno("%s", name);
     }
+
+    unit = lib_put_aux(lib, top, ctx, false, mt);
   }
 
-  closedir(d);
   file_unlock(lib->lock_fd);
 
-  if ((unit == NULL) && (lib_find_in_index(lib, ident) != NULL)) {
-    fatal("library %s corrupt: unit %s present in index but missing "
-      "on disk", istr(lib->name), istr(ident));
-  }
-
   return (unit);
 } /* lib_get_aux() */
 
@@ -919,9 +1009,15 @@ lib_init (
 
   l->n_units = 0;
   l->units = NULL;
+  l->unit_hash = hash_new(64, true);
   l->name = upcase_name(name);
   l->index = NULL;
+  l->index_hash = hash_new(64, true);
+  l->index_mtime = 0;
   l->lock_fd = lock_fd;
+  l->codec = FBUF_CODEC_FASTLZ;
+
+  tree_set_unload_fn(lib_unload);
 
   if (rpath == NULL) {
     l->path[0] = '\0';
@@ -943,28 +1039,12 @@ lib_init (
     file_read_lock(l->lock_fd);
   }
 
-  fbuf_t *f = lib_fbuf_open(l, "_index", FBUF_IN);
-  if (f != NULL) {
-    ident_rd_ctx_t ictx = ident_read_begin(f);
-
-    const int entries = read_u32(f);
-    for (int i = 0; i < entries; i++) {
-      ident_t name = ident_read(ictx);
-      tree_kind_t kind = read_u16(f);
-      assert(kind < T_LAST_TREE_KIND);
-
-      lib_index_t *in = xmalloc(sizeof(lib_index_t));
-      in->name = name;
-      in->kind = kind;
-      in->next = l->index;
-
-      l->index = in;
-    }
-
-    ident_read_end(ictx);
-    fbuf_close(f);
+  if (l->lock_fd != -1) {
+    lib_read_format(l);
   }
 
+  lib_read_index(l);
+
   if (l->lock_fd != -1) {
     file_unlock(l->lock_fd);
   }
@@ -985,14 +1065,8 @@ lib_put_aux (
   assert(lib != NULL);
   assert(unit != NULL);
 
-  lib_unit_t *where = NULL;
   ident_t name = tree_ident(unit);
-
-  for (unsigned i = 0; (where == NULL) && (i < lib->n_units); i++) {
-    if (tree_ident(lib->units[i].top) == tree_ident(unit)) {
-      where = &(lib->units[i]);
-    }
-  }
+  lib_unit_t *where = hash_get(lib->unit_hash, name);
 
   if (where == NULL) {
     if (lib->n_units == 0) {
@@ -1002,14 +1076,17 @@ lib_put_aux (
       lib->units_alloc *= 2;
       lib->units = xrealloc(lib->units,
           sizeof(lib_unit_t) * lib->units_alloc);
+      lib_rehash_units(lib);
     }
 
     where = &(lib->units[lib->n_units++]);
+    hash_put(lib->unit_hash, name, where);
   }
 
   where->top = unit;
   where->read_ctx = ctx;
   where->dirty = dirty;
+  where->checked = false;
   where->mtime = mtime;
   where->kind = tree_kind(unit);
 
@@ -1021,6 +1098,7 @@ lib_put_aux (
     new->next = lib->index;
 
     lib->index = new;
+    hash_put(lib->index_hash, name, new);
   } else {
     it->kind = tree_kind(unit);
   }
@@ -1030,19 +1108,90 @@ lib_put_aux (
 
 /* ------------------------------------------------------------------------- */
 
-static lib_mtime_t
-lib_stat_mtime (
-  struct stat *st
+static void
+lib_read_format (
+  lib_t lib
 ) {
-  lib_mtime_t mt = lib_time_to_usecs(st->st_mtime);
+  // Libraries created before the format line was added use fastlz
+  char buf[128];
+  const ssize_t nr = pread(lib->lock_fd, buf, sizeof(buf) - 1, 0);
+  if (nr < 0) {
+    fatal_errno("read: %s", lib_file_path(lib, "_NVC_LIB"));
+  }
+  buf[nr] = '\0';
 
-#if defined HAVE_STRUCT_STAT_ST_MTIMESPEC_TV_NSEC
-  mt += st->st_mtimespec.tv_nsec / 1000;
-#elif defined HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
-  mt += st->st_mtim.tv_nsec / 1000;
-#endif
-  return (mt);
-} /* lib_stat_mtime() */
+  char *format = strchr(buf, '\n');
+  if ((format == NULL) || (*++format == '\0')) {
+    return;
+  }
+
+  char *end = strchr(format, '\n');
+  if (end != NULL) {
+    *end = '\0';
+  }
+
+  if (!fbuf_codec_parse(format, &(lib->codec))) {
+    fatal("library %s uses unknown format %s", istr(lib->name), format);
+  }
+} /* lib_read_format() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+lib_read_index (
+  lib_t lib
+) {
+  // Merge the index file into the in-memory index keeping the kind of
+  // any unit already present: the caller must hold the lock
+
+  fbuf_t *f = lib_fbuf_open(lib, "_index", FBUF_IN);
+  if (f == NULL) {
+    return;
+  }
+
+  (void)lib_stat(lib, "_index", &(lib->index_mtime));
+
+  ident_rd_ctx_t ictx = ident_read_begin(f);
+
+  const int entries = read_u32(f);
+  for (int i = 0; i < entries; i++) {
+    ident_t name = ident_read(ictx);
+    tree_kind_t kind = read_u16(f);
+    assert(kind < T_LAST_TREE_KIND);
+
+    if (lib_find_in_index(lib, name) != NULL) {
+      continue;
+    }
+
+    lib_index_t *in = xmalloc(sizeof(lib_index_t));
+    in->name = name;
+    in->kind = kind;
+    in->next = lib->index;
+
+    lib->index = in;
+    hash_put(lib->index_hash, name, in);
+  }
+
+  ident_read_end(ictx);
+  fbuf_close(f);
+} /* lib_read_index() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+lib_rehash_units (
+  lib_t lib
+) {
+  // Called whenever the units array moves or shrinks
+
+  hash_free(lib->unit_hash);
+  lib->unit_hash = hash_new(MAX(lib->units_alloc, 64), true);
+
+  for (unsigned n = 0; n < lib->n_units; n++) {
+    hash_put(lib->unit_hash, tree_ident(lib->units[n].top),
+      &(lib->units[n]));
+  }
+} /* lib_rehash_units() */
 
 /* ------------------------------------------------------------------------- */
 
@@ -1055,6 +1204,40 @@ lib_time_to_usecs (
 
 /* ------------------------------------------------------------------------- */
 
+static void
+lib_unload (
+  tree_t unit
+) {
+  // Nothing refers to this unit any more so it is forgotten and read
+  // again from disk if it is needed later
+  ident_t name = tree_ident(unit);
+
+  for (lib_list_t *it = loaded; it != NULL; it = it->next) {
+    lib_t lib = it->item;
+
+    lib_unit_t *where = hash_get(lib->unit_hash, name);
+    if ((where == NULL) || (where->top != unit)) {
+      continue;
+    }
+
+    if (where->read_ctx != NULL) {
+      tree_read_end(where->read_ctx);
+    }
+
+    (void)hash_delete(lib->unit_hash, name);
+
+    lib_unit_t *last = &(lib->units[--(lib->n_units)]);
+    if (where != last) {
+      *where = *last;
+      hash_put(lib->unit_hash, tree_ident(where->top), where);
+    }
+
+    return;
+  }
+} /* lib_unload() */
+
+/* ------------------------------------------------------------------------- */
+
 static void
 push_path (
   const char *path
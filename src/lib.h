@@ -21,6 +21,7 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <sys/stat.h>
 
 #include "fbuf.h"
 #include "prim.h"
@@ -45,8 +46,11 @@ void lib_mkdir(lib_t lib, const char *name);
 const char *lib_enum_search_paths(void **token);
 void lib_add_search_path(const char *path);
 bool lib_stat(lib_t lib, const char *name, lib_mtime_t *mt);
+lib_mtime_t lib_stat_mtime(struct stat *st);
 void lib_add_map(const char *name, const char *path);
 void lib_delete(lib_t lib, const char *name);
+void lib_reopen_locks(void);
+void lib_sync(lib_t lib);
 
 lib_t lib_work(void);
 void lib_set_work(lib_t lib);
@@ -101,6 +101,12 @@ typedef enum {
   SHORT_CIRCUIT_NOR
 } short_circuit_op_t;
 
+typedef struct {
+  const char       *name;
+  const char       *params[2];
+  intrinsic_kind_t  kind;
+} lower_intrinsic_t;
+
 typedef vcode_reg_t (*lower_signal_flag_fn_t)(vcode_reg_t, vcode_reg_t);
 typedef vcode_reg_t (*arith_fn_t)(vcode_reg_t, vcode_reg_t);
 
@@ -215,6 +221,7 @@ static bool lower_has_subprograms(tree_t scope);
 static bool lower_have_signal(vcode_reg_t reg);
 static void lower_if(tree_t stmt, loop_stack_t *loops);
 static vcode_reg_t lower_image_map(type_t type);
+static bool lower_intrinsic(tree_t decl, intrinsic_kind_t *kind);
 static bool lower_is_const(tree_t t);
 static vcode_reg_t lower_literal(tree_t lit, expr_ctx_t ctx);
 static vcode_reg_t lower_logical(tree_t fcall, vcode_reg_t result);
@@ -295,6 +302,48 @@ static const char *verbose = NULL;
 static bool tmp_alloc_used = false;
 static lower_mode_t mode = LOWER_NORMAL;
 static hash_t *vcode_objs = NULL;
+static hash_t *drives_all = NULL;   // Signal declaration to process
+
+#define UNSIGNED "IEEE.NUMERIC_STD.UNSIGNED"
+#define NATURAL  "STD.STANDARD.NATURAL"
+#define SLV      "IEEE.STD_LOGIC_1164.STD_LOGIC_VECTOR"
+#define SULV     "IEEE.STD_LOGIC_1164.STD_ULOGIC_VECTOR"
+
+// IEEE library functions with a native implementation in the runtime
+static const lower_intrinsic_t intrinsics[] = {
+  { "IEEE.NUMERIC_STD.\"+\"",  { UNSIGNED, UNSIGNED }, INTRINSIC_UNSIGNED_ADD },
+  { "IEEE.NUMERIC_STD.\"-\"",  { UNSIGNED, UNSIGNED }, INTRINSIC_UNSIGNED_SUB },
+  { "IEEE.NUMERIC_STD.\"=\"",  { UNSIGNED, UNSIGNED }, INTRINSIC_UNSIGNED_EQ },
+  { "IEEE.NUMERIC_STD.\"/=\"", { UNSIGNED, UNSIGNED }, INTRINSIC_UNSIGNED_NEQ },
+  { "IEEE.NUMERIC_STD.\"<\"",  { UNSIGNED, UNSIGNED }, INTRINSIC_UNSIGNED_LT },
+  { "IEEE.NUMERIC_STD.\"<=\"", { UNSIGNED, UNSIGNED }, INTRINSIC_UNSIGNED_LEQ },
+  { "IEEE.NUMERIC_STD.\">\"",  { UNSIGNED, UNSIGNED }, INTRINSIC_UNSIGNED_GT },
+  { "IEEE.NUMERIC_STD.\">=\"", { UNSIGNED, UNSIGNED }, INTRINSIC_UNSIGNED_GEQ },
+  { "IEEE.NUMERIC_STD.RESIZE", { UNSIGNED, NATURAL }, INTRINSIC_UNSIGNED_RESIZE },
+  { "IEEE.NUMERIC_STD.TO_INTEGER", { UNSIGNED },
+    INTRINSIC_UNSIGNED_TO_INTEGER },
+  { "IEEE.NUMERIC_STD.TO_UNSIGNED", { NATURAL, NATURAL },
+    INTRINSIC_TO_UNSIGNED },
+  { "IEEE.STD_LOGIC_1164.\"not\"",  { SLV },       INTRINSIC_LOGIC_NOT },
+  { "IEEE.STD_LOGIC_1164.\"not\"",  { SULV },      INTRINSIC_LOGIC_NOT },
+  { "IEEE.STD_LOGIC_1164.\"and\"",  { SLV, SLV },   INTRINSIC_LOGIC_AND },
+  { "IEEE.STD_LOGIC_1164.\"and\"",  { SULV, SULV }, INTRINSIC_LOGIC_AND },
+  { "IEEE.STD_LOGIC_1164.\"or\"",   { SLV, SLV },   INTRINSIC_LOGIC_OR },
+  { "IEEE.STD_LOGIC_1164.\"or\"",   { SULV, SULV }, INTRINSIC_LOGIC_OR },
+  { "IEEE.STD_LOGIC_1164.\"xor\"",  { SLV, SLV },   INTRINSIC_LOGIC_XOR },
+  { "IEEE.STD_LOGIC_1164.\"xor\"",  { SULV, SULV }, INTRINSIC_LOGIC_XOR },
+  { "IEEE.STD_LOGIC_1164.\"xnor\"", { SLV, SLV },   INTRINSIC_LOGIC_XNOR },
+  { "IEEE.STD_LOGIC_1164.\"xnor\"", { SULV, SULV }, INTRINSIC_LOGIC_XNOR },
+  { "IEEE.STD_LOGIC_1164.\"nand\"", { SLV, SLV },   INTRINSIC_LOGIC_NAND },
+  { "IEEE.STD_LOGIC_1164.\"nand\"", { SULV, SULV }, INTRINSIC_LOGIC_NAND },
+  { "IEEE.STD_LOGIC_1164.\"nor\"",  { SLV, SLV },   INTRINSIC_LOGIC_NOR },
+  { "IEEE.STD_LOGIC_1164.\"nor\"",  { SULV, SULV }, INTRINSIC_LOGIC_NOR },
+};
+
+#undef UNSIGNED
+#undef NATURAL
+#undef SLV
+#undef SULV
 
 static vcode_reg_t lower_expr(tree_t expr, expr_ctx_t ctx);
 static vcode_reg_t lower_reify_expr(tree_t expr);
@@ -334,6 +383,7 @@ lower_func (
 
   vcode_select_unit(context);
   vcode_objs = hash_new(128, true);
+  drives_all = hash_new(16, true);
   mode = LOWER_THUNK;
   tmp_alloc_used = false;
 
@@ -343,6 +393,9 @@ lower_func (
   hash_free(vcode_objs);
   vcode_objs = NULL;
 
+  hash_free(drives_all);
+  drives_all = NULL;
+
   return (vu);
 } /* lower_func() */
 
@@ -406,6 +459,7 @@ lower_unit (
   lower_set_verbose();
 
   vcode_objs = hash_new(4096, true);
+  drives_all = hash_new(1024, true);
   mode = LOWER_NORMAL;
   tmp_alloc_used = false;
 
@@ -440,6 +494,9 @@ lower_unit (
   hash_free(vcode_objs);
   vcode_objs = NULL;
 
+  hash_free(drives_all);
+  drives_all = NULL;
+
   return (context);
 } /* lower_unit() */
 
@@ -1173,7 +1230,7 @@ static void
 lower_assert (
   tree_t stmt
 ) {
-  const int is_report = tree_attr_int(stmt, ident_new("is_report"), 0);
+  const int is_report = tree_attr_int(stmt, is_report_i, 0);
 
   vcode_reg_t severity = lower_reify_expr(tree_severity(stmt));
 
@@ -2777,7 +2834,7 @@ lower_driver_nets (
       {
         *decl = tree_ref(t);
 
-        if (tree_attr_ptr(*decl, drives_all_i) == proc) {
+        if (hash_get(drives_all, *decl) == proc) {
           return (false);
         }
 
@@ -2927,7 +2984,7 @@ lower_driver_target (
   assert(decl != NULL);
 
   if (all_length == driven_length) {
-    tree_add_attr_ptr(decl, drives_all_i, proc);
+    hash_put(drives_all, decl, proc);
   }
 
   vcode_reg_t init_reg = VCODE_INVALID_REG;
@@ -3317,6 +3374,12 @@ lower_fcall (
 
   vcode_type_t rtype = lower_func_result_type(decl);
   const int nest_depth = tree_attr_int(decl, nested_i, 0);
+
+  intrinsic_kind_t kind;
+  if ((nest_depth == 0) && lower_intrinsic(decl, &kind)) {
+    return (emit_intrinsic(kind, name, rtype, args, nargs));
+  }
+
   if (nest_depth > 0) {
     const int hops = vcode_unit_depth() - nest_depth;
     return (emit_nested_fcall(name, rtype, args, nargs, hops));
@@ -3425,6 +3488,7 @@ lower_finished (
     if ((*verbose == '\0') ||
       (strstr(istr(vcode_unit_name()), verbose) != NULL)) {
       vcode_dump();
+      vcode_dump_opt_stats();
     }
   }
 } /* lower_finished() */
@@ -3866,6 +3930,44 @@ lower_image_map (
 
 /* ------------------------------------------------------------------------- */
 
+static bool
+lower_intrinsic (
+  tree_t            decl,
+  intrinsic_kind_t *kind
+) {
+  // True if decl is one of the IEEE library functions implemented
+  // natively by the runtime
+
+  const char *name = istr(tree_ident(decl));
+  if (strncmp(name, "IEEE.", 5) != 0) {
+    return (false);
+  }
+
+  const int nports = tree_ports(decl);
+
+  for (size_t i = 0; i < ARRAY_LEN(intrinsics); i++) {
+    const lower_intrinsic_t *in = &(intrinsics[i]);
+    if (strcmp(in->name, name) != 0) {
+      continue;
+    }
+
+    bool match = (nports == ((in->params[1] == NULL) ? 1 : 2));
+    for (int j = 0; match && (j < nports); j++) {
+      type_t type = tree_type(tree_port(decl, j));
+      match = icmp(type_ident(type), in->params[j]);
+    }
+
+    if (match) {
+      *kind = in->kind;
+      return (true);
+    }
+  }
+
+  return (false);
+} /* lower_intrinsic() */
+
+/* ------------------------------------------------------------------------- */
+
 static bool
 lower_is_const (
   tree_t t
@@ -4096,7 +4198,7 @@ lower_name_attr (
   tree_t decl = tree_ref(ref);
 
   ident_t i = NULL;
-  ident_t instance = tree_attr_str(decl, ident_new("INSTANCE_NAME"));
+  ident_t instance = tree_attr_str(decl, inst_name_i);
   if (instance == NULL) {
     // Assume this is a package not an elaborated design
     i = ident_new(package_signal_path_name(tree_ident(decl)));
@@ -35,6 +35,9 @@
 #include <unistd.h>
 
 /* System Inclusions */
+#ifndef __MINGW32__
+#include <sys/wait.h>
+#endif
 
 /* Project Inclusions */
 
@@ -54,17 +57,18 @@ typedef enum {
   MAKE_TREE,
   MAKE_LIB,
   MAKE_SO,
-  MAKE_FINAL_SO,
   MAKE_IMPLIB,
   MAKE_VCODE,
 } make_product_t;
 
-typedef struct rule rule_t;
-
 typedef enum {
-  RULE_ANALYSE,
-  RULE_ELABORATE
-} rule_kind_t;
+  BUILD_WAITING,
+  BUILD_RUNNING,
+  BUILD_DONE,
+  BUILD_FAILED
+} build_state_t;
+
+typedef struct rule rule_t;
 
 struct rule {
   rule_t       *next;
@@ -72,6 +76,9 @@ struct rule {
   ident_list_t *outputs;
   ident_list_t *inputs;
   ident_t       source;
+  build_state_t state;
+  bool          ran;
+  pid_t         pid;
 };
 
 static ident_t make_tag_i;
@@ -89,6 +96,7 @@ static ident_t make_tag_i;
 /* ========================================================================= */
 
 static void make_add_target(ident_t name, int kind, void *context);
+static tree_t *make_all_targets(int *count);
 static void make_clean(tree_t dummy, FILE *out);
 static char *make_elab_name(tree_t t);
 static void make_free_rules(rule_t *list);
@@ -101,8 +109,10 @@ static const char *make_product(tree_t t, make_product_t product);
 static void make_rule(tree_t t, rule_t **rules);
 static void make_rule_add_input(rule_t *r, const char *input);
 static void make_rule_add_output(rule_t *r, const char *output);
+static bool make_rule_depends(rule_t *r, rule_t *on);
 static rule_t *make_rule_for_source(rule_t **all, rule_kind_t kind,
   const char *source);
+static bool make_rule_stale(rule_t *r);
 static void make_run(tree_t *targets, int count, FILE *out);
 
 /* ========================================================================= */
@@ -130,11 +140,7 @@ make (
   make_tag_i = ident_new("make_tag");
 
   if (count == 0) {
-    lib_t work = lib_work();
-    count = lib_index_size(work);
-    targets = xmalloc(count * sizeof(tree_t));
-    tree_t *outp = targets;
-    lib_walk_index(work, make_add_target, &outp);
+    targets = make_all_targets(&count);
   }
 
   make_header(targets, count, out);
@@ -164,6 +170,134 @@ make (
   free(targets);
 } /* make() */
 
+/* ------------------------------------------------------------------------- */
+
+int
+make_build (
+  tree_t        *targets,
+  int            count,
+  int            jobs,
+  make_rule_fn_t fn
+) {
+  make_tag_i = ident_new("make_tag");
+
+  if (count == 0) {
+    targets = make_all_targets(&count);
+  }
+
+  rule_t *rules = NULL;
+  for (int i = 0; i < count; i++) {
+    make_rule(targets[i], &rules);
+  }
+
+  free(targets);
+
+#ifdef __MINGW32__
+  jobs = 1;
+#endif
+
+  // Units loaded while finding the rules stay in memory and are shared
+  // with each worker process so the standard libraries are only read
+  // from disk once
+
+  int running = 0, status = EXIT_SUCCESS;
+  for (;;) {
+    bool changed = false, waiting = false;
+
+    for (rule_t *r = rules; r != NULL; r = r->next) {
+      if (r->state != BUILD_WAITING) {
+        continue;
+      } else if ((running == jobs) || (status != EXIT_SUCCESS)) {
+        waiting = (status == EXIT_SUCCESS);
+        continue;
+      }
+
+      bool ready = true, forced = false;
+      for (rule_t *d = rules; d != NULL; d = d->next) {
+        if ((d != r) && make_rule_depends(r, d)) {
+          ready = ready && (d->state == BUILD_DONE);
+          forced = forced || d->ran;
+        }
+      }
+
+      if (!ready) {
+        waiting = true;
+        continue;
+      }
+
+      changed = true;
+
+      if (!forced && !make_rule_stale(r)) {
+        r->state = BUILD_DONE;
+        continue;
+      }
+
+      r->ran = true;
+
+      if (jobs == 1) {
+        const bool ok = ((*fn)(r->kind, istr(r->source)) == EXIT_SUCCESS);
+        r->state = ok ? BUILD_DONE : BUILD_FAILED;
+        if (!ok) {
+          status = EXIT_FAILURE;
+        }
+        continue;
+      }
+
+#ifndef __MINGW32__
+      fflush(stdout);
+      fflush(stderr);
+
+      const pid_t pid = fork();
+      if (pid == 0) {
+        lib_reopen_locks();
+        exit((*fn)(r->kind, istr(r->source)));
+      } else if (pid < 0) {
+        fatal_errno("fork");
+      }
+
+      r->pid = pid;
+      r->state = BUILD_RUNNING;
+      running++;
+#endif
+    }
+
+    if (running > 0) {
+#ifndef __MINGW32__
+      int wstatus;
+      const pid_t pid = waitpid(-1, &wstatus, 0);
+      if (pid < 0) {
+        fatal_errno("waitpid");
+      }
+
+      for (rule_t *r = rules; r != NULL; r = r->next) {
+        if ((r->state == BUILD_RUNNING) && (r->pid == pid)) {
+          const bool ok = WIFEXITED(wstatus) && (WEXITSTATUS(wstatus) == 0);
+          r->state = ok ? BUILD_DONE : BUILD_FAILED;
+          running--;
+
+          if (!ok) {
+            status = EXIT_FAILURE;
+          }
+          break;
+        }
+      }
+
+      // Forget any units the worker replaced so the next one reads the
+      // new version from disk
+      lib_sync(lib_work());
+#endif
+    } else if (!waiting) {
+      break;
+    } else if (!changed) {
+      fatal("circular dependency between design units");
+    }
+  }
+
+  make_free_rules(rules);
+
+  return (status);
+} /* make_build() */
+
 /* ========================================================================= */
 /* -- INTERNAL FUNCTION DEFINITIONS ---------------------------------------- */
 /* ========================================================================= */
@@ -185,6 +319,22 @@ make_add_target (
 
 /* ------------------------------------------------------------------------- */
 
+static tree_t *
+make_all_targets (
+  int *count
+) {
+  lib_t work = lib_work();
+
+  *count = lib_index_size(work);
+  tree_t *targets = xmalloc(*count * sizeof(tree_t));
+  tree_t *outp = targets;
+  lib_walk_index(work, make_add_target, &outp);
+
+  return (targets);
+} /* make_all_targets() */
+
+/* ------------------------------------------------------------------------- */
+
 static void
 make_clean (
   tree_t dummy,
@@ -387,13 +537,6 @@ make_product (
       }
       break;
 
-    case MAKE_FINAL_SO:
-      {
-        ident_t base = ident_runtil(name, '.');
-        checked_sprintf(buf, PATH_MAX, "%s/_%s.final.so", path, istr(base));
-      }
-      break;
-
     case MAKE_LIB:
       {
         checked_sprintf(buf, PATH_MAX, "%s", path);
@@ -450,7 +593,7 @@ make_rule (
     case T_ELAB:
       {
         make_rule_add_output(r, make_product(t, MAKE_TREE));
-        make_rule_add_output(r, make_product(t, MAKE_FINAL_SO));
+        make_rule_add_output(r, make_product(t, MAKE_SO));
       }
       break;
 
@@ -460,7 +603,9 @@ make_rule (
           case T_PACK_BODY:
             make_rule_add_output(r, make_product(t, MAKE_VCODE));
             make_rule_add_output(r, make_product(t, MAKE_SO));
+#ifdef IMPLIB_REQUIRED
             make_rule_add_output(r, make_product(t, MAKE_IMPLIB));
+#endif
         }
         // Fall-through
       }
@@ -563,6 +708,22 @@ make_rule_add_output (
 
 /* ------------------------------------------------------------------------- */
 
+static bool
+make_rule_depends (
+  rule_t *r,
+  rule_t *on
+) {
+  for (ident_list_t *it = r->inputs; it != NULL; it = it->next) {
+    if (ident_list_find(on->outputs, it->ident)) {
+      return (true);
+    }
+  }
+
+  return (false);
+} /* make_rule_depends() */
+
+/* ------------------------------------------------------------------------- */
+
 static rule_t *
 make_rule_for_source (
   rule_t    **all,
@@ -583,6 +744,9 @@ make_rule_for_source (
   new->kind = kind;
   new->next = *all;
   new->source = ident;
+  new->state = BUILD_WAITING;
+  new->ran = false;
+  new->pid = 0;
 
   *all = new;
   return (new);
@@ -590,6 +754,37 @@ make_rule_for_source (
 
 /* ------------------------------------------------------------------------- */
 
+static bool
+make_rule_stale (
+  rule_t *r
+) {
+  // A rule is out of date if any output is missing or older than one
+  // of its inputs
+
+  struct stat st;
+  lib_mtime_t oldest = UINT64_MAX;
+  for (ident_list_t *it = r->outputs; it != NULL; it = it->next) {
+    if (stat(istr(it->ident), &st) != 0) {
+      return (true);
+    }
+    oldest = MIN(oldest, lib_stat_mtime(&st));
+  }
+
+  for (ident_list_t *it = r->inputs; it != NULL; it = it->next) {
+    if (ident_list_find(r->outputs, it->ident)) {
+      continue;
+    } else if (stat(istr(it->ident), &st) != 0) {
+      return (true);
+    } else if (lib_stat_mtime(&st) > oldest) {
+      return (true);
+    }
+  }
+
+  return (false);
+} /* make_rule_stale() */
+
+/* ------------------------------------------------------------------------- */
+
 static void
 make_run (
   tree_t *targets,
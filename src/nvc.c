@@ -35,6 +35,10 @@
 #include <ctype.h>
 #include <assert.h>
 
+#ifndef __MINGW32__
+#include <sys/wait.h>
+#endif
+
 /* Project Inclusions */
 
 /* ========================================================================= */
@@ -49,6 +53,19 @@
 /* -- PRIVATE TYPEDEFS ----------------------------------------------------- */
 /* ========================================================================= */
 
+typedef enum {
+  DEP_NONE,
+  DEP_ORDER,
+  DEP_USES
+} dep_kind_t;
+
+typedef enum {
+  JOB_PENDING,
+  JOB_RUNNING,
+  JOB_DONE,
+  JOB_FAILED
+} job_state_t;
+
 /* ========================================================================= */
 /* -- PRIVATE STRUCTURES --------------------------------------------------- */
 /* ========================================================================= */
@@ -63,9 +80,17 @@
 
 static ident_t to_unit_name(const char *str);
 static int analyse(int argc, char **argv);
+static int analyse_files(int nfiles, char **files);
+#ifndef __MINGW32__
+static int analyse_parallel(int nfiles, char **files, int jobs);
+#endif
+static int build_cmd(int argc, char **argv);
+static int build_rule(rule_kind_t kind, const char *source);
 static int codegen(int argc, char **argv);
 static int dump_cmd(int argc, char **argv);
 static int elaborate(int argc, char **argv);
+static int elaborate_unit(void);
+static tree_t *find_make_targets(char **names, int count);
 static int list_cmd(int argc, char **argv);
 static int make_cmd(int argc, char **argv);
 static int parse_int(const char *str);
@@ -73,6 +98,7 @@ static int process_command(int argc, char **argv);
 static int run(int argc, char **argv);
 static int scan_cmd(int start, int argc, char **argv);
 static int syntax_cmd(int argc, char **argv);
+static fbuf_codec_t parse_lib_format(const char *str);
 static message_style_t parse_message_style(const char *str);
 static rt_severity_t parse_severity(const char *str);
 static unsigned parse_relax(const char *str);
@@ -144,6 +170,8 @@ main (
     { "map",         required_argument, 0, 'p' },
     { "ignore-time", no_argument,       0, 'i' },
     { "force-init",  no_argument,       0, 'f' },
+    { "cache-dir",   required_argument, 0, 'C' },
+    { "lib-format",  required_argument, 0, 'F' },
     {             0,                 0, 0,   0 }
   };
 
@@ -219,6 +247,18 @@ main (
         }
         break;
 
+      case 'C':
+        {
+          opt_set_str("cache-dir", optarg);
+        }
+        break;
+
+      case 'F':
+        {
+          opt_set_int("lib-format", parse_lib_format(optarg));
+        }
+        break;
+
       case 'n':
         {
           warnf("the --native option is deprecated and has no effect");
@@ -263,6 +303,7 @@ analyse (
     { "dump-json",       required_argument, 0, 'j' },
     { "dump-llvm",       no_argument,       0, 'D' },
     { "dump-vcode",      optional_argument, 0, 'v' },
+    { "jobs",            required_argument, 0, 'J' },
     { "parse-pragmas",   no_argument,       0, 'P' },
     { "prefer-explicit", no_argument,       0, 'p' },                 // DEPRECATED
     { "relax",           required_argument, 0, 'R' },
@@ -270,7 +311,7 @@ analyse (
   };
 
   const int next_cmd = scan_cmd(2, argc, argv);
-  int c, index = 0;
+  int c, index = 0, jobs = 1;
   const char *spec = "";
 
   while ((c = getopt_long(next_cmd, argv, spec, long_options, &index)) != -1) {
@@ -287,6 +328,15 @@ analyse (
           fatal("unrecognised analyse option %s", argv[optind - 1]);
         }
 
+      case 'J':
+        {
+          jobs = parse_int(optarg);
+          if (jobs < 1) {
+            fatal("invalid number of jobs %s", optarg);
+          }
+        }
+        break;
+
       case 'b':
         {
           opt_set_int("bootstrap", 1);
@@ -336,12 +386,43 @@ analyse (
     }
   }
 
+  const int nfiles = next_cmd - optind;
+  int status;
+
+#ifndef __MINGW32__
+  // Each worker process would overwrite the same JSON file
+  if ((jobs > 1) && (nfiles > 1) && !opt_get_str("dump-json")) {
+    status = analyse_parallel(nfiles, argv + optind, jobs);
+  } else {
+    status = analyse_files(nfiles, argv + optind);
+  }
+#else
+  status = analyse_files(nfiles, argv + optind);
+#endif
+
+  if (status != EXIT_SUCCESS) {
+    return (status);
+  }
+
+  argc -= next_cmd - 1;
+  argv += next_cmd - 1;
+
+  return (argc > 1 ? process_command(argc, argv) : EXIT_SUCCESS);
+} /* analyse() */
+
+/* ------------------------------------------------------------------------- */
+
+static int
+analyse_files (
+  int    nfiles,
+  char **files
+) {
   size_t unit_list_sz = 32;
   tree_t *units LOCAL = xmalloc(sizeof(tree_t) * unit_list_sz);
   int n_units = 0;
 
-  for (int i = optind; i < next_cmd; i++) {
-    input_from_file(argv[i]);
+  for (int i = 0; i < nfiles; i++) {
+    input_from_file(files[i]);
 
     tree_t unit;
     while ((unit = parse()) && sem_check(unit)) {
@@ -382,11 +463,247 @@ analyse (
     }
   }
 
+  return (EXIT_SUCCESS);
+} /* analyse_files() */
+
+/* ------------------------------------------------------------------------- */
+
+#ifndef __MINGW32__
+static int
+analyse_parallel (
+  int    nfiles,
+  char **files,
+  int    jobs
+) {
+  // Analyse each file in a worker process once every earlier file on
+  // the command line that declares a unit it refers to has been
+  // analysed: files that declare the same unit or a unit used by an
+  // earlier file also keep their command line order
+
+  ident_t work = lib_name(lib_work());
+
+  ident_list_t **defines = xcalloc(nfiles * sizeof(ident_list_t *));
+  ident_list_t **uses = xcalloc(nfiles * sizeof(ident_list_t *));
+
+  for (int i = 0; i < nfiles; i++) {
+    input_from_file(files[i]);
+    parse_dependencies(work, &(defines[i]), &(uses[i]));
+  }
+
+  // A file must wait for an earlier file that declares a unit it uses
+  // or else only keeps its command line order relative to it
+  dep_kind_t *depends LOCAL =
+    xcalloc(nfiles * nfiles * sizeof(dep_kind_t));
+  for (int i = 0; i < nfiles; i++) {
+    for (int j = 0; j < i; j++) {
+      dep_kind_t dep = DEP_NONE;
+      if (ident_list_find(uses[i], work)) {
+        dep = DEP_USES;
+      }
+
+      for (ident_list_t *it = defines[j];
+        (it != NULL) && (dep != DEP_USES); it = it->next) {
+        if (ident_list_find(uses[i], it->ident)) {
+          dep = DEP_USES;
+        } else if (ident_list_find(defines[i], it->ident)) {
+          dep = DEP_ORDER;
+        }
+      }
+
+      for (ident_list_t *it = defines[i];
+        (it != NULL) && (dep == DEP_NONE); it = it->next) {
+        if (ident_list_find(uses[j], it->ident)) {
+          dep = DEP_ORDER;
+        }
+      }
+
+      if ((dep == DEP_NONE) && ident_list_find(uses[j], work)) {
+        dep = DEP_ORDER;
+      }
+
+      depends[(i * nfiles) + j] = dep;
+    }
+  }
+
+  for (int i = 0; i < nfiles; i++) {
+    ident_list_free(defines[i]);
+    ident_list_free(uses[i]);
+  }
+
+  free(defines);
+  free(uses);
+
+  job_state_t *state LOCAL = xcalloc(nfiles * sizeof(job_state_t));
+  pid_t *pids LOCAL = xmalloc(nfiles * sizeof(pid_t));
+
+  int running = 0, finished = 0, status = EXIT_SUCCESS;
+
+  while (finished < nfiles) {
+    for (int i = 0; (i < nfiles) && (running < jobs); i++) {
+      if (state[i] != JOB_PENDING) {
+        continue;
+      }
+
+      bool ready = true, blocked = false;
+      for (int j = 0; j < i; j++) {
+        const dep_kind_t dep = depends[(i * nfiles) + j];
+        if (dep != DEP_NONE) {
+          ready = ready &&
+            ((state[j] == JOB_DONE) || (state[j] == JOB_FAILED));
+          blocked = blocked ||
+            ((dep == DEP_USES) && (state[j] == JOB_FAILED));
+        }
+      }
+
+      if (blocked) {
+        notef("not analysing %s as it depends on a file with errors",
+          files[i]);
+        state[i] = JOB_FAILED;
+        finished++;
+        status = EXIT_FAILURE;
+        continue;
+      } else if (!ready) {
+        continue;
+      }
+
+      fflush(stdout);
+      fflush(stderr);
+
+      const pid_t pid = fork();
+      if (pid == 0) {
+        lib_reopen_locks();
+        exit(analyse_files(1, &(files[i])));
+      } else if (pid < 0) {
+        fatal_errno("fork");
+      }
+
+      pids[i] = pid;
+      state[i] = JOB_RUNNING;
+      running++;
+    }
+
+    if (running == 0) {
+      continue;
+    }
+
+    int wstatus;
+    const pid_t pid = waitpid(-1, &wstatus, 0);
+    if (pid < 0) {
+      fatal_errno("waitpid");
+    }
+
+    for (int i = 0; i < nfiles; i++) {
+      if ((state[i] == JOB_RUNNING) && (pids[i] == pid)) {
+        const bool ok = WIFEXITED(wstatus) && (WEXITSTATUS(wstatus) == 0);
+        state[i] = ok ? JOB_DONE : JOB_FAILED;
+        running--;
+        finished++;
+
+        if (!ok) {
+          status = EXIT_FAILURE;
+        }
+        break;
+      }
+    }
+  }
+
+  // Units were saved to the library by the worker processes
+  lib_sync(lib_work());
+
+  return (status);
+} /* analyse_parallel() */
+#endif
+
+/* ------------------------------------------------------------------------- */
+
+static int
+build_cmd (
+  int    argc,
+  char **argv
+) {
+  static struct option long_options[] =
+  {
+    { "jobs", required_argument, 0, 'j' },
+    {      0,                 0, 0,   0 }
+  };
+
+  const int next_cmd = scan_cmd(2, argc, argv);
+  int c, index = 0, jobs = 1;
+  const char *spec = "j:";
+
+  while ((c = getopt_long(next_cmd, argv, spec, long_options, &index)) != -1) {
+    switch (c)
+    {
+      case 0:
+        {
+          // Set a flag
+        }
+        break;
+
+      case '?':
+        {
+          fatal("unrecognised build option %s", argv[optind - 1]);
+        }
+
+      case 'j':
+        {
+          jobs = parse_int(optarg);
+          if (jobs < 1) {
+            fatal("invalid number of jobs %s", optarg);
+          }
+        }
+        break;
+
+      default:
+        abort();
+    }
+  }
+
+  const int count = next_cmd - optind;
+  tree_t *targets = find_make_targets(argv + optind, count);
+
+  // A following run command can use the same unit name like after -e
+  if (count == 1) {
+    set_top_level(argv, next_cmd);
+  }
+
+  const int status = make_build(targets, count, jobs, build_rule);
+  if (status != EXIT_SUCCESS) {
+    return (status);
+  }
+
   argc -= next_cmd - 1;
   argv += next_cmd - 1;
 
   return (argc > 1 ? process_command(argc, argv) : EXIT_SUCCESS);
-} /* analyse() */
+} /* build_cmd() */
+
+/* ------------------------------------------------------------------------- */
+
+static int
+build_rule (
+  rule_kind_t kind,
+  const char *source
+) {
+  switch (kind)
+  {
+    case RULE_ANALYSE:
+      {
+        char *file LOCAL = xstrdup(source);
+        return (analyse_files(1, &file));
+      }
+
+    case RULE_ELABORATE:
+      {
+        free(top_level_orig);
+        top_level_orig = xstrdup(source);
+        top_level = to_unit_name(top_level_orig);
+        return (elaborate_unit());
+      }
+  }
+
+  return (EXIT_FAILURE);
+} /* build_rule() */
 
 /* ------------------------------------------------------------------------- */
 
@@ -565,17 +882,20 @@ elaborate (
 ) {
   static struct option long_options[] =
   {
-    { "disable-opt", no_argument,       0, 'o' },        // DEPRECATED
-    { "dump-llvm",   no_argument,       0, 'd' },
-    { "dump-vcode",  optional_argument, 0, 'v' },
-    { "native",      no_argument,       0, 'n' },        // DEPRECATED
-    { "cover",       no_argument,       0, 'c' },
-    { "verbose",     no_argument,       0, 'V' },
-    {             0,                 0, 0,   0 }
+    { "disable-opt",  no_argument,       0, 'o' },       // DEPRECATED
+    { "dump-llvm",    no_argument,       0, 'd' },
+    { "dump-vcode",   optional_argument, 0, 'v' },
+    { "native",       no_argument,       0, 'n' },       // DEPRECATED
+    { "cover",        no_argument,       0, 'c' },
+    { "single-image", no_argument,       0, 'i' },
+    { "jit",          no_argument,       0, 'j' },
+    { "jobs",         required_argument, 0, 'J' },
+    { "inline-limit", required_argument, 0, 'I' },
+    { "verbose",      no_argument,       0, 'V' },
+    {              0,                 0, 0,   0 }
   };
 
   const int next_cmd = scan_cmd(2, argc, argv);
-  bool verbose = false;
   int c, index = 0;
   const char *spec = "Vg:O:";
 
@@ -624,9 +944,48 @@ elaborate (
         }
         break;
 
+      case 'i':
+        {
+#ifdef IMPLIB_REQUIRED
+          warnf("--single-image is not supported on this platform");
+#else
+          opt_set_int("single-image", 1);
+#endif
+        }
+        break;
+
+      case 'j':
+        {
+#if LLVM_HAS_LLJIT
+          opt_set_int("jit", 1);
+#else
+          warnf("--jit requires LLVM 12 or later");
+#endif
+        }
+        break;
+
+      case 'J':
+        {
+          const int jobs = parse_int(optarg);
+          if (jobs < 1) {
+            fatal("invalid number of jobs %s", optarg);
+          }
+          opt_set_int("jobs", jobs);
+        }
+        break;
+
+      case 'I':
+        {
+          const int limit = parse_int(optarg);
+          if (limit < 0) {
+            fatal("invalid inline limit %s", optarg);
+          }
+          opt_set_int("inline-limit", limit);
+        }
+        break;
+
       case 'V':
         {
-          verbose = true;
           opt_set_int("verbose", 1);
         }
         break;
@@ -655,6 +1014,30 @@ elaborate (
 
   set_top_level(argv, next_cmd);
 
+  const bool run_next = (next_cmd < argc) && !strcmp(argv[next_cmd], "-r");
+  if (opt_get_int("jit") && !run_next) {
+    warnf("--jit has no effect unless followed by the run command");
+  }
+
+  const int status = elaborate_unit();
+  if (status != EXIT_SUCCESS) {
+    return (status);
+  }
+
+  argc -= next_cmd - 1;
+  argv += next_cmd - 1;
+
+  return (argc > 1 ? process_command(argc, argv) : EXIT_SUCCESS);
+} /* elaborate() */
+
+/* ------------------------------------------------------------------------- */
+
+static int
+elaborate_unit (
+  void
+) {
+  const bool verbose = opt_get_int("verbose");
+
   elab_verbose(verbose, "initialising");
 
   tree_t unit = lib_get(lib_work(), top_level);
@@ -680,17 +1063,46 @@ elaborate (
   lib_save(lib_work());
   elab_verbose(verbose, "saving library");
 
+  // Library units that were only needed to elaborate the design are
+  // released before code generation
+  tree_gc();
+  elab_verbose(verbose, "releasing unused units");
+
   vcode_unit_t vu = lower_unit(e);
   elab_verbose(verbose, "generating intermediate code");
 
   cgen(e, vu);
   elab_verbose(verbose, "generating LLVM");
 
-  argc -= next_cmd - 1;
-  argv += next_cmd - 1;
+  return (EXIT_SUCCESS);
+} /* elaborate_unit() */
 
-  return (argc > 1 ? process_command(argc, argv) : EXIT_SUCCESS);
-} /* elaborate() */
+/* ------------------------------------------------------------------------- */
+
+static tree_t *
+find_make_targets (
+  char **names,
+  int    count
+) {
+  // Prefer the elaborated design if a name refers to a top-level entity
+
+  tree_t *targets = xmalloc(count * sizeof(tree_t));
+
+  lib_t work = lib_work();
+
+  for (int i = 0; i < count; i++) {
+    ident_t name = to_unit_name(names[i]);
+    ident_t elab = ident_prefix(name, ident_new("elab"), '.');
+    if ((targets[i] = lib_get(work, elab)) == NULL) {
+      if ((targets[i] = lib_get(work, name)) == NULL) {
+        fatal("cannot find unit %s in library %s",
+          istr(name), istr(lib_name(work)));
+      }
+    }
+  }
+
+  return (targets);
+} /* find_make_targets() */
 
 /* ------------------------------------------------------------------------- */
 
@@ -837,20 +1249,7 @@ make_cmd (
   }
 
   const int count = next_cmd - optind;
-  tree_t *targets = xmalloc(count * sizeof(tree_t));
-
-  lib_t work = lib_work();
-
-  for (int i = optind; i < next_cmd; i++) {
-    ident_t name = to_unit_name(argv[i]);
-    ident_t elab = ident_prefix(name, ident_new("elab"), '.');
-    if ((targets[i - optind] = lib_get(work, elab)) == NULL) {
-      if ((targets[i - optind] = lib_get(work, name)) == NULL) {
-        fatal("cannot find unit %s in library %s",
-          istr(name), istr(lib_name(work)));
-      }
-    }
-  }
+  tree_t *targets = find_make_targets(argv + optind, count);
 
   make(targets, count, stdout);
 
@@ -900,6 +1299,19 @@ parse_int (
 
 /* ------------------------------------------------------------------------- */
 
+static fbuf_codec_t
+parse_lib_format (
+  const char *str
+) {
+  fbuf_codec_t codec;
+  if (!fbuf_codec_parse(str, &codec)) {
+    fatal("invalid library format: %s (allowed fastlz, lz4, none)", str);
+  }
+  return (codec);
+} /* parse_lib_format() */
+
+/* ------------------------------------------------------------------------- */
+
 static void
 parse_library_map (
   char *str
@@ -1103,6 +1515,7 @@ process_command (
     { "dump",    no_argument, 0, 'd' },
     { "codegen", no_argument, 0, 'c' },     // DEPRECATED
     { "make",    no_argument, 0, 'm' },
+    { "build",   no_argument, 0, 'b' },
     { "syntax",  no_argument, 0, 's' },
     { "list",    no_argument, 0, 'l' },
     {         0,           0, 0,   0 }
@@ -1145,6 +1558,11 @@ process_command (
         return (make_cmd(argc, argv));
       }
 
+    case 'b':
+      {
+        return (build_cmd(argc, argv));
+      }
+
     case 's':
       {
         return (syntax_cmd(argc, argv));
@@ -1381,7 +1799,8 @@ scan_cmd (
 ) {
   const char *commands[] =
   {
-    "-a", "-e", "-r", "--codegen", "--dump", "--make", "--syntax", "--list"
+    "-a", "-e", "-r", "--codegen", "--dump", "--make", "--build",
+    "--syntax", "--list"
   };
 
   for (int i = start; i < argc; i++) {
@@ -1409,6 +1828,10 @@ set_default_opts (
   opt_set_int("bootstrap", 0);
   opt_set_str("dump-json", NULL);
   opt_set_int("cover", 0);
+  opt_set_int("single-image", 0);
+  opt_set_int("jit", 0);
+  opt_set_int("jobs", 1);
+  opt_set_int("inline-limit", 64);
   opt_set_int("stop-delta", 1000);
   opt_set_int("unit-test", 0);
   opt_set_int("make-deps-only", 0);
@@ -1421,6 +1844,8 @@ set_default_opts (
   opt_set_int("rt_profile", 0);
   opt_set_int("synthesis", 0);
   opt_set_int("parse-pragmas", 0);
+  opt_set_str("cache-dir", NULL);
+  opt_set_int("lib-format", FBUF_CODEC_FASTLZ);
 } /* set_default_opts() */
 
 /* ------------------------------------------------------------------------- */
@@ -1521,16 +1946,19 @@ usage (
     " -a [OPTION]... FILE...\t\tAnalyse FILEs into work library\n"
     " -e [OPTION]... UNIT\t\tElaborate and generate code for UNIT\n"
     " -r [OPTION]... UNIT\t\tExecute previously elaborated UNIT\n"
+    " --build [OPTION]... [UNIT]...\tReanalyse and elaborate out of date UNITs\n"
     " --dump [OPTION]... UNIT\tPrint out previously analysed UNIT\n"
     " --list\t\t\t\tPrint all units in the library\n"
     " --make [OPTION]... [UNIT]...\tGenerate makefile to rebuild UNITs\n"
     " --syntax FILE...\t\tCheck FILEs for syntax errors only\n"
     "\n"
     "Global options may be placed before COMMAND:\n"
+    "     --cache-dir=PATH\tReuse object code cached in PATH\n"
     "     --force-init\tCreate a library in an existing directory\n"
     " -h, --help\t\tDisplay this message and exit\n"
     "     --ignore-time\tSkip source file timestamp check\n"
     " -L PATH\t\tAdd PATH to library search paths\n"
+    "     --lib-format=FMT\tCompress new libraries with fastlz, lz4 or none\n"
     "     --map=LIB:PATH\tMap library LIB to PATH\n"
     "     --messages=STYLE\tSelect full or compact message format\n"
     "     --native\t\tGenerate native code shared library\n"
@@ -1540,6 +1968,7 @@ usage (
     "\n"
     "Analyse options:\n"
     "     --bootstrap\tAllow compilation of STANDARD package\n"
+    "     --jobs=N\t\tAnalyse independent files using N processes\n"
     "     --parse-pragmas\tEnable parsing comments for pragmas\n"
     "     --relax=RULES\tDisable certain pedantic rule checks\n"
     "\n"
@@ -1548,7 +1977,11 @@ usage (
     "     --dump-llvm\tPrint generated LLVM IR\n"
     "     --dump-vcode\tPrint generated intermediate code\n"
     " -g NAME=VALUE\t\tSet top level generic NAME to VALUE\n"
+    "     --inline-limit=N\tInline package subprograms up to N instructions\n"
+    "     --jit\t\tCompile in memory for a following run command\n"
+    "     --jobs=N\t\tGenerate code using N parallel jobs\n"
     " -O0, -O1, -O2, -O3\tSet optimisation level (default is -O2)\n"
+    "     --single-image\tLink design and packages into one object\n"
     " -V, --verbose\t\tPrint resource usage at each step\n"
     "\n"
     "Run options:\n"
@@ -1577,6 +2010,9 @@ usage (
     "Make options:\n"
     "     --deps-only\tOutput dependencies without actions\n"
     "     --posix\t\tStrictly POSIX compliant makefile\n"
+    "\n"
+    "Build options:\n"
+    " -j, --jobs=N\t\tRun up to N steps in parallel\n"
     "\n",
     PACKAGE,
     opt_get_int("stop-delta"));
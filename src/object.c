@@ -34,18 +34,56 @@
 /* -- PRIVATE DEFINITIONS -------------------------------------------------- */
 /* ========================================================================= */
 
+// Items of the top-level object written at the end of the stream
+#define DEFERRED_ITEMS (I_DECLS | I_STMTS)
+
+// Objects of all sizes are packed into slabs which start small and
+// double up to this limit
+#define SLAB_MIN_BYTES 512
+#define SLAB_MAX_BYTES 65536
+
+// Set in the tag of a slot whose object has been swept
+#define OBJECT_TAG_FREE 0x80
+
+// Swept slots are linked through their first item
+#define FREE_SLOT_NEXT(object) ((object)->items[0].tree)
+
+// Locations are interned in chunks of this many entries so pointers
+// into the table remain valid as it grows
+#define LOC_CHUNK_BITS 10
+#define LOC_CHUNK_SIZE (1 << LOC_CHUNK_BITS)
+
 /* ========================================================================= */
 /* -- PRIVATE MACROS ------------------------------------------------------- */
 /* ========================================================================= */
 
+#define LOC_AT(index) \
+  (&(loc_chunks[(index) >> LOC_CHUNK_BITS][(index) & (LOC_CHUNK_SIZE - 1)]))
+
 /* ========================================================================= */
 /* -- PRIVATE TYPEDEFS ----------------------------------------------------- */
 /* ========================================================================= */
 
+typedef struct slab slab_t;
+
 /* ========================================================================= */
 /* -- PRIVATE STRUCTURES --------------------------------------------------- */
 /* ========================================================================= */
 
+struct slab {
+  slab_t  *next;
+  uint32_t used;      // Bytes
+  uint32_t size;
+  char     data[0];
+};
+
+struct object_arena {
+  object_arena_t *next;
+  slab_t         *slabs;
+  object_t       *top;          // Unit read from a library if any
+  object_t       *free[0];      // Swept slots by number of items
+};
+
 /* ========================================================================= */
 /* -- INTERNAL FUNCTION PROTOTYPES ----------------------------------------- */
 /* ========================================================================= */
@@ -54,7 +92,22 @@
 /* -- STATIC FUNCTION PROTOTYPES ------------------------------------------- */
 /* ========================================================================= */
 
+static object_t *object_alloc(object_arena_t *arena,
+  const object_class_t *class, int kind);
+static object_arena_t *object_arena_new(void);
+static bool object_arena_marked(object_arena_t *arena,
+  generation_t base_gen);
+static size_t object_arena_sweep(object_arena_t *arena,
+  generation_t base_gen, size_t *nfreed);
 static void object_init(object_class_t *class);
+static uint32_t object_loc_hash(const loc_t *loc);
+static uint32_t object_loc_intern(const loc_t *loc);
+static void object_loc_rehash(void);
+static void object_mark(object_t *object, generation_t generation);
+static void object_read_discard(object_t *object);
+static void object_read_free(object_rd_ctx_t *ctx);
+static inline bool object_shared(const object_t *object, bool skip,
+                                 generation_t generation);
 static void object_sweep(object_t *object);
 
 /* ========================================================================= */
@@ -89,9 +142,20 @@ static const char *item_text_map[] =
 static object_class_t *classes[4];
 static uint32_t format_digest;
 static generation_t next_generation = 1;
-static object_t **all_objects = NULL;
-static size_t max_objects = 256;            // Grows at runtime
+static object_arena_t *all_arenas = NULL;
+static object_arena_t *default_arena = NULL;
 static size_t n_objects_alloc = 0;
+static int n_size_classes = 0;
+static object_t **gc_roots = NULL;
+static size_t max_gc_roots = 16;
+static size_t n_gc_roots = 0;
+static object_rd_ctx_t **pending = NULL;
+static size_t max_pending = 16;
+static size_t n_pending = 0;
+static loc_t **loc_chunks = NULL;
+static uint32_t n_locs = 0;
+static uint32_t *loc_slots = NULL;      // Location index plus one
+static uint32_t loc_nslots = 0;
 
 /* ========================================================================= */
 /* -- EXPORTED DATA -------------------------------------------------------- */
@@ -101,6 +165,11 @@ static size_t n_objects_alloc = 0;
 /* -- STATIC ASSERTIONS ---------------------------------------------------- */
 /* ========================================================================= */
 
+// Arrays and attribute tables keep their length out of line so every
+// item fits in a single word
+STATIC_ASSERT(sizeof(item_t) == 8)
+STATIC_ASSERT(sizeof(object_t) == 16)
+
 /* ========================================================================= */
 /* -- EXPORTED FUNCTION DEFINITIONS ---------------------------------------- */
 /* ========================================================================= */
@@ -109,19 +178,23 @@ static size_t n_objects_alloc = 0;
 /* -- INTERNAL FUNCTION DEFINITIONS ---------------------------------------- */
 /* ========================================================================= */
 
-DEFINE_ARRAY(tree);
+DEFINE_COMPACT_ARRAY(tree);
 
 /* ------------------------------------------------------------------------- */
 
-DEFINE_ARRAY(netid);
+DEFINE_COMPACT_ARRAY(netid);
 
 /* ------------------------------------------------------------------------- */
 
-DEFINE_ARRAY(type);
+DEFINE_COMPACT_ARRAY(type);
 
 /* ------------------------------------------------------------------------- */
 
-DEFINE_ARRAY(range);
+DEFINE_COMPACT_ARRAY(range);
+
+/* ------------------------------------------------------------------------- */
+
+DEFINE_COMPACT_ARRAY(attr);
 
 /* ------------------------------------------------------------------------- */
 
@@ -140,6 +213,20 @@ item_without_type (
 
 /* ------------------------------------------------------------------------- */
 
+void
+object_add_gc_root (
+  object_t *object
+) {
+  // For objects cached outside the tree such as the universal types
+  if (unlikely(gc_roots == NULL)) {
+    gc_roots = xmalloc(sizeof(object_t *) * max_gc_roots);
+  }
+
+  ARRAY_APPEND(gc_roots, object, n_gc_roots, max_gc_roots);
+} /* object_add_gc_root() */
+
+/* ------------------------------------------------------------------------- */
+
 void
 object_change_kind (
   const object_class_t *class,
@@ -150,6 +237,10 @@ object_change_kind (
     return;
   }
 
+  if (n_pending > 0) {
+    object_read_deferred(object);
+  }
+
   bool allow = false;
   for (size_t i = 0; (class->change_allowed[i][0] != -1) && !allow; i++) {
     allow = (class->change_allowed[i][0] == object->kind) &&
@@ -227,15 +318,18 @@ object_copy_mark (
       } else if (ITEM_DOUBLE & mask) {
       } else if (ITEM_TREE_ARRAY & mask) {
         tree_array_t *a = &(object->items[n].tree_array);
-        for (unsigned i = 0; i < a->count; i++) {
-          marked = object_copy_mark((object_t *) a->items[i], ctx) ||
-            marked;
+        if (object_array_deferred(a)) {
+          object_read_deferred(object);
+        }
+        for (unsigned i = 0; i < tree_array_count(a); i++) {
+          marked = object_copy_mark((object_t *) a->data->items[i], ctx)
+            || marked;
         }
       } else if (ITEM_TYPE_ARRAY & mask) {
         type_array_t *a = &(object->items[n].type_array);
-        for (unsigned i = 0; i < a->count; i++) {
-          marked = object_copy_mark((object_t *) a->items[i], ctx) ||
-            marked;
+        for (unsigned i = 0; i < type_array_count(a); i++) {
+          marked = object_copy_mark((object_t *) a->data->items[i], ctx)
+            || marked;
         }
       } else if (ITEM_TYPE & mask) {
         type_item = n;
@@ -243,11 +337,10 @@ object_copy_mark (
       } else if (ITEM_INT32 & mask) {
       } else if (ITEM_RANGE_ARRAY & mask) {
         range_array_t *a = &(object->items[n].range_array);
-        for (unsigned i = 0; i < a->count; i++) {
-          marked = object_copy_mark((object_t *) a->items[i].left, ctx) ||
-            marked;
-          marked = object_copy_mark((object_t *) a->items[i].right, ctx) ||
-            marked;
+        for (unsigned i = 0; i < range_array_count(a); i++) {
+          range_t *r = &(a->data->items[i]);
+          marked = object_copy_mark((object_t *) r->left, ctx) || marked;
+          marked = object_copy_mark((object_t *) r->right, ctx) || marked;
         }
       } else if (ITEM_NETID_ARRAY & mask) {
       } else if (ITEM_ATTRS & mask) {
@@ -302,7 +395,7 @@ object_copy_sweep (
   object_t *copy = object_new(class, object->kind);
   ctx->copied[object->index] = copy;
 
-  copy->loc = object->loc;
+  copy->loc = object->loc;     // Copies share the interned location
 
   const imask_t has = class->has_map[object->kind];
   const int nitems = class->object_nitems[object->kind];
@@ -320,11 +413,11 @@ object_copy_sweep (
         const tree_array_t *from = &(object->items[n].tree_array);
         tree_array_t *to = &(copy->items[n].tree_array);
 
-        tree_array_resize(to, from->count, 0);
+        tree_array_resize(to, tree_array_count(from), 0);
 
-        for (size_t i = 0; i < from->count; i++) {
-          to->items[i] = (tree_t)
-            object_copy_sweep((object_t *) from->items[i], ctx);
+        for (size_t i = 0; i < tree_array_count(from); i++) {
+          to->data->items[i] = (tree_t)
+            object_copy_sweep((object_t *) from->data->items[i], ctx);
         }
       } else if (ITEM_TYPE & mask) {
         copy->items[n].type = (type_t)
@@ -335,42 +428,41 @@ object_copy_sweep (
         const netid_array_t *from = &(object->items[n].netid_array);
         netid_array_t *to = &(copy->items[n].netid_array);
 
-        netid_array_resize(to, from->count, 0xff);
+        netid_array_resize(to, netid_array_count(from), 0xff);
 
-        for (unsigned i = 0; i < from->count; i++) {
-          to->items[i] = from->items[i];
+        for (unsigned i = 0; i < netid_array_count(from); i++) {
+          to->data->items[i] = from->data->items[i];
         }
       } else if (ITEM_ATTRS & mask) {
-        if ((copy->items[n].attrs.num = object->items[n].attrs.num) > 0) {
-          copy->items[n].attrs.alloc = object->items[n].attrs.alloc;
-          copy->items[n].attrs.table =
-            xmalloc(sizeof(attr_t) * copy->items[n].attrs.alloc);
-          for (unsigned i = 0; i < object->items[n].attrs.num; i++) {
-            copy->items[n].attrs.table[i] =
-              object->items[n].attrs.table[i];
-          }
+        const attr_array_t *from = &(object->items[n].attrs);
+        attr_array_t *to = &(copy->items[n].attrs);
+
+        attr_array_resize(to, attr_array_count(from), 0);
+
+        for (unsigned i = 0; i < attr_array_count(from); i++) {
+          to->data->items[i] = from->data->items[i];
         }
       } else if (ITEM_RANGE_ARRAY & mask) {
         const range_array_t *from = &(object->items[n].range_array);
         range_array_t *to = &(copy->items[n].range_array);
-        range_array_resize(to, from->count, 0);
-
-        for (unsigned i = 0; i < from->count; i++) {
-          to->items[i].kind = from->items[i].kind;
-          to->items[i].left = (tree_t)
-            object_copy_sweep((object_t *) from->items[i].left, ctx);
-          to->items[i].right = (tree_t)
-            object_copy_sweep((object_t *) from->items[i].right, ctx);
+        range_array_resize(to, range_array_count(from), 0);
+
+        for (unsigned i = 0; i < range_array_count(from); i++) {
+          to->data->items[i].kind = from->data->items[i].kind;
+          to->data->items[i].left = (tree_t)
+            object_copy_sweep((object_t *) from->data->items[i].left, ctx);
+          to->data->items[i].right = (tree_t)
+            object_copy_sweep((object_t *) from->data->items[i].right, ctx);
         }
       } else if (ITEM_TYPE_ARRAY & mask) {
         const type_array_t *from = &(object->items[n].type_array);
         type_array_t *to = &(copy->items[n].type_array);
 
-        type_array_resize(to, from->count, 0);
+        type_array_resize(to, type_array_count(from), 0);
 
-        for (unsigned i = 0; i < from->count; i++) {
-          to->items[i] = (type_t)
-            object_copy_sweep((object_t *) from->items[i], ctx);
+        for (unsigned i = 0; i < type_array_count(from); i++) {
+          to->data->items[i] = (type_t)
+            object_copy_sweep((object_t *) from->data->items[i], ctx);
         }
       } else if (ITEM_TEXT_BUF & mask) {
       } else {
@@ -387,66 +479,111 @@ object_copy_sweep (
 
 void
 object_gc (
-  void
+  object_unload_fn_t fn
 ) {
-  // Generation will be updated by tree_visit
-  const generation_t base_gen = next_generation;
+  // Every object reached is stamped with this generation so each one
+  // is visited once however many roots refer to it
+  const generation_t base_gen = next_generation++;
+
+  // Mark from the top-level objects created in this process. Units read
+  // from a library are kept whole if anything refers into them and are
+  // otherwise released with their arena as they can be read again.
+  for (object_arena_t *a = all_arenas; a != NULL; a = a->next) {
+    if (a->top != NULL) {
+      continue;
+    }
 
-  // Mark
-  for (unsigned i = 0; i < n_objects_alloc; i++) {
-    assert(all_objects[i] != NULL);
+    for (slab_t *s = a->slabs; s != NULL; s = s->next) {
+      for (uint32_t off = 0; off < s->used; ) {
+        object_t *object = (object_t *) (s->data + off);
+        off += object->slot_size;
 
-    const object_class_t *class = classes[all_objects[i]->tag];
+        if (object->tag & OBJECT_TAG_FREE) {
+          continue;
+        }
+
+        const object_class_t *class = classes[object->tag];
+
+        bool top_level = false;
+        for (int j = 0; (j < class->gc_num_roots) && !top_level; j++) {
+          if (class->gc_roots[j] == object->kind) {
+            top_level = true;
+          }
+        }
 
-    bool top_level = false;
-    for (int j = 0; (j < class->gc_num_roots) && !top_level; j++) {
-      if (class->gc_roots[j] == all_objects[i]->kind) {
-        top_level = true;
+        if (top_level) {
+          object_mark(object, base_gen);
+        }
       }
     }
+  }
 
-    if (top_level) {
-      object_visit_ctx_t ctx =
-      {
-        .count      =                 0,
-        .postorder  = NULL,
-        .preorder   = NULL,
-        .context    = NULL,
-        .kind       = T_LAST_TREE_KIND,
-        .generation = next_generation++,
-        .deep       = true
-      };
-
-      object_visit(all_objects[i], &ctx);
-    }
+  for (size_t i = 0; i < n_gc_roots; i++) {
+    object_mark(gc_roots[i], base_gen);
   }
 
-  // Sweep
-  for (unsigned i = 0; i < n_objects_alloc; i++) {
-    object_t *object = all_objects[i];
-    if (object->generation < base_gen) {
-      object_sweep(object);
-      all_objects[i] = NULL;
+  bool changed;
+  do {
+    changed = false;
+    for (object_arena_t *a = all_arenas; a != NULL; a = a->next) {
+      if ((a->top != NULL) && (a->top->generation < base_gen)
+        && object_arena_marked(a, base_gen)) {
+        object_mark(a->top, base_gen);
+        changed = true;
+      }
+    }
+  } while (changed);
+
+  // Every unit is unloaded before anything is freed as the callback may
+  // look at other units
+  for (object_arena_t *a = all_arenas; a != NULL; a = a->next) {
+    if ((a->top != NULL) && (a->top->generation < base_gen)) {
+      if (fn != NULL) {
+        (*fn)(a->top);
+      }
+      object_read_discard(a->top);
     }
   }
 
-  // Compact
-  size_t p = 0;
-  for (unsigned i = 0; i < n_objects_alloc; i++) {
-    if (all_objects[i] != NULL) {
-      all_objects[p++] = all_objects[i];
+  // Sweep: an arena with nothing left alive is released in one go
+  size_t nfreed = 0, nlive = 0, narenas = 0;
+  for (object_arena_t **p = &all_arenas; *p != NULL; ) {
+    object_arena_t *a = *p;
+
+    const size_t live = object_arena_sweep(a, base_gen, &nfreed);
+    nlive += live;
+
+    if (live == 0) {
+      if (a == default_arena) {
+        default_arena = NULL;
+      }
+
+      *p = a->next;
+      free(a);
+      narenas++;
+    } else {
+      p = &(a->next);
     }
   }
 
   if ((getenv("NVC_GC_VERBOSE") != NULL) || is_debugger_running()) {
-    notef("GC: freed %zu objects; %zu allocated", n_objects_alloc - p, p);
+    notef("GC: freed %zu objects and %zu arenas; %zu allocated",
+      nfreed, narenas, nlive);
   }
-
-  n_objects_alloc = p;
 } /* object_gc() */
 
 /* ------------------------------------------------------------------------- */
 
+const loc_t *
+object_loc (
+  const object_t *object
+) {
+  assert(object->loc < n_locs);
+  return (LOC_AT(object->loc));
+} /* object_loc() */
+
+/* ------------------------------------------------------------------------- */
+
 void
 object_lookup_failed (
   const char  *name,
@@ -477,19 +614,11 @@ object_new (
 
   object_one_time_init();
 
-  object_t *object = xcalloc(class->object_size[kind]);
-
-  object->kind = kind;
-  object->tag = class->tag;
-  object->index = UINT32_MAX;
-
-  if (unlikely(all_objects == NULL)) {
-    all_objects = xmalloc(sizeof(object_t *) * max_objects);
+  if (unlikely(default_arena == NULL)) {
+    default_arena = object_arena_new();
   }
 
-  ARRAY_APPEND(all_objects, object, n_objects_alloc, max_objects);
-
-  return (object);
+  return (object_alloc(default_arena, class, kind));
 } /* object_new() */
 
 /* ------------------------------------------------------------------------- */
@@ -518,10 +647,14 @@ object_one_time_init (
 
     // Increment this each time a incompatible change is made to the
     // on-disk format not expressed in the tree and type items table
-    const uint32_t format_fudge = 12;
+    const uint32_t format_fudge = 13;
 
     format_digest += format_fudge * UINT32_C(2654435761);
 
+    // New objects start with index zero which is the empty location
+    static const loc_t empty_loc;
+    (void) object_loc_intern(&empty_loc);
+
     done = true;
   }
 } /* object_one_time_init() */
@@ -535,6 +668,8 @@ object_read (
 ) {
   uint16_t marker = read_u16(ctx->file);
 
+  const bool top_level = (ctx->n_objects == 0) && (tag == OBJECT_TAG_TREE);
+
   if (marker == UINT16_C(0xffff)) {
     return (NULL);    // Null marker
   } else if (marker ==
@@ -549,10 +684,16 @@ object_read (
 
   assert(marker < class->last_kind);
 
-  object_t *object = object_new(class, marker);
+  object_t *object = object_alloc(ctx->arena, class, marker);
+
+  if (top_level) {
+    ctx->arena->top = object;
+  }
 
   if (tag == OBJECT_TAG_TREE) {
-    loc_read(&(object->loc), ctx->file, ctx->ident_ctx);
+    loc_t loc;
+    loc_read(&loc, ctx->file, ctx->ident_ctx);
+    object->loc = object_loc_intern(&loc);
   }
 
   // Stash pointer for later back references
@@ -565,6 +706,7 @@ object_read (
   }
   ctx->store[object->index] = object;
 
+  bool defer = false;
   const imask_t has = class->has_map[object->kind];
   const int nitems = class->object_nitems[object->kind];
   imask_t mask = 1;
@@ -578,15 +720,26 @@ object_read (
         object->items[n].tree = (tree_t) object_read(ctx, OBJECT_TAG_TYPE);
       } else if (ITEM_TREE_ARRAY & mask) {
         tree_array_t *a = &(object->items[n].tree_array);
-        tree_array_resize(a, read_u32(ctx->file), 0);
-        for (unsigned i = 0; i < a->count; i++) {
-          a->items[i] = (tree_t) object_read(ctx, OBJECT_TAG_TREE);
+        if (top_level && (DEFERRED_ITEMS & mask)) {
+          // Items follow the rest of the unit and are read later by
+          // object_read_deferred
+          const uint32_t count = read_u32(ctx->file);
+          if (count > 0) {
+            a->data = xcalloc(sizeof(tree_array_data_t));
+            a->data->count = count;
+            defer = true;
+          }
+        } else {
+          tree_array_resize(a, read_u32(ctx->file), 0);
+          for (unsigned i = 0; i < tree_array_count(a); i++) {
+            a->data->items[i] = (tree_t) object_read(ctx, OBJECT_TAG_TREE);
+          }
         }
       } else if (ITEM_TYPE_ARRAY & mask) {
         type_array_t *a = &(object->items[n].type_array);
         type_array_resize(a, read_u16(ctx->file), 0);
-        for (unsigned i = 0; i < a->count; i++) {
-          a->items[i] = (type_t) object_read(ctx, OBJECT_TAG_TYPE);
+        for (unsigned i = 0; i < type_array_count(a); i++) {
+          a->data->items[i] = (type_t) object_read(ctx, OBJECT_TAG_TYPE);
         }
       } else if (ITEM_INT64 & mask) {
         object->items[n].ival = read_u64(ctx->file);
@@ -596,11 +749,11 @@ object_read (
         range_array_t *a = &(object->items[n].range_array);
         range_array_resize(a, read_u16(ctx->file), 0);
 
-        for (unsigned i = 0; i < a->count; i++) {
-          a->items[i].kind = read_u8(ctx->file);
-          a->items[i].left =
+        for (unsigned i = 0; i < range_array_count(a); i++) {
+          a->data->items[i].kind = read_u8(ctx->file);
+          a->data->items[i].left =
             (tree_t) object_read(ctx, OBJECT_TAG_TREE);
-          a->items[i].right =
+          a->data->items[i].right =
             (tree_t) object_read(ctx, OBJECT_TAG_TREE);
         }
       } else if (ITEM_TEXT_BUF & mask) {
@@ -612,41 +765,36 @@ object_read (
       } else if (ITEM_NETID_ARRAY & mask) {
         netid_array_t *a = &(object->items[n].netid_array);
         netid_array_resize(a, read_u32(ctx->file), 0xff);
-        for (unsigned i = 0; i < a->count; i++) {
-          a->items[i] = read_u32(ctx->file);
+        if (netid_array_count(a) > 0) {
+          read_u32_array(a->data->items, a->data->count, ctx->file);
         }
       } else if (ITEM_DOUBLE & mask) {
         object->items[n].dval = read_double(ctx->file);
       } else if (ITEM_ATTRS & mask) {
-        attr_tab_t *attrs = &(object->items[n].attrs);
-
-        attrs->num = read_u16(ctx->file);
-        if (attrs->num > 0) {
-          attrs->alloc = next_power_of_2(attrs->num);
-          attrs->table = xmalloc(sizeof(attr_t) * attrs->alloc);
-        }
+        attr_array_t *attrs = &(object->items[n].attrs);
+        attr_array_resize(attrs, read_u16(ctx->file), 0);
 
-        for (unsigned i = 0; i < attrs->num; i++) {
-          attrs->table[i].kind = read_u16(ctx->file);
-          attrs->table[i].name = ident_read(ctx->ident_ctx);
+        for (unsigned i = 0; i < attr_array_count(attrs); i++) {
+          attrs->data->items[i].kind = read_u16(ctx->file);
+          attrs->data->items[i].name = ident_read(ctx->ident_ctx);
 
-          switch (attrs->table[i].kind)
+          switch (attrs->data->items[i].kind)
           {
             case A_STRING:
               {
-                attrs->table[i].sval = ident_read(ctx->ident_ctx);
+                attrs->data->items[i].sval = ident_read(ctx->ident_ctx);
               }
               break;
 
             case A_INT:
               {
-                attrs->table[i].ival = read_u32(ctx->file);
+                attrs->data->items[i].ival = read_u32(ctx->file);
               }
               break;
 
             case A_TREE:
               {
-                attrs->table[i].tval =
+                attrs->data->items[i].tval =
                   (tree_t) object_read(ctx, OBJECT_TAG_TREE);
               }
               break;
@@ -662,11 +810,70 @@ object_read (
     }
   }
 
+  if (defer) {
+    // The caller usually closes the file as soon as the top-level object
+    // is returned so keep a private copy of the remaining data
+    ctx->deferred = object;
+    ctx->file = fbuf_snapshot(ctx->file);
+    ident_read_rebind(ctx->ident_ctx, ctx->file);
+
+    if (unlikely(pending == NULL)) {
+      pending = xmalloc(sizeof(object_rd_ctx_t *) * max_pending);
+    }
+
+    ARRAY_APPEND(pending, ctx, n_pending, max_pending);
+  }
+
   return (object);
 } /* object_read() */
 
 /* ------------------------------------------------------------------------- */
 
+void
+object_read_deferred (
+  object_t *object
+) {
+  object_rd_ctx_t *ctx = NULL;
+  for (size_t i = 0; i < n_pending; i++) {
+    if (pending[i]->deferred == object) {
+      ctx = pending[i];
+      pending[i] = pending[--n_pending];
+      break;
+    }
+  }
+
+  if (ctx == NULL) {
+    return;
+  }
+
+  ctx->deferred = NULL;
+
+  // Arrays appear in the stream in item order
+  const object_class_t *class = classes[object->tag];
+  const imask_t has = class->has_map[object->kind] & DEFERRED_ITEMS;
+  for (int bit = 0; bit < 64; bit++) {
+    if (has & ONE_HOT(bit)) {
+      const int n = class->item_lookup[(object->kind * 64) + bit];
+      tree_array_t *a = &(object->items[n].tree_array);
+      if (object_array_deferred(a)) {
+        tree_array_resize(a, a->data->count, 0);
+        for (unsigned i = 0; i < tree_array_count(a); i++) {
+          a->data->items[i] = (tree_t) object_read(ctx, OBJECT_TAG_TREE);
+        }
+      }
+    }
+  }
+
+  fbuf_close(ctx->file);
+  ctx->file = NULL;
+
+  if (ctx->ended) {
+    object_read_free(ctx);
+  }
+} /* object_read_deferred() */
+
+/* ------------------------------------------------------------------------- */
+
 object_rd_ctx_t *
 object_read_begin (
   fbuf_t     *f,
@@ -697,6 +904,9 @@ object_read_begin (
   ctx->n_objects = 0;
   ctx->db_fname = xstrdup(fname);
 
+  // Each unit gets its own arena so it can be released as a whole
+  ctx->arena = object_arena_new();
+
   return (ctx);
 } /* object_read_begin() */
 
@@ -706,12 +916,12 @@ void
 object_read_end (
   object_rd_ctx_t *ctx
 ) {
-  if (ctx->ident_ctx != NULL) {
-    ident_read_end(ctx->ident_ctx);
+  if (ctx->deferred != NULL) {
+    // Freed once the deferred items have been read
+    ctx->ended = true;
+  } else {
+    object_read_free(ctx);
   }
-  free(ctx->store);
-  free(ctx->db_fname);
-  free(ctx);
 } /* object_read_end() */
 
 /* ------------------------------------------------------------------------- */
@@ -734,10 +944,10 @@ object_replace (
         const type_array_t *from = &(a->items[n].type_array);
         type_array_t *to = &(t->items[n].type_array);
 
-        type_array_resize(to, from->count, 0);
+        type_array_resize(to, type_array_count(from), 0);
 
-        for (unsigned i = 0; i < from->count; i++) {
-          to->items[i] = from->items[i];
+        for (unsigned i = 0; i < type_array_count(from); i++) {
+          to->data->items[i] = from->data->items[i];
         }
       } else if (ITEM_TYPE & mask) {
         t->items[n].type = a->items[n].type;
@@ -747,19 +957,23 @@ object_replace (
         const tree_array_t *from = &(a->items[n].tree_array);
         tree_array_t *to = &(t->items[n].tree_array);
 
-        tree_array_resize(to, from->count, 0);
+        if (object_array_deferred(from)) {
+          object_read_deferred(a);
+        }
 
-        for (size_t i = 0; i < from->count; i++) {
-          to->items[i] = from->items[i];
+        tree_array_resize(to, tree_array_count(from), 0);
+
+        for (size_t i = 0; i < tree_array_count(from); i++) {
+          to->data->items[i] = from->data->items[i];
         }
       } else if (ITEM_RANGE_ARRAY & mask) {
         const range_array_t *from = &(a->items[n].range_array);
         range_array_t *to = &(t->items[n].range_array);
 
-        range_array_resize(to, from->count, 0);
+        range_array_resize(to, range_array_count(from), 0);
 
-        for (unsigned i = 0; i < from->count; i++) {
-          to->items[i] = from->items[i];
+        for (unsigned i = 0; i < range_array_count(from); i++) {
+          to->data->items[i] = from->data->items[i];
         }
       } else if (ITEM_TEXT_BUF & mask) {
       } else if (ITEM_IDENT & mask) {
@@ -783,6 +997,11 @@ object_rewrite (
     return (NULL);
   }
 
+  if (unlikely(object_shared(object, ctx->skip_shared,
+                             ctx->shared_generation))) {
+    return (object);
+  }
+
   if (object->generation == ctx->generation) {
     // Already rewritten this tree so return the cached version
     return (ctx->cache[object->index]);
@@ -805,19 +1024,26 @@ object_rewrite (
       } else if (ITEM_TREE_ARRAY & mask) {
         tree_array_t *a = &(object->items[n].tree_array);
 
-        for (size_t i = 0; i < a->count; i++) {
-          a->items[i] =
-            (tree_t) object_rewrite((object_t *) a->items[i], ctx);
+        if (object_array_deferred(a)) {
+          object_read_deferred(object);
+        }
+
+        // The rewrite callback may append to this array and move its
+        // storage so only index the data after the call returns
+        for (size_t i = 0; i < tree_array_count(a); i++) {
+          tree_t new =
+            (tree_t) object_rewrite((object_t *) a->data->items[i], ctx);
+          a->data->items[i] = new;
         }
 
         // If an item was rewritten to NULL then delete it
         size_t n = 0;
-        for (size_t i = 0; i < a->count; i++) {
-          if (a->items[i] != NULL) {
-            a->items[n++] = a->items[i];
+        for (size_t i = 0; i < tree_array_count(a); i++) {
+          if (a->data->items[i] != NULL) {
+            a->data->items[n++] = a->data->items[i];
           }
         }
-        a->count = n;
+        tree_array_resize(a, n, 0);
       } else if (ITEM_TYPE & mask) {
         type_item = n;
       } else if (ITEM_INT64 & mask) {
@@ -825,18 +1051,20 @@ object_rewrite (
       } else if (ITEM_DOUBLE & mask) {
       } else if (ITEM_TYPE_ARRAY & mask) {
         type_array_t *a = &(object->items[n].type_array);
-        for (unsigned i = 0; i < a->count; i++) {
-          (void) object_rewrite((object_t *) a->items[i], ctx);
+        for (unsigned i = 0; i < type_array_count(a); i++) {
+          (void) object_rewrite((object_t *) a->data->items[i], ctx);
         }
       } else if (ITEM_RANGE_ARRAY & mask) {
         range_array_t *a = &(object->items[n].range_array);
-        for (unsigned i = 0; i < a->count; i++) {
-          a->items[i].left =
-            (tree_t) object_rewrite((object_t *) a->items[i].left, ctx);
-          a->items[i].right =
-            (tree_t) object_rewrite((object_t *) a->items[i].right, ctx);
-          assert(a->items[i].left);
-          assert(a->items[i].right);
+        for (unsigned i = 0; i < range_array_count(a); i++) {
+          tree_t left = (tree_t)
+            object_rewrite((object_t *) a->data->items[i].left, ctx);
+          a->data->items[i].left = left;
+          tree_t right = (tree_t)
+            object_rewrite((object_t *) a->data->items[i].right, ctx);
+          a->data->items[i].right = right;
+          assert(left);
+          assert(right);
         }
       } else if (ITEM_TEXT_BUF & mask) {
       } else if (ITEM_TEXT & mask) {
@@ -891,6 +1119,16 @@ object_rewrite (
 
 /* ------------------------------------------------------------------------- */
 
+void
+object_set_loc (
+  object_t    *object,
+  const loc_t *loc
+) {
+  object->loc = object_loc_intern(loc);
+} /* object_set_loc() */
+
+/* ------------------------------------------------------------------------- */
+
 void
 object_visit (
   object_t           *object,
@@ -902,6 +1140,9 @@ object_visit (
 
   if ((object == NULL) || (object->generation == ctx->generation)) {
     return;
+  } else if (unlikely(object_shared(object, ctx->skip_shared,
+                                    ctx->shared_generation))) {
+    return;
   }
 
   object->generation = ctx->generation;
@@ -928,13 +1169,16 @@ object_visit (
         object_visit((object_t *) object->items[i].tree, ctx);
       } else if (ITEM_TREE_ARRAY & mask) {
         tree_array_t *a = &(object->items[i].tree_array);
-        for (unsigned j = 0; j < a->count; j++) {
-          object_visit((object_t *) a->items[j], ctx);
+        if (object_array_deferred(a)) {
+          object_read_deferred(object);
+        }
+        for (unsigned j = 0; j < tree_array_count(a); j++) {
+          object_visit((object_t *) a->data->items[j], ctx);
         }
       } else if (ITEM_TYPE_ARRAY & mask) {
         type_array_t *a = &(object->items[i].type_array);
-        for (unsigned j = 0; j < a->count; j++) {
-          object_visit((object_t *) a->items[j], ctx);
+        for (unsigned j = 0; j < type_array_count(a); j++) {
+          object_visit((object_t *) a->data->items[j], ctx);
         }
       } else if (ITEM_TYPE & mask) {
         object_visit((object_t *) object->items[i].type, ctx);
@@ -943,21 +1187,21 @@ object_visit (
       } else if (ITEM_DOUBLE & mask) {
       } else if (ITEM_RANGE_ARRAY & mask) {
         range_array_t *a = &(object->items[i].range_array);
-        for (unsigned j = 0; j < a->count; j++) {
-          object_visit((object_t *) a->items[j].left, ctx);
-          object_visit((object_t *) a->items[j].right, ctx);
+        for (unsigned j = 0; j < range_array_count(a); j++) {
+          object_visit((object_t *) a->data->items[j].left, ctx);
+          object_visit((object_t *) a->data->items[j].right, ctx);
         }
       } else if (ITEM_NETID_ARRAY & mask) {
       } else if (ITEM_TEXT_BUF & mask) {
       } else if (ITEM_TEXT & mask) {
       } else if (ITEM_ATTRS & mask) {
-        attr_tab_t *attrs = &(object->items[i].attrs);
-        for (unsigned j = 0; j < attrs->num; j++) {
-          switch (attrs->table[j].kind)
+        attr_array_t *attrs = &(object->items[i].attrs);
+        for (unsigned j = 0; j < attr_array_count(attrs); j++) {
+          switch (attrs->data->items[j].kind)
           {
             case A_TREE:
               {
-                object_visit((object_t *) attrs->table[j].tval, ctx);
+                object_visit((object_t *) attrs->data->items[j].tval, ctx);
               }
               break;
 
@@ -1004,13 +1248,16 @@ object_write (
     return;
   }
 
+  const bool top_level =
+    (ctx->n_objects == 0) && (object->tag == OBJECT_TAG_TREE);
+
   object->generation = ctx->generation;
   object->index = (ctx->n_objects)++;
 
   write_u16(object->kind, ctx->file);
 
   if (object->tag == OBJECT_TAG_TREE) {
-    loc_write(&object->loc, ctx->file, ctx->ident_ctx);
+    loc_write(object_loc(object), ctx->file, ctx->ident_ctx);
   }
 
   const object_class_t *class = classes[object->tag];
@@ -1028,15 +1275,20 @@ object_write (
         object_write((object_t *) object->items[n].type, ctx);
       } else if (ITEM_TREE_ARRAY & mask) {
         const tree_array_t *a = &(object->items[n].tree_array);
-        write_u32(a->count, ctx->file);
-        for (unsigned i = 0; i < a->count; i++) {
-          object_write((object_t *) a->items[i], ctx);
+        if (object_array_deferred(a)) {
+          object_read_deferred(object);
+        }
+        write_u32(tree_array_count(a), ctx->file);
+        if (!top_level || !(DEFERRED_ITEMS & mask)) {
+          for (unsigned i = 0; i < tree_array_count(a); i++) {
+            object_write((object_t *) a->data->items[i], ctx);
+          }
         }
       } else if (ITEM_TYPE_ARRAY & mask) {
         const type_array_t *a = &(object->items[n].type_array);
-        write_u16(a->count, ctx->file);
-        for (unsigned i = 0; i < a->count; i++) {
-          object_write((object_t *) a->items[i], ctx);
+        write_u16(type_array_count(a), ctx->file);
+        for (unsigned i = 0; i < type_array_count(a); i++) {
+          object_write((object_t *) a->data->items[i], ctx);
         }
       } else if (ITEM_INT64 & mask) {
         write_u64(object->items[n].ival, ctx->file);
@@ -1044,36 +1296,36 @@ object_write (
         write_u32(object->items[n].ival, ctx->file);
       } else if (ITEM_NETID_ARRAY & mask) {
         const netid_array_t *a = &(object->items[n].netid_array);
-        write_u32(a->count, ctx->file);
-        for (unsigned i = 0; i < a->count; i++) {
-          write_u32(a->items[i], ctx->file);
+        write_u32(netid_array_count(a), ctx->file);
+        if (netid_array_count(a) > 0) {
+          write_u32_array(a->data->items, a->data->count, ctx->file);
         }
       } else if (ITEM_DOUBLE & mask) {
         write_double(object->items[n].dval, ctx->file);
       } else if (ITEM_ATTRS & mask) {
-        const attr_tab_t *attrs = &(object->items[n].attrs);
-        write_u16(attrs->num, ctx->file);
-        for (unsigned i = 0; i < attrs->num; i++) {
-          write_u16(attrs->table[i].kind, ctx->file);
-          ident_write(attrs->table[i].name, ctx->ident_ctx);
+        const attr_array_t *attrs = &(object->items[n].attrs);
+        write_u16(attr_array_count(attrs), ctx->file);
+        for (unsigned i = 0; i < attr_array_count(attrs); i++) {
+          write_u16(attrs->data->items[i].kind, ctx->file);
+          ident_write(attrs->data->items[i].name, ctx->ident_ctx);
 
-          switch (attrs->table[i].kind)
+          switch (attrs->data->items[i].kind)
           {
             case A_STRING:
               {
-                ident_write(attrs->table[i].sval, ctx->ident_ctx);
+                ident_write(attrs->data->items[i].sval, ctx->ident_ctx);
               }
               break;
 
             case A_INT:
               {
-                write_u32(attrs->table[i].ival, ctx->file);
+                write_u32(attrs->data->items[i].ival, ctx->file);
               }
               break;
 
             case A_TREE:
               {
-                object_write((object_t *) attrs->table[i].tval, ctx);
+                object_write((object_t *) attrs->data->items[i].tval, ctx);
               }
               break;
 
@@ -1083,11 +1335,11 @@ object_write (
         }
       } else if (ITEM_RANGE_ARRAY & mask) {
         range_array_t *a = &(object->items[n].range_array);
-        write_u16(a->count, ctx->file);
-        for (unsigned i = 0; i < a->count; i++) {
-          write_u8(a->items[i].kind, ctx->file);
-          object_write((object_t *) a->items[i].left, ctx);
-          object_write((object_t *) a->items[i].right, ctx);
+        write_u16(range_array_count(a), ctx->file);
+        for (unsigned i = 0; i < range_array_count(a); i++) {
+          write_u8(a->data->items[i].kind, ctx->file);
+          object_write((object_t *) a->data->items[i].left, ctx);
+          object_write((object_t *) a->data->items[i].right, ctx);
         }
       } else if (ITEM_TEXT & mask) {
         size_t len = strlen(object->items[n].text);
@@ -1101,6 +1353,20 @@ object_write (
       n++;
     }
   }
+
+  if (top_level) {
+    // Write the deferred arrays after everything else in the unit so
+    // the reader can skip them until they are needed
+    for (int bit = 0; bit < 64; bit++) {
+      if (has & DEFERRED_ITEMS & ONE_HOT(bit)) {
+        const int n = class->item_lookup[(object->kind * 64) + bit];
+        const tree_array_t *a = &(object->items[n].tree_array);
+        for (unsigned i = 0; i < tree_array_count(a); i++) {
+          object_write((object_t *) a->data->items[i], ctx);
+        }
+      }
+    }
+  }
 } /* object_write() */
 
 /* ------------------------------------------------------------------------- */
@@ -1135,6 +1401,155 @@ object_write_end (
 /* -- STATIC FUNCTION DEFINITIONS ------------------------------------------ */
 /* ========================================================================= */
 
+static object_t *
+object_alloc (
+  object_arena_t       *arena,
+  const object_class_t *class,
+  int                   kind
+) {
+  // The size already allows for any kind this object may change to
+  const size_t size = class->object_size[kind];
+  const int sclass = (size - sizeof(object_t)) / sizeof(item_t);
+  assert(sclass < n_size_classes);
+
+  object_t *reuse = arena->free[sclass];
+  if (reuse != NULL) {
+    arena->free[sclass] = (object_t *) FREE_SLOT_NEXT(reuse);
+    memset(reuse, '\0', size);
+
+    reuse->kind = kind;
+    reuse->tag = class->tag;
+    reuse->slot_size = size;
+    reuse->index = UINT32_MAX;
+
+    n_objects_alloc++;
+
+    return (reuse);
+  }
+
+  slab_t *s = arena->slabs;
+  if (unlikely((s == NULL) || (s->used + size > s->size))) {
+    const size_t bytes = (s == NULL) ? SLAB_MIN_BYTES
+      : MIN(s->size * 2, SLAB_MAX_BYTES);
+
+    slab_t *new = xcalloc(sizeof(slab_t) + MAX(bytes, size));
+    new->size = MAX(bytes, size);
+    new->used = 0;
+    new->next = s;
+
+    arena->slabs = s = new;
+  }
+
+  object_t *object = (object_t *) (s->data + s->used);
+  s->used += size;
+
+  object->kind = kind;
+  object->tag = class->tag;
+  object->slot_size = size;
+  object->index = UINT32_MAX;
+
+  n_objects_alloc++;
+
+  return (object);
+} /* object_alloc() */
+
+/* ------------------------------------------------------------------------- */
+
+static bool
+object_arena_marked (
+  object_arena_t *arena,
+  generation_t    base_gen
+) {
+  for (slab_t *s = arena->slabs; s != NULL; s = s->next) {
+    for (uint32_t off = 0; off < s->used; ) {
+      object_t *object = (object_t *) (s->data + off);
+      off += object->slot_size;
+
+      if (!(object->tag & OBJECT_TAG_FREE)
+        && (object->generation >= base_gen)) {
+        return (true);
+      }
+    }
+  }
+
+  return (false);
+} /* object_arena_marked() */
+
+/* ------------------------------------------------------------------------- */
+
+static object_arena_t *
+object_arena_new (
+  void
+) {
+  object_one_time_init();
+
+  object_arena_t *arena =
+    xcalloc(sizeof(object_arena_t) + (n_size_classes * sizeof(object_t *)));
+
+  arena->next = all_arenas;
+  all_arenas = arena;
+
+  return (arena);
+} /* object_arena_new() */
+
+/* ------------------------------------------------------------------------- */
+
+static size_t
+object_arena_sweep (
+  object_arena_t *arena,
+  generation_t    base_gen,
+  size_t         *nfreed
+) {
+  // The free lists are rebuilt from the slabs that survive
+  memset(arena->free, '\0', n_size_classes * sizeof(object_t *));
+
+  size_t live = 0;
+  for (slab_t **p = &(arena->slabs); *p != NULL; ) {
+    slab_t *s = *p;
+
+    size_t slab_live = 0;
+    for (uint32_t off = 0; off < s->used; ) {
+      object_t *object = (object_t *) (s->data + off);
+      off += object->slot_size;
+
+      if (object->tag & OBJECT_TAG_FREE) {
+        continue;
+      } else if (object->generation < base_gen) {
+        object_sweep(object);
+        (*nfreed)++;
+      } else {
+        slab_live++;
+      }
+    }
+
+    if (slab_live == 0) {
+      *p = s->next;
+      free(s);
+      continue;
+    }
+
+    for (uint32_t off = 0; off < s->used; ) {
+      object_t *object = (object_t *) (s->data + off);
+      off += object->slot_size;
+
+      // A slot without items has no room for the link
+      const int sclass =
+        (object->slot_size - sizeof(object_t)) / sizeof(item_t);
+      if ((object->tag & OBJECT_TAG_FREE) && (sclass > 0)) {
+        FREE_SLOT_NEXT(object) = (tree_t) arena->free[sclass];
+        arena->free[sclass] = object;
+      }
+    }
+
+    live += slab_live;
+    p = &(s->next);
+  }
+
+  return (live);
+} /* object_arena_sweep() */
+
+/* ------------------------------------------------------------------------- */
+
 static void
 object_init (
   object_class_t *class
@@ -1188,6 +1603,12 @@ object_init (
     }
   } while (changed);
 
+  for (int i = 0; i < class->last_kind; i++) {
+    const int sclass =
+      (class->object_size[i] - sizeof(object_t)) / sizeof(item_t);
+    n_size_classes = MAX(n_size_classes, sclass + 1);
+  }
+
   if (getenv("NVC_TREE_SIZES") != NULL) {
     for (int i = 0; i < T_LAST_TREE_KIND; i++) {
       printf("%-15s %d\n", class->kind_text_map[i],
@@ -1198,6 +1619,155 @@ object_init (
 
 /* ------------------------------------------------------------------------- */
 
+static uint32_t
+object_loc_hash (
+  const loc_t *loc
+) {
+  uint64_t h =
+    ((uint64_t) loc->first_line << 44)
+    | ((uint64_t) loc->first_column << 32)
+    | ((uint64_t) loc->last_line << 12)
+    | (uint64_t) loc->last_column;
+
+  h ^= (uintptr_t) loc->file * UINT64_C(0x9e3779b97f4a7c15);
+  h ^= (uintptr_t) loc->linebuf;
+  h *= UINT64_C(0xff51afd7ed558ccd);
+
+  return ((uint32_t) (h ^ (h >> 32)));
+} /* object_loc_hash() */
+
+/* ------------------------------------------------------------------------- */
+
+static uint32_t
+object_loc_intern (
+  const loc_t *loc
+) {
+  if (2 * (n_locs + 1) > loc_nslots) {
+    object_loc_rehash();
+  }
+
+  uint32_t slot = object_loc_hash(loc) & (loc_nslots - 1);
+  for (; loc_slots[slot] != 0; slot = (slot + 1) & (loc_nslots - 1)) {
+    const loc_t *l = LOC_AT(loc_slots[slot] - 1);
+    if ((l->first_line == loc->first_line)
+      && (l->first_column == loc->first_column)
+      && (l->last_line == loc->last_line)
+      && (l->last_column == loc->last_column)
+      && (l->file == loc->file)
+      && (l->linebuf == loc->linebuf)) {
+      return (loc_slots[slot] - 1);
+    }
+  }
+
+  const uint32_t index = n_locs++;
+  if ((index & (LOC_CHUNK_SIZE - 1)) == 0) {
+    const size_t nchunks = (index >> LOC_CHUNK_BITS) + 1;
+    loc_chunks = xrealloc(loc_chunks, nchunks * sizeof(loc_t *));
+    loc_chunks[nchunks - 1] = xmalloc(LOC_CHUNK_SIZE * sizeof(loc_t));
+  }
+
+  *LOC_AT(index) = *loc;
+  loc_slots[slot] = index + 1;
+
+  return (index);
+} /* object_loc_intern() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+object_loc_rehash (
+  void
+) {
+  free(loc_slots);
+
+  loc_nslots = MAX(loc_nslots * 2, 4096);
+  loc_slots = xcalloc(loc_nslots * sizeof(uint32_t));
+
+  for (uint32_t i = 0; i < n_locs; i++) {
+    uint32_t slot = object_loc_hash(LOC_AT(i)) & (loc_nslots - 1);
+    while (loc_slots[slot] != 0) {
+      slot = (slot + 1) & (loc_nslots - 1);
+    }
+    loc_slots[slot] = i + 1;
+  }
+} /* object_loc_rehash() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+object_mark (
+  object_t    *object,
+  generation_t generation
+) {
+  object_visit_ctx_t ctx =
+  {
+    .count      =                 0,
+    .postorder  = NULL,
+    .preorder   = NULL,
+    .context    = NULL,
+    .kind       = T_LAST_TREE_KIND,
+    .generation = generation,
+    .deep       = true
+  };
+
+  object_visit(object, &ctx);
+} /* object_mark() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+object_read_discard (
+  object_t *object
+) {
+  // The deferred items of a unit being released are never read
+  for (size_t i = 0; i < n_pending; i++) {
+    if (pending[i]->deferred == object) {
+      object_rd_ctx_t *ctx = pending[i];
+      pending[i] = pending[--n_pending];
+
+      ctx->deferred = NULL;
+      fbuf_close(ctx->file);
+      ctx->file = NULL;
+
+      if (ctx->ended) {
+        object_read_free(ctx);
+      }
+      return;
+    }
+  }
+} /* object_read_discard() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+object_read_free (
+  object_rd_ctx_t *ctx
+) {
+  if (ctx->ident_ctx != NULL) {
+    ident_read_end(ctx->ident_ctx);
+  }
+  free(ctx->store);
+  free(ctx->db_fname);
+  free(ctx);
+} /* object_read_free() */
+
+/* ------------------------------------------------------------------------- */
+
+static inline bool
+object_shared (
+  const object_t *object,
+  bool            skip,
+  generation_t    generation
+) {
+  // Objects marked but not copied by the object_copy_mark pass with this
+  // generation are shared with the original tree
+
+  return (skip && (object->generation == generation) &&
+    (object->index == UINT32_MAX));
+} /* object_shared() */
+
+/* ------------------------------------------------------------------------- */
+
 static void
 object_sweep (
   object_t *object
@@ -1211,15 +1781,15 @@ object_sweep (
   for (int n = 0; n < nitems; mask <<= 1) {
     if (has & mask) {
       if (ITEM_TREE_ARRAY & mask) {
-        free(object->items[n].tree_array.items);
+        tree_array_free(&(object->items[n].tree_array));
       } else if (ITEM_TYPE_ARRAY & mask) {
-        free(object->items[n].type_array.items);
+        type_array_free(&(object->items[n].type_array));
       } else if (ITEM_NETID_ARRAY & mask) {
-        free(object->items[n].netid_array.items);
+        netid_array_free(&(object->items[n].netid_array));
       } else if (ITEM_ATTRS & mask) {
-        free(object->items[n].attrs.table);
+        attr_array_free(&(object->items[n].attrs));
       } else if (ITEM_RANGE_ARRAY & mask) {
-        free(object->items[n].range_array.items);
+        range_array_free(&(object->items[n].range_array));
       } else if (ITEM_TEXT_BUF & mask) {
         if (object->items[n].text_buf != NULL) {
           tb_free(object->items[n].text_buf);
@@ -1231,7 +1801,9 @@ object_sweep (
     }
   }
 
-  free(object);
+  // The slot itself belongs to the arena
+  object->tag |= OBJECT_TAG_FREE;
+  n_objects_alloc--;
 } /* object_sweep() */
 
 /* :vi set ts=2 et sw=2: */
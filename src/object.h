@@ -108,11 +108,10 @@ typedef uint64_t imask_t;
 #define OBJECT_TAG_TREE  0
 #define OBJECT_TAG_TYPE  1
 
-DECLARE_ARRAY(netid);
-DECLARE_ARRAY(range);
-DECLARE_ARRAY(tree);
-DECLARE_ARRAY(type);
-DECLARE_ARRAY(ident);
+DECLARE_COMPACT_ARRAY(netid);
+DECLARE_COMPACT_ARRAY(range);
+DECLARE_COMPACT_ARRAY(tree);
+DECLARE_COMPACT_ARRAY(type);
 
 #define lookup_item(class, t, mask) ({                                  \
          assert((t) != NULL);                                           \
@@ -149,11 +148,7 @@ typedef struct {
    };
 } attr_t;
 
-typedef struct {
-   uint16_t  alloc;
-   uint16_t  num;
-   attr_t   *table;
-} attr_tab_t;
+DECLARE_COMPACT_ARRAY(attr);
 
 typedef union {
    ident_t        ident;
@@ -168,8 +163,7 @@ typedef union {
    range_array_t  range_array;
    text_buf_t    *text_buf;
    type_array_t   type_array;
-   attr_tab_t     attrs;
-   ident_array_t  ident_array;
+   attr_array_t   attrs;
    char          *text;
 } item_t;
 
@@ -177,8 +171,9 @@ typedef struct {
    uint8_t      kind;
    uint8_t      tag;
    generation_t generation;
+   uint16_t     slot_size;
    index_t      index;
-   loc_t        loc;
+   uint32_t     loc;      // Index into the location table
    item_t       items[0];
 } object_t;
 
@@ -197,6 +192,8 @@ typedef struct {
    tree_rewrite_fn_t fn;
    void             *context;
    size_t            cache_size;
+   bool              skip_shared;
+   generation_t      shared_generation;
 } object_rewrite_ctx_t;
 
 typedef struct {
@@ -207,10 +204,14 @@ typedef struct {
    tree_kind_t      kind;
    unsigned         generation;
    bool             deep;
+   bool             skip_shared;
+   generation_t     shared_generation;
 } object_visit_ctx_t;
 
 typedef int change_allowed_t[2];
 
+typedef void (*object_unload_fn_t)(object_t *object);
+
 typedef struct {
    const char             *name;
    const change_allowed_t *change_allowed;
@@ -232,15 +233,25 @@ typedef struct {
    unsigned        n_objects;
 } object_wr_ctx_t;
 
+typedef struct object_arena object_arena_t;
+
 typedef struct {
    fbuf_t         *file;
    ident_rd_ctx_t  ident_ctx;
+   object_arena_t *arena;
    unsigned        n_objects;
    object_t      **store;
    unsigned        store_sz;
    char           *db_fname;
+   object_t       *deferred;
+   bool            ended;
 } object_rd_ctx_t;
 
+// Top-level declaration and statement arrays are read on first access:
+// until then their count is greater than their limit
+#define object_array_deferred(a) \
+   unlikely(((a)->data != NULL) && ((a)->data->count > (a)->data->limit))
+
 __attribute__((noreturn))
 void object_lookup_failed(const char *name, const char **kind_text_map,
                           int kind, imask_t mask);
@@ -251,13 +262,16 @@ void object_change_kind(const object_class_t *class,
                         object_t *object, int kind);
 object_t *object_new(const object_class_t *class, int kind);
 void object_one_time_init(void);
-void object_gc(void);
+void object_add_gc_root(object_t *object);
+void object_gc(object_unload_fn_t fn);
 void object_visit(object_t *object, object_visit_ctx_t *ctx);
 object_t *object_rewrite(object_t *object, object_rewrite_ctx_t *ctx);
 unsigned object_next_generation(void);
 object_t *object_copy_sweep(object_t *object, object_copy_ctx_t *ctx);
 bool object_copy_mark(object_t *object, object_copy_ctx_t *ctx);
 void object_replace(object_t *t, object_t *a);
+const loc_t *object_loc(const object_t *object);
+void object_set_loc(object_t *object, const loc_t *loc);
 
 void object_write(object_t *object, object_wr_ctx_t *ctx);
 object_wr_ctx_t *object_write_begin(fbuf_t *f);
@@ -266,5 +280,6 @@ void object_write_end(object_wr_ctx_t *ctx);
 object_rd_ctx_t *object_read_begin(fbuf_t *f, const char *fname);
 void object_read_end(object_rd_ctx_t *ctx);
 object_t *object_read(object_rd_ctx_t *ctx, int tag);
+void object_read_deferred(object_t *object);
 
 #endif   // _OBJECT_H
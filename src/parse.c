@@ -430,6 +430,69 @@ parse (
 
 /* ------------------------------------------------------------------------- */
 
+void
+parse_dependencies (
+  ident_t        work,
+  ident_list_t **defines,
+  ident_list_t **uses
+) {
+  // Scan the rest of the input file for the design units it declares
+  // and the units in the work library it refers to without analysing
+  // it: the result is conservative so a reference to all units in the
+  // work library adds the name of the library itself to the uses
+
+  ident_t work_i = ident_new("WORK");
+  token_t toks[4] = { tEOF, tEOF, tEOF, tEOF };
+  ident_t ids[4] = { NULL, NULL, NULL, NULL };
+
+  token_t tok;
+  while ((tok = peek()) != tEOF) {
+    drop_token();
+
+    memmove(&toks[0], &toks[1], sizeof(toks) - sizeof(toks[0]));
+    memmove(&ids[0], &ids[1], sizeof(ids) - sizeof(ids[0]));
+    toks[3] = tok;
+    ids[3] = NULL;
+
+    if (tok == tID) {
+      ids[3] = ident_new(last_lval.s);
+    }
+
+    if ((tok == tID) || (tok == tSTRING) || (tok == tBITSTRING)) {
+      free(last_lval.s);
+    }
+
+    if ((toks[1] == tID) && (toks[2] == tDOT) &&
+      ((ids[1] == work_i) || (ids[1] == work))) {
+      // Selected name such as work.pack.all or entity work.ent
+      if (tok == tID) {
+        ident_list_add(uses, ident_prefix(work, ids[3], '.'));
+      } else if (tok == tALL) {
+        ident_list_add(uses, work);
+      }
+    } else if ((toks[1] == tENTITY || toks[1] == tPACKAGE ||
+      toks[1] == tCONTEXT) && (toks[2] == tID) && (tok == tIS)) {
+      ident_list_add(defines, ident_prefix(work, ids[2], '.'));
+    } else if ((toks[0] == tPACKAGE) && (toks[1] == tBODY) &&
+      (toks[2] == tID) && (tok == tIS)) {
+      ident_t pack = ident_prefix(work, ids[2], '.');
+      ident_list_add(uses, pack);
+      ident_list_add(defines, ident_prefix(pack, ident_new("body"), '-'));
+    } else if ((toks[0] == tARCHITECTURE || toks[0] == tCONFIGURATION) &&
+      (toks[1] == tID) && (toks[2] == tOF) && (tok == tID)) {
+      ident_t ent = ident_prefix(work, ids[3], '.');
+      ident_list_add(uses, ent);
+      if (toks[0] == tARCHITECTURE) {
+        ident_list_add(defines, ident_prefix(ent, ids[1], '-'));
+      } else {
+        ident_list_add(defines, ident_prefix(work, ids[1], '.'));
+      }
+    }
+  }
+} /* parse_dependencies() */
+
+/* ------------------------------------------------------------------------- */
+
 int
 parse_errors (
   void
@@ -6310,7 +6373,7 @@ p_report_statement (
 
   consume(tSEMI);
 
-  tree_add_attr_int(t, ident_new("is_report"), 1);
+  tree_add_attr_int(t, is_report_i, 1);
 
   set_label_and_loc(t, label, CURRENT_LOC);
   return (t);
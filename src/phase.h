@@ -76,15 +76,31 @@ void dump_nets(tree_t top);
 // Groups nets which never have sub-elements assigned.
 void group_nets(tree_t top);
 
+typedef enum {
+   RULE_ANALYSE,
+   RULE_ELABORATE
+} rule_kind_t;
+
+typedef int (*make_rule_fn_t)(rule_kind_t kind, const char *source);
+
 // Generate a makefile for the givein unit
 void make(tree_t *targets, int count, FILE *out);
 
+// Bring the given units up to date by calling FN for each out of date
+// rule, running up to JOBS rules at once in separate processes
+int make_build(tree_t *targets, int count, int jobs, make_rule_fn_t fn);
+
 // Set parser input file
 void input_from_file(const char *file);
 
 // Read the next unit from the input file
 tree_t parse(void);
 
+// Find the units declared in the input file and the units in library
+// work they depend on without analysing them
+void parse_dependencies(ident_t work, ident_list_t **defines,
+                        ident_list_t **uses);
+
 // Number of errors found while parsing last unit
 int parse_errors(void);
 void reset_parse_errors(void);
@@ -21,7 +21,7 @@
 #include <stdint.h>
 #include <stddef.h>
 
-typedef struct trie *ident_t;
+typedef struct ident *ident_t;
 
 typedef struct loc {
    unsigned    first_line : 20;
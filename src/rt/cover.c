@@ -17,6 +17,7 @@
 
 #include "util.h"
 #include "cover.h"
+#include "common.h"
 
 #include <assert.h>
 #include <stdlib.h>
@@ -84,11 +85,6 @@ typedef struct {
    const int32_t *conds;
 } report_ctx_t;
 
-static ident_t       stmt_tag_i;
-static ident_t       cond_tag_i;
-static ident_t       sub_cond_i;
-static ident_t       builtin_i;
-static ident_t       std_bool_i;
 static cover_file_t *files;
 static cover_stats_t stats;
 
@@ -167,12 +163,6 @@ static void cover_tag_visit_fn(tree_t t, void *context)
 
 void cover_tag(tree_t top)
 {
-   stmt_tag_i = ident_new("stmt_tag");
-   cond_tag_i = ident_new("cond_tag");
-   sub_cond_i = ident_new("sub_cond");
-   std_bool_i = ident_new("STD.STANDARD.BOOLEAN");
-   builtin_i  = ident_new("builtin");
-
    cover_tag_ctx_t ctx = {
       .next_stmt_tag = 0,
       .next_cond_tag = 0
@@ -180,8 +170,8 @@ void cover_tag(tree_t top)
 
    tree_visit(top, cover_tag_visit_fn, &ctx);
 
-   tree_add_attr_int(top, ident_new("stmt_tags"), ctx.next_stmt_tag);
-   tree_add_attr_int(top, ident_new("cond_tags"), ctx.next_cond_tag);
+   tree_add_attr_int(top, stmt_tags_i, ctx.next_stmt_tag);
+   tree_add_attr_int(top, cond_tags_i, ctx.next_cond_tag);
 }
 
 static void cover_append_line(cover_file_t *f, const char *buf)
@@ -538,10 +528,6 @@ static void cover_index(ident_t name, const char *dir)
 
 void cover_report(tree_t top, const int32_t *stmts, const int32_t *conds)
 {
-   stmt_tag_i = ident_new("stmt_tag");
-   cond_tag_i = ident_new("cond_tag");
-   sub_cond_i = ident_new("sub_cond");
-
    report_ctx_t report_ctx = {
       .stmts = stmts,
       .conds = conds
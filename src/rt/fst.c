@@ -22,6 +22,7 @@
 #include "fstapi.h"
 
 #include <assert.h>
+#include <string.h>
 
 static tree_t   fst_top;
 static void    *fst_ctx;
@@ -50,6 +51,8 @@ struct fst_data {
    watch_t      *watch;
 };
 
+static fst_data_t **fst_data;   // Indexed by position in fst_top decls
+
 static void fst_close(void)
 {
    fstWriterEmitTimeChange(fst_ctx, rt_now(NULL));
@@ -174,7 +177,7 @@ static bool fst_can_fmt_chars(type_t type, fst_data_t *data,
       return false;
 }
 
-static void fst_process_signal(tree_t d)
+static fst_data_t *fst_process_signal(tree_t d)
 {
    type_t type = tree_type(d);
    type_t base = type_base_recur(type);
@@ -190,7 +193,7 @@ static void fst_process_signal(tree_t d)
          warn_at(tree_loc(d), "cannot represent multidimensional arrays "
                  "in FST format");
          free(data);
-         return;
+         return NULL;
       }
 
       range_t r = range_of(type, 0);
@@ -209,7 +212,7 @@ static void fst_process_signal(tree_t d)
          warn_at(tree_loc(d), "cannot represent arrays of type %s "
                  "in FST format", type_pp(elem));
          free(data);
-         return;
+         return NULL;
       }
       else {
          ident_t ident = type_ident(base);
@@ -272,7 +275,7 @@ static void fst_process_signal(tree_t d)
          warn_at(tree_loc(d), "cannot represent type %s in FST format",
                  type_pp(type));
          free(data);
-         return;
+         return NULL;
       }
    }
 
@@ -304,9 +307,8 @@ static void fst_process_signal(tree_t d)
       FST_SVT_VHDL_SIGNAL,
       sdt);
 
-   tree_add_attr_ptr(d, fst_data_i, data);
-
    data->watch = rt_set_event_cb(d, fst_event_cb, data, true);
+   return data;
 }
 
 static void fst_process_hier(tree_t h)
@@ -339,13 +341,16 @@ void fst_restart(void)
       return;
 
    const int ndecls = tree_decls(fst_top);
+   fst_data = xrealloc(fst_data, ndecls * sizeof(fst_data_t *));
+   memset(fst_data, '\0', ndecls * sizeof(fst_data_t *));
+
    for (int i = 0; i < ndecls; i++) {
       tree_t d = tree_decl(fst_top, i);
 
       switch (tree_kind(d)) {
       case T_SIGNAL_DECL:
          if (wave_should_dump(d))
-            fst_process_signal(d);
+            fst_data[i] = fst_process_signal(d);
          break;
       case T_HIER:
          fst_process_hier(d);
@@ -354,7 +359,7 @@ void fst_restart(void)
          break;
       }
 
-      int npop = tree_attr_int(d, ident_new("scope_pop"), 0);
+      int npop = tree_attr_int(d, scope_pop_i, 0);
       while (npop-- > 0)
          fstWriterSetUpscope(fst_ctx);
    }
@@ -362,12 +367,9 @@ void fst_restart(void)
    last_time = UINT64_MAX;
 
    for (int i = 0; i < ndecls; i++) {
-      tree_t d = tree_decl(fst_top, i);
-      if (tree_kind(d) == T_SIGNAL_DECL) {
-         fst_data_t *data = tree_attr_ptr(d, fst_data_i);
-         if (likely(data != NULL))
-            fst_event_cb(0, d, data->watch, data);
-      }
+      fst_data_t *data = fst_data[i];
+      if (data != NULL)
+         fst_event_cb(0, tree_decl(fst_top, i), data->watch, data);
    }
 }
 
@@ -58,6 +58,9 @@ static size_t nmodules = 0, max_modules = 0;
 
 #endif
 
+static ident_t         jit_module_name = NULL;
+static jit_lookup_fn_t jit_module_lookup = NULL;
+
 void *jit_find_symbol(const char *name, bool required)
 {
 #if (defined __MINGW32__ || defined __CYGWIN__) && !defined _WIN64
@@ -67,6 +70,12 @@ void *jit_find_symbol(const char *name, bool required)
 
    name = safe_symbol(name);
 
+   if (jit_module_lookup != NULL) {
+      void *ptr = (*jit_module_lookup)(name);
+      if (ptr != NULL)
+         return ptr;
+   }
+
 #ifdef __MINGW32__
 
 #ifdef _WIN64
@@ -107,7 +116,7 @@ void *jit_find_symbol(const char *name, bool required)
 #endif
 }
 
-static void jit_load_module(ident_t name)
+static void jit_load_module(ident_t name, bool single_image)
 {
    lib_t lib = lib_find(ident_until(name, '.'), true);
 
@@ -138,7 +147,10 @@ static void jit_load_module(ident_t name)
 
    ARRAY_APPEND(search_modules, hModule, nmodules, max_modules);
 #else
-   if (dlopen(so_path, RTLD_LAZY | RTLD_GLOBAL) == NULL)
+   // A single image has no external references to packages so resolve
+   // everything up front rather than on first call
+   const int mode = single_image ? RTLD_NOW : RTLD_LAZY;
+   if (dlopen(so_path, mode | RTLD_GLOBAL) == NULL)
       fatal("%s: %s", so_path, dlerror());
 #endif
 }
@@ -154,14 +166,27 @@ void jit_init(tree_t top)
                 nmodules, max_modules);
 #endif
 
-   const int ncontext = tree_contexts(top);
-   for (int i = 0; i < ncontext; i++) {
-      tree_t c = tree_context(top, i);
-      if (tree_kind(c) == T_USE)
-         jit_load_module(tree_ident(c));
+   // Packages are linked into the top-level module in single image mode
+   const bool single_image = tree_attr_int(top, single_image_i, 0);
+
+   if (!single_image) {
+      const int ncontext = tree_contexts(top);
+      for (int i = 0; i < ncontext; i++) {
+         tree_t c = tree_context(top, i);
+         if (tree_kind(c) == T_USE)
+            jit_load_module(tree_ident(c), false);
+      }
    }
 
-   jit_load_module(tree_ident(top));
+   // The design may have been compiled in memory by this process
+   if (tree_ident(top) != jit_module_name)
+      jit_load_module(tree_ident(top), single_image);
+}
+
+void jit_register_module(ident_t name, jit_lookup_fn_t lookup)
+{
+   jit_module_name = name;
+   jit_module_lookup = lookup;
 }
 
 void jit_shutdown(void)
@@ -42,7 +42,6 @@ struct lxt_data {
 
 static struct lt_trace *trace = NULL;
 static tree_t           lxt_top;
-static ident_t          lxt_data_i;
 static lxttime_t        last_time;
 
 static const char std_logic_map[] = "UX01ZWLH-";
@@ -212,8 +211,6 @@ void lxt_restart(void)
       data->sym = lt_symbol_add(trace, name, rows, msb, lsb, flags);
       free(name);
 
-      tree_add_attr_ptr(d, lxt_data_i, data);
-
       watch_t *w = rt_set_event_cb(d, lxt_event_cb, data, true);
 
       (*data->fmt)(d, w, data);
@@ -224,8 +221,6 @@ void lxt_restart(void)
 
 void lxt_init(const char *filename, tree_t top)
 {
-   lxt_data_i = ident_new("lxt_data");
-
    warnf("Use of the LXT file format is deprecated and will be removed "
    "in the next release. Use FST instead for GtkWave.");
 
@@ -59,6 +59,27 @@ typedef enum {
    BIT_VEC_NOR
 } bit_vec_op_kind_t;
 
+typedef enum {
+   INTRINSIC_UNSIGNED_ADD,
+   INTRINSIC_UNSIGNED_SUB,
+   INTRINSIC_UNSIGNED_EQ,
+   INTRINSIC_UNSIGNED_NEQ,
+   INTRINSIC_UNSIGNED_LT,
+   INTRINSIC_UNSIGNED_LEQ,
+   INTRINSIC_UNSIGNED_GT,
+   INTRINSIC_UNSIGNED_GEQ,
+   INTRINSIC_UNSIGNED_RESIZE,
+   INTRINSIC_UNSIGNED_TO_INTEGER,
+   INTRINSIC_TO_UNSIGNED,
+   INTRINSIC_LOGIC_NOT,
+   INTRINSIC_LOGIC_AND,
+   INTRINSIC_LOGIC_OR,
+   INTRINSIC_LOGIC_XOR,
+   INTRINSIC_LOGIC_XNOR,
+   INTRINSIC_LOGIC_NAND,
+   INTRINSIC_LOGIC_NOR
+} intrinsic_kind_t;
+
 typedef enum {
    IMAGE_INTEGER,
    IMAGE_REAL,
@@ -130,9 +151,12 @@ uint64_t rt_now(unsigned *deltas);
 void rt_stop(void);
 void rt_set_exit_severity(rt_severity_t severity);
 
+typedef void *(*jit_lookup_fn_t)(const char *name);
+
 void jit_init(tree_t top);
 void jit_shutdown(void);
 void *jit_find_symbol(const char *name, bool required);
+void jit_register_module(ident_t name, jit_lookup_fn_t lookup);
 void jit_trace(jit_trace_t **trace, size_t *count);
 
 text_buf_t *pprint(struct tree *t, const uint64_t *values, size_t len);
@@ -57,6 +57,8 @@
 
 typedef void (*proc_fn_t)(int32_t reset);
 typedef uint64_t (*resolution_fn_t)(void *vals, int32_t n);
+typedef void (*resolution_vec_fn_t)(void *vals, int32_t n, int32_t length,
+                                    void *result);
 
 typedef struct netgroup   netgroup_t;
 typedef struct driver     driver_t;
@@ -71,6 +73,8 @@ typedef struct callback   callback_t;
 typedef struct image_map  image_map_t;
 typedef struct rt_loc     rt_loc_t;
 typedef struct size_list  size_list_t;
+typedef struct res_record res_record_t;
+typedef struct static_initial static_initial_t;
 
 struct rt_proc {
    tree_t    source;
@@ -139,6 +143,8 @@ struct netgroup {
    uint16_t      n_drivers;
    driver_t     *drivers;
    res_memo_t   *resolution;
+   res_record_t *record;
+   uint32_t      record_off;
    uint64_t      last_event;
    tree_t        sig_decl;
    value_t      *free_values;
@@ -181,12 +187,19 @@ struct watch_list {
 };
 
 struct res_memo {
-   resolution_fn_t fn;
-   res_flags_t     flags;
+   resolution_fn_t     fn;
+   resolution_vec_fn_t vec_fn;
+   res_flags_t         flags;
    int8_t          tab2[16][16];
    int8_t          tab1[16];
 };
 
+struct res_record {
+   size_t   size;
+   int      n_drivers;
+   uint8_t  inputs[0];
+};
+
 typedef enum {
    SIDE_EFFECT_ALLOW,
    SIDE_EFFECT_DISALLOW,
@@ -220,6 +233,15 @@ struct size_list {
    uint32_t count;
    void    *resolution;
    uint32_t flags;
+   void    *resolution_vec;
+};
+
+struct static_initial {
+   int32_t            nid;
+   int32_t            offset;
+   int32_t            nparts;
+   const size_list_t *size_list;
+   const char        *name;
 };
 
 static struct rt_proc   *procs = NULL;
@@ -232,6 +254,7 @@ static uint64_t      now = 0;
 static int           iteration = -1;
 static bool          trace_on = false;
 static nvc_rusage_t  ready_rusage;
+static uint64_t      load_time_us = 0;
 static jmp_buf       fatal_jmp;
 static bool          aborted = false;
 static netdb_t      *netdb = NULL;
@@ -247,6 +270,10 @@ static void         *global_tmp_stack = NULL;
 static void         *proc_tmp_stack = NULL;
 static uint32_t      global_tmp_alloc;
 static hash_t       *res_memo_hash = NULL;
+static uint8_t      *res_matrix = NULL;
+static size_t        res_matrix_sz = 0;
+static uint8_t      *static_mem = NULL;
+static size_t        static_mem_sz = 0;
 static side_effect_t init_side_effect = SIDE_EFFECT_ALLOW;
 static bool          force_stop;
 static bool          can_create_delta;
@@ -275,7 +302,8 @@ static void rt_sched_event(sens_list_t **list, netid_t first, netid_t last,
 static void *rt_tmp_alloc(size_t sz);
 static value_t *rt_alloc_value(netgroup_t *g);
 static tree_t rt_recall_decl(const char *name);
-static res_memo_t *rt_memo_resolution_fn(type_t type, resolution_fn_t fn);
+static res_memo_t *rt_memo_resolution_fn(type_t type, resolution_fn_t fn,
+                                         resolution_vec_fn_t vec_fn);
 static void _tracef(const char *fmt, ...);
 
 #define GLOBAL_TMP_STACK_SZ (1024 * 1024)
@@ -403,6 +431,309 @@ static void rt_show_trace(void)
    free(trace);
 }
 
+// Encoding of IEEE.STD_LOGIC_1164.STD_ULOGIC values
+enum {
+   SL_U, SL_X, SL_0, SL_1, SL_Z, SL_W, SL_L, SL_H, SL_DC
+};
+
+#define IEEE_MAX_WORDS 64
+
+static const uint8_t std_logic_and[9][9] = {
+   { 0, 0, 2, 0, 0, 0, 2, 0, 0 },   // U
+   { 0, 1, 2, 1, 1, 1, 2, 1, 1 },   // X
+   { 2, 2, 2, 2, 2, 2, 2, 2, 2 },   // 0
+   { 0, 1, 2, 3, 1, 1, 2, 3, 1 },   // 1
+   { 0, 1, 2, 1, 1, 1, 2, 1, 1 },   // Z
+   { 0, 1, 2, 1, 1, 1, 2, 1, 1 },   // W
+   { 2, 2, 2, 2, 2, 2, 2, 2, 2 },   // L
+   { 0, 1, 2, 3, 1, 1, 2, 3, 1 },   // H
+   { 0, 1, 2, 1, 1, 1, 2, 1, 1 },   // -
+};
+
+static const uint8_t std_logic_or[9][9] = {
+   { 0, 0, 0, 3, 0, 0, 0, 3, 0 },   // U
+   { 0, 1, 1, 3, 1, 1, 1, 3, 1 },   // X
+   { 0, 1, 2, 3, 1, 1, 2, 3, 1 },   // 0
+   { 3, 3, 3, 3, 3, 3, 3, 3, 3 },   // 1
+   { 0, 1, 1, 3, 1, 1, 1, 3, 1 },   // Z
+   { 0, 1, 1, 3, 1, 1, 1, 3, 1 },   // W
+   { 0, 1, 2, 3, 1, 1, 2, 3, 1 },   // L
+   { 3, 3, 3, 3, 3, 3, 3, 3, 3 },   // H
+   { 0, 1, 1, 3, 1, 1, 1, 3, 1 },   // -
+};
+
+static const uint8_t std_logic_xor[9][9] = {
+   { 0, 0, 0, 0, 0, 0, 0, 0, 0 },   // U
+   { 0, 1, 1, 1, 1, 1, 1, 1, 1 },   // X
+   { 0, 1, 2, 3, 1, 1, 2, 3, 1 },   // 0
+   { 0, 1, 3, 2, 1, 1, 3, 2, 1 },   // 1
+   { 0, 1, 1, 1, 1, 1, 1, 1, 1 },   // Z
+   { 0, 1, 1, 1, 1, 1, 1, 1, 1 },   // W
+   { 0, 1, 2, 3, 1, 1, 2, 3, 1 },   // L
+   { 0, 1, 3, 2, 1, 1, 3, 2, 1 },   // H
+   { 0, 1, 1, 1, 1, 1, 1, 1, 1 },   // -
+};
+
+static const uint8_t std_logic_not[9] = {
+   0, 1, 3, 2, 1, 1, 3, 2, 1
+};
+
+static int32_t uarray_len(const struct uarray *u)
+{
+   const int32_t diff = (u->dims[0].dir == RANGE_TO)
+      ? u->dims[0].right - u->dims[0].left
+      : u->dims[0].left - u->dims[0].right;
+   return MAX(diff + 1, 0);
+}
+
+static void ieee_wrap(struct uarray *u, uint8_t *buf, int32_t left,
+                      int32_t right, range_kind_t dir)
+{
+   u->ptr = buf;
+   u->dims[0].left  = left;
+   u->dims[0].right = right;
+   u->dims[0].dir   = dir;
+}
+
+static bool ieee_pack_unsigned(const struct uarray *u, int32_t len,
+                               uint64_t *words, int nwords)
+{
+   // Convert an UNSIGNED value to a little-endian array of words
+   // returning false if it contains a metavalue
+
+   const uint8_t *data = u->ptr;
+
+   memset(words, '\0', nwords * sizeof(uint64_t));
+
+   for (int32_t i = 0; i < len; i++) {
+      const int32_t bit = len - 1 - i;
+      switch (data[i]) {
+      case SL_0:
+      case SL_L:
+         break;
+      case SL_1:
+      case SL_H:
+         words[bit / 64] |= UINT64_C(1) << (bit % 64);
+         break;
+      default:
+         return false;
+      }
+   }
+
+   return true;
+}
+
+static uint8_t *ieee_unpack_unsigned(const uint64_t *words, int32_t size)
+{
+   uint8_t *buf = rt_tmp_alloc(size);
+
+   for (int32_t i = 0; i < size; i++) {
+      const int32_t bit = size - 1 - i;
+      buf[i] = ((words[bit / 64] >> (bit % 64)) & 1) ? SL_1 : SL_0;
+   }
+
+   return buf;
+}
+
+static bool ieee_unsigned_arith(int32_t kind, const struct uarray *l,
+                                const struct uarray *r, struct uarray *u)
+{
+   const int32_t llen = uarray_len(l);
+   const int32_t rlen = uarray_len(r);
+
+   if (llen < 1 || rlen < 1)
+      return false;   // Null array result
+
+   const int32_t size = MAX(llen, rlen);
+   const int nwords = (size + 63) / 64;
+   if (nwords > IEEE_MAX_WORDS)
+      return false;
+
+   uint64_t lw[nwords], rw[nwords];
+   uint8_t *buf;
+
+   if (!ieee_pack_unsigned(l, llen, lw, nwords)
+       || !ieee_pack_unsigned(r, rlen, rw, nwords)) {
+      // Any metavalue in either argument gives an all 'X' result
+      buf = rt_tmp_alloc(size);
+      memset(buf, SL_X, size);
+   }
+   else {
+      const bool sub = (kind == INTRINSIC_UNSIGNED_SUB);
+      uint64_t carry = sub;
+      for (int i = 0; i < nwords; i++) {
+         const uint64_t a = lw[i];
+         const uint64_t b = sub ? ~rw[i] : rw[i];
+         const uint64_t sum = a + b;
+         lw[i] = sum + carry;
+         carry = (sum < a) || (lw[i] < sum);
+      }
+
+      buf = ieee_unpack_unsigned(lw, size);
+   }
+
+   ieee_wrap(u, buf, size - 1, 0, RANGE_DOWNTO);
+   return true;
+}
+
+static bool ieee_unsigned_compare(int32_t kind, const struct uarray *l,
+                                  const struct uarray *r, int32_t *result)
+{
+   const int32_t llen = uarray_len(l);
+   const int32_t rlen = uarray_len(r);
+
+   if (llen < 1 || rlen < 1)
+      return false;   // Reports a warning
+
+   const int nwords = (MAX(llen, rlen) + 63) / 64;
+   if (nwords > IEEE_MAX_WORDS)
+      return false;
+
+   uint64_t lw[nwords], rw[nwords];
+   if (!ieee_pack_unsigned(l, llen, lw, nwords)
+       || !ieee_pack_unsigned(r, rlen, rw, nwords))
+      return false;   // Reports a warning
+
+   int cmp = 0;
+   for (int i = nwords - 1; i >= 0 && cmp == 0; i--) {
+      if (lw[i] != rw[i])
+         cmp = (lw[i] < rw[i]) ? -1 : 1;
+   }
+
+   switch (kind) {
+   case INTRINSIC_UNSIGNED_EQ:  *result = (cmp == 0); break;
+   case INTRINSIC_UNSIGNED_NEQ: *result = (cmp != 0); break;
+   case INTRINSIC_UNSIGNED_LT:  *result = (cmp < 0);  break;
+   case INTRINSIC_UNSIGNED_LEQ: *result = (cmp <= 0); break;
+   case INTRINSIC_UNSIGNED_GT:  *result = (cmp > 0);  break;
+   case INTRINSIC_UNSIGNED_GEQ: *result = (cmp >= 0); break;
+   }
+
+   return true;
+}
+
+static bool ieee_unsigned_resize(const struct uarray *arg, int32_t new_size,
+                                 struct uarray *u)
+{
+   if (new_size < 1)
+      return false;   // Null array result
+
+   const int32_t len = uarray_len(arg);
+   const uint8_t *data = arg->ptr;
+   uint8_t *buf = rt_tmp_alloc(new_size);
+
+   if (new_size <= len)
+      memcpy(buf, data + len - new_size, new_size);
+   else {
+      memset(buf, SL_0, new_size - len);
+      memcpy(buf + new_size - len, data, len);
+   }
+
+   ieee_wrap(u, buf, new_size - 1, 0, RANGE_DOWNTO);
+   return true;
+}
+
+static bool ieee_unsigned_to_integer(const struct uarray *arg,
+                                     int32_t *result)
+{
+   const int32_t len = uarray_len(arg);
+   const uint8_t *data = arg->ptr;
+
+   if (len < 1)
+      return false;   // Reports a warning
+
+   int32_t value = 0;
+   for (int32_t i = 0; i < len; i++) {
+      int32_t bit;
+      switch (data[i]) {
+      case SL_0:
+      case SL_L:
+         bit = 0;
+         break;
+      case SL_1:
+      case SL_H:
+         bit = 1;
+         break;
+      default:
+         return false;   // Reports a warning
+      }
+
+      if (value > (INT32_MAX - bit) / 2)
+         return false;   // Let the VHDL version report the overflow
+
+      value = value * 2 + bit;
+   }
+
+   *result = value;
+   return true;
+}
+
+static bool ieee_to_unsigned(int32_t arg, int32_t size, struct uarray *u)
+{
+   if (size < 1 || arg < 0)
+      return false;   // Null array result
+   else if (size < 31 && (arg >> size) != 0)
+      return false;   // Reports truncation warning
+
+   uint8_t *buf = rt_tmp_alloc(size);
+   for (int32_t i = 0; i < size; i++) {
+      const int32_t bit = size - 1 - i;
+      buf[i] = (bit < 31 && ((arg >> bit) & 1)) ? SL_1 : SL_0;
+   }
+
+   ieee_wrap(u, buf, size - 1, 0, RANGE_DOWNTO);
+   return true;
+}
+
+static bool ieee_logic_op(int32_t kind, const struct uarray *l,
+                          const struct uarray *r, struct uarray *u)
+{
+   const int32_t len = uarray_len(l);
+
+   if (kind != INTRINSIC_LOGIC_NOT && uarray_len(r) != len)
+      return false;   // Reports a failure
+
+   const uint8_t *ldata = l->ptr;
+   const uint8_t *rdata = (kind == INTRINSIC_LOGIC_NOT) ? NULL : r->ptr;
+   uint8_t *buf = rt_tmp_alloc(len);
+
+   switch (kind) {
+   case INTRINSIC_LOGIC_NOT:
+      for (int32_t i = 0; i < len; i++)
+         buf[i] = std_logic_not[ldata[i]];
+      break;
+   case INTRINSIC_LOGIC_AND:
+      for (int32_t i = 0; i < len; i++)
+         buf[i] = std_logic_and[ldata[i]][rdata[i]];
+      break;
+   case INTRINSIC_LOGIC_OR:
+      for (int32_t i = 0; i < len; i++)
+         buf[i] = std_logic_or[ldata[i]][rdata[i]];
+      break;
+   case INTRINSIC_LOGIC_XOR:
+      for (int32_t i = 0; i < len; i++)
+         buf[i] = std_logic_xor[ldata[i]][rdata[i]];
+      break;
+   case INTRINSIC_LOGIC_XNOR:
+      for (int32_t i = 0; i < len; i++)
+         buf[i] = std_logic_not[std_logic_xor[ldata[i]][rdata[i]]];
+      break;
+   case INTRINSIC_LOGIC_NAND:
+      for (int32_t i = 0; i < len; i++)
+         buf[i] = std_logic_not[std_logic_and[ldata[i]][rdata[i]]];
+      break;
+   case INTRINSIC_LOGIC_NOR:
+      for (int32_t i = 0; i < len; i++)
+         buf[i] = std_logic_not[std_logic_or[ldata[i]][rdata[i]]];
+      break;
+   default:
+      return false;
+   }
+
+   ieee_wrap(u, buf, 1, len, RANGE_TO);
+   return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Runtime support functions
 
@@ -616,27 +947,18 @@ void _needs_last_value(const int32_t *nids, int32_t n)
    }
 }
 
-DLLEXPORT
-void _set_initial(int32_t nid, const uint8_t *values,
-                  const size_list_t *size_list, int32_t nparts,
-                  const char *name)
+static void rt_setup_signal(int32_t nid, uint8_t *res_mem, uint8_t *last_mem,
+                            const size_list_t *size_list, int32_t nparts,
+                            const char *name)
 {
+   // Bind the net groups of a signal to memory that already holds the
+   // initial value
+
    tree_t decl = rt_recall_decl(name);
    RT_ASSERT(tree_kind(decl) == T_SIGNAL_DECL);
 
-   TRACE("_set_initial %s values=%s nparts=%d", name,
-         fmt_values(values, size_list[0].count * size_list[0].size), nparts);
-
-   int total_size = 0;
-   for (int i = 0; i < nparts; i++)
-      total_size += size_list[i].size * size_list[i].count;
-
-   uint8_t *res_mem  = xmalloc(total_size * 2);
-   uint8_t *last_mem = res_mem + total_size;
-
    type_t type = tree_type(decl);
 
-   const uint8_t *src = values;
    int offset = 0, part = 0, remain = size_list[0].count;
    while (part < nparts) {
       groupid_t gid = netdb_lookup(netdb, nid + offset);
@@ -649,7 +971,8 @@ void _set_initial(int32_t nid, const uint8_t *values,
 
       res_memo_t *memo = NULL;
       if (size_list[part].resolution != NULL) {
-         memo = rt_memo_resolution_fn(type, size_list[part].resolution);
+         memo = rt_memo_resolution_fn(type, size_list[part].resolution,
+                                      size_list[part].resolution_vec);
          memo->flags |= size_list[part].flags;
 
          if (size_list[part].flags & R_BOUNDARY)
@@ -667,32 +990,49 @@ void _set_initial(int32_t nid, const uint8_t *values,
 
       const int nbytes = g->length * size;
 
-      res_mem += nbytes;
+      res_mem  += nbytes;
       last_mem += nbytes;
 
-      memcpy(g->resolved, src, nbytes);
-      memcpy(g->last_value, src, nbytes);
-
       offset += g->length;
-      src    += nbytes;
       remain -= g->length;
 
-      if (remain == 0) {
-         part++;
+      if (remain == 0 && ++part < nparts)
          remain = size_list[part].count;
-      }
    }
 }
 
+DLLEXPORT
+void _set_initial(int32_t nid, const uint8_t *values,
+                  const size_list_t *size_list, int32_t nparts,
+                  const char *name)
+{
+   TRACE("_set_initial %s values=%s nparts=%d", name,
+         fmt_values(values, size_list[0].count * size_list[0].size), nparts);
+
+   int total_size = 0;
+   for (int i = 0; i < nparts; i++)
+      total_size += size_list[i].size * size_list[i].count;
+
+   uint8_t *res_mem  = xmalloc(total_size * 2);
+   uint8_t *last_mem = res_mem + total_size;
+
+   memcpy(res_mem, values, total_size);
+   memcpy(last_mem, values, total_size);
+
+   rt_setup_signal(nid, res_mem, last_mem, size_list, nparts, name);
+}
+
 DLLEXPORT
 void _set_initial_1(int32_t nid, const uint8_t *values, uint32_t size,
-                    uint32_t count, void *resolution, const char *name)
+                    uint32_t count, void *resolution, void *resolution_vec,
+                    const char *name)
 {
    const size_list_t size_list = {
-      .size       = size,
-      .count      = count,
-      .resolution = resolution,
-      .flags      = 0
+      .size           = size,
+      .count          = count,
+      .resolution     = resolution,
+      .flags          = 0,
+      .resolution_vec = resolution_vec
    };
 
    _set_initial(nid, values, &size_list, 1, name);
@@ -1114,6 +1454,37 @@ void _bit_vec_op(int32_t kind, const uint8_t *left, int32_t left_len,
    u->dims[0].dir   = left_dir;
 }
 
+DLLEXPORT
+int8_t _ieee_intrinsic(int32_t kind, const struct uarray *l,
+                       const struct uarray *r, int32_t li, int32_t ri,
+                       void *result)
+{
+   // Native versions of frequently called IEEE library functions:
+   // returns zero when the VHDL definition must be called instead
+   // such as when a metavalue warning should be reported
+
+   switch (kind) {
+   case INTRINSIC_UNSIGNED_ADD:
+   case INTRINSIC_UNSIGNED_SUB:
+      return ieee_unsigned_arith(kind, l, r, result);
+   case INTRINSIC_UNSIGNED_EQ:
+   case INTRINSIC_UNSIGNED_NEQ:
+   case INTRINSIC_UNSIGNED_LT:
+   case INTRINSIC_UNSIGNED_LEQ:
+   case INTRINSIC_UNSIGNED_GT:
+   case INTRINSIC_UNSIGNED_GEQ:
+      return ieee_unsigned_compare(kind, l, r, result);
+   case INTRINSIC_UNSIGNED_RESIZE:
+      return ieee_unsigned_resize(l, ri, result);
+   case INTRINSIC_UNSIGNED_TO_INTEGER:
+      return ieee_unsigned_to_integer(l, result);
+   case INTRINSIC_TO_UNSIGNED:
+      return ieee_to_unsigned(li, ri, result);
+   default:
+      return ieee_logic_op(kind, l, r, result);
+   }
+}
+
 DLLEXPORT
 void _debug_out(int32_t val, int32_t reg)
 {
@@ -1377,7 +1748,8 @@ static void deltaq_dump(void)
 }
 #endif
 
-static res_memo_t *rt_memo_resolution_fn(type_t type, resolution_fn_t fn)
+static res_memo_t *rt_memo_resolution_fn(type_t type, resolution_fn_t fn,
+                                         resolution_vec_fn_t vec_fn)
 {
    // Optimise some common resolution functions by memoising them
 
@@ -1389,8 +1761,9 @@ static res_memo_t *rt_memo_resolution_fn(type_t type, resolution_fn_t fn)
       type = type_elem(type);
 
    memo = xmalloc(sizeof(res_memo_t));
-   memo->fn    = fn;
-   memo->flags = 0;
+   memo->fn     = fn;
+   memo->vec_fn = vec_fn;
+   memo->flags  = 0;
 
    hash_put(res_memo_hash, fn, memo);
 
@@ -1583,10 +1956,10 @@ static void rt_setup(tree_t top)
    }
 
    const int ndecls = tree_decls(top);
-   decl_hash = hash_new(next_power_of_2(ndecls * 2), true);
+   decl_hash = hash_new_kind(ndecls * 2, true, HASH_STRING);
    for (int i = 0; i < ndecls; i++) {
       tree_t d = tree_decl(top, i);
-      hash_put(decl_hash, tree_ident(d), d);
+      hash_put(decl_hash, istr(tree_ident(d)), d);
    }
 
    res_memo_hash = hash_new(128, true);
@@ -1646,6 +2019,37 @@ static void rt_run(struct rt_proc *proc, bool reset)
       proc->usage += get_timestamp_us() - start_clock;
 }
 
+static void rt_static_initial(void)
+{
+   // Signals whose initial values are known at compile time are listed
+   // in a table generated by cgen in net order and all their values
+   // are copied into place at once
+
+   const int32_t *count = jit_find_symbol("_initial_count", false);
+   if (count == NULL || *count == 0)
+      return;
+
+   const int32_t *size = jit_find_symbol("_initial_size", true);
+   const uint8_t *data = jit_find_symbol("_initial_data", true);
+   const static_initial_t *table = jit_find_symbol("_initial_table", true);
+
+   TRACE("static initial values for %d signals size %d", *count, *size);
+
+   free(static_mem);
+   static_mem_sz = *size;
+   static_mem    = xmalloc(static_mem_sz * 2);
+
+   memcpy(static_mem, data, static_mem_sz);
+   memcpy(static_mem + static_mem_sz, data, static_mem_sz);
+
+   for (int i = 0; i < *count; i++) {
+      const static_initial_t *si = &(table[i]);
+      rt_setup_signal(si->nid, static_mem + si->offset,
+                      static_mem + static_mem_sz + si->offset,
+                      si->size_list, si->nparts, si->name);
+   }
+}
+
 static void rt_call_module_reset(ident_t name)
 {
    char *buf LOCAL = xasprintf("%s_reset", istr(name));
@@ -1708,64 +2112,45 @@ static int32_t rt_resolve_group(netgroup_t *group, int driver, void *values)
       }
    }
    else if (group->resolution->flags & R_RECORD) {
-      // Call resolution function for resolved record
-
-      netid_t first = group->first, last = group->first + group->length - 1;
-
-      for (const netgroup_t *it = group;
-           it->resolution == group->resolution && it->first > 0
-              && !(it->flags & NET_F_BOUNDARY);
-           it = &(groups[netdb_lookup(netdb, it->first - 1)]),
-              first = it->first)
-         ;
-
-      for (const netgroup_t *it = group;
-           it->resolution == group->resolution
-              && it->first + it->length < netdb_size(netdb)
-              && (it == group
-                  || !(it->flags & (NET_F_BOUNDARY | NET_F_OWNS_MEM)));
-           it = &(groups[netdb_lookup(netdb, it->first + it->length)]),
-              last = it->first + it->length - 1)
-         ;
-
-      size_t size = 0, group_off = 0;
-      for (int offset = first; offset <= last;) {
-         netgroup_t *g = &(groups[netdb_lookup(netdb, offset)]);
-         size += g->size * g->length;
-         if (offset < group->first)
-            group_off = size;
-         assert(g->n_drivers == group->n_drivers);
+      // Call resolution function for resolved record with the driver
+      // image built by rt_group_record: only the field belonging to
+      // this group needs to be patched
 
-         offset += g->length;
-      }
+      res_record_t *rec = group->record;
+      RT_ASSERT(rec != NULL);
+
+      if (likely(driver >= 0))
+         memcpy(rec->inputs + (driver * rec->size) + group->record_off,
+                values, valuesz);
 
-      uint8_t *inputs = alloca(size * group->n_drivers);
+      uint8_t *result =
+         (uint8_t *)(*group->resolution->fn)(rec->inputs, rec->n_drivers);
+      resolved = result + group->record_off;
+   }
+   else if (likely(group->resolution->vec_fn != NULL)) {
+      // Pass the values of every driver to the vectorised wrapper which
+      // calls the resolution function for each element
 
-      size_t ptr = 0;
-      for (int offset = first; offset <= last;) {
-         netgroup_t *p = &(groups[netdb_lookup(netdb, offset)]);
+      resolved = alloca(valuesz);
 
-         for (int i = 0; i < p->n_drivers; i++) {
-            void *src = NULL;
-            if (i == driver && p == group)
-               src = p->drivers[i].waveforms->next->values->data;
-            else
-               src = p->drivers[i].waveforms->values->data;
-            memcpy(inputs + ptr + (i * size),
-                   src,
-                   p->size * p->length);
-         }
-         ptr += p->size * p->length;
+      const size_t matrixsz = valuesz * group->n_drivers;
+      if (unlikely(matrixsz > res_matrix_sz)) {
+         res_matrix_sz = MAX(matrixsz, res_matrix_sz * 2);
+         res_matrix = xrealloc(res_matrix, res_matrix_sz);
+      }
 
-         offset += p->length;
+      for (int i = 0; i < group->n_drivers; i++) {
+         const void *src = group->drivers[i].waveforms->values->data;
+         if (i == driver)
+            src = values;
+         memcpy(res_matrix + (i * valuesz), src, valuesz);
       }
 
-      uint8_t *result =
-         (uint8_t *)(*group->resolution->fn)(inputs, group->n_drivers);
-      resolved = result + group_off;
+      (*group->resolution->vec_fn)(res_matrix, group->n_drivers,
+                                   group->length, resolved);
    }
    else {
-      // Must actually call resolution function in general case
+      // Must call resolution function for each element
 
       resolved = alloca(valuesz);
 
@@ -1804,11 +2189,86 @@ static int32_t rt_resolve_group(netgroup_t *group, int driver, void *values)
    return new_flags;
 }
 
+static void rt_group_record(groupid_t gid, netid_t first, unsigned length)
+{
+   // Find the extent of each resolved record once all drivers have been
+   // allocated and build a persistent image of every driver's value
+
+   netgroup_t *group = &(groups[gid]);
+   if (group->resolution == NULL || !(group->resolution->flags & R_RECORD))
+      return;
+   else if (group->record != NULL || group->n_drivers == 0)
+      return;
+
+   netid_t rfirst = group->first, rlast = group->first + group->length - 1;
+
+   for (const netgroup_t *it = group;
+        it->first > 0 && !(it->flags & NET_F_BOUNDARY);) {
+      const netgroup_t *prev = &(groups[netdb_lookup(netdb, it->first - 1)]);
+      if (prev->resolution != group->resolution)
+         break;
+
+      rfirst = prev->first;
+      it = prev;
+   }
+
+   // The span ends before the next group that starts another record or
+   // has a different resolution function
+   while (rlast + 1 < netdb_size(netdb)) {
+      const netgroup_t *next = &(groups[netdb_lookup(netdb, rlast + 1)]);
+      if (next->resolution != group->resolution
+          || (next->flags & (NET_F_BOUNDARY | NET_F_OWNS_MEM)))
+         break;
+
+      rlast = next->first + next->length - 1;
+   }
+
+   size_t size = 0;
+   for (netid_t offset = rfirst; offset <= rlast;) {
+      const netgroup_t *g = &(groups[netdb_lookup(netdb, offset)]);
+      size += g->size * g->length;
+      offset += g->length;
+   }
+
+   const int n_drivers = group->n_drivers;
+
+   res_record_t *rec = xmalloc(sizeof(res_record_t) + size * n_drivers);
+   rec->size      = size;
+   rec->n_drivers = n_drivers;
+
+   TRACE("resolved record %s span %d..%d size %zu", fmt_group(group),
+         rfirst, rlast, size);
+
+   size_t ptr = 0;
+   for (netid_t offset = rfirst; offset <= rlast;) {
+      netgroup_t *g = &(groups[netdb_lookup(netdb, offset)]);
+      assert(g->n_drivers == n_drivers);
+
+      g->record     = rec;
+      g->record_off = ptr;
+
+      const size_t nbytes = g->size * g->length;
+      for (int i = 0; i < n_drivers; i++)
+         memcpy(rec->inputs + ptr + (i * size),
+                g->drivers[i].waveforms->values->data, nbytes);
+
+      ptr += nbytes;
+      offset += g->length;
+   }
+}
+
 static void rt_group_inital(groupid_t gid, netid_t first, unsigned length)
 {
    netgroup_t *g = &(groups[gid]);
-   if ((g->n_drivers == 1) && (g->resolution == NULL))
-      rt_resolve_group(g, -1, g->drivers[0].waveforms->values->data);
+   if ((g->n_drivers == 1) && (g->resolution == NULL)) {
+      // A single unresolved driver only needs to be applied if its
+      // initial value differs from the default value of the signal
+      void *data = g->drivers[0].waveforms->values->data;
+      if (memcmp(data, g->resolved, g->size * g->length) != 0)
+         rt_resolve_group(g, -1, data);
+   }
+   else if ((g->n_drivers == 1) && (g->resolution->flags & R_IDENT))
+      return;   // Resolving the default value cannot change it
    else if (g->n_drivers > 0)
       rt_resolve_group(g, -1, g->resolved);
 }
@@ -1824,6 +2284,10 @@ static void rt_initial(tree_t top)
       rt_call_module_reset(unit_name);
    }
 
+   // Resolution functions are memoised when the static initial values
+   // are bound so this must come after the packages are initialised
+   rt_static_initial();
+
    rt_call_module_reset(tree_ident(top));
 
    for (size_t i = 0; i < n_procs; i++)
@@ -1832,6 +2296,7 @@ static void rt_initial(tree_t top)
    TRACE("calculate initial driver values");
 
    init_side_effect = SIDE_EFFECT_ALLOW;
+   netdb_walk(netdb, rt_group_record);
    netdb_walk(netdb, rt_group_inital);
 
    TRACE("used %d bytes of global temporary stack", global_tmp_alloc);
@@ -2273,7 +2738,7 @@ static void rt_cycle(int stop_delta)
 
 static tree_t rt_recall_decl(const char *name)
 {
-   tree_t decl = hash_get(decl_hash, ident_new(name));
+   tree_t decl = hash_get(decl_hash, name);
    if (decl != NULL)
       return decl;
    else
@@ -2287,9 +2752,16 @@ static void rt_cleanup_group(groupid_t gid, netid_t first, unsigned length)
    RT_ASSERT(g->first == first);
    RT_ASSERT(g->length == length);
 
-   if (g->flags & NET_F_OWNS_MEM)
+   const bool is_static = static_mem != NULL
+      && (uint8_t *)g->resolved >= static_mem
+      && (uint8_t *)g->resolved < static_mem + static_mem_sz;
+
+   if ((g->flags & NET_F_OWNS_MEM) && !is_static)
       free(g->resolved);
 
+   if (g->record != NULL && g->record_off == 0)
+      free(g->record);   // First group in the record span owns the image
+
    free(g->forcing);
 
    for (int j = 0; j < g->n_drivers; j++) {
@@ -2368,6 +2840,14 @@ static void rt_cleanup(tree_t top)
    rt_alloc_stack_destroy(callback_stack);
 
    hash_free(res_memo_hash);
+
+   free(res_matrix);
+   res_matrix = NULL;
+   res_matrix_sz = 0;
+
+   free(static_mem);
+   static_mem = NULL;
+   static_mem_sz = 0;
 }
 
 static bool rt_stop_now(uint64_t stop_time)
@@ -2411,20 +2891,22 @@ static void rt_stats_print(void)
       }
    }
 
-   notef("setup:%ums run:%ums maxrss:%ukB", ready_rusage.ms, ru.ms, ru.rss);
+   // Loading the design is often well under a millisecond
+   notef("load:%"PRIu64"us setup:%ums run:%ums maxrss:%ukB",
+         load_time_us, ready_rusage.ms, ru.ms, ru.rss);
 }
 
 static void rt_reset_coverage(tree_t top)
 {
    int32_t *cover_stmts = jit_find_symbol("cover_stmts", false);
    if (cover_stmts != NULL) {
-      const int ntags = tree_attr_int(top, ident_new("stmt_tags"), 0);
+      const int ntags = tree_attr_int(top, stmt_tags_i, 0);
       memset(cover_stmts, '\0', sizeof(int32_t) * ntags);
    }
 
    int32_t *cover_conds = jit_find_symbol("cover_conds", false);
    if (cover_conds != NULL) {
-      const int ntags = tree_attr_int(top, ident_new("cond_tags"), 0);
+      const int ntags = tree_attr_int(top, cond_tags_i, 0);
       memset(cover_conds, '\0', sizeof(int32_t) * ntags);
    }
 }
@@ -2463,7 +2945,9 @@ static BOOL rt_win_ctrl_handler(DWORD fdwCtrlType)
 
 void rt_start_of_tool(tree_t top)
 {
+   const uint64_t load_start = get_timestamp_us();
    jit_init(top);
+   load_time_us = get_timestamp_us() - load_start;
 
 #if RT_DEBUG
    warnf("runtime debug assertions enabled");
@@ -41,7 +41,7 @@ struct vcd_data {
 
 static FILE    *vcd_file;
 static tree_t   vcd_top;
-static ident_t  vcd_data_i;
+static vcd_data_t **vcd_data;   // Indexed by position in vcd_top decls
 static uint64_t last_time;
 
 static void vcd_fmt_int(tree_t decl, watch_t *w, vcd_data_t *data)
@@ -120,7 +120,7 @@ static bool vcd_can_fmt_chars(type_t type, vcd_data_t *data)
       return false;
 }
 
-static void vcd_process_signal(tree_t d, int *next_key)
+static vcd_data_t *vcd_process_signal(tree_t d, int *next_key)
 {
    type_t type = tree_type(d);
    type_t base = type_base_recur(type);
@@ -135,7 +135,7 @@ static void vcd_process_signal(tree_t d, int *next_key)
          warn_at(tree_loc(d), "cannot represent multidimensional arrays "
                  "in VCD format");
          free(data);
-         return;
+         return NULL;
       }
 
       range_t r = type_dim(type, 0);
@@ -154,7 +154,7 @@ static void vcd_process_signal(tree_t d, int *next_key)
          warn_at(tree_loc(d), "cannot represent arrays of type %s "
                  "in VCD format", type_pp(elem));
          free(data);
-         return;
+         return NULL;
       }
    }
    else {
@@ -180,7 +180,7 @@ static void vcd_process_signal(tree_t d, int *next_key)
          warn_at(tree_loc(d), "cannot represent type %s in VCD format",
                  type_pp(type));
          free(data);
-         return;
+         return NULL;
       }
    }
 
@@ -192,8 +192,6 @@ static void vcd_process_signal(tree_t d, int *next_key)
    else
       checked_sprintf(name, sizeof(name), "%s", name_base);
 
-   tree_add_attr_ptr(d, vcd_data_i, data);
-
    data->watch = rt_set_event_cb(d, vcd_event_cb, data, true);
 
    vcd_key_fmt(*next_key, data->key);
@@ -202,6 +200,7 @@ static void vcd_process_signal(tree_t d, int *next_key)
            (int)data->size, data->key, name);
 
    ++(*next_key);
+   return data;
 }
 
 void vcd_restart(void)
@@ -213,6 +212,9 @@ void vcd_restart(void)
 
    int next_key = 0;
    const int ndecls = tree_decls(vcd_top);
+   vcd_data = xrealloc(vcd_data, ndecls * sizeof(vcd_data_t *));
+   memset(vcd_data, '\0', ndecls * sizeof(vcd_data_t *));
+
    for (int i = 0; i < ndecls; i++) {
       tree_t d = tree_decl(vcd_top, i);
       switch (tree_kind(d)) {
@@ -221,13 +223,13 @@ void vcd_restart(void)
          break;
       case T_SIGNAL_DECL:
          if (wave_should_dump(d))
-            vcd_process_signal(d, &next_key);
+            vcd_data[i] = vcd_process_signal(d, &next_key);
          break;
       default:
          break;
       }
 
-      int npop = tree_attr_int(d, ident_new("scope_pop"), 0);
+      int npop = tree_attr_int(d, scope_pop_i, 0);
       while (npop-- > 0)
          fprintf(vcd_file, "$upscope $end\n");
    }
@@ -239,12 +241,9 @@ void vcd_restart(void)
    last_time = UINT64_MAX;
 
    for (int i = 0; i < ndecls; i++) {
-      tree_t d = tree_decl(vcd_top, i);
-      if (tree_kind(d) == T_SIGNAL_DECL) {
-         vcd_data_t *data = tree_attr_ptr(d, vcd_data_i);
-         if (likely(data != NULL))
-            vcd_event_cb(0, d, data->watch, data);
-      }
+      vcd_data_t *data = vcd_data[i];
+      if (data != NULL)
+         vcd_event_cb(0, tree_decl(vcd_top, i), data->watch, data);
    }
 
    fprintf(vcd_file, "$end\n");
@@ -252,8 +251,6 @@ void vcd_restart(void)
 
 void vcd_init(const char *filename, tree_t top)
 {
-   vcd_data_i   = ident_new("vcd_data");
-
    vcd_top = top;
 
    warnf("Use of the VCD file format is discouraged as it cannot fully "
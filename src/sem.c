@@ -3838,7 +3838,7 @@ sem_check_configuration (
       istr(lib_name(work)));
   }
 
-  tree_t copy = tree_copy(arch, sem_copy_instances, NULL);
+  tree_t copy = tree_copy(arch, sem_copy_instances, NULL, false);
   tree_set_ident(copy, ident_prefix(name_qual, tree_ident(t), '-'));
   lib_put(lib_work(), copy);
 
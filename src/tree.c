@@ -25,6 +25,7 @@
 #include "array.h"
 #include "object.h"
 #include "common.h"
+#include "hash.h"
 
 #include <assert.h>
 #include <stdlib.h>
@@ -71,6 +72,9 @@ static void tree_assert_kind(tree_t t, const tree_kind_t *list, size_t len,
 static void tree_assert_stmt(tree_t t);
 static attr_t *tree_find_attr(tree_t t, ident_t name, attr_kind_t kind);
 static bool tree_kind_in(tree_t t, const tree_kind_t *list, size_t len);
+static void tree_restricted(tree_t t, bool *skip_shared,
+                            generation_t *shared_generation);
+static void tree_unload(object_t *object);
 
 /* ========================================================================= */
 /* -- PRIVATE DATA --------------------------------------------------------- */
@@ -398,6 +402,9 @@ static tree_kind_t decl_kinds[] = {
   T_USE,        T_PROT_BODY,   T_BLOCK_CONFIG
 };
 
+static hash_t *restricted_copies = NULL;   // Copy root to shared generation
+static tree_unload_fn_t unload_fn = NULL;
+
 /* ========================================================================= */
 /* -- EXPORTED DATA -------------------------------------------------------- */
 /* ========================================================================= */
@@ -432,7 +439,7 @@ tree_add_assoc (
   tree_array_t *array = &(lookup_item(&tree_object, t, I_ASSOCS)->tree_array);
 
   if (tree_subkind(a) == A_POS) {
-    tree_set_pos(a, array->count);
+    tree_set_pos(a, tree_array_count(array));
   }
 
   tree_array_add(array, a);
@@ -525,7 +532,11 @@ tree_add_decl (
   tree_t d
 ) {
   tree_assert_decl(d);
-  tree_array_add(&(lookup_item(&tree_object, t, I_DECLS)->tree_array), d);
+  tree_array_t *array = &(lookup_item(&tree_object, t, I_DECLS)->tree_array);
+  if (object_array_deferred(array)) {
+    object_read_deferred(&(t->object));
+  }
+  tree_array_add(array, d);
 } /* tree_add_decl() */
 
 /* ------------------------------------------------------------------------- */
@@ -541,6 +552,15 @@ tree_add_else_stmt (
 
 /* ------------------------------------------------------------------------- */
 
+void
+tree_add_gc_root (
+  tree_t t
+) {
+  object_add_gc_root(&(t->object));
+} /* tree_add_gc_root() */
+
+/* ------------------------------------------------------------------------- */
+
 void
 tree_add_generic (
   tree_t t,
@@ -562,7 +582,7 @@ tree_add_genmap (
   tree_array_t *array = &(lookup_item(&tree_object, t, I_GENMAPS)->tree_array);
 
   if (tree_subkind(e) == P_POS) {
-    tree_set_pos(e, array->count);
+    tree_set_pos(e, tree_array_count(array));
   }
 
   tree_array_add(&(lookup_item(&tree_object, t, I_GENMAPS)->tree_array), e);
@@ -602,7 +622,7 @@ tree_add_param (
   tree_array_t *array = &(lookup_item(&tree_object, t, I_PARAMS)->tree_array);
 
   if (tree_subkind(e) == P_POS) {
-    tree_set_pos(e, array->count);
+    tree_set_pos(e, tree_array_count(array));
   }
 
   tree_array_add(array, e);
@@ -637,7 +657,11 @@ tree_add_stmt (
   tree_t s
 ) {
   tree_assert_stmt(s);
-  tree_array_add(&(lookup_item(&tree_object, t, I_STMTS)->tree_array), s);
+  tree_array_t *array = &(lookup_item(&tree_object, t, I_STMTS)->tree_array);
+  if (object_array_deferred(array)) {
+    object_read_deferred(&(t->object));
+  }
+  tree_array_add(array, s);
 } /* tree_add_stmt() */
 
 /* ------------------------------------------------------------------------- */
@@ -680,7 +704,8 @@ unsigned
 tree_assocs (
   tree_t t
 ) {
-  return (lookup_item(&tree_object, t, I_ASSOCS)->tree_array.count);
+  item_t *item = lookup_item(&tree_object, t, I_ASSOCS);
+  return (tree_array_count(&(item->tree_array)));
 } /* tree_assocs() */
 
 /* ------------------------------------------------------------------------- */
@@ -752,11 +777,11 @@ tree_change_net (
 ) {
   item_t *item = lookup_item(&tree_object, t, I_NETS);
 
-  if (n >= item->netid_array.count) {
+  if (n >= netid_array_count(&(item->netid_array))) {
     netid_array_resize(&(item->netid_array), n + 1, 0xff);
   }
 
-  item->netid_array.items[n] = i;
+  *netid_array_nth_ptr(&(item->netid_array), n) = i;
 } /* tree_change_net() */
 
 /* ------------------------------------------------------------------------- */
@@ -769,8 +794,7 @@ tree_change_range (
 ) {
   item_t *item = lookup_item(&tree_object, t, I_RANGES);
 
-  assert(n < item->range_array.count);
-  item->range_array.items[n] = r;
+  *range_array_nth_ptr(&(item->range_array), n) = r;
 } /* tree_change_range() */
 
 /* ------------------------------------------------------------------------- */
@@ -792,7 +816,8 @@ tree_chars (
   tree_t t
 ) {
   assert((t->object.kind == T_LITERAL) && (tree_subkind(t) == L_STRING));
-  return (lookup_item(&tree_object, t, I_CHARS)->ident_array.count);
+  item_t *item = lookup_item(&tree_object, t, I_CHARS);
+  return (tree_array_count(&(item->tree_array)));
 } /* tree_chars() */
 
 /* ------------------------------------------------------------------------- */
@@ -822,7 +847,8 @@ unsigned
 tree_conds (
   tree_t t
 ) {
-  return (lookup_item(&tree_object, t, I_CONDS)->tree_array.count);
+  item_t *item = lookup_item(&tree_object, t, I_CONDS);
+  return (tree_array_count(&(item->tree_array)));
 } /* tree_conds() */
 
 /* ------------------------------------------------------------------------- */
@@ -843,7 +869,8 @@ unsigned
 tree_contexts (
   tree_t t
 ) {
-  return (lookup_item(&tree_object, t, I_CONTEXT)->tree_array.count);
+  item_t *item = lookup_item(&tree_object, t, I_CONTEXT);
+  return (tree_array_count(&(item->tree_array)));
 } /* tree_contexts() */
 
 /* ------------------------------------------------------------------------- */
@@ -852,7 +879,8 @@ tree_t
 tree_copy (
   tree_t         t,
   tree_copy_fn_t fn,
-  void          *context
+  void          *context,
+  bool           restrict_walks
 ) {
   object_copy_ctx_t ctx =
   {
@@ -873,17 +901,44 @@ tree_copy (
   tree_t copy = (tree_t) object_copy_sweep(&(t->object), &ctx);
 
   free(ctx.copied);
+
+  if (restrict_walks) {
+    // Walks rooted at the copy skip the subtrees it shares with the
+    // original until tree_copy_unrestrict is called: the shared objects
+    // are the ones marked with this generation but not copied
+
+    if (restricted_copies == NULL) {
+      restricted_copies = hash_new(64, true);
+    }
+    hash_put(restricted_copies, copy,
+      (void *) (uintptr_t) (ctx.generation + 1));
+  }
+
   return (copy);
 } /* tree_copy() */
 
 /* ------------------------------------------------------------------------- */
 
+void
+tree_copy_unrestrict (
+  tree_t copy
+) {
+  if (restricted_copies != NULL) {
+    (void) hash_delete(restricted_copies, copy);
+  }
+} /* tree_copy_unrestrict() */
+
+/* ------------------------------------------------------------------------- */
+
 tree_t
 tree_decl (
   tree_t   t,
   unsigned n
 ) {
   item_t *item = lookup_item(&tree_object, t, I_DECLS);
+  if (object_array_deferred(&(item->tree_array))) {
+    object_read_deferred(&(t->object));
+  }
 
   return (tree_array_nth(&(item->tree_array), n));
 } /* tree_decl() */
@@ -894,7 +949,8 @@ unsigned
 tree_decls (
   tree_t t
 ) {
-  return (lookup_item(&tree_object, t, I_DECLS)->tree_array.count);
+  item_t *item = lookup_item(&tree_object, t, I_DECLS);
+  return (tree_array_count(&(item->tree_array)));
 } /* tree_decls() */
 
 /* ------------------------------------------------------------------------- */
@@ -937,7 +993,8 @@ unsigned
 tree_else_stmts (
   tree_t t
 ) {
-  return (lookup_item(&tree_object, t, I_ELSES)->tree_array.count);
+  item_t *item = lookup_item(&tree_object, t, I_ELSES);
+  return (tree_array_count(&(item->tree_array)));
 } /* tree_else_stmts() */
 
 /* ------------------------------------------------------------------------- */
@@ -964,7 +1021,14 @@ void
 tree_gc (
   void
 ) {
-  object_gc();
+  object_gc(tree_unload);
+  type_eq_flush();
+
+  // Collected copies may be reallocated at the same address
+  if (restricted_copies != NULL) {
+    hash_free(restricted_copies);
+    restricted_copies = NULL;
+  }
 } /* tree_gc() */
 
 /* ------------------------------------------------------------------------- */
@@ -985,7 +1049,8 @@ unsigned
 tree_generics (
   tree_t t
 ) {
-  return (lookup_item(&tree_object, t, I_GENERICS)->tree_array.count);
+  item_t *item = lookup_item(&tree_object, t, I_GENERICS);
+  return (tree_array_count(&(item->tree_array)));
 } /* tree_generics() */
 
 /* ------------------------------------------------------------------------- */
@@ -1006,7 +1071,8 @@ unsigned
 tree_genmaps (
   tree_t t
 ) {
-  return (lookup_item(&tree_object, t, I_GENMAPS)->tree_array.count);
+  item_t *item = lookup_item(&tree_object, t, I_GENMAPS);
+  return (tree_array_count(&(item->tree_array)));
 } /* tree_genmaps() */
 
 /* ------------------------------------------------------------------------- */
@@ -1151,7 +1217,7 @@ tree_loc (
 ) {
   assert(t != NULL);
 
-  return (&t->object.loc);
+  return (object_loc(&(t->object)));
 } /* tree_loc() */
 
 /* ------------------------------------------------------------------------- */
@@ -1198,7 +1264,8 @@ unsigned
 tree_nets (
   tree_t t
 ) {
-  return (lookup_item(&tree_object, t, I_NETS)->netid_array.count);
+  item_t *item = lookup_item(&tree_object, t, I_NETS);
+  return (netid_array_count(&(item->netid_array)));
 } /* tree_nets() */
 
 /* ------------------------------------------------------------------------- */
@@ -1227,7 +1294,8 @@ unsigned
 tree_ops (
   tree_t t
 ) {
-  return (lookup_item(&tree_object, t, I_OPS)->tree_array.count);
+  item_t *item = lookup_item(&tree_object, t, I_OPS);
+  return (tree_array_count(&(item->tree_array)));
 } /* tree_ops() */
 
 /* ------------------------------------------------------------------------- */
@@ -1248,7 +1316,8 @@ unsigned
 tree_params (
   tree_t t
 ) {
-  return (lookup_item(&tree_object, t, I_PARAMS)->tree_array.count);
+  item_t *item = lookup_item(&tree_object, t, I_PARAMS);
+  return (tree_array_count(&(item->tree_array)));
 } /* tree_params() */
 
 /* ------------------------------------------------------------------------- */
@@ -1269,7 +1338,8 @@ unsigned
 tree_ports (
   tree_t t
 ) {
-  return (lookup_item(&tree_object, t, I_PORTS)->tree_array.count);
+  item_t *item = lookup_item(&tree_object, t, I_PORTS);
+  return (tree_array_count(&(item->tree_array)));
 } /* tree_ports() */
 
 /* ------------------------------------------------------------------------- */
@@ -1299,7 +1369,8 @@ unsigned
 tree_ranges (
   tree_t t
 ) {
-  return (lookup_item(&tree_object, t, I_RANGES)->range_array.count);
+  item_t *item = lookup_item(&tree_object, t, I_RANGES);
+  return (range_array_count(&(item->range_array)));
 } /* tree_ranges() */
 
 /* ------------------------------------------------------------------------- */
@@ -1366,20 +1437,22 @@ tree_remove_attr (
 
   item_t *item = lookup_item(&tree_object, t, I_ATTRS);
 
+  const unsigned nattrs = attr_array_count(&(item->attrs));
+
   unsigned i;
-  for (i = 0; (i < item->attrs.num) &&
-    (item->attrs.table[i].name != name); i++) {
+  for (i = 0; (i < nattrs) &&
+    (item->attrs.data->items[i].name != name); i++) {
   }
 
-  if (i == item->attrs.num) {
+  if (i == nattrs) {
     return;
   }
 
-  for ( ; i + 1 < item->attrs.num; i++) {
-    item->attrs.table[i] = item->attrs.table[i + 1];
+  for ( ; i + 1 < nattrs; i++) {
+    item->attrs.data->items[i] = item->attrs.data->items[i + 1];
   }
 
-  item->attrs.num--;
+  attr_array_resize(&(item->attrs), nattrs - 1, 0);
 } /* tree_remove_attr() */
 
 /* ------------------------------------------------------------------------- */
@@ -1398,6 +1471,8 @@ tree_rewrite (
     .context    = context
   };
 
+  tree_restricted(t, &(ctx.skip_shared), &(ctx.shared_generation));
+
   tree_t result = (tree_t) object_rewrite(&(t->object), &ctx);
 
   free(ctx.cache);
@@ -1497,7 +1572,7 @@ tree_set_loc (
   assert(t != NULL);
   assert(loc != NULL);
 
-  t->object.loc = *loc;
+  object_set_loc(&(t->object), loc);
 } /* tree_set_loc() */
 
 /* ------------------------------------------------------------------------- */
@@ -1616,6 +1691,15 @@ tree_set_type (
 
 /* ------------------------------------------------------------------------- */
 
+void
+tree_set_unload_fn (
+  tree_unload_fn_t fn
+) {
+  unload_fn = fn;
+} /* tree_set_unload_fn() */
+
+/* ------------------------------------------------------------------------- */
+
 void
 tree_set_value (
   tree_t t,
@@ -1660,6 +1744,9 @@ tree_stmt (
   unsigned n
 ) {
   item_t *item = lookup_item(&tree_object, t, I_STMTS);
+  if (object_array_deferred(&(item->tree_array))) {
+    object_read_deferred(&(t->object));
+  }
 
   return (tree_array_nth(&(item->tree_array), n));
 } /* tree_stmt() */
@@ -1670,7 +1757,8 @@ unsigned
 tree_stmts (
   tree_t t
 ) {
-  return (lookup_item(&tree_object, t, I_STMTS)->tree_array.count);
+  item_t *item = lookup_item(&tree_object, t, I_STMTS);
+  return (tree_array_count(&(item->tree_array)));
 } /* tree_stmts() */
 
 /* ------------------------------------------------------------------------- */
@@ -1723,7 +1811,8 @@ unsigned
 tree_triggers (
   tree_t t
 ) {
-  return (lookup_item(&tree_object, t, I_TRIGGERS)->tree_array.count);
+  item_t *item = lookup_item(&tree_object, t, I_TRIGGERS);
+  return (tree_array_count(&(item->tree_array)));
 } /* tree_triggers() */
 
 /* ------------------------------------------------------------------------- */
@@ -1771,6 +1860,8 @@ tree_visit (
     .deep       = false
   };
 
+  tree_restricted(t, &(ctx.skip_shared), &(ctx.shared_generation));
+
   object_visit(&(t->object), &ctx);
 
   return (ctx.count);
@@ -1798,6 +1889,8 @@ tree_visit_only (
     .deep       = false
   };
 
+  tree_restricted(t, &(ctx.skip_shared), &(ctx.shared_generation));
+
   object_visit(&(t->object), &ctx);
 
   return (ctx.count);
@@ -1821,7 +1914,8 @@ unsigned
 tree_waveforms (
   tree_t t
 ) {
-  return (lookup_item(&tree_object, t, I_WAVES)->tree_array.count);
+  item_t *item = lookup_item(&tree_object, t, I_WAVES);
+  return (tree_array_count(&(item->tree_array)));
 } /* tree_waveforms() */
 
 /* ------------------------------------------------------------------------- */
@@ -1876,20 +1970,11 @@ tree_add_attr (
 
   item_t *item = lookup_item(&tree_object, t, I_ATTRS);
 
-  if (item->attrs.table == NULL) {
-    item->attrs.alloc = 8;
-    item->attrs.table = xmalloc(sizeof(attr_t) * item->attrs.alloc);
-  } else if (item->attrs.alloc == item->attrs.num) {
-    item->attrs.alloc *= 2;
-    item->attrs.table = xrealloc(item->attrs.table,
-        sizeof(attr_t) * item->attrs.alloc);
-  }
-
-  unsigned i = item->attrs.num++;
-  item->attrs.table[i].kind = kind;
-  item->attrs.table[i].name = name;
+  a = attr_array_alloc(&(item->attrs));
+  a->kind = kind;
+  a->name = name;
 
-  return (&(item->attrs.table[i]));
+  return (a);
 } /* tree_add_attr() */
 
 /* ------------------------------------------------------------------------- */
@@ -1948,10 +2033,10 @@ tree_find_attr (
   assert(name != NULL);
 
   item_t *item = lookup_item(&tree_object, t, I_ATTRS);
-  for (unsigned i = 0; i < item->attrs.num; i++) {
-    if ((item->attrs.table[i].kind == kind) &&
-      (item->attrs.table[i].name == name)) {
-      return (&(item->attrs.table[i]));
+  for (unsigned i = 0; i < attr_array_count(&(item->attrs)); i++) {
+    attr_t *a = &(item->attrs.data->items[i]);
+    if ((a->kind == kind) && (a->name == name)) {
+      return (a);
     }
   }
 
@@ -1975,5 +2060,37 @@ tree_kind_in (
   return (false);
 } /* tree_kind_in() */
 
+/* ------------------------------------------------------------------------- */
+
+static void
+tree_restricted (
+  tree_t        t,
+  bool         *skip_shared,
+  generation_t *shared_generation
+) {
+  // Only walks rooted at a restricted copy skip its shared subtrees so
+  // walks started from a visit or rewrite callback, for example when
+  // evaluating a function, are unaffected
+
+  uintptr_t value = 0;
+  if (restricted_copies != NULL) {
+    value = (uintptr_t) hash_get(restricted_copies, t);
+  }
+
+  *skip_shared = (value != 0);
+  *shared_generation = (value != 0) ? (generation_t) (value - 1) : 0;
+} /* tree_restricted() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+tree_unload (
+  object_t *object
+) {
+  if (unload_fn != NULL) {
+    (*unload_fn)((tree_t) object);
+  }
+} /* tree_unload() */
+
 /* :vi set ts=2 et sw=2: */
 
@@ -343,10 +343,19 @@ typedef tree_t (*tree_rewrite_fn_t)(tree_t t, void *context);
 tree_t tree_rewrite(tree_t t, tree_rewrite_fn_t fn, void *context);
 
 typedef bool (*tree_copy_fn_t)(tree_t t, void *context);
-tree_t tree_copy(tree_t t, tree_copy_fn_t fn, void *context);
+tree_t tree_copy(tree_t t, tree_copy_fn_t fn, void *context,
+                 bool restrict_walks);
+void tree_copy_unrestrict(tree_t copy);
 
 void tree_gc(void);
 
+// Keeps a tree that is not reachable from any design unit alive
+void tree_add_gc_root(tree_t t);
+
+// Called by tree_gc for each unit read from a library before it is freed
+typedef void (*tree_unload_fn_t)(tree_t unit);
+void tree_set_unload_fn(tree_unload_fn_t fn);
+
 tree_wr_ctx_t tree_write_begin(fbuf_t *f);
 void tree_write(tree_t t, tree_wr_ctx_t ctx);
 void tree_write_end(tree_wr_ctx_t ctx);
@@ -42,6 +42,9 @@
 /* -- PRIVATE DEFINITIONS -------------------------------------------------- */
 /* ========================================================================= */
 
+#define EQ_MEMO_BITS    12
+#define EQ_FILTER_BITS  16
+
 /* ========================================================================= */
 /* -- PRIVATE MACROS ------------------------------------------------------- */
 /* ========================================================================= */
@@ -66,6 +69,13 @@ struct type_rd_ctx {
   unsigned       store_sz;
 };
 
+typedef struct {
+  type_t   a;
+  type_t   b;
+  uint32_t epoch;
+  bool     result;
+} eq_memo_t;
+
 /* ========================================================================= */
 /* -- INTERNAL FUNCTION PROTOTYPES ----------------------------------------- */
 /* ========================================================================= */
@@ -74,6 +84,10 @@ struct type_rd_ctx {
 /* -- STATIC FUNCTION PROTOTYPES ------------------------------------------- */
 /* ========================================================================= */
 
+static inline unsigned type_eq_bit(type_t t);
+static void type_eq_changed(type_t t);
+static inline void type_eq_mark(type_t t);
+static bool type_eq_structure(type_t a, type_t b, bool compare_c_u_arrays);
 static type_t type_make_universal(type_kind_t kind, const char *name,
   tree_t min, tree_t max);
 static const char *type_minify_identity(const char *s);
@@ -151,6 +165,16 @@ static const change_allowed_t change_allowed[] = {
   {           -1,         -1 }
 };
 
+// Memoised results of the structural comparison in type_eq. Overload
+// resolution compares the same pairs of subprogram types on every call.
+// Every type inspected by type_eq is recorded in a Bloom filter and
+// changing one of those starts a new epoch which invalidates the memo:
+// types are almost always complete before they are first compared so
+// this rarely happens.
+static eq_memo_t eq_memo[1 << EQ_MEMO_BITS];
+static uint64_t  eq_filter[(1 << EQ_FILTER_BITS) / 64];
+static uint32_t  eq_epoch = 1;
+
 /* ========================================================================= */
 /* -- EXPORTED DATA -------------------------------------------------------- */
 /* ========================================================================= */
@@ -201,6 +225,7 @@ type_add_dim (
   range_t r
 ) {
   range_array_add(&(lookup_item(&type_object, t, I_DIMS)->range_array), r);
+  type_eq_changed(t);
 } /* type_add_dim() */
 
 /* ------------------------------------------------------------------------- */
@@ -232,6 +257,7 @@ type_add_param (
   type_t p
 ) {
   type_array_add(&(lookup_item(&type_object, t, I_PTYPES)->type_array), p);
+  type_eq_changed(t);
 } /* type_add_param() */
 
 /* ------------------------------------------------------------------------- */
@@ -305,8 +331,7 @@ type_change_dim (
 ) {
   item_t *item = lookup_item(&type_object, t, I_DIMS);
 
-  assert(n < item->range_array.count);
-  item->range_array.items[n] = r;
+  *range_array_nth_ptr(&(item->range_array), n) = r;
 } /* type_change_dim() */
 
 /* ------------------------------------------------------------------------- */
@@ -319,8 +344,7 @@ type_change_index_constr (
 ) {
   type_array_t *a = &(lookup_item(&type_object, t, I_INDEXCON)->type_array);
 
-  assert(n < a->count);
-  a->items[n] = c;
+  *type_array_nth_ptr(a, n) = c;
 } /* type_change_index_constr() */
 
 /* ------------------------------------------------------------------------- */
@@ -331,6 +355,7 @@ type_change_kind (
   type_kind_t kind
 ) {
   object_change_kind(&type_object, &(t->object), kind);
+  type_eq_changed(t);
 } /* type_change_kind() */
 
 /* ------------------------------------------------------------------------- */
@@ -343,8 +368,8 @@ type_change_param (
 ) {
   type_array_t *a = &(lookup_item(&type_object, t, I_PTYPES)->type_array);
 
-  assert(n < a->count);
-  a->items[n] = p;
+  *type_array_nth_ptr(a, n) = p;
+  type_eq_changed(t);
 } /* type_change_param() */
 
 /* ------------------------------------------------------------------------- */
@@ -377,7 +402,8 @@ unsigned
 type_decls (
   type_t t
 ) {
-  return (lookup_item(&type_object, t, I_DECLS)->tree_array.count);
+  item_t *item = lookup_item(&type_object, t, I_DECLS);
+  return (tree_array_count(&(item->tree_array)));
 } /* type_decls() */
 
 /* ------------------------------------------------------------------------- */
@@ -398,7 +424,8 @@ unsigned
 type_dims (
   type_t t
 ) {
-  return (lookup_item(&type_object, t, I_DIMS)->range_array.count);
+  item_t *item = lookup_item(&type_object, t, I_DIMS);
+  return (range_array_count(&(item->range_array)));
 } /* type_dims() */
 
 /* ------------------------------------------------------------------------- */
@@ -447,7 +474,8 @@ unsigned
 type_enum_literals (
   type_t t
 ) {
-  return (lookup_item(&type_object, t, I_LITERALS)->tree_array.count);
+  item_t *item = lookup_item(&type_object, t, I_LITERALS);
+  return (tree_array_count(&(item->tree_array)));
 } /* type_enum_literals() */
 
 /* ------------------------------------------------------------------------- */
@@ -464,6 +492,9 @@ type_eq (
     return (true);
   }
 
+  type_eq_mark(a);
+  type_eq_mark(b);
+
   type_kind_t kind_a = a->object.kind;
   type_kind_t kind_b = b->object.kind;
 
@@ -474,9 +505,15 @@ type_eq (
   // Subtypes are convertible to the base type
   while ((kind_a = a->object.kind) == T_SUBTYPE) {
     a = type_base(a);
+    type_eq_mark(a);
   }
   while ((kind_b = b->object.kind) == T_SUBTYPE) {
     b = type_base(b);
+    type_eq_mark(b);
+  }
+
+  if (a == b) {
+    return (true);
   }
 
   const bool compare_c_u_arrays =
@@ -488,19 +525,19 @@ type_eq (
   }
 
   // Universal integer type is equal to any other integer type
-  type_t universal_int = type_universal_int();
-  ident_t uint_i = type_ident(universal_int);
-  if ((kind_a == T_INTEGER) &&
-    ((type_ident(a) == uint_i) || (type_ident(b) == uint_i))) {
-    return (true);
+  if (kind_a == T_INTEGER) {
+    ident_t uint_i = type_ident(type_universal_int());
+    if ((type_ident(a) == uint_i) || (type_ident(b) == uint_i)) {
+      return (true);
+    }
   }
 
   // Universal real type is equal to any other real type
-  type_t universal_real = type_universal_real();
-  ident_t ureal_i = type_ident(universal_real);
-  if ((kind_a == T_REAL) &&
-    ((type_ident(a) == ureal_i) || (type_ident(b) == ureal_i))) {
-    return (true);
+  if (kind_a == T_REAL) {
+    ident_t ureal_i = type_ident(type_universal_real());
+    if ((type_ident(a) == ureal_i) || (type_ident(b) == ureal_i)) {
+      return (true);
+    }
   }
 
   // XXX: this is not quite right as structurally equivalent types
@@ -513,42 +550,37 @@ type_eq (
     }
   }
 
-  // Access types are equal if the pointed to type is the same
-  if (kind_a == T_ACCESS) {
-    return (type_eq(type_access(a), type_access(b)));
-  }
+  // Fibonacci hash of the pair
+  const uint64_t mix =
+    ((uintptr_t) a ^ ((uintptr_t) b << 1)) * UINT64_C(0x9e3779b97f4a7c15);
+  eq_memo_t *memo = &(eq_memo[mix >> (64 - EQ_MEMO_BITS)]);
 
-  if (compare_c_u_arrays) {
-    return (type_eq(type_elem(a), type_elem(b)));
+  if ((memo->epoch == eq_epoch) && (memo->a == a) && (memo->b == b)) {
+    return (memo->result);
   }
 
-  const imask_t has = has_map[a->object.kind];
-
-  if ((has & I_DIMS) && (type_dims(a) != type_dims(b))) {
-    return (false);
-  }
+  const bool result = type_eq_structure(a, b, compare_c_u_arrays);
 
-  if (type_kind(a) == T_FUNC) {
-    if (!type_eq(type_result(a), type_result(b))) {
-      return (false);
-    }
-  }
+  // The recursive comparison may have reused this entry
+  memo->a = a;
+  memo->b = b;
+  memo->epoch = eq_epoch;
+  memo->result = result;
 
-  if (has & I_PTYPES) {
-    if (type_params(a) != type_params(b)) {
-      return (false);
-    }
+  return (result);
+} /* type_eq() */
 
-    const int nparams = type_params(a);
-    for (int i = 0; i < nparams; i++) {
-      if (!type_eq(type_param(a, i), type_param(b, i))) {
-        return (false);
-      }
-    }
-  }
+/* ------------------------------------------------------------------------- */
 
-  return (true);
-} /* type_eq() */
+void
+type_eq_flush (
+  void
+) {
+  // Also called after garbage collection as freed types may be
+  // reallocated at the same address
+  ++eq_epoch;
+  memset(eq_filter, '\0', sizeof(eq_filter));
+} /* type_eq_flush() */
 
 /* ------------------------------------------------------------------------- */
 
@@ -574,7 +606,8 @@ type_fields (
   if (t->object.kind == T_SUBTYPE) {
     return (type_fields(type_base(t)));
   } else {
-    return (lookup_item(&type_object, t, I_FIELDS)->tree_array.count);
+    item_t *item = lookup_item(&type_object, t, I_FIELDS);
+    return (tree_array_count(&(item->tree_array)));
   }
 } /* type_fields() */
 
@@ -674,7 +707,8 @@ unsigned
 type_index_constrs (
   type_t t
 ) {
-  return (lookup_item(&type_object, t, I_INDEXCON)->type_array.count);
+  item_t *item = lookup_item(&type_object, t, I_INDEXCON);
+  return (type_array_count(&(item->type_array)));
 } /* type_index_constrs() */
 
 /* ------------------------------------------------------------------------- */
@@ -912,7 +946,8 @@ unsigned
 type_params (
   type_t t
 ) {
-  return (lookup_item(&type_object, t, I_PTYPES)->type_array.count);
+  item_t *item = lookup_item(&type_object, t, I_PTYPES);
+  return (type_array_count(&(item->type_array)));
 } /* type_params() */
 
 /* ------------------------------------------------------------------------- */
@@ -982,6 +1017,7 @@ type_replace (
   assert(t->object.kind == T_INCOMPLETE);
 
   object_replace(&(t->object), &(a->object));
+  type_eq_changed(t);
 } /* type_replace() */
 
 /* ------------------------------------------------------------------------- */
@@ -1016,6 +1052,7 @@ type_set_access (
   type_t a
 ) {
   lookup_item(&type_object, t, I_ACCESS)->type = a;
+  type_eq_changed(t);
 } /* type_set_access() */
 
 /* ------------------------------------------------------------------------- */
@@ -1026,6 +1063,7 @@ type_set_base (
   type_t b
 ) {
   lookup_item(&type_object, t, I_BASE)->type = b;
+  type_eq_changed(t);
 } /* type_set_base() */
 
 /* ------------------------------------------------------------------------- */
@@ -1058,6 +1096,7 @@ type_set_elem (
   type_t e
 ) {
   lookup_item(&type_object, t, I_ELEM)->type = e;
+  type_eq_changed(t);
 } /* type_set_elem() */
 
 /* ------------------------------------------------------------------------- */
@@ -1079,6 +1118,7 @@ type_set_ident (
 ) {
   assert(t != NULL);
   lookup_item(&type_object, t, I_IDENT)->ident = id;
+  type_eq_changed(t);
 } /* type_set_ident() */
 
 /* ------------------------------------------------------------------------- */
@@ -1099,6 +1139,7 @@ type_set_result (
   type_t r
 ) {
   lookup_item(&type_object, t, I_RESULT)->type = r;
+  type_eq_changed(t);
 } /* type_set_result() */
 
 /* ------------------------------------------------------------------------- */
@@ -1187,7 +1228,8 @@ unsigned
 type_units (
   type_t t
 ) {
-  return (lookup_item(&type_object, t, I_UNITS)->tree_array.count);
+  item_t *item = lookup_item(&type_object, t, I_UNITS);
+  return (tree_array_count(&(item->tree_array)));
 } /* type_units() */
 
 /* ------------------------------------------------------------------------- */
@@ -1208,6 +1250,7 @@ type_universal_int (
     tree_set_ival(max, INT_MAX);
 
     t = type_make_universal(T_INTEGER, "universal integer", min, max);
+    object_add_gc_root(&(t->object));
   }
 
   return (t);
@@ -1231,6 +1274,7 @@ type_universal_real (
     tree_set_dval(max, DBL_MAX);
 
     t = type_make_universal(T_REAL, "universal real", min, max);
+    object_add_gc_root(&(t->object));
   }
 
   return (t);
@@ -1273,6 +1317,85 @@ type_width (
 /* -- STATIC FUNCTION DEFINITIONS ------------------------------------------ */
 /* ========================================================================= */
 
+static inline unsigned
+type_eq_bit (
+  type_t t
+) {
+  return (((uintptr_t) t * UINT64_C(0x9e3779b97f4a7c15))
+    >> (64 - EQ_FILTER_BITS));
+} /* type_eq_bit() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+type_eq_changed (
+  type_t t
+) {
+  const unsigned bit = type_eq_bit(t);
+  if (eq_filter[bit / 64] & (UINT64_C(1) << (bit % 64))) {
+    type_eq_flush();
+  }
+} /* type_eq_changed() */
+
+/* ------------------------------------------------------------------------- */
+
+static inline void
+type_eq_mark (
+  type_t t
+) {
+  const unsigned bit = type_eq_bit(t);
+  eq_filter[bit / 64] |= (UINT64_C(1) << (bit % 64));
+} /* type_eq_mark() */
+
+/* ------------------------------------------------------------------------- */
+
+static bool
+type_eq_structure (
+  type_t a,
+  type_t b,
+  bool   compare_c_u_arrays
+) {
+  const type_kind_t kind_a = a->object.kind;
+
+  // Access types are equal if the pointed to type is the same
+  if (kind_a == T_ACCESS) {
+    return (type_eq(type_access(a), type_access(b)));
+  }
+
+  if (compare_c_u_arrays) {
+    return (type_eq(type_elem(a), type_elem(b)));
+  }
+
+  const imask_t has = has_map[kind_a];
+
+  if ((has & I_DIMS) && (type_dims(a) != type_dims(b))) {
+    return (false);
+  }
+
+  if (kind_a == T_FUNC) {
+    if (!type_eq(type_result(a), type_result(b))) {
+      return (false);
+    }
+  }
+
+  if (has & I_PTYPES) {
+    if (type_params(a) != type_params(b)) {
+      return (false);
+    }
+
+    const int nparams = type_params(a);
+    for (int i = 0; i < nparams; i++) {
+      if (!type_eq(type_param(a, i), type_param(b, i))) {
+        return (false);
+      }
+    }
+  }
+
+  return (true);
+} /* type_eq_structure() */
+
+/* ------------------------------------------------------------------------- */
+
 static type_t
 type_make_universal (
   type_kind_t kind,
@@ -50,6 +50,7 @@ type_kind_t type_kind(type_t t);
 const char *type_kind_str(type_kind_t t);
 
 bool type_eq(type_t a, type_t b);
+void type_eq_flush(void);
 bool type_strict_eq(type_t a, type_t b);
 
 // See `has_map' in type.c for definition of which fields each type
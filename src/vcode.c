@@ -42,8 +42,11 @@
 /* ========================================================================= */
 
 #define VCODE_MAGIC           0x76636f64
-#define VCODE_VERSION         6
+#define VCODE_VERSION         7
 #define VCODE_CHECK_UNIONS    0
+#define VCODE_OPT_MAX_ROUNDS  4
+#define VCODE_RANGE_WIDEN     3
+#define VCODE_RANGE_MAX_ITERS 64
 
 /* ========================================================================= */
 /* -- PRIVATE MACROS ------------------------------------------------------- */
@@ -64,7 +67,8 @@
 #define OP_HAS_FUNC(x)                               \
   (x == VCODE_OP_FCALL || x == VCODE_OP_NESTED_FCALL \
   || x == VCODE_OP_PCALL || x == VCODE_OP_RESUME     \
-  || x == VCODE_OP_NESTED_PCALL || x == VCODE_OP_NESTED_RESUME)
+  || x == VCODE_OP_NESTED_PCALL || x == VCODE_OP_NESTED_RESUME \
+  || x == VCODE_OP_INTRINSIC)
 #define OP_HAS_REAL(x) \
   (x == VCODE_OP_CONST_REAL)
 #define OP_HAS_VALUE(x) \
@@ -84,6 +88,8 @@
   (x == VCODE_OP_CMP)
 #define OP_HAS_TAG(x) \
   (x == VCODE_OP_COVER_STMT || x == VCODE_OP_COVER_COND)
+#define OP_HAS_INTRINSIC(x) \
+  (x == VCODE_OP_INTRINSIC)
 #define OP_HAS_COMMENT(x) \
   (x == VCODE_OP_COMMENT)
 #define OP_HAS_HINT(x) \
@@ -152,6 +158,7 @@ typedef struct {
     unsigned       field;             // OP_HAS_FIELD
     char          *hint;              // OP_HAS_HINT
     uint32_t       tag;               // OP_HAS_TAG
+    intrinsic_kind_t intrinsic;       // OP_HAS_INTRINSIC
     image_map_t   *image_map;         // OP_HAS_IMAGE_MAP
   };
 } op_t;
@@ -234,6 +241,7 @@ DECLARE_AND_DEFINE_ARRAY(reg);
 DECLARE_AND_DEFINE_ARRAY(block);
 DECLARE_AND_DEFINE_ARRAY(signal);
 DECLARE_AND_DEFINE_ARRAY(vtype);
+DECLARE_AND_DEFINE_ARRAY(vcode_global_ref);
 
 typedef enum {
   UNIT_PURE      = (1 << 0),
@@ -258,6 +266,112 @@ struct vcode_unit {
   unsigned       refcount;
 };
 
+typedef struct {
+  int   nblocks;
+  bool *root;            // Blocks where execution can enter the unit
+  int  *pred_base;       // Index of first predecessor of each block
+  int  *preds;           // Predecessors including the virtual entry block
+  int  *idom;            // Immediate dominator or -1 if unreachable
+  int  *rpo;             // Reachable blocks in reverse post-order
+  int   nrpo;
+  int  *child_base;      // Index of first child in the dominator tree
+  int  *children;
+} vcode_cfg_t;
+
+typedef struct {
+  int block;
+  int next;
+  int mark;
+} vcode_frame_t;
+
+typedef int (*vcode_enter_fn_t)(int block, void *ctx);
+typedef void (*vcode_leave_fn_t)(int mark, void *ctx);
+typedef int (*vcode_pass_fn_t)(void);
+
+typedef struct {
+  const char     *name;
+  vcode_pass_fn_t fn;
+  int             level;    // Minimum optimisation level
+} vcode_pass_t;
+
+typedef struct {
+  op_t    *op;
+  int      block;
+  int      chain;
+  uint32_t hash;
+} vcode_avail_t;
+
+typedef struct {
+  vcode_avail_t *entries;
+  int            count;
+  int           *heads;
+  uint32_t       mask;
+} vcode_avail_table_t;
+
+typedef struct {
+  vcode_avail_table_t avail;
+  int                 removed;
+} vcode_checks_ctx_t;
+
+typedef struct {
+  vcode_avail_table_t avail;
+  vcode_reg_t        *subst;
+  int                *defblock;
+  int                 replaced;
+} vcode_cse_ctx_t;
+
+typedef struct {
+  vcode_reg_t reg;
+  unsigned    gen;
+} vcode_fwd_t;
+
+typedef struct {
+  int         var;      // Or -1 to restore the generation
+  vcode_fwd_t old;
+} vcode_fwd_undo_t;
+
+typedef struct {
+  const vcode_cfg_t     *cfg;
+  vcode_fwd_t           *avail;
+  bool                  *aliased;
+  vcode_reg_t           *subst;
+  int                   *defblock;
+  vcode_fwd_undo_t      *undo;
+  int                    nundo;
+  unsigned               gen;
+  unsigned               maxgen;
+  bool                   calls_clobber;
+  int                    forwarded;
+} vcode_fwd_ctx_t;
+
+typedef struct {
+  int         key;      // Variable index or number of variables plus register
+  int64_t     low;
+  int64_t     high;
+  vcode_reg_t alias;    // Register known to hold the value of a variable
+} vcode_range_t;
+
+typedef struct {
+  vcode_range_t *items;   // Sorted by key
+  int            count;
+  int            updates;
+  bool           reached;
+} vcode_range_set_t;
+
+typedef struct {
+  vcode_range_set_t  *in;
+  vcode_range_set_t   cur;
+  vcode_range_set_t   save;
+  int64_t            *low;      // Interval of each register at its definition
+  int64_t            *high;
+  op_t              **defop;
+  bool               *tracked;
+  int                 nvars;
+  bool                calls_clobber;
+  bool                changed;
+  int                 removed;
+} vcode_range_ctx_t;
+
 /* ========================================================================= */
 /* -- PRIVATE STRUCTURES --------------------------------------------------- */
 /* ========================================================================= */
@@ -328,12 +442,68 @@ static void vcode_dump_type(int col, vcode_type_t type, vcode_type_t bounds);
 static int vcode_dump_var(vcode_var_t var);
 static op_t *vcode_find_definition(vcode_reg_t reg);
 static op_t *vcode_op_data(int op);
+static bool vcode_op_equivalent(vcode_unit_t ua, const op_t *a,
+  vcode_global_ref_array_t *arefs, vcode_unit_t ub, const op_t *b,
+  vcode_global_ref_array_t *brefs);
+static void vcode_opt_apply_subst(const vcode_reg_t *subst);
+static void vcode_opt_avail_init(vcode_avail_table_t *tab);
+static void vcode_opt_avail_leave(int mark, void *ctx);
+static void vcode_opt_avail_push(vcode_avail_table_t *tab, op_t *op,
+  int block, uint32_t hash);
+static void vcode_opt_cfg_free(vcode_cfg_t *cfg);
+static void vcode_opt_cfg_new(vcode_cfg_t *cfg);
+static bool vcode_opt_check_redundant(const op_t *o);
+static int vcode_opt_checks(void);
+static int vcode_opt_checks_enter(int block, void *arg);
+static void vcode_opt_compact(void);
+static int vcode_opt_count_ops(void);
+static int vcode_opt_cse(void);
+static int vcode_opt_cse_enter(int block, void *arg);
+static int vcode_opt_dead_blocks(void);
+static int *vcode_opt_def_blocks(void);
+static int vcode_opt_fold(void);
+static bool vcode_opt_fold_op(const op_t *o, int64_t *value);
+static int vcode_opt_forward(void);
+static int vcode_opt_forward_enter(int block, void *arg);
+static void vcode_opt_forward_leave(int mark, void *arg);
+static void vcode_opt_forward_reset(vcode_fwd_ctx_t *ctx);
+static void vcode_opt_kill(op_t *o);
+static int vcode_opt_prune(void);
+static void vcode_opt_range_block(vcode_range_ctx_t *ctx, int block,
+  bool apply);
+static void vcode_opt_range_clobber(vcode_range_ctx_t *ctx);
+static bool vcode_opt_range_cmp(vcode_range_ctx_t *ctx, vcode_cmp_t cmp,
+  vcode_reg_t lhs, vcode_reg_t rhs);
+static bool vcode_opt_range_cond(vcode_range_ctx_t *ctx, vcode_reg_t test,
+  bool truth, int depth);
+static vcode_range_t *vcode_opt_range_find(vcode_range_set_t *set, int key);
+static void vcode_opt_range_get(vcode_range_ctx_t *ctx, vcode_reg_t reg,
+  int64_t *low, int64_t *high);
+static void vcode_opt_range_join(vcode_range_ctx_t *ctx, int block);
+static void vcode_opt_range_op(vcode_range_ctx_t *ctx, const op_t *o);
+static bool vcode_opt_range_redundant(vcode_range_ctx_t *ctx,
+  const op_t *o);
+static void vcode_opt_range_refine(vcode_range_ctx_t *ctx, vcode_reg_t reg,
+  int64_t low, int64_t high);
+static void vcode_opt_range_set(vcode_range_set_t *set, int key,
+  int64_t low, int64_t high, vcode_reg_t alias);
+static int vcode_opt_ranges(void);
+static vcode_reg_t vcode_opt_resolve(const vcode_reg_t *subst,
+  vcode_reg_t reg);
+static bool vcode_opt_same_op(const op_t *a, const op_t *b);
+static const vcode_block_array_t *vcode_opt_successors(const block_t *b);
+static void vcode_opt_walk(const vcode_cfg_t *cfg, vcode_enter_fn_t enter,
+  vcode_leave_fn_t leave, void *ctx);
 static void vcode_pretty_print_int(int64_t n);
+static bool vcode_range_not_null(vcode_reg_t low, vcode_reg_t high);
 static bool vcode_read_unit(fbuf_t *f, ident_rd_ctx_t ident_rd_ctx);
 static reg_t *vcode_reg_data(vcode_reg_t reg);
 static void vcode_registry_add(vcode_unit_t vu);
 static signal_t *vcode_signal_data(vcode_signal_t sig);
+static int vcode_ref_slot(vcode_global_ref_array_t *refs,
+  vcode_ref_kind_t kind, int32_t handle);
 static vtype_t *vcode_type_data(vcode_type_t type);
+static bool vcode_type_equivalent(const vtype_t *a, const vtype_t *b);
 static unsigned vcode_unit_calc_depth(vcode_unit_t unit);
 static var_t *vcode_var_data(vcode_var_t var);
 static void vcode_write_unit(vcode_unit_t unit, fbuf_t *f,
@@ -349,6 +519,19 @@ static vcode_unit_t active_unit = NULL;
 static vcode_block_t active_block = VCODE_INVALID_BLOCK;
 static hash_t *registry = NULL;
 
+static const vcode_pass_t opt_passes[] =
+{
+  { "ranges",      vcode_opt_ranges,      2 },
+  { "fold",        vcode_opt_fold,        1 },
+  { "dead-blocks", vcode_opt_dead_blocks, 1 },
+  { "forward",     vcode_opt_forward,     1 },
+  { "cse",         vcode_opt_cse,         1 },
+  { "checks",      vcode_opt_checks,      1 },
+  { "prune",       vcode_opt_prune,       0 }
+};
+
+static int opt_stats[ARRAY_LEN(opt_passes)];
+
 /* ========================================================================= */
 /* -- EXPORTED DATA -------------------------------------------------------- */
 /* ========================================================================= */
@@ -1721,6 +1904,38 @@ emit_index_check (
 
 /* ------------------------------------------------------------------------- */
 
+vcode_reg_t
+emit_intrinsic (
+  intrinsic_kind_t   kind,
+  ident_t            func,
+  vcode_type_t       type,
+  const vcode_reg_t *args,
+  int                nargs
+) {
+  // Call to a library function with a native implementation in the
+  // runtime: func is still called when the native version declines
+  op_t *op = vcode_add_op(VCODE_OP_INTRINSIC);
+
+  op->func = func;
+  op->type = type;
+  op->intrinsic = kind;
+  for (int i = 0; i < nargs; i++) {
+    vcode_add_arg(op, args[i]);
+  }
+
+  VCODE_ASSERT((nargs >= 1) && (nargs <= 2),
+    "intrinsic must have one or two arguments");
+  for (int i = 0; i < nargs; i++) {
+    const vtype_kind_t akind = vcode_reg_kind(args[i]);
+    VCODE_ASSERT(akind == VCODE_TYPE_UARRAY || akind == VCODE_TYPE_INT,
+      "intrinsic arguments must be uarray or integer");
+  }
+
+  return (op->result = vcode_add_reg(type));
+} /* emit_intrinsic() */
+
+/* ------------------------------------------------------------------------- */
+
 void
 emit_jump (
   vcode_block_t target
@@ -3257,6 +3472,33 @@ vcode_dump (
 
 /* ------------------------------------------------------------------------- */
 
+void
+vcode_dump_opt_stats (
+  void
+) {
+  // Print the number of changes made by each pass in the last call to
+  // vcode_opt
+
+  int npasses = 0;
+  for (size_t i = 0; i < ARRAY_LEN(opt_passes); i++) {
+    if (opt_stats[i] != -1) {
+      npasses++;
+    }
+  }
+
+  printf("Passes     %d\n", npasses);
+
+  for (size_t i = 0; i < ARRAY_LEN(opt_passes); i++) {
+    if (opt_stats[i] != -1) {
+      int col = printf("  %s", opt_passes[i].name);
+      vcode_dump_tab(col, 40);
+      printf("%d\n", opt_stats[i]);
+    }
+  }
+} /* vcode_dump_opt_stats() */
+
+/* ------------------------------------------------------------------------- */
+
 void
 vcode_dump_with_mark (
   int mark_op
@@ -3491,6 +3733,21 @@ vcode_dump_with_mark (
           }
           break;
 
+        case VCODE_OP_INTRINSIC:
+          {
+            col += vcode_dump_reg(op->result);
+            col += color_printf(" := %s %d $magenta$%s$$ ",
+                vcode_op_string(op->kind), op->intrinsic, istr(op->func));
+            for (int i = 0; i < op->args.count; i++) {
+              if (i > 0) {
+                col += printf(", ");
+              }
+              col += vcode_dump_reg(op->args.items[i]);
+            }
+            vcode_dump_result_type(col, op);
+          }
+          break;
+
         case VCODE_OP_FCALL:
         case VCODE_OP_NESTED_FCALL:
           {
@@ -4619,6 +4876,18 @@ vcode_get_tag (
 
 /* ------------------------------------------------------------------------- */
 
+intrinsic_kind_t
+vcode_get_intrinsic (
+  int op
+) {
+  op_t *o = vcode_op_data(op);
+
+  assert(OP_HAS_INTRINSIC(o->kind));
+  return (o->intrinsic);
+} /* vcode_get_intrinsic() */
+
+/* ------------------------------------------------------------------------- */
+
 vcode_block_t
 vcode_get_target (
   int op,
@@ -4736,6 +5005,7 @@ vcode_heap_allocate (
 
     case VCODE_OP_FCALL:
     case VCODE_OP_NESTED_FCALL:
+    case VCODE_OP_INTRINSIC:
       {
         // Must have been safety checked by definition
       }
@@ -4893,7 +5163,7 @@ vcode_op_string (
     "nested resume",
     "undefined",
     "image map",        "debug info",       "addi",
-    "range null"
+    "range null",       "intrinsic"
   };
 
   if ((unsigned) op >= ARRAY_LEN(strs)) {
@@ -4909,116 +5179,32 @@ void
 vcode_opt (
   void
 ) {
-  // Prune assignments to unused registers
-
-  int *uses LOCAL = xmalloc(active_unit->regs.count * sizeof(int));
-
-  int pruned = 0;
-
-  do {
-    memset(uses, '\0', active_unit->regs.count * sizeof(int));
-    pruned = 0;
-
-    for (int i = active_unit->blocks.count - 1; i >= 0; i--) {
-      block_t *b = &(active_unit->blocks.items[i]);
-
-      for (int j = b->ops.count - 1; j >= 0; j--) {
-        op_t *o = &(b->ops.items[j]);
+  // Run each pass enabled at the current optimisation level until no
+  // further changes are made: later passes expose more constants and
+  // unreachable blocks to the earlier ones
 
-        switch (o->kind)
-        {
-          case VCODE_OP_FCALL:
-            {
-              if (o->result == VCODE_INVALID_REG) {
-                break;
-              }
-            }
-
-          case VCODE_OP_CONST:
-          case VCODE_OP_CONST_REAL:
-          case VCODE_OP_CONST_ARRAY:
-          case VCODE_OP_CONST_RECORD:
-          case VCODE_OP_LOAD:
-          case VCODE_OP_LOAD_INDIRECT:
-          case VCODE_OP_ADD:
-          case VCODE_OP_ADDI:
-          case VCODE_OP_SUB:
-          case VCODE_OP_MUL:
-          case VCODE_OP_CMP:
-          case VCODE_OP_INDEX:
-          case VCODE_OP_NETS:
-          case VCODE_OP_WRAP:
-          case VCODE_OP_VEC_LOAD:
-          case VCODE_OP_HEAP_SAVE:
-          case VCODE_OP_EXP:
-          case VCODE_OP_UNDEFINED:
-          case VCODE_OP_UARRAY_LEN:
-          case VCODE_OP_UARRAY_DIR:
-          case VCODE_OP_UARRAY_LEFT:
-          case VCODE_OP_UARRAY_RIGHT:
-          case VCODE_OP_UNWRAP:
-            {
-              if (uses[o->result] == -1) {
-                vcode_dump_with_mark(j);
-                fatal("defintion of r%d does not dominate all uses",
-                  o->result);
-              } else if (uses[o->result] == 0) {
-                if (o->kind == VCODE_OP_CONST) {
-                  o->kind = (vcode_op_t) -1;
-                } else {
-                  o->comment = xasprintf("Dead %s definition of r%d",
-                      vcode_op_string(o->kind),
-                      o->result);
-                  o->kind = VCODE_OP_COMMENT;
-                }
-                vcode_reg_array_resize(&(o->args), 0, VCODE_INVALID_REG);
-                pruned++;
-              }
-              uses[o->result] = -1;
-            }
-            break;
+  assert(active_unit != NULL);
 
-          case VCODE_OP_STORAGE_HINT:
-            {
-              vcode_dump_with_mark(j);
-              fatal("Unused storage hint for r%d was not removed",
-                o->args.items[0]);
-            }
-            break;
+  const int level = opt_get_int("optimise");
+  const int rounds = (level > 0) ? VCODE_OPT_MAX_ROUNDS : 1;
 
-          default:
-            {
-            }
-            break;
-        }
+  for (size_t i = 0; i < ARRAY_LEN(opt_passes); i++) {
+    opt_stats[i] = (level >= opt_passes[i].level) ? 0 : -1;
+  }
 
-        for (int k = 0; k < o->args.count; k++) {
-          if (o->args.items[k] != VCODE_INVALID_REG) {
-            uses[o->args.items[k]]++;
-          }
-        }
+  for (int round = 0; round < rounds; round++) {
+    int changes = 0;
+    for (size_t i = 0; i < ARRAY_LEN(opt_passes); i++) {
+      if (opt_stats[i] != -1) {
+        const int n = (*opt_passes[i].fn)();
+        opt_stats[i] += n;
+        changes += n;
       }
     }
-  } while (pruned > 0);
 
-  for (int i = active_unit->blocks.count - 1; i >= 0; i--) {
-    block_t *b = &(active_unit->blocks.items[i]);
-    op_t *dst = &(b->ops.items[0]);
-    size_t copied = 0;
-    for (int j = 0; j < b->ops.count; j++) {
-      const op_t *src = &(b->ops.items[j]);
-      if (src->kind != (vcode_op_t) -1) {
-        if (src != dst) {
-          assert(dst < src);
-          *dst = *src;
-        }
-        dst++;
-        copied++;
-      }
+    if (changes == 0) {
+      break;
     }
-
-    assert(copied <= b->ops.count);
-    b->ops.count = copied;
   }
 } /* vcode_opt() */
 
@@ -5264,6 +5450,122 @@ vcode_unit_depth (
 
 /* ------------------------------------------------------------------------- */
 
+bool
+vcode_unit_equivalent (
+  vcode_unit_t a,
+  vcode_unit_t b
+) {
+  // Units are equivalent if they generate the same code apart from which
+  // signals and variables in the enclosing unit they refer to: these are
+  // matched by order of first reference
+
+  if (a == b) {
+    return (true);
+  } else if ((a->kind != b->kind) || (a->context != b->context)
+             || (a->depth != b->depth) || (a->flags != b->flags)
+             || (a->result != b->result)) {
+    return (false);
+  } else if ((a->children != NULL) || (b->children != NULL)) {
+    return (false);   // Nested subprograms are named after the parent
+  } else if ((a->blocks.count != b->blocks.count)
+             || (a->regs.count != b->regs.count)
+             || (a->types.count != b->types.count)
+             || (a->vars.count != b->vars.count)
+             || (a->params.count != b->params.count)
+             || (a->signals.count != b->signals.count)) {
+    return (false);
+  }
+
+  for (unsigned i = 0; i < a->types.count; i++) {
+    if (!vcode_type_equivalent(&(a->types.items[i]), &(b->types.items[i]))) {
+      return (false);
+    }
+  }
+
+  for (unsigned i = 0; i < a->regs.count; i++) {
+    const reg_t *ra = &(a->regs.items[i]);
+    const reg_t *rb = &(b->regs.items[i]);
+    if ((ra->type != rb->type) || (ra->bounds != rb->bounds)) {
+      return (false);
+    }
+  }
+
+  for (unsigned i = 0; i < a->vars.count; i++) {
+    const var_t *va = &(a->vars.items[i]);
+    const var_t *vb = &(b->vars.items[i]);
+    if ((va->type != vb->type) || (va->bounds != vb->bounds)
+        || (va->flags != vb->flags)) {
+      return (false);
+    }
+  }
+
+  for (unsigned i = 0; i < a->params.count; i++) {
+    const param_t *pa = &(a->params.items[i]);
+    const param_t *pb = &(b->params.items[i]);
+    if ((pa->type != pb->type) || (pa->bounds != pb->bounds)
+        || (pa->reg != pb->reg)) {
+      return (false);
+    }
+  }
+
+  if (a->signals.count > 0) {
+    return (false);
+  }
+
+  vcode_global_ref_array_t arefs = { 0, NULL };
+  vcode_global_ref_array_t brefs = { 0, NULL };
+
+  bool equivalent = true;
+  for (unsigned i = 0; equivalent && (i < a->blocks.count); i++) {
+    const block_t *ba = &(a->blocks.items[i]);
+    const block_t *bb = &(b->blocks.items[i]);
+
+    if (ba->ops.count != bb->ops.count) {
+      equivalent = false;
+      break;
+    }
+
+    for (unsigned j = 0; equivalent && (j < ba->ops.count); j++) {
+      equivalent = vcode_op_equivalent(a, &(ba->ops.items[j]), &arefs,
+        b, &(bb->ops.items[j]), &brefs);
+    }
+  }
+
+  free(arefs.items);
+  free(brefs.items);
+
+  return (equivalent);
+} /* vcode_unit_equivalent() */
+
+/* ------------------------------------------------------------------------- */
+
+int
+vcode_unit_global_refs (
+  vcode_unit_t         unit,
+  vcode_global_ref_t **refs
+) {
+  vcode_global_ref_array_t array = { 0, NULL };
+
+  for (unsigned i = 0; i < unit->blocks.count; i++) {
+    const block_t *b = &(unit->blocks.items[i]);
+    for (unsigned j = 0; j < b->ops.count; j++) {
+      const op_t *o = &(b->ops.items[j]);
+
+      if (OP_HAS_SIGNAL(o->kind)) {
+        vcode_ref_slot(&array, VCODE_REF_SIGNAL, o->signal);
+      } else if (OP_HAS_ADDRESS(o->kind)
+                 && (MASK_CONTEXT(o->address) < unit->depth)) {
+        vcode_ref_slot(&array, VCODE_REF_VAR, o->address);
+      }
+    }
+  }
+
+  *refs = array.items;
+  return (array.count);
+} /* vcode_unit_global_refs() */
+
+/* ------------------------------------------------------------------------- */
+
 bool
 vcode_unit_has_undefined (
   void
@@ -5274,6 +5576,33 @@ vcode_unit_has_undefined (
 
 /* ------------------------------------------------------------------------- */
 
+uint32_t
+vcode_unit_hash (
+  vcode_unit_t unit
+) {
+  // Cheap hash of the shape of a unit for grouping candidates before
+  // calling vcode_unit_equivalent
+  uint32_t hash = unit->kind;
+  hash = (hash * 31) + unit->blocks.count;
+  hash = (hash * 31) + unit->regs.count;
+  hash = (hash * 31) + unit->vars.count;
+
+  for (unsigned i = 0; i < unit->blocks.count; i++) {
+    const block_t *b = &(unit->blocks.items[i]);
+    for (unsigned j = 0; j < b->ops.count; j++) {
+      const op_t *o = &(b->ops.items[j]);
+      hash = (hash * 31) + o->kind;
+      if (OP_HAS_VALUE(o->kind)) {
+        hash = (hash * 31) + (uint32_t)o->value;
+      }
+    }
+  }
+
+  return (hash);
+} /* vcode_unit_hash() */
+
+/* ------------------------------------------------------------------------- */
+
 vunit_kind_t
 vcode_unit_kind (
   void
@@ -6424,7 +6753,7 @@ vcode_block_data (
    (OP_HAS_CMP(x) + OP_HAS_VALUE(x) + OP_HAS_REAL(x) +                  \
     OP_HAS_COMMENT(x) + OP_HAS_SIGNAL(x) + OP_HAS_DIM(x) +              \
     OP_HAS_HOPS(x) + OP_HAS_FIELD(x) + OP_HAS_HINT(x) +                 \
-    OP_HAS_TAG(x))
+    OP_HAS_TAG(x) + OP_HAS_INTRINSIC(x))
 #define OP_USE_COUNT_U1(x)                                              \
    (OP_HAS_SUBKIND(x) + OP_HAS_FUNC(x) + OP_HAS_ADDRESS(x))
 #define OP_USE_COUNT_U2(x)                                              \
@@ -6662,8 +6991,2388 @@ vcode_op_data (
 
 /* ------------------------------------------------------------------------- */
 
-static void
-vcode_pretty_print_int (
+static bool
+vcode_op_equivalent (
+  vcode_unit_t              ua,
+  const op_t               *a,
+  vcode_global_ref_array_t *arefs,
+  vcode_unit_t              ub,
+  const op_t               *b,
+  vcode_global_ref_array_t *brefs
+) {
+  if ((a->kind != b->kind) || (a->result != b->result)
+      || (a->type != b->type) || (a->args.count != b->args.count)) {
+    return (false);
+  }
+
+  for (unsigned i = 0; i < a->args.count; i++) {
+    if (a->args.items[i] != b->args.items[i]) {
+      return (false);
+    }
+  }
+
+  if (OP_HAS_RESOLUTION(a->kind) || (a->kind == VCODE_OP_RESOLVED_ADDRESS)
+      || (a->kind == VCODE_OP_NEEDS_LAST_VALUE)) {
+    return (false);   // Code generation depends on the particular signal
+  }
+
+  if (OP_HAS_FUNC(a->kind)) {
+    if (a->func != b->func) {
+      return (false);
+    }
+  } else if (OP_HAS_ADDRESS(a->kind)) {
+    const bool aglobal = MASK_CONTEXT(a->address) < ua->depth;
+    const bool bglobal = MASK_CONTEXT(b->address) < ub->depth;
+
+    if (aglobal != bglobal) {
+      return (false);
+    } else if (!aglobal) {
+      if (a->address != b->address) {
+        return (false);
+      }
+    } else {
+      vcode_unit_t context = ua->context;
+      while (context->depth != MASK_CONTEXT(a->address)) {
+        context = context->context;
+      }
+
+      const var_t *va = &(context->vars.items[MASK_INDEX(a->address)]);
+      const var_t *vb = &(context->vars.items[MASK_INDEX(b->address)]);
+      if ((MASK_CONTEXT(a->address) != MASK_CONTEXT(b->address))
+          || (va->type != vb->type) || (va->flags != vb->flags)) {
+        return (false);
+      }
+
+      if (vcode_ref_slot(arefs, VCODE_REF_VAR, a->address)
+          != vcode_ref_slot(brefs, VCODE_REF_VAR, b->address)) {
+        return (false);
+      }
+    }
+  } else if (OP_HAS_SUBKIND(a->kind)) {
+    if (a->subkind != b->subkind) {
+      return (false);
+    }
+  }
+
+  if (OP_HAS_LOC(a->kind)) {
+    if ((a->loc.first_line != b->loc.first_line)
+        || (a->loc.first_column != b->loc.first_column)
+        || (a->loc.last_line != b->loc.last_line)
+        || (a->loc.last_column != b->loc.last_column)
+        || (a->loc.file != b->loc.file)) {
+      return (false);
+    }
+  } else if (OP_HAS_TARGET(a->kind)) {
+    if (a->targets.count != b->targets.count) {
+      return (false);
+    }
+
+    for (unsigned i = 0; i < a->targets.count; i++) {
+      if (a->targets.items[i] != b->targets.items[i]) {
+        return (false);
+      }
+    }
+  }
+
+  if (OP_HAS_CMP(a->kind)) {
+    return (a->cmp == b->cmp);
+  } else if (OP_HAS_VALUE(a->kind)) {
+    return (a->value == b->value);
+  } else if (OP_HAS_REAL(a->kind)) {
+    return (memcmp(&(a->real), &(b->real), sizeof(double)) == 0);
+  } else if (OP_HAS_COMMENT(a->kind)) {
+    return (true);
+  } else if (OP_HAS_SIGNAL(a->kind)) {
+    signal_t *sa = NULL, *sb = NULL;
+    vcode_unit_t context = ua;
+    while (context->kind != VCODE_UNIT_CONTEXT) {
+      context = context->context;
+    }
+
+    sa = signal_array_nth_ptr(&(context->signals), a->signal);
+    sb = signal_array_nth_ptr(&(context->signals), b->signal);
+    if ((sa->type != sb->type) || (sa->flags != sb->flags)) {
+      return (false);
+    }
+
+    return (vcode_ref_slot(arefs, VCODE_REF_SIGNAL, a->signal)
+            == vcode_ref_slot(brefs, VCODE_REF_SIGNAL, b->signal));
+  } else if (OP_HAS_DIM(a->kind)) {
+    return (a->dim == b->dim);
+  } else if (OP_HAS_HOPS(a->kind)) {
+    return (a->hops == b->hops);
+  } else if (OP_HAS_FIELD(a->kind)) {
+    return (a->field == b->field);
+  } else if (OP_HAS_HINT(a->kind)) {
+    if ((a->hint == NULL) || (b->hint == NULL)) {
+      return (a->hint == b->hint);
+    } else {
+      return (strcmp(a->hint, b->hint) == 0);
+    }
+  } else if (OP_HAS_TAG(a->kind)) {
+    return (a->tag == b->tag);
+  } else if (OP_HAS_INTRINSIC(a->kind)) {
+    return (a->intrinsic == b->intrinsic);
+  } else if (OP_HAS_IMAGE_MAP(a->kind)) {
+    const image_map_t *ma = a->image_map;
+    const image_map_t *mb = b->image_map;
+
+    if ((ma->name != mb->name) || (ma->kind != mb->kind)
+        || (ma->nelems != mb->nelems)) {
+      return (false);
+    }
+
+    for (size_t i = 0; i < ma->nelems; i++) {
+      if (ma->elems[i] != mb->elems[i]) {
+        return (false);
+      } else if ((ma->values != NULL) && (ma->values[i] != mb->values[i])) {
+        return (false);
+      }
+    }
+
+    return (true);
+  } else {
+    return (true);
+  }
+} /* vcode_op_equivalent() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+vcode_opt_apply_subst (
+  const vcode_reg_t *subst
+) {
+  for (int i = 0; i < active_unit->blocks.count; i++) {
+    block_t *b = &(active_unit->blocks.items[i]);
+    for (int j = 0; j < b->ops.count; j++) {
+      op_t *o = &(b->ops.items[j]);
+      for (int k = 0; k < o->args.count; k++) {
+        o->args.items[k] = vcode_opt_resolve(subst, o->args.items[k]);
+      }
+    }
+  }
+} /* vcode_opt_apply_subst() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+vcode_opt_avail_init (
+  vcode_avail_table_t *tab
+) {
+  const int size = next_power_of_2(MAX(active_unit->regs.count, 16));
+
+  memset(tab, '\0', sizeof(vcode_avail_table_t));
+  tab->entries =
+    xmalloc(MAX(vcode_opt_count_ops(), 1) * sizeof(vcode_avail_t));
+  tab->mask = size - 1;
+  tab->heads = xmalloc(size * sizeof(int));
+  for (int i = 0; i < size; i++) {
+    tab->heads[i] = -1;
+  }
+} /* vcode_opt_avail_init() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+vcode_opt_avail_leave (
+  int   mark,
+  void *ctx
+) {
+  vcode_avail_table_t *tab = ctx;
+
+  while (tab->count > mark) {
+    const vcode_avail_t *e = &(tab->entries[--(tab->count)]);
+    tab->heads[e->hash & tab->mask] = e->chain;
+  }
+} /* vcode_opt_avail_leave() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+vcode_opt_avail_push (
+  vcode_avail_table_t *tab,
+  op_t                *op,
+  int                  block,
+  uint32_t             hash
+) {
+  const int index = tab->count++;
+
+  vcode_avail_t *e = &(tab->entries[index]);
+  e->op = op;
+  e->block = block;
+  e->hash = hash;
+  e->chain = tab->heads[hash & tab->mask];
+
+  tab->heads[hash & tab->mask] = index;
+} /* vcode_opt_avail_push() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+vcode_opt_cfg_free (
+  vcode_cfg_t *cfg
+) {
+  free(cfg->root);
+  free(cfg->pred_base);
+  free(cfg->preds);
+  free(cfg->idom);
+  free(cfg->rpo);
+  free(cfg->child_base);
+  free(cfg->children);
+} /* vcode_opt_cfg_free() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+vcode_opt_cfg_new (
+  vcode_cfg_t *cfg
+) {
+  // Build the control flow graph and dominator tree for the active unit
+  // using the algorithm from Cooper, Harvey, and Kennedy. Execution can
+  // enter a unit at block zero, the start block of a process, or any
+  // block that is resumed after a wait or procedure call: these are the
+  // successors of a virtual entry block numbered after all the others
+
+  const int nblocks = active_unit->blocks.count;
+  const int entry = nblocks;
+
+  cfg->nblocks = nblocks;
+  cfg->root = xcalloc((nblocks + 1) * sizeof(bool));
+
+  if (nblocks > 0) {
+    cfg->root[0] = true;
+  }
+  if ((active_unit->kind == VCODE_UNIT_PROCESS) && (nblocks > 1)) {
+    cfg->root[1] = true;
+  }
+
+  int *npreds LOCAL = xcalloc((nblocks + 1) * sizeof(int));
+
+  for (int i = 0; i < nblocks; i++) {
+    const block_t *b = &(active_unit->blocks.items[i]);
+    const vcode_block_array_t *succs = vcode_opt_successors(b);
+    if (succs == NULL) {
+      continue;
+    }
+
+    const vcode_op_t kind = b->ops.items[b->ops.count - 1].kind;
+    if ((kind == VCODE_OP_WAIT) || (kind == VCODE_OP_PCALL) ||
+      (kind == VCODE_OP_NESTED_PCALL)) {
+      cfg->root[succs->items[0]] = true;
+    }
+
+    for (int j = 0; j < succs->count; j++) {
+      npreds[succs->items[j]]++;
+    }
+  }
+
+  for (int i = 0; i < nblocks; i++) {
+    if (cfg->root[i]) {
+      npreds[i]++;
+    }
+  }
+
+  cfg->pred_base = xmalloc((nblocks + 2) * sizeof(int));
+  cfg->pred_base[0] = 0;
+  for (int i = 0; i <= nblocks; i++) {
+    cfg->pred_base[i + 1] = cfg->pred_base[i] + npreds[i];
+    npreds[i] = cfg->pred_base[i];
+  }
+
+  cfg->preds = xmalloc((cfg->pred_base[nblocks + 1] + 1) * sizeof(int));
+  for (int i = 0; i < nblocks; i++) {
+    if (cfg->root[i]) {
+      cfg->preds[npreds[i]++] = entry;
+    }
+
+    const vcode_block_array_t *succs =
+      vcode_opt_successors(&(active_unit->blocks.items[i]));
+    if (succs != NULL) {
+      for (int j = 0; j < succs->count; j++) {
+        cfg->preds[npreds[succs->items[j]]++] = i;
+      }
+    }
+  }
+
+  // Depth first search from the virtual entry block
+
+  int *stack LOCAL = xmalloc((nblocks + 1) * sizeof(int));
+  int *cursor LOCAL = xcalloc((nblocks + 1) * sizeof(int));
+  int *post LOCAL = xmalloc((nblocks + 1) * sizeof(int));
+  bool *visited LOCAL = xcalloc((nblocks + 1) * sizeof(bool));
+  int sp = 0, npost = 0;
+
+  stack[sp++] = entry;
+  visited[entry] = true;
+
+  while (sp > 0) {
+    const int b = stack[sp - 1];
+    int next = -1;
+
+    if (b == entry) {
+      while ((next == -1) && (cursor[b] < nblocks)) {
+        const int r = cursor[b]++;
+        if (cfg->root[r] && !visited[r]) {
+          next = r;
+        }
+      }
+    } else {
+      const vcode_block_array_t *succs =
+        vcode_opt_successors(&(active_unit->blocks.items[b]));
+      const int nsuccs = (succs != NULL) ? succs->count : 0;
+      while ((next == -1) && (cursor[b] < nsuccs)) {
+        const int s = succs->items[cursor[b]++];
+        if (!visited[s]) {
+          next = s;
+        }
+      }
+    }
+
+    if (next == -1) {
+      post[npost++] = stack[--sp];
+    } else {
+      visited[next] = true;
+      stack[sp++] = next;
+    }
+  }
+
+  // The entry block is always first in reverse post-order
+  cfg->nrpo = npost;
+  cfg->rpo = xmalloc(npost * sizeof(int));
+  for (int i = 0; i < npost; i++) {
+    cfg->rpo[i] = post[npost - i - 1];
+  }
+
+  int *order LOCAL = xmalloc((nblocks + 1) * sizeof(int));
+  for (int i = 0; i < npost; i++) {
+    order[cfg->rpo[i]] = i;
+  }
+
+  cfg->idom = xmalloc((nblocks + 1) * sizeof(int));
+  for (int i = 0; i < nblocks; i++) {
+    cfg->idom[i] = -1;
+  }
+  cfg->idom[entry] = entry;
+
+  bool changed;
+  do {
+    changed = false;
+    for (int i = 1; i < cfg->nrpo; i++) {
+      const int b = cfg->rpo[i];
+      int new_idom = -1;
+      for (int j = cfg->pred_base[b]; j < cfg->pred_base[b + 1]; j++) {
+        int p = cfg->preds[j];
+        if (cfg->idom[p] == -1) {
+          continue;
+        } else if (new_idom == -1) {
+          new_idom = p;
+        } else {
+          int q = new_idom;
+          while (p != q) {
+            while (order[p] > order[q]) {
+              p = cfg->idom[p];
+            }
+            while (order[q] > order[p]) {
+              q = cfg->idom[q];
+            }
+          }
+          new_idom = p;
+        }
+      }
+
+      if (cfg->idom[b] != new_idom) {
+        cfg->idom[b] = new_idom;
+        changed = true;
+      }
+    }
+  } while (changed);
+
+  // Children in the dominator tree are listed in reverse post-order so
+  // definitions are visited before their uses
+
+  memset(npreds, '\0', (nblocks + 1) * sizeof(int));
+  for (int i = 1; i < cfg->nrpo; i++) {
+    npreds[cfg->idom[cfg->rpo[i]]]++;
+  }
+
+  cfg->child_base = xmalloc((nblocks + 2) * sizeof(int));
+  cfg->child_base[0] = 0;
+  for (int i = 0; i <= nblocks; i++) {
+    cfg->child_base[i + 1] = cfg->child_base[i] + npreds[i];
+    npreds[i] = cfg->child_base[i];
+  }
+
+  cfg->children = xmalloc(MAX(cfg->nrpo, 1) * sizeof(int));
+  for (int i = 1; i < cfg->nrpo; i++) {
+    const int b = cfg->rpo[i];
+    cfg->children[npreds[cfg->idom[b]]++] = b;
+  }
+} /* vcode_opt_cfg_new() */
+
+/* ------------------------------------------------------------------------- */
+
+static bool
+vcode_opt_check_redundant (
+  const op_t *o
+) {
+  switch (o->kind)
+  {
+    case VCODE_OP_BOUNDS:
+      {
+        const vcode_reg_t reg = o->args.items[0];
+        return ((vtype_kind(o->type) == VCODE_TYPE_INT) &&
+               (vcode_reg_kind(reg) == VCODE_TYPE_INT) &&
+               vtype_includes(o->type, vcode_reg_data(reg)->bounds));
+      }
+
+    case VCODE_OP_DYNAMIC_BOUNDS:
+      {
+        const vcode_reg_t reg = o->args.items[0];
+        const vcode_reg_t rlow = o->args.items[1];
+        const vcode_reg_t rhigh = o->args.items[2];
+        if ((reg == rlow) || (reg == rhigh)) {
+          return (vcode_range_not_null(rlow, rhigh));
+        }
+
+        int64_t lconst, hconst;
+        if (!vcode_reg_const(o->args.items[1], &lconst) ||
+          !vcode_reg_const(o->args.items[2], &hconst) ||
+          (vcode_reg_kind(reg) != VCODE_TYPE_INT)) {
+          return (false);
+        }
+
+        const vcode_type_t bounds = vcode_reg_bounds(reg);
+        return ((lconst <= vtype_low(bounds)) &&
+               (hconst >= vtype_high(bounds)));
+      }
+
+    case VCODE_OP_INDEX_CHECK:
+      {
+        const vcode_reg_t rlow = o->args.items[0];
+        const vcode_reg_t rhigh = o->args.items[1];
+
+        int64_t lconst, hconst;
+        if (vcode_reg_const(rlow, &lconst) && vcode_reg_const(rhigh, &hconst)
+          && (hconst < lconst)) {
+          return (true);    // Null range always passes
+        } else if (o->args.count == 2) {
+          return (vtype_includes(o->type, vcode_reg_data(rlow)->bounds) &&
+                 vtype_includes(o->type, vcode_reg_data(rhigh)->bounds));
+        }
+
+        int64_t bmin, bmax;
+        if (!vcode_reg_const(o->args.items[2], &bmin) ||
+          !vcode_reg_const(o->args.items[3], &bmax)) {
+          return (false);
+        }
+
+        const vtype_t *lb = vcode_type_data(vcode_reg_data(rlow)->bounds);
+        const vtype_t *hb = vcode_type_data(vcode_reg_data(rhigh)->bounds);
+        return ((lb->kind == VCODE_TYPE_INT) && (hb->kind == VCODE_TYPE_INT) &&
+               (lb->low >= bmin) && (lb->high <= bmax) &&
+               (hb->low >= bmin) && (hb->high <= bmax));
+      }
+
+    default:
+      {
+        return (false);
+      }
+  }
+} /* vcode_opt_check_redundant() */
+
+/* ------------------------------------------------------------------------- */
+
+static int
+vcode_opt_checks (
+  void
+) {
+  // Remove bounds and index checks that are implied by the bounds of
+  // their arguments or by an identical check in a dominating block
+
+  vcode_cfg_t cfg;
+  vcode_opt_cfg_new(&cfg);
+
+  vcode_checks_ctx_t ctx;
+  vcode_opt_avail_init(&(ctx.avail));
+  ctx.removed = 0;
+
+  vcode_opt_walk(&cfg, vcode_opt_checks_enter, vcode_opt_avail_leave, &ctx);
+
+  free(ctx.avail.heads);
+  free(ctx.avail.entries);
+  vcode_opt_cfg_free(&cfg);
+
+  vcode_opt_compact();
+
+  return (ctx.removed);
+} /* vcode_opt_checks() */
+
+/* ------------------------------------------------------------------------- */
+
+static int
+vcode_opt_checks_enter (
+  int   block,
+  void *arg
+) {
+  vcode_checks_ctx_t *ctx = arg;
+  const int mark = ctx->avail.count;
+
+  block_t *b = &(active_unit->blocks.items[block]);
+  for (int i = 0; i < b->ops.count; i++) {
+    op_t *o = &(b->ops.items[i]);
+
+    if ((o->kind != VCODE_OP_BOUNDS) && (o->kind != VCODE_OP_INDEX_CHECK) &&
+      (o->kind != VCODE_OP_DYNAMIC_BOUNDS)) {
+      continue;
+    } else if (vcode_opt_check_redundant(o)) {
+      vcode_opt_kill(o);
+      ctx->removed++;
+      continue;
+    }
+
+    // The kind argument to a dynamic bounds check only affects the
+    // error message
+    const int nargs =
+      (o->kind == VCODE_OP_DYNAMIC_BOUNDS) ? 3 : o->args.count;
+
+    uint32_t hash = o->kind;
+    for (int j = 0; j < nargs; j++) {
+      hash = (hash * 31) + o->args.items[j];
+    }
+
+    bool dominated = false;
+    for (int e = ctx->avail.heads[hash & ctx->avail.mask];
+      (e != -1) && !dominated; e = ctx->avail.entries[e].chain) {
+      const op_t *other = ctx->avail.entries[e].op;
+      if ((other->kind != o->kind) || (other->args.count != o->args.count)) {
+        continue;
+      }
+
+      bool same = true;
+      for (int j = 0; (j < nargs) && same; j++) {
+        same = (other->args.items[j] == o->args.items[j]);
+      }
+
+      if (!same) {
+        continue;
+      } else if (o->kind == VCODE_OP_DYNAMIC_BOUNDS) {
+        dominated = true;
+      } else if ((o->kind == VCODE_OP_INDEX_CHECK) && (o->args.count == 4)) {
+        dominated = true;
+      } else {
+        dominated = (vtype_kind(o->type) == VCODE_TYPE_INT) &&
+          vtype_includes(o->type, other->type);
+      }
+    }
+
+    if (dominated) {
+      vcode_opt_kill(o);
+      ctx->removed++;
+    } else {
+      vcode_opt_avail_push(&(ctx->avail), o, block, hash);
+    }
+  }
+
+  return (mark);
+} /* vcode_opt_checks_enter() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+vcode_opt_compact (
+  void
+) {
+  // Remove ops that were deleted by an optimisation pass
+
+  for (int i = active_unit->blocks.count - 1; i >= 0; i--) {
+    block_t *b = &(active_unit->blocks.items[i]);
+    op_t *dst = &(b->ops.items[0]);
+    size_t copied = 0;
+    for (int j = 0; j < b->ops.count; j++) {
+      const op_t *src = &(b->ops.items[j]);
+      if (src->kind != (vcode_op_t) -1) {
+        if (src != dst) {
+          assert(dst < src);
+          *dst = *src;
+        }
+        dst++;
+        copied++;
+      }
+    }
+
+    assert(copied <= b->ops.count);
+    b->ops.count = copied;
+  }
+} /* vcode_opt_compact() */
+
+/* ------------------------------------------------------------------------- */
+
+static int
+vcode_opt_count_ops (
+  void
+) {
+  int count = 0;
+  for (int i = 0; i < active_unit->blocks.count; i++) {
+    count += active_unit->blocks.items[i].ops.count;
+  }
+
+  return (count);
+} /* vcode_opt_count_ops() */
+
+/* ------------------------------------------------------------------------- */
+
+static int
+vcode_opt_cse (
+  void
+) {
+  // Replace pure operations with the result of an identical operation
+  // in a dominating block
+
+  vcode_cfg_t cfg;
+  vcode_opt_cfg_new(&cfg);
+
+  vcode_cse_ctx_t ctx;
+  vcode_opt_avail_init(&(ctx.avail));
+  ctx.subst = xmalloc(active_unit->regs.count * sizeof(vcode_reg_t));
+  ctx.defblock = vcode_opt_def_blocks();
+  ctx.replaced = 0;
+
+  for (int i = 0; i < active_unit->regs.count; i++) {
+    ctx.subst[i] = VCODE_INVALID_REG;
+  }
+
+  vcode_opt_walk(&cfg, vcode_opt_cse_enter, vcode_opt_avail_leave, &ctx);
+
+  if (ctx.replaced > 0) {
+    vcode_opt_apply_subst(ctx.subst);
+    vcode_opt_compact();
+  }
+
+  free(ctx.avail.heads);
+  free(ctx.avail.entries);
+  free(ctx.subst);
+  free(ctx.defblock);
+  vcode_opt_cfg_free(&cfg);
+
+  return (ctx.replaced);
+} /* vcode_opt_cse() */
+
+/* ------------------------------------------------------------------------- */
+
+static int
+vcode_opt_cse_enter (
+  int   block,
+  void *arg
+) {
+  vcode_cse_ctx_t *ctx = arg;
+  const int mark = ctx->avail.count;
+
+  block_t *b = &(active_unit->blocks.items[block]);
+  for (int i = 0; i < b->ops.count; i++) {
+    op_t *o = &(b->ops.items[i]);
+
+    for (int j = 0; j < o->args.count; j++) {
+      o->args.items[j] = vcode_opt_resolve(ctx->subst, o->args.items[j]);
+    }
+
+    switch (o->kind)
+    {
+      case VCODE_OP_CONST:
+      case VCODE_OP_CONST_REAL:
+      case VCODE_OP_ADD:
+      case VCODE_OP_ADDI:
+      case VCODE_OP_SUB:
+      case VCODE_OP_MUL:
+      case VCODE_OP_DIV:
+      case VCODE_OP_MOD:
+      case VCODE_OP_REM:
+      case VCODE_OP_EXP:
+      case VCODE_OP_NEG:
+      case VCODE_OP_ABS:
+      case VCODE_OP_CMP:
+      case VCODE_OP_CAST:
+      case VCODE_OP_NOT:
+      case VCODE_OP_AND:
+      case VCODE_OP_OR:
+      case VCODE_OP_XOR:
+      case VCODE_OP_XNOR:
+      case VCODE_OP_NAND:
+      case VCODE_OP_NOR:
+      case VCODE_OP_SELECT:
+      case VCODE_OP_UARRAY_LEFT:
+      case VCODE_OP_UARRAY_RIGHT:
+      case VCODE_OP_UARRAY_DIR:
+      case VCODE_OP_UARRAY_LEN:
+      case VCODE_OP_UNWRAP:
+      case VCODE_OP_WRAP:
+      case VCODE_OP_RECORD_REF:
+      case VCODE_OP_INDEX:
+      case VCODE_OP_RANGE_NULL:
+        break;
+
+      default:
+        continue;
+    }
+
+    uint32_t hash = o->kind;
+    for (int j = 0; j < o->args.count; j++) {
+      hash = (hash * 31) + o->args.items[j];
+    }
+    if (OP_HAS_VALUE(o->kind)) {
+      hash = (hash * 31) + (uint32_t) o->value;
+    }
+
+    const op_t *found = NULL;
+    for (int e = ctx->avail.heads[hash & ctx->avail.mask];
+      (e != -1) && (found == NULL); e = ctx->avail.entries[e].chain) {
+      const vcode_avail_t *a = &(ctx->avail.entries[e]);
+      // Registers must be defined in a block numbered no higher than
+      // their uses for the pruning pass
+      if ((a->block <= block) && vcode_opt_same_op(a->op, o)) {
+        found = a->op;
+      }
+    }
+
+    if (found != NULL) {
+      ctx->subst[o->result] = found->result;
+      vcode_opt_kill(o);
+      ctx->replaced++;
+    } else {
+      vcode_opt_avail_push(&(ctx->avail), o, block, hash);
+    }
+  }
+
+  return (mark);
+} /* vcode_opt_cse_enter() */
+
+/* ------------------------------------------------------------------------- */
+
+static int
+vcode_opt_dead_blocks (
+  void
+) {
+  // Delete blocks that are not reachable from any entry point and
+  // renumber the remaining blocks preserving their order
+
+  vcode_cfg_t cfg;
+  vcode_opt_cfg_new(&cfg);
+
+  const int nblocks = active_unit->blocks.count;
+
+  bool *live LOCAL = xcalloc((nblocks + 1) * sizeof(bool));
+  for (int i = 0; i < cfg.nrpo; i++) {
+    live[cfg.rpo[i]] = true;
+  }
+
+  vcode_opt_cfg_free(&cfg);
+
+  int *map LOCAL = xmalloc(nblocks * sizeof(int));
+  int nlive = 0;
+  for (int i = 0; i < nblocks; i++) {
+    map[i] = live[i] ? nlive++ : VCODE_INVALID_BLOCK;
+  }
+
+  if (nlive == nblocks) {
+    return (0);
+  }
+
+  for (int i = 0; i < nblocks; i++) {
+    block_t *b = &(active_unit->blocks.items[i]);
+    if (!live[i]) {
+      for (int j = 0; j < b->ops.count; j++) {
+        vcode_opt_kill(&(b->ops.items[j]));
+      }
+      free(b->ops.items);
+      continue;
+    }
+
+    for (int j = 0; j < b->ops.count; j++) {
+      op_t *o = &(b->ops.items[j]);
+      if (OP_HAS_TARGET(o->kind)) {
+        for (int k = 0; k < o->targets.count; k++) {
+          o->targets.items[k] = map[o->targets.items[k]];
+          assert(o->targets.items[k] != VCODE_INVALID_BLOCK);
+        }
+      }
+    }
+
+    active_unit->blocks.items[map[i]] = *b;
+  }
+
+  active_unit->blocks.count = nlive;
+
+  if (active_block != VCODE_INVALID_BLOCK) {
+    active_block = map[active_block];
+  }
+
+  return (nblocks - nlive);
+} /* vcode_opt_dead_blocks() */
+
+/* ------------------------------------------------------------------------- */
+
+static int *
+vcode_opt_def_blocks (
+  void
+) {
+  // Map each register to the block containing its definition or -1 for
+  // parameters
+
+  int *defblock = xmalloc(MAX(active_unit->regs.count, 1) * sizeof(int));
+  for (int i = 0; i < active_unit->regs.count; i++) {
+    defblock[i] = -1;
+  }
+
+  for (int i = 0; i < active_unit->blocks.count; i++) {
+    const block_t *b = &(active_unit->blocks.items[i]);
+    for (int j = 0; j < b->ops.count; j++) {
+      const vcode_reg_t result = b->ops.items[j].result;
+      if (result != VCODE_INVALID_REG) {
+        defblock[result] = i;
+      }
+    }
+  }
+
+  return (defblock);
+} /* vcode_opt_def_blocks() */
+
+/* ------------------------------------------------------------------------- */
+
+static int
+vcode_opt_fold (
+  void
+) {
+  // Propagate and fold constants and resolve branches on constant
+  // conditions: registers are always defined in a block numbered no
+  // higher than their uses so a single forward scan is sufficient
+
+  vcode_reg_t *subst LOCAL =
+    xmalloc(MAX(active_unit->regs.count, 1) * sizeof(vcode_reg_t));
+  for (int i = 0; i < active_unit->regs.count; i++) {
+    subst[i] = VCODE_INVALID_REG;
+  }
+
+  int folded = 0, replaced = 0;
+
+  for (int i = 0; i < active_unit->blocks.count; i++) {
+    block_t *b = &(active_unit->blocks.items[i]);
+    for (int j = 0; j < b->ops.count; j++) {
+      op_t *o = &(b->ops.items[j]);
+
+      for (int k = 0; k < o->args.count; k++) {
+        o->args.items[k] = vcode_opt_resolve(subst, o->args.items[k]);
+      }
+
+      int64_t value, tconst = 0;
+      if (vcode_opt_fold_op(o, &value)) {
+        const vcode_type_t type = vcode_reg_type(o->result);
+        const vcode_reg_t result = o->result;
+
+        vcode_opt_kill(o);
+        o->kind = VCODE_OP_CONST;
+        o->result = result;
+        o->type = type;
+        o->value = value;
+
+        vcode_reg_data(result)->bounds = vtype_int(value, value);
+        folded++;
+      } else if ((o->kind == VCODE_OP_SELECT) &&
+        (vcode_reg_const(o->args.items[0], &tconst) ||
+        (o->args.items[1] == o->args.items[2]))) {
+        const vcode_reg_t chosen =
+          (o->args.items[1] == o->args.items[2] || !!tconst)
+          ? o->args.items[1] : o->args.items[2];
+
+        subst[o->result] = chosen;
+        vcode_opt_kill(o);
+        replaced++;
+      } else if ((o->kind == VCODE_OP_ASSERT) &&
+        vcode_reg_const(o->args.items[0], &tconst) && (tconst != 0)) {
+        vcode_opt_kill(o);    // Always true assertion
+        folded++;
+      } else if ((o->kind == VCODE_OP_COND) &&
+        vcode_reg_const(o->args.items[0], &tconst)) {
+        const vcode_block_t target = o->targets.items[!!tconst ? 0 : 1];
+
+        vcode_reg_array_resize(&(o->args), 0, VCODE_INVALID_REG);
+        o->kind = VCODE_OP_JUMP;
+        o->targets.items[0] = target;
+        o->targets.count = 1;
+        folded++;
+      } else if ((o->kind == VCODE_OP_CASE) &&
+        vcode_reg_const(o->args.items[0], &tconst)) {
+        vcode_block_t target = o->targets.items[0];
+        bool known = true;
+        for (int k = 1; (k < o->args.count) && known; k++) {
+          int64_t cconst;
+          if (!vcode_reg_const(o->args.items[k], &cconst)) {
+            known = false;
+          } else if (cconst == tconst) {
+            target = o->targets.items[k];
+            break;
+          }
+        }
+
+        if (known) {
+          vcode_reg_array_resize(&(o->args), 0, VCODE_INVALID_REG);
+          o->kind = VCODE_OP_JUMP;
+          o->targets.items[0] = target;
+          o->targets.count = 1;
+          folded++;
+        }
+      }
+    }
+  }
+
+  if (replaced > 0) {
+    vcode_opt_apply_subst(subst);
+  }
+
+  vcode_opt_compact();
+
+  return (folded + replaced);
+} /* vcode_opt_fold() */
+
+/* ------------------------------------------------------------------------- */
+
+static bool
+vcode_opt_fold_op (
+  const op_t *o,
+  int64_t    *value
+) {
+  if (o->result == VCODE_INVALID_REG) {
+    return (false);
+  }
+
+  const vtype_kind_t rkind = vcode_reg_kind(o->result);
+  if ((rkind != VCODE_TYPE_INT) && (rkind != VCODE_TYPE_OFFSET)) {
+    return (false);
+  }
+
+  int64_t l = 0, r = 0;
+  const bool l_const =
+    (o->args.count > 0) && vcode_reg_const(o->args.items[0], &l);
+  const bool r_const =
+    (o->args.count > 1) && vcode_reg_const(o->args.items[1], &r);
+
+  switch (o->kind)
+  {
+    case VCODE_OP_ADD:
+      {
+        return (l_const && r_const && !__builtin_add_overflow(l, r, value));
+      }
+
+    case VCODE_OP_ADDI:
+      {
+        return (l_const && !__builtin_add_overflow(l, o->value, value));
+      }
+
+    case VCODE_OP_SUB:
+      {
+        return (l_const && r_const && !__builtin_sub_overflow(l, r, value));
+      }
+
+    case VCODE_OP_MUL:
+      {
+        return (l_const && r_const && !__builtin_mul_overflow(l, r, value));
+      }
+
+    case VCODE_OP_NEG:
+      {
+        return (l_const && !__builtin_sub_overflow(0, l, value));
+      }
+
+    case VCODE_OP_CAST:
+      {
+        const vcode_type_t from_type = vcode_reg_type(o->args.items[0]);
+        const vtype_kind_t from = vtype_kind(from_type);
+        if (!l_const ||
+          ((from != VCODE_TYPE_INT) && (from != VCODE_TYPE_OFFSET))) {
+          return (false);
+        }
+
+        // The generated code truncates or extends to the width of the
+        // result type: only fold values that survive this unchanged
+        if ((l < vtype_low(from_type)) || (l > vtype_high(from_type)) ||
+          (l < vtype_low(o->type)) || (l > vtype_high(o->type))) {
+          return (false);
+        }
+
+        *value = l;
+        return (true);
+      }
+
+    case VCODE_OP_CMP:
+      {
+        if (!l_const || !r_const) {
+          return (false);
+        }
+
+        switch (o->cmp)
+        {
+          case VCODE_CMP_EQ:  *value = (l == r); return (true);
+          case VCODE_CMP_NEQ: *value = (l != r); return (true);
+          case VCODE_CMP_LT:  *value = (l < r);  return (true);
+          case VCODE_CMP_GT:  *value = (l > r);  return (true);
+          case VCODE_CMP_LEQ: *value = (l <= r); return (true);
+          case VCODE_CMP_GEQ: *value = (l >= r); return (true);
+          default:            return (false);
+        }
+      }
+
+    case VCODE_OP_NOT:
+      {
+        if (l_const && ((l == 0) || (l == 1))) {
+          *value = !l;
+          return (true);
+        }
+
+        return (false);
+      }
+
+    case VCODE_OP_AND:
+    case VCODE_OP_OR:
+    case VCODE_OP_XOR:
+    case VCODE_OP_XNOR:
+    case VCODE_OP_NAND:
+    case VCODE_OP_NOR:
+      {
+        if (!l_const || !r_const || (l & ~1) || (r & ~1)) {
+          return (false);
+        }
+
+        switch (o->kind)
+        {
+          case VCODE_OP_AND:  *value = l & r;    break;
+          case VCODE_OP_OR:   *value = l | r;    break;
+          case VCODE_OP_XOR:  *value = l ^ r;    break;
+          case VCODE_OP_XNOR: *value = !(l ^ r); break;
+          case VCODE_OP_NAND: *value = !(l & r); break;
+          default:            *value = !(l | r); break;
+        }
+
+        return (true);
+      }
+
+    default:
+      {
+        return (false);
+      }
+  }
+} /* vcode_opt_fold_op() */
+
+/* ------------------------------------------------------------------------- */
+
+static int
+vcode_opt_forward (
+  void
+) {
+  // Forward values stored to or loaded from local variables to later
+  // loads in the same extended basic block: this extends the forwarding
+  // in emit_load across blocks that have a single predecessor
+
+  const int nvars = active_unit->vars.count;
+  if (nvars == 0) {
+    return (0);
+  }
+
+  vcode_cfg_t cfg;
+  vcode_opt_cfg_new(&cfg);
+
+  vcode_fwd_ctx_t ctx;
+  memset(&ctx, '\0', sizeof(ctx));
+  ctx.cfg = &cfg;
+  ctx.avail = xcalloc(nvars * sizeof(vcode_fwd_t));
+  ctx.aliased = xcalloc(nvars * sizeof(bool));
+  ctx.subst = xmalloc(MAX(active_unit->regs.count, 1) * sizeof(vcode_reg_t));
+  ctx.defblock = vcode_opt_def_blocks();
+  ctx.gen = ctx.maxgen = 1;
+
+  // Each op and block pushes at most one entry on the undo log
+  ctx.undo = xmalloc((vcode_opt_count_ops() + active_unit->blocks.count + 1)
+    * sizeof(vcode_fwd_undo_t));
+  ctx.calls_clobber = (active_unit->kind == VCODE_UNIT_CONTEXT);
+
+  for (int i = 0; i < active_unit->regs.count; i++) {
+    ctx.subst[i] = VCODE_INVALID_REG;
+  }
+
+  // Variables whose address is taken may be modified through a pointer
+  for (int i = 0; i < active_unit->blocks.count; i++) {
+    const block_t *b = &(active_unit->blocks.items[i]);
+    for (int j = 0; j < b->ops.count; j++) {
+      const op_t *o = &(b->ops.items[j]);
+      if ((o->kind == VCODE_OP_INDEX) &&
+        (MASK_CONTEXT(o->address) == active_unit->depth)) {
+        ctx.aliased[MASK_INDEX(o->address)] = true;
+      }
+    }
+  }
+
+  vcode_opt_walk(&cfg, vcode_opt_forward_enter, vcode_opt_forward_leave,
+    &ctx);
+
+  if (ctx.forwarded > 0) {
+    vcode_opt_apply_subst(ctx.subst);
+    vcode_opt_compact();
+  }
+
+  free(ctx.avail);
+  free(ctx.aliased);
+  free(ctx.subst);
+  free(ctx.defblock);
+  free(ctx.undo);
+  vcode_opt_cfg_free(&cfg);
+
+  return (ctx.forwarded);
+} /* vcode_opt_forward() */
+
+/* ------------------------------------------------------------------------- */
+
+static int
+vcode_opt_forward_enter (
+  int   block,
+  void *arg
+) {
+  vcode_fwd_ctx_t *ctx = arg;
+  const int mark = ctx->nundo;
+
+  const vcode_cfg_t *cfg = ctx->cfg;
+  const int npreds = cfg->pred_base[block + 1] - cfg->pred_base[block];
+
+  if (cfg->root[block] || (npreds != 1)) {
+    vcode_opt_forward_reset(ctx);
+  }
+
+  block_t *b = &(active_unit->blocks.items[block]);
+  for (int i = 0; i < b->ops.count; i++) {
+    op_t *o = &(b->ops.items[i]);
+
+    for (int j = 0; j < o->args.count; j++) {
+      o->args.items[j] = vcode_opt_resolve(ctx->subst, o->args.items[j]);
+    }
+
+    switch (o->kind)
+    {
+      case VCODE_OP_LOAD:
+      case VCODE_OP_STORE:
+      case VCODE_OP_RESOLVED_ADDRESS:
+        {
+          if (MASK_CONTEXT(o->address) != active_unit->depth) {
+            break;
+          }
+
+          const int var = MASK_INDEX(o->address);
+          if (ctx->aliased[var]) {
+            break;
+          }
+
+          vcode_reg_t value = VCODE_INVALID_REG;
+          if (o->kind == VCODE_OP_STORE) {
+            value = o->args.items[0];
+          } else if (o->kind == VCODE_OP_LOAD) {
+            const vcode_fwd_t *a = &(ctx->avail[var]);
+            if ((a->gen == ctx->gen) && (a->reg != VCODE_INVALID_REG) &&
+              (ctx->defblock[a->reg] <= block) &&
+              vtype_eq(vcode_reg_type(a->reg), vcode_reg_type(o->result))) {
+              ctx->subst[o->result] = a->reg;
+              vcode_opt_kill(o);
+              ctx->forwarded++;
+              break;
+            }
+
+            value = o->result;
+          }
+
+          vcode_fwd_undo_t *u = &(ctx->undo[ctx->nundo++]);
+          u->var = var;
+          u->old = ctx->avail[var];
+
+          ctx->avail[var].reg = value;
+          ctx->avail[var].gen = ctx->gen;
+        }
+        break;
+
+      case VCODE_OP_NESTED_FCALL:
+      case VCODE_OP_NESTED_PCALL:
+      case VCODE_OP_NESTED_RESUME:
+        {
+          // Nested call captures variables
+          vcode_opt_forward_reset(ctx);
+        }
+        break;
+
+      case VCODE_OP_FCALL:
+      case VCODE_OP_PCALL:
+      case VCODE_OP_RESUME:
+      case VCODE_OP_INTRINSIC:
+        {
+          // Any subprogram may modify shared variables in a package
+          if (ctx->calls_clobber) {
+            vcode_opt_forward_reset(ctx);
+          }
+        }
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  return (mark);
+} /* vcode_opt_forward_enter() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+vcode_opt_forward_leave (
+  int   mark,
+  void *arg
+) {
+  vcode_fwd_ctx_t *ctx = arg;
+
+  while (ctx->nundo > mark) {
+    const vcode_fwd_undo_t *u = &(ctx->undo[--(ctx->nundo)]);
+    if (u->var == -1) {
+      ctx->gen = u->old.gen;
+    } else {
+      ctx->avail[u->var] = u->old;
+    }
+  }
+} /* vcode_opt_forward_leave() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+vcode_opt_forward_reset (
+  vcode_fwd_ctx_t *ctx
+) {
+  // Invalidate all available values by starting a new generation
+
+  vcode_fwd_undo_t *u = &(ctx->undo[ctx->nundo++]);
+  u->var = -1;
+  u->old.reg = VCODE_INVALID_REG;
+  u->old.gen = ctx->gen;
+
+  ctx->gen = ++(ctx->maxgen);
+} /* vcode_opt_forward_reset() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+vcode_opt_kill (
+  op_t *o
+) {
+  if (OP_HAS_COMMENT(o->kind)) {
+    free(o->comment);
+  }
+  if (OP_HAS_HINT(o->kind)) {
+    free(o->hint);
+  }
+
+  free(o->args.items);
+  o->args.items = NULL;
+  o->args.count = 0;
+
+  o->kind = (vcode_op_t) -1;
+  o->result = VCODE_INVALID_REG;
+} /* vcode_opt_kill() */
+
+/* ------------------------------------------------------------------------- */
+
+static int
+vcode_opt_prune (
+  void
+) {
+  // Prune assignments to unused registers
+
+  int *uses LOCAL = xmalloc(MAX(active_unit->regs.count, 1) * sizeof(int));
+
+  int pruned = 0, total = 0;
+
+  do {
+    memset(uses, '\0', active_unit->regs.count * sizeof(int));
+    pruned = 0;
+
+    for (int i = active_unit->blocks.count - 1; i >= 0; i--) {
+      block_t *b = &(active_unit->blocks.items[i]);
+
+      for (int j = b->ops.count - 1; j >= 0; j--) {
+        op_t *o = &(b->ops.items[j]);
+
+        switch (o->kind)
+        {
+          case VCODE_OP_FCALL:
+            {
+              if (o->result == VCODE_INVALID_REG) {
+                break;
+              }
+            }
+
+          case VCODE_OP_INTRINSIC:
+          case VCODE_OP_CONST:
+          case VCODE_OP_CONST_REAL:
+          case VCODE_OP_CONST_ARRAY:
+          case VCODE_OP_CONST_RECORD:
+          case VCODE_OP_LOAD:
+          case VCODE_OP_LOAD_INDIRECT:
+          case VCODE_OP_ADD:
+          case VCODE_OP_ADDI:
+          case VCODE_OP_SUB:
+          case VCODE_OP_MUL:
+          case VCODE_OP_CMP:
+          case VCODE_OP_INDEX:
+          case VCODE_OP_NETS:
+          case VCODE_OP_WRAP:
+          case VCODE_OP_VEC_LOAD:
+          case VCODE_OP_HEAP_SAVE:
+          case VCODE_OP_EXP:
+          case VCODE_OP_UNDEFINED:
+          case VCODE_OP_UARRAY_LEN:
+          case VCODE_OP_UARRAY_DIR:
+          case VCODE_OP_UARRAY_LEFT:
+          case VCODE_OP_UARRAY_RIGHT:
+          case VCODE_OP_UNWRAP:
+            {
+              if (uses[o->result] == -1) {
+                vcode_dump_with_mark(j);
+                fatal("defintion of r%d does not dominate all uses",
+                  o->result);
+              } else if (uses[o->result] == 0) {
+                if (o->kind == VCODE_OP_CONST) {
+                  o->kind = (vcode_op_t) -1;
+                } else {
+                  o->comment = xasprintf("Dead %s definition of r%d",
+                      vcode_op_string(o->kind),
+                      o->result);
+                  o->kind = VCODE_OP_COMMENT;
+                }
+                vcode_reg_array_resize(&(o->args), 0, VCODE_INVALID_REG);
+                pruned++;
+              }
+              uses[o->result] = -1;
+            }
+            break;
+
+          case VCODE_OP_STORAGE_HINT:
+            {
+              vcode_dump_with_mark(j);
+              fatal("Unused storage hint for r%d was not removed",
+                o->args.items[0]);
+            }
+            break;
+
+          default:
+            {
+            }
+            break;
+        }
+
+        for (int k = 0; k < o->args.count; k++) {
+          if (o->args.items[k] != VCODE_INVALID_REG) {
+            uses[o->args.items[k]]++;
+          }
+        }
+      }
+    }
+
+    total += pruned;
+  } while (pruned > 0);
+
+  vcode_opt_compact();
+
+  return (total);
+} /* vcode_opt_prune() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+vcode_opt_range_block (
+  vcode_range_ctx_t *ctx,
+  int                block,
+  bool               apply
+) {
+  // Compute intervals through one block starting from its entry state
+  // and merge the state at the end into each successor: if apply is
+  // set then remove checks that the intervals show cannot fail
+
+  vcode_range_set_t *in = &(ctx->in[block]);
+  memcpy(ctx->cur.items, in->items, in->count * sizeof(vcode_range_t));
+  ctx->cur.count = in->count;
+
+  block_t *b = &(active_unit->blocks.items[block]);
+  for (int i = 0; i < b->ops.count; i++) {
+    op_t *o = &(b->ops.items[i]);
+
+    switch (o->kind)
+    {
+      case VCODE_OP_BOUNDS:
+      case VCODE_OP_DYNAMIC_BOUNDS:
+      case VCODE_OP_INDEX_CHECK:
+        {
+          if (apply && vcode_opt_range_redundant(ctx, o)) {
+            vcode_opt_kill(o);
+            ctx->removed++;
+          }
+        }
+        break;
+
+      case VCODE_OP_STORE:
+      case VCODE_OP_RESOLVED_ADDRESS:
+        {
+          if ((MASK_CONTEXT(o->address) != active_unit->depth) ||
+            !ctx->tracked[MASK_INDEX(o->address)]) {
+            break;
+          }
+
+          const int var = MASK_INDEX(o->address);
+          if (o->kind == VCODE_OP_STORE) {
+            int64_t low, high;
+            vcode_opt_range_get(ctx, o->args.items[0], &low, &high);
+            vcode_opt_range_set(&(ctx->cur), var, low, high,
+              o->args.items[0]);
+          } else {
+            vcode_opt_range_set(&(ctx->cur), var, INT64_MIN, INT64_MAX,
+              VCODE_INVALID_REG);
+          }
+        }
+        break;
+
+      case VCODE_OP_NESTED_FCALL:
+      case VCODE_OP_NESTED_PCALL:
+      case VCODE_OP_NESTED_RESUME:
+        {
+          // Nested call captures variables
+          vcode_opt_range_clobber(ctx);
+        }
+        break;
+
+      case VCODE_OP_FCALL:
+      case VCODE_OP_PCALL:
+      case VCODE_OP_RESUME:
+      case VCODE_OP_INTRINSIC:
+        {
+          // Any subprogram may modify shared variables in a package
+          if (ctx->calls_clobber) {
+            vcode_opt_range_clobber(ctx);
+          }
+        }
+        break;
+
+      default:
+        break;
+    }
+
+    if (o->result != VCODE_INVALID_REG) {
+      vcode_opt_range_op(ctx, o);
+    }
+  }
+
+  if (apply || (b->ops.count == 0)) {
+    return;
+  }
+
+  const op_t *last = &(b->ops.items[b->ops.count - 1]);
+  if ((last->kind == VCODE_OP_COND) &&
+    (last->targets.items[0] != last->targets.items[1])) {
+    // Each edge of a conditional branch learns the outcome of the test
+    memcpy(ctx->save.items, ctx->cur.items,
+      ctx->cur.count * sizeof(vcode_range_t));
+    ctx->save.count = ctx->cur.count;
+
+    for (int i = 0; i < 2; i++) {
+      if (i > 0) {
+        memcpy(ctx->cur.items, ctx->save.items,
+          ctx->save.count * sizeof(vcode_range_t));
+        ctx->cur.count = ctx->save.count;
+      }
+
+      if (vcode_opt_range_cond(ctx, last->args.items[0], (i == 0), 0)) {
+        vcode_opt_range_join(ctx, last->targets.items[i]);
+      }
+    }
+  } else {
+    const vcode_block_array_t *succs = vcode_opt_successors(b);
+    for (int i = 0; (succs != NULL) && (i < succs->count); i++) {
+      vcode_opt_range_join(ctx, succs->items[i]);
+    }
+  }
+} /* vcode_opt_range_block() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+vcode_opt_range_clobber (
+  vcode_range_ctx_t *ctx
+) {
+  // Forget everything known about variables but keep the refined
+  // intervals of registers as those cannot change
+
+  int out = 0;
+  for (int i = 0; i < ctx->cur.count; i++) {
+    if (ctx->cur.items[i].key >= ctx->nvars) {
+      ctx->cur.items[out++] = ctx->cur.items[i];
+    }
+  }
+
+  ctx->cur.count = out;
+} /* vcode_opt_range_clobber() */
+
+/* ------------------------------------------------------------------------- */
+
+static bool
+vcode_opt_range_cmp (
+  vcode_range_ctx_t *ctx,
+  vcode_cmp_t        cmp,
+  vcode_reg_t        lhs,
+  vcode_reg_t        rhs
+) {
+  // Narrow the intervals of both operands given that the comparison
+  // is true: returns false if it can never be true
+
+  const vtype_kind_t lkind = vcode_reg_kind(lhs);
+  const vtype_kind_t rkind = vcode_reg_kind(rhs);
+  if (((lkind != VCODE_TYPE_INT) && (lkind != VCODE_TYPE_OFFSET)) ||
+    ((rkind != VCODE_TYPE_INT) && (rkind != VCODE_TYPE_OFFSET))) {
+    return (true);
+  }
+
+  int64_t al, ah, bl, bh;
+  vcode_opt_range_get(ctx, lhs, &al, &ah);
+  vcode_opt_range_get(ctx, rhs, &bl, &bh);
+
+  switch (cmp)
+  {
+    case VCODE_CMP_EQ:
+      {
+        al = bl = MAX(al, bl);
+        ah = bh = MIN(ah, bh);
+      }
+      break;
+
+    case VCODE_CMP_NEQ:
+      {
+        if (bl == bh) {
+          if (al == bl) {
+            al = sadd64(al, 1);
+          }
+          if (ah == bl) {
+            ah = sadd64(ah, -1);
+          }
+        } else if (al == ah) {
+          if (bl == al) {
+            bl = sadd64(bl, 1);
+          }
+          if (bh == al) {
+            bh = sadd64(bh, -1);
+          }
+        }
+      }
+      break;
+
+    case VCODE_CMP_LT:
+      {
+        ah = MIN(ah, sadd64(bh, -1));
+        bl = MAX(bl, sadd64(al, 1));
+      }
+      break;
+
+    case VCODE_CMP_LEQ:
+      {
+        ah = MIN(ah, bh);
+        bl = MAX(bl, al);
+      }
+      break;
+
+    case VCODE_CMP_GT:
+      {
+        al = MAX(al, sadd64(bl, 1));
+        bh = MIN(bh, sadd64(ah, -1));
+      }
+      break;
+
+    case VCODE_CMP_GEQ:
+      {
+        al = MAX(al, bl);
+        bh = MIN(bh, ah);
+      }
+      break;
+
+    default:
+      return (true);
+  }
+
+  if ((al > ah) || (bl > bh)) {
+    return (false);
+  }
+
+  vcode_opt_range_refine(ctx, lhs, al, ah);
+  vcode_opt_range_refine(ctx, rhs, bl, bh);
+
+  return (true);
+} /* vcode_opt_range_cmp() */
+
+/* ------------------------------------------------------------------------- */
+
+static bool
+vcode_opt_range_cond (
+  vcode_range_ctx_t *ctx,
+  vcode_reg_t        test,
+  bool               truth,
+  int                depth
+) {
+  // Narrow intervals given the value of a branch condition: returns
+  // false if the condition can never have that value
+
+  int64_t low, high;
+  vcode_opt_range_get(ctx, test, &low, &high);
+  if ((truth && (high < 1)) || (!truth && (low > 0))) {
+    return (false);
+  }
+
+  vcode_opt_range_refine(ctx, test, truth, truth);
+
+  const op_t *def = ctx->defop[test];
+  if ((def == NULL) || (depth > 4)) {
+    return (true);
+  }
+
+  static const vcode_cmp_t negate[] = {
+    [VCODE_CMP_EQ]  = VCODE_CMP_NEQ, [VCODE_CMP_NEQ] = VCODE_CMP_EQ,
+    [VCODE_CMP_LT]  = VCODE_CMP_GEQ, [VCODE_CMP_GT]  = VCODE_CMP_LEQ,
+    [VCODE_CMP_LEQ] = VCODE_CMP_GT,  [VCODE_CMP_GEQ] = VCODE_CMP_LT
+  };
+
+  switch (def->kind)
+  {
+    case VCODE_OP_CMP:
+      {
+        return (vcode_opt_range_cmp(ctx, truth ? def->cmp : negate[def->cmp],
+          def->args.items[0], def->args.items[1]));
+      }
+
+    case VCODE_OP_NOT:
+      {
+        return (vcode_opt_range_cond(ctx, def->args.items[0], !truth,
+          depth + 1));
+      }
+
+    case VCODE_OP_AND:
+    case VCODE_OP_OR:
+      {
+        // Both operands are known only when the conjunction is true or
+        // the disjunction is false
+        if (truth != (def->kind == VCODE_OP_AND)) {
+          return (true);
+        }
+
+        return (vcode_opt_range_cond(ctx, def->args.items[0], truth,
+          depth + 1) &&
+          vcode_opt_range_cond(ctx, def->args.items[1], truth, depth + 1));
+      }
+
+    default:
+      return (true);
+  }
+} /* vcode_opt_range_cond() */
+
+/* ------------------------------------------------------------------------- */
+
+static vcode_range_t *
+vcode_opt_range_find (
+  vcode_range_set_t *set,
+  int                key
+) {
+  int low = 0, high = set->count - 1;
+  while (low <= high) {
+    const int mid = (low + high) / 2;
+    if (set->items[mid].key == key) {
+      return (&(set->items[mid]));
+    } else if (set->items[mid].key < key) {
+      low = mid + 1;
+    } else {
+      high = mid - 1;
+    }
+  }
+
+  return (NULL);
+} /* vcode_opt_range_find() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+vcode_opt_range_get (
+  vcode_range_ctx_t *ctx,
+  vcode_reg_t        reg,
+  int64_t           *low,
+  int64_t           *high
+) {
+  const vcode_range_t *r = vcode_opt_range_find(&(ctx->cur), ctx->nvars + reg);
+  if (r != NULL) {
+    *low = r->low;
+    *high = r->high;
+  } else {
+    *low = ctx->low[reg];
+    *high = ctx->high[reg];
+  }
+} /* vcode_opt_range_get() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+vcode_opt_range_join (
+  vcode_range_ctx_t *ctx,
+  int                block
+) {
+  // Merge the current state into the entry state of a block keeping
+  // only facts that hold on every incoming edge: after a few updates
+  // any bound that is still moving is widened so loops converge
+
+  vcode_range_set_t *in = &(ctx->in[block]);
+  const vcode_range_set_t *cur = &(ctx->cur);
+
+  if (!in->reached) {
+    in->items = xmalloc(MAX(cur->count, 1) * sizeof(vcode_range_t));
+    memcpy(in->items, cur->items, cur->count * sizeof(vcode_range_t));
+    in->count = cur->count;
+    in->reached = true;
+    ctx->changed = true;
+    return;
+  }
+
+  const bool widen = (++(in->updates) > VCODE_RANGE_WIDEN);
+
+  bool changed = false;
+  int out = 0;
+  for (int i = 0, j = 0; (i < in->count) && (j < cur->count); ) {
+    const vcode_range_t *a = &(in->items[i]);
+    const vcode_range_t *b = &(cur->items[j]);
+    if (a->key < b->key) {
+      i++;
+    } else if (a->key > b->key) {
+      j++;
+    } else {
+      vcode_range_t r = {
+        .key   = a->key,
+        .low   = MIN(a->low, b->low),
+        .high  = MAX(a->high, b->high),
+        .alias = (a->alias == b->alias) ? a->alias : VCODE_INVALID_REG
+      };
+
+      if (widen && (r.low < a->low)) {
+        r.low = INT64_MIN;
+      }
+      if (widen && (r.high > a->high)) {
+        r.high = INT64_MAX;
+      }
+
+      changed = changed || (r.low != a->low) || (r.high != a->high)
+        || (r.alias != a->alias);
+
+      in->items[out++] = r;
+      i++, j++;
+    }
+  }
+
+  if (changed || (out != in->count)) {
+    ctx->changed = true;
+  }
+
+  in->count = out;
+} /* vcode_opt_range_join() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+vcode_opt_range_op (
+  vcode_range_ctx_t *ctx,
+  const op_t        *o
+) {
+  // Compute the interval of the result of an operation from the
+  // intervals of its arguments, never widening the existing bounds
+
+  const vcode_reg_t result = o->result;
+  const vtype_kind_t rkind = vcode_reg_kind(result);
+  if ((rkind != VCODE_TYPE_INT) && (rkind != VCODE_TYPE_OFFSET)) {
+    return;
+  }
+
+  const vtype_t *bt = vcode_type_data(vcode_reg_data(result)->bounds);
+  int64_t low = INT64_MIN, high = INT64_MAX;
+  if ((bt->kind == VCODE_TYPE_INT) || (bt->kind == VCODE_TYPE_OFFSET)) {
+    low = bt->low;
+    high = bt->high;
+  }
+
+  int64_t al = INT64_MIN, ah = INT64_MAX, bl = INT64_MIN, bh = INT64_MAX;
+  for (int i = 0; (i < o->args.count) && (i < 2); i++) {
+    const vtype_kind_t kind = vcode_reg_kind(o->args.items[i]);
+    if ((kind == VCODE_TYPE_INT) || (kind == VCODE_TYPE_OFFSET)) {
+      vcode_opt_range_get(ctx, o->args.items[i],
+        (i == 0) ? &al : &bl, (i == 0) ? &ah : &bh);
+    } else if ((o->kind != VCODE_OP_LOAD) && (o->kind != VCODE_OP_SELECT)) {
+      ctx->low[result] = low;
+      ctx->high[result] = high;
+      return;
+    }
+  }
+
+  int64_t nl = INT64_MIN, nh = INT64_MAX;
+
+  switch (o->kind)
+  {
+    case VCODE_OP_CONST:
+      {
+        nl = nh = o->value;
+      }
+      break;
+
+    case VCODE_OP_ADD:
+      {
+        nl = sadd64(al, bl);
+        nh = sadd64(ah, bh);
+      }
+      break;
+
+    case VCODE_OP_ADDI:
+      {
+        nl = sadd64(al, o->value);
+        nh = sadd64(ah, o->value);
+      }
+      break;
+
+    case VCODE_OP_SUB:
+      {
+        if ((bl != INT64_MIN) && (bh != INT64_MIN)) {
+          nl = sadd64(al, -bh);
+          nh = sadd64(ah, -bl);
+        }
+      }
+      break;
+
+    case VCODE_OP_NEG:
+      {
+        if (al != INT64_MIN) {
+          nl = -ah;
+          nh = -al;
+        }
+      }
+      break;
+
+    case VCODE_OP_MUL:
+      {
+        int64_t p[4];
+        if (!__builtin_mul_overflow(al, bl, &p[0]) &&
+          !__builtin_mul_overflow(al, bh, &p[1]) &&
+          !__builtin_mul_overflow(ah, bl, &p[2]) &&
+          !__builtin_mul_overflow(ah, bh, &p[3])) {
+          nl = MIN(MIN(p[0], p[1]), MIN(p[2], p[3]));
+          nh = MAX(MAX(p[0], p[1]), MAX(p[2], p[3]));
+        }
+      }
+      break;
+
+    case VCODE_OP_CAST:
+      {
+        nl = al;
+        nh = ah;
+      }
+      break;
+
+    case VCODE_OP_SELECT:
+      {
+        int64_t tl, th, fl, fh;
+        vcode_opt_range_get(ctx, o->args.items[1], &tl, &th);
+        vcode_opt_range_get(ctx, o->args.items[2], &fl, &fh);
+
+        if (al > 0) {
+          nl = tl, nh = th;
+        } else if (ah < 1) {
+          nl = fl, nh = fh;
+        } else {
+          nl = MIN(tl, fl);
+          nh = MAX(th, fh);
+        }
+      }
+      break;
+
+    case VCODE_OP_LOAD:
+      {
+        if ((MASK_CONTEXT(o->address) != active_unit->depth) ||
+          !ctx->tracked[MASK_INDEX(o->address)]) {
+          break;
+        }
+
+        const vcode_range_t *r =
+          vcode_opt_range_find(&(ctx->cur), MASK_INDEX(o->address));
+        if (r != NULL) {
+          nl = r->low;
+          nh = r->high;
+        }
+      }
+      break;
+
+    case VCODE_OP_CMP:
+      {
+        bool maybe_true = true, maybe_false = true;
+        switch (o->cmp)
+        {
+          case VCODE_CMP_EQ:
+            maybe_true = (al <= bh) && (bl <= ah);
+            maybe_false = !((al == ah) && (bl == bh) && (al == bl));
+            break;
+          case VCODE_CMP_NEQ:
+            maybe_true = !((al == ah) && (bl == bh) && (al == bl));
+            maybe_false = (al <= bh) && (bl <= ah);
+            break;
+          case VCODE_CMP_LT:
+            maybe_true = (al < bh);
+            maybe_false = (ah >= bl);
+            break;
+          case VCODE_CMP_GT:
+            maybe_true = (ah > bl);
+            maybe_false = (al <= bh);
+            break;
+          case VCODE_CMP_LEQ:
+            maybe_true = (al <= bh);
+            maybe_false = (ah > bl);
+            break;
+          case VCODE_CMP_GEQ:
+            maybe_true = (ah >= bl);
+            maybe_false = (al < bh);
+            break;
+          default:
+            break;
+        }
+
+        nl = maybe_false ? 0 : 1;
+        nh = maybe_true ? 1 : 0;
+      }
+      break;
+
+    case VCODE_OP_NOT:
+      {
+        if ((al >= 0) && (ah <= 1)) {
+          nl = 1 - ah;
+          nh = 1 - al;
+        }
+      }
+      break;
+
+    case VCODE_OP_AND:
+    case VCODE_OP_OR:
+      {
+        if ((al >= 0) && (ah <= 1) && (bl >= 0) && (bh <= 1)) {
+          nl = (o->kind == VCODE_OP_AND) ? (al & bl) : (al | bl);
+          nh = (o->kind == VCODE_OP_AND) ? (ah & bh) : (ah | bh);
+        }
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  if ((nl <= high) && (nh >= low) && (nl <= nh)) {
+    low = MAX(low, nl);
+    high = MIN(high, nh);
+  }
+
+  ctx->low[result] = low;
+  ctx->high[result] = high;
+
+  if ((o->kind == VCODE_OP_LOAD) &&
+    (MASK_CONTEXT(o->address) == active_unit->depth) &&
+    ctx->tracked[MASK_INDEX(o->address)]) {
+    // Later branches on the loaded value also narrow the variable
+    const int var = MASK_INDEX(o->address);
+    const vcode_range_t *r = vcode_opt_range_find(&(ctx->cur), var);
+    if ((r == NULL) || (r->alias == VCODE_INVALID_REG)) {
+      vcode_opt_range_set(&(ctx->cur), var, low, high, result);
+    }
+  }
+} /* vcode_opt_range_op() */
+
+/* ------------------------------------------------------------------------- */
+
+static bool
+vcode_opt_range_redundant (
+  vcode_range_ctx_t *ctx,
+  const op_t        *o
+) {
+  for (int i = 0; i < o->args.count; i++) {
+    const vtype_kind_t kind = vcode_reg_kind(o->args.items[i]);
+    if ((kind != VCODE_TYPE_INT) && (kind != VCODE_TYPE_OFFSET)) {
+      return (false);
+    }
+  }
+
+  int64_t al, ah;
+  vcode_opt_range_get(ctx, o->args.items[0], &al, &ah);
+
+  switch (o->kind)
+  {
+    case VCODE_OP_BOUNDS:
+      {
+        if (vtype_kind(o->type) != VCODE_TYPE_INT) {
+          return (false);
+        }
+
+        return ((al >= vtype_low(o->type)) && (ah <= vtype_high(o->type)));
+      }
+
+    case VCODE_OP_DYNAMIC_BOUNDS:
+      {
+        int64_t ll, lh, hl, hh;
+        vcode_opt_range_get(ctx, o->args.items[1], &ll, &lh);
+        vcode_opt_range_get(ctx, o->args.items[2], &hl, &hh);
+
+        return ((al >= lh) && (ah <= hl));
+      }
+
+    case VCODE_OP_INDEX_CHECK:
+      {
+        int64_t bl, bh;
+        vcode_opt_range_get(ctx, o->args.items[1], &bl, &bh);
+
+        if (bh < al) {
+          return (true);    // Null range always passes
+        }
+
+        int64_t min, max;
+        if (o->args.count == 2) {
+          if (vtype_kind(o->type) != VCODE_TYPE_INT) {
+            return (false);
+          }
+
+          min = vtype_low(o->type);
+          max = vtype_high(o->type);
+        } else {
+          int64_t ignore;
+          vcode_opt_range_get(ctx, o->args.items[2], &ignore, &min);
+          vcode_opt_range_get(ctx, o->args.items[3], &max, &ignore);
+        }
+
+        return ((al >= min) && (ah <= max) && (bl >= min) && (bh <= max));
+      }
+
+    default:
+      return (false);
+  }
+} /* vcode_opt_range_redundant() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+vcode_opt_range_refine (
+  vcode_range_ctx_t *ctx,
+  vcode_reg_t        reg,
+  int64_t            low,
+  int64_t            high
+) {
+  // Record a narrower interval for a register on the current path and
+  // for any variable currently holding the same value
+
+  int64_t old_low, old_high;
+  vcode_opt_range_get(ctx, reg, &old_low, &old_high);
+  if ((low <= old_low) && (high >= old_high)) {
+    return;
+  }
+
+  vcode_opt_range_set(&(ctx->cur), ctx->nvars + reg, low, high,
+    VCODE_INVALID_REG);
+
+  for (int i = 0; i < ctx->cur.count; i++) {
+    vcode_range_t *r = &(ctx->cur.items[i]);
+    if (r->key >= ctx->nvars) {
+      break;
+    } else if (r->alias == reg) {
+      r->low = MAX(r->low, low);
+      r->high = MIN(r->high, high);
+    }
+  }
+} /* vcode_opt_range_refine() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+vcode_opt_range_set (
+  vcode_range_set_t *set,
+  int                key,
+  int64_t            low,
+  int64_t            high,
+  vcode_reg_t        alias
+) {
+  // The caller ensures the set has space for every possible key
+
+  int pos = 0;
+  while ((pos < set->count) && (set->items[pos].key < key)) {
+    pos++;
+  }
+
+  if ((pos == set->count) || (set->items[pos].key != key)) {
+    memmove(&(set->items[pos + 1]), &(set->items[pos]),
+      (set->count - pos) * sizeof(vcode_range_t));
+    set->count++;
+  }
+
+  set->items[pos].key = key;
+  set->items[pos].low = low;
+  set->items[pos].high = high;
+  set->items[pos].alias = alias;
+} /* vcode_opt_range_set() */
+
+/* ------------------------------------------------------------------------- */
+
+static int
+vcode_opt_ranges (
+  void
+) {
+  // Compute an interval for every integer register and local variable
+  // by forward dataflow over the control flow graph, narrowing on the
+  // outcome of branch conditions, and remove checks that cannot fail
+  // and conditions that always have the same value
+
+  vcode_cfg_t cfg;
+  vcode_opt_cfg_new(&cfg);
+
+  const int nvars = active_unit->vars.count;
+  const int nregs = active_unit->regs.count;
+  const int nblocks = active_unit->blocks.count;
+
+  vcode_range_ctx_t ctx;
+  memset(&ctx, '\0', sizeof(ctx));
+  ctx.in = xcalloc(MAX(nblocks, 1) * sizeof(vcode_range_set_t));
+  ctx.cur.items = xmalloc(MAX(nvars + nregs, 1) * sizeof(vcode_range_t));
+  ctx.save.items = xmalloc(MAX(nvars + nregs, 1) * sizeof(vcode_range_t));
+  ctx.low = xmalloc(MAX(nregs, 1) * sizeof(int64_t));
+  ctx.high = xmalloc(MAX(nregs, 1) * sizeof(int64_t));
+  ctx.defop = xcalloc(MAX(nregs, 1) * sizeof(op_t *));
+  ctx.tracked = xcalloc(MAX(nvars, 1) * sizeof(bool));
+  ctx.nvars = nvars;
+  ctx.calls_clobber = (active_unit->kind == VCODE_UNIT_CONTEXT);
+
+  for (int i = 0; i < nregs; i++) {
+    const vtype_t *bt = vcode_type_data(active_unit->regs.items[i].bounds);
+    const bool is_int =
+      (bt->kind == VCODE_TYPE_INT) || (bt->kind == VCODE_TYPE_OFFSET);
+    ctx.low[i] = is_int ? bt->low : INT64_MIN;
+    ctx.high[i] = is_int ? bt->high : INT64_MAX;
+  }
+
+  for (int i = 0; i < nvars; i++) {
+    const var_t *v = &(active_unit->vars.items[i]);
+    const vtype_kind_t kind = vtype_kind(v->type);
+    ctx.tracked[i] = !(v->flags & VAR_EXTERN) &&
+      ((kind == VCODE_TYPE_INT) || (kind == VCODE_TYPE_OFFSET));
+  }
+
+  // Variables whose address is taken may be modified through a pointer
+  for (int i = 0; i < nblocks; i++) {
+    block_t *b = &(active_unit->blocks.items[i]);
+    for (int j = 0; j < b->ops.count; j++) {
+      op_t *o = &(b->ops.items[j]);
+      if (o->result != VCODE_INVALID_REG) {
+        ctx.defop[o->result] = o;
+      }
+
+      if ((o->kind == VCODE_OP_INDEX) &&
+        (MASK_CONTEXT(o->address) == active_unit->depth)) {
+        ctx.tracked[MASK_INDEX(o->address)] = false;
+      }
+    }
+  }
+
+  for (int i = 0; i < nblocks; i++) {
+    ctx.in[i].reached = cfg.root[i];
+  }
+
+  // Registers are defined in a block that dominates their uses so
+  // visiting blocks in reverse post-order sees every definition first:
+  // the first block in this order is the virtual entry block
+  bool converged = false;
+  for (int iter = 0; (iter < VCODE_RANGE_MAX_ITERS) && !converged; iter++) {
+    ctx.changed = false;
+    for (int i = 1; i < cfg.nrpo; i++) {
+      if (ctx.in[cfg.rpo[i]].reached) {
+        vcode_opt_range_block(&ctx, cfg.rpo[i], false);
+      }
+    }
+
+    converged = !ctx.changed;
+  }
+
+  if (converged) {
+    for (int i = 1; i < cfg.nrpo; i++) {
+      if (ctx.in[cfg.rpo[i]].reached) {
+        vcode_opt_range_block(&ctx, cfg.rpo[i], true);
+      }
+    }
+
+    // Let constant folding resolve branches on conditions that are
+    // always true or always false
+    for (int i = 0; i < nregs; i++) {
+      const op_t *def = ctx.defop[i];
+      if ((def == NULL) || (ctx.low[i] != ctx.high[i])) {
+        continue;
+      } else if ((def->kind == VCODE_OP_CMP) || (def->kind == VCODE_OP_NOT)
+        || (def->kind == VCODE_OP_AND) || (def->kind == VCODE_OP_OR)) {
+        active_unit->regs.items[i].bounds =
+          vtype_int(ctx.low[i], ctx.high[i]);
+      }
+    }
+  }
+
+  for (int i = 0; i < nblocks; i++) {
+    free(ctx.in[i].items);
+  }
+
+  free(ctx.in);
+  free(ctx.cur.items);
+  free(ctx.save.items);
+  free(ctx.low);
+  free(ctx.high);
+  free(ctx.defop);
+  free(ctx.tracked);
+  vcode_opt_cfg_free(&cfg);
+
+  if (ctx.removed > 0) {
+    vcode_opt_compact();
+  }
+
+  // Branches on decided conditions are counted by the folding pass
+  return (ctx.removed);
+} /* vcode_opt_ranges() */
+
+/* ------------------------------------------------------------------------- */
+
+static vcode_reg_t
+vcode_opt_resolve (
+  const vcode_reg_t *subst,
+  vcode_reg_t        reg
+) {
+  while ((reg != VCODE_INVALID_REG) && (subst[reg] != VCODE_INVALID_REG)) {
+    reg = subst[reg];
+  }
+
+  return (reg);
+} /* vcode_opt_resolve() */
+
+/* ------------------------------------------------------------------------- */
+
+static bool
+vcode_opt_same_op (
+  const op_t *a,
+  const op_t *b
+) {
+  if ((a->kind != b->kind) || (a->args.count != b->args.count)) {
+    return (false);
+  }
+
+  for (int i = 0; i < a->args.count; i++) {
+    if (a->args.items[i] != b->args.items[i]) {
+      return (false);
+    }
+  }
+
+  if (!vtype_eq(vcode_reg_type(a->result), vcode_reg_type(b->result))) {
+    return (false);
+  }
+
+  switch (a->kind)
+  {
+    case VCODE_OP_CONST:
+    case VCODE_OP_ADDI:
+      {
+        return (a->value == b->value);
+      }
+
+    case VCODE_OP_CONST_REAL:
+      {
+        return (memcmp(&(a->real), &(b->real), sizeof(double)) == 0);
+      }
+
+    case VCODE_OP_CMP:
+      {
+        return (a->cmp == b->cmp);
+      }
+
+    case VCODE_OP_UARRAY_LEFT:
+    case VCODE_OP_UARRAY_RIGHT:
+    case VCODE_OP_UARRAY_DIR:
+    case VCODE_OP_UARRAY_LEN:
+      {
+        return (a->dim == b->dim);
+      }
+
+    case VCODE_OP_RECORD_REF:
+      {
+        return (a->field == b->field);
+      }
+
+    case VCODE_OP_INDEX:
+      {
+        return (a->address == b->address);
+      }
+
+    default:
+      {
+        return (true);
+      }
+  }
+} /* vcode_opt_same_op() */
+
+/* ------------------------------------------------------------------------- */
+
+static const vcode_block_array_t *
+vcode_opt_successors (
+  const block_t *b
+) {
+  if (b->ops.count == 0) {
+    return (NULL);
+  }
+
+  const op_t *last = &(b->ops.items[b->ops.count - 1]);
+  return (OP_HAS_TARGET(last->kind) ? &(last->targets) : NULL);
+} /* vcode_opt_successors() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+vcode_opt_walk (
+  const vcode_cfg_t *cfg,
+  vcode_enter_fn_t   enter,
+  vcode_leave_fn_t   leave,
+  void              *ctx
+) {
+  // Visit the dominator tree in pre-order calling leave with the value
+  // returned from enter once all the children of a block are visited
+
+  vcode_frame_t *stack LOCAL =
+    xmalloc((cfg->nblocks + 1) * sizeof(vcode_frame_t));
+  int sp = 0;
+
+  const int entry = cfg->nblocks;
+  stack[sp++] = (vcode_frame_t){ entry, cfg->child_base[entry], 0 };
+
+  while (sp > 0) {
+    vcode_frame_t *top = &(stack[sp - 1]);
+    if (top->next < cfg->child_base[top->block + 1]) {
+      const int child = cfg->children[top->next++];
+      const int mark = (*enter)(child, ctx);
+      stack[sp++] = (vcode_frame_t){ child, cfg->child_base[child], mark };
+    } else {
+      if (top->block != entry) {
+        (*leave)(top->mark, ctx);
+      }
+      sp--;
+    }
+  }
+} /* vcode_opt_walk() */
+
+/* ------------------------------------------------------------------------- */
+
+static void
+vcode_pretty_print_int (
   int64_t n
 ) {
   if (n == INT64_MAX) {
@@ -6684,6 +9393,23 @@ vcode_pretty_print_int (
 
 /* ------------------------------------------------------------------------- */
 
+static bool
+vcode_range_not_null (
+  vcode_reg_t low,
+  vcode_reg_t high
+) {
+  // Either bound of a range is only within the range when it is not null
+  if ((vcode_reg_kind(low) != VCODE_TYPE_INT) ||
+    (vcode_reg_kind(high) != VCODE_TYPE_INT)) {
+    return (false);
+  }
+
+  return (vtype_high(vcode_reg_bounds(low)) <=
+         vtype_low(vcode_reg_bounds(high)));
+} /* vcode_range_not_null() */
+
+/* ------------------------------------------------------------------------- */
+
 static bool
 vcode_read_unit (
   fbuf_t        *f,
@@ -6710,6 +9436,8 @@ vcode_read_unit (
       fatal("%s references nonexistent context %s", fbuf_file_name(f),
         istr(context_name));
     }
+
+    vcode_add_child(unit->context, unit);
   } else {
     unit->context = unit;
   }
@@ -6786,6 +9514,9 @@ vcode_read_unit (
       if (OP_HAS_TAG(op->kind)) {
         op->tag = read_u32(f);
       }
+      if (OP_HAS_INTRINSIC(op->kind)) {
+        op->intrinsic = read_u8(f);
+      }
       if (OP_HAS_LOC(op->kind)) {
         loc_read(&(op->loc), f, ident_rd_ctx);
       }
@@ -6940,6 +9671,27 @@ vcode_read_unit (
 
 /* ------------------------------------------------------------------------- */
 
+static int
+vcode_ref_slot (
+  vcode_global_ref_array_t *refs,
+  vcode_ref_kind_t          kind,
+  int32_t                   handle
+) {
+  for (unsigned i = 0; i < refs->count; i++) {
+    if ((refs->items[i].kind == kind) && (refs->items[i].handle == handle)) {
+      return (i);
+    }
+  }
+
+  vcode_global_ref_t *ref = vcode_global_ref_array_alloc(refs);
+  ref->kind = kind;
+  ref->handle = handle;
+
+  return (refs->count - 1);
+} /* vcode_ref_slot() */
+
+/* ------------------------------------------------------------------------- */
+
 static reg_t *
 vcode_reg_data (
   vcode_reg_t reg
@@ -7012,6 +9764,63 @@ vcode_unit_calc_depth (
 
 /* ------------------------------------------------------------------------- */
 
+static bool
+vcode_type_equivalent (
+  const vtype_t *a,
+  const vtype_t *b
+) {
+  if (a->kind != b->kind) {
+    return (false);
+  }
+
+  switch (a->kind)
+  {
+    case VCODE_TYPE_INT:
+      {
+        return ((a->low == b->low) && (a->high == b->high));
+      }
+
+    case VCODE_TYPE_REAL:
+      {
+        return ((a->rlow == b->rlow) && (a->rhigh == b->rhigh));
+      }
+
+    case VCODE_TYPE_CARRAY:
+    case VCODE_TYPE_UARRAY:
+      {
+        return ((a->dims == b->dims) && (a->size == b->size)
+                && (a->elem == b->elem) && (a->bounds == b->bounds));
+      }
+
+    case VCODE_TYPE_POINTER:
+    case VCODE_TYPE_ACCESS:
+      {
+        return (a->pointed == b->pointed);
+      }
+
+    case VCODE_TYPE_SIGNAL:
+    case VCODE_TYPE_FILE:
+      {
+        return (a->base == b->base);
+      }
+
+    case VCODE_TYPE_RECORD:
+      {
+        return (a->name == b->name);
+      }
+
+    case VCODE_TYPE_OFFSET:
+      {
+        return (true);
+      }
+
+    default:
+      return (false);
+  }
+} /* vcode_type_equivalent() */
+
+/* ------------------------------------------------------------------------- */
+
 static var_t *
 vcode_var_data (
   vcode_var_t var
@@ -7121,6 +9930,9 @@ vcode_write_unit (
       if (OP_HAS_TAG(op->kind)) {
         write_u32(op->tag, f);
       }
+      if (OP_HAS_INTRINSIC(op->kind)) {
+        write_u8(op->intrinsic, f);
+      }
       if (OP_HAS_LOC(op->kind)) {
         loc_write(&(op->loc), f, ident_wr_ctx);
       }
@@ -7143,14 +9955,16 @@ vcode_write_unit (
         }
       }
       if (OP_HAS_RESOLUTION(op->kind)) {
-        write_u32(op->resolution->count, f);
-        if (op->resolution->count > 0) {
+        if (op->resolution == NULL) {
+          write_u32(0, f);
+        } else {
+          write_u32(op->resolution->count, f);
           for (size_t i = 0; i < op->resolution->count; i++) {
             ident_write(op->resolution->element[i].name, ident_wr_ctx);
             write_u32(op->resolution->element[i].type, f);
             write_u32(op->resolution->element[i].ileft, f);
             write_u32(op->resolution->element[i].kind, f);
-            write_u32(op->resolution->element[i].boundary, f);
+            write_u8(op->resolution->element[i].boundary, f);
           }
         }
       }
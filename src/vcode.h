@@ -133,6 +133,7 @@ typedef enum {
    VCODE_OP_DEBUG_INFO,
    VCODE_OP_ADDI,
    VCODE_OP_RANGE_NULL,
+   VCODE_OP_INTRINSIC,
 } vcode_op_t;
 
 typedef enum {
@@ -199,6 +200,17 @@ typedef struct {
    vcode_res_elem_t element[];
 } vcode_res_fn_t;
 
+typedef enum {
+   VCODE_REF_SIGNAL,
+   VCODE_REF_VAR
+} vcode_ref_kind_t;
+
+// Signal or variable in an enclosing unit referenced by a process
+typedef struct {
+   vcode_ref_kind_t kind;
+   int32_t          handle;
+} vcode_global_ref_t;
+
 #define VCODE_INVALID_REG    -1
 #define VCODE_INVALID_BLOCK  -1
 #define VCODE_INVALID_VAR    -1
@@ -243,11 +255,15 @@ vcode_unit_t vcode_find_unit(ident_t name);
 vcode_unit_t vcode_unit_next(vcode_unit_t unit);
 vcode_unit_t vcode_unit_child(vcode_unit_t unit);
 void vcode_unit_unref(vcode_unit_t unit);
+uint32_t vcode_unit_hash(vcode_unit_t unit);
+bool vcode_unit_equivalent(vcode_unit_t a, vcode_unit_t b);
+int vcode_unit_global_refs(vcode_unit_t unit, vcode_global_ref_t **refs);
 
 void vcode_opt(void);
 void vcode_close(void);
 void vcode_dump(void);
 void vcode_dump_with_mark(int mark_op);
+void vcode_dump_opt_stats(void);
 void vcode_select_unit(vcode_unit_t vu);
 void vcode_select_block(vcode_block_t block);
 int vcode_count_blocks(void);
@@ -311,6 +327,7 @@ int vcode_get_hops(int op);
 int vcode_get_field(int op);
 unsigned vcode_get_subkind(int op);
 uint32_t vcode_get_tag(int op);
+intrinsic_kind_t vcode_get_intrinsic(int op);
 void vcode_get_image_map(int op, image_map_t *map);
 void vcode_clear_storage_hint(uint32_t tag);
 const vcode_res_fn_t *vcode_get_resolution(int op);
@@ -464,6 +481,9 @@ vcode_reg_t emit_enum_map(ident_t name, size_t nelems, const ident_t *elems);
 vcode_reg_t emit_physical_map(ident_t name, size_t nelems,
                               const ident_t *elems, const int64_t *values);
 void emit_debug_info(const loc_t *loc);
+vcode_reg_t emit_intrinsic(intrinsic_kind_t kind, ident_t func,
+                           vcode_type_t type, const vcode_reg_t *args,
+                           int nargs);
 vcode_reg_t emit_range_null(vcode_reg_t left, vcode_reg_t right,
                             vcode_reg_t dir);
 
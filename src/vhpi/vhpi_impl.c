@@ -1419,7 +1419,7 @@ int vhpi_release_handle(vhpiHandleT handle)
    case VHPI_RANGE:
       assert(handle->refcnt > 0);
       if (--(handle->refcnt) == 0) {
-         hash_put(handle_hash, handle->pointer, NULL);
+         hash_delete(handle_hash, handle->pointer);
          vhpi_free_obj(handle);
       }
       return 0;
@@ -0,0 +1,91 @@
+#include "fbuf.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+#define NRECORDS 2000000
+#define NLOADS   5
+
+static void write_records(const char *file, fbuf_codec_t codec)
+{
+   fbuf_t *f = fbuf_open(file, FBUF_OUT, codec);
+   assert(f != NULL);
+
+   srandom(42);
+
+   uint32_t nets[16];
+   for (int i = 0; i < NRECORDS; i++) {
+      // Roughly the mix of fields written by object_write
+      write_u16(random() % 100, f);
+      write_u64(random(), f);
+      write_u32(i, f);
+      write_u8(random() % 4, f);
+
+      const int nnets = random() % 16;
+      for (int j = 0; j < nnets; j++)
+         nets[j] = random();
+      write_u32(nnets, f);
+      write_u32_array(nets, nnets, f);
+   }
+
+   fbuf_close(f);
+}
+
+static uint64_t read_records(const char *file, fbuf_codec_t codec)
+{
+   fbuf_t *f = fbuf_open(file, FBUF_IN, codec);
+   assert(f != NULL);
+
+   uint64_t sum = 0;
+   uint32_t nets[16];
+   for (int i = 0; i < NRECORDS; i++) {
+      sum += read_u16(f);
+      sum += read_u64(f);
+      sum += read_u32(f);
+      sum += read_u8(f);
+
+      const int nnets = read_u32(f);
+      assert(nnets < 16);
+      read_u32_array(nets, nnets, f);
+      for (int j = 0; j < nnets; j++)
+         sum += nets[j];
+   }
+
+   fbuf_close(f);
+   return sum;
+}
+
+int main(int argc, char **argv)
+{
+   const fbuf_codec_t codecs[] = {
+      FBUF_CODEC_FASTLZ, FBUF_CODEC_LZ4, FBUF_CODEC_NONE
+   };
+
+   uint64_t expect = 0;
+   for (int i = 0; i < ARRAY_LEN(codecs); i++) {
+      char file[64];
+      snprintf(file, sizeof(file), "fbuf_perf.%s", fbuf_codec_str(codecs[i]));
+
+      const uint64_t wstart = get_timestamp_us();
+      write_records(file, codecs[i]);
+      const uint64_t wtime = get_timestamp_us() - wstart;
+
+      const uint64_t rstart = get_timestamp_us();
+      for (int j = 0; j < NLOADS; j++) {
+         const uint64_t sum = read_records(file, codecs[i]);
+         assert((expect == 0) || (sum == expect));
+         expect = sum;
+      }
+      const uint64_t rtime = get_timestamp_us() - rstart;
+
+      printf("%-8s %8.1f ms save %8.1f ms per load\n",
+             fbuf_codec_str(codecs[i]), wtime / 1000.0,
+             rtime / (1000.0 * NLOADS));
+
+      remove(file);
+   }
+
+   return 0;
+}
@@ -0,0 +1,74 @@
+#include "hash.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+#define MAX_KEYS 1000000
+#define NLOOKS   10000000
+
+static void *keys[MAX_KEYS];
+
+static inline uint32_t next_rand(uint32_t *state)
+{
+   // Cheap LCG so the benchmark does not just measure random()
+   *state = *state * 1664525 + 1013904223;
+   return *state >> 8;
+}
+
+static void bench(int nkeys, bool replace)
+{
+   hash_t *h = hash_new(64, replace);
+   uint32_t state = 42;
+
+   const uint64_t istart = get_timestamp_us();
+   for (int i = 0; i < nkeys; i++)
+      hash_put(h, keys[i], keys[i]);
+   const uint64_t itime = get_timestamp_us() - istart;
+
+   const uint64_t hstart = get_timestamp_us();
+   for (int i = 0; i < NLOOKS; i++) {
+      void *k = keys[next_rand(&state) % nkeys];
+      void *v = hash_get(h, k);
+      assert(v == k);
+   }
+   const uint64_t htime = get_timestamp_us() - hstart;
+
+   const uint64_t mstart = get_timestamp_us();
+   for (int i = 0; i < NLOOKS; i++) {
+      void *v = hash_get(h, (void *)(uintptr_t)((next_rand(&state) << 4) | 1));
+      assert(v == NULL);
+   }
+   const uint64_t mtime = get_timestamp_us() - mstart;
+
+   const uint64_t dstart = get_timestamp_us();
+   if (replace) {
+      for (int i = 0; i < nkeys; i += 2)
+         hash_delete(h, keys[i]);
+   }
+   const uint64_t dtime = get_timestamp_us() - dstart;
+
+   printf("%-8s %7d insert %6.1f ms  hit %6.1f ms  miss %6.1f ms  "
+          "delete %6.1f ms\n", replace ? "map" : "multimap", nkeys,
+          itime / 1000.0, htime / 1000.0, mtime / 1000.0, dtime / 1000.0);
+
+   hash_free(h);
+}
+
+int main(int argc, char **argv)
+{
+   srandom(42);
+
+   // Heap-like pointer keys
+   for (int i = 0; i < MAX_KEYS; i++)
+      keys[i] = xmalloc(16 + (random() % 64));
+
+   const int sizes[] = { 1000, 50000, MAX_KEYS };
+   for (int i = 0; i < ARRAY_LEN(sizes); i++) {
+      bench(sizes[i], true);
+      bench(sizes[i], false);
+   }
+
+   return 0;
+}
@@ -0,0 +1,20 @@
+entity intrinsic is
+end entity;
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+architecture test of intrinsic is
+    signal a, b : unsigned(7 downto 0);
+    signal n    : natural;
+    signal v    : std_logic_vector(7 downto 0);
+begin
+
+    process (a, b) is
+    begin
+        n <= to_integer(a + b);
+        v <= std_logic_vector(a) and std_logic_vector(b);
+    end process;
+
+end architecture;
@@ -0,0 +1,34 @@
+entity ranges1 is
+end entity;
+
+architecture test of ranges1 is
+    signal x : integer := 5;
+begin
+
+    process is
+        type arr_t is array (0 to 7) of integer;
+        variable a : arr_t;
+        variable i : integer;
+        variable k : natural;
+        variable y : integer;
+    begin
+        i := 0;
+        while i < 8 loop
+            a(i) := i;
+            i := i + 1;
+        end loop;
+        y := x;
+        if y >= 0 and y < 8 then
+            a(y) := 1;
+            a(y + 1) := 2;              -- Can be out of range
+        end if;
+        k := 0;
+        for j in 1 to 20 loop
+            if k < 7 then
+                k := k + 1;
+            end if;
+        end loop;
+        wait;
+    end process;
+
+end architecture;
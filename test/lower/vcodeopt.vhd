@@ -0,0 +1,24 @@
+entity vcodeopt is
+end entity;
+
+architecture test of vcodeopt is
+    signal x : integer := 5;
+begin
+
+    process is
+        variable v, w : integer;
+    begin
+        v := 4;
+        if x > 0 then
+            if v > 2 then
+                w := v + 1;
+            else
+                w := v - 1;
+            end if;
+            assert w = 5;
+            report "ok";
+        end if;
+        wait;
+    end process;
+
+end architecture;
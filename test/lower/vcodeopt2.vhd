@@ -0,0 +1,45 @@
+package vcodeopt2 is
+    function scale(a, b : integer; c : boolean) return integer;
+    function pick(x : integer) return integer;
+    function twice(x : integer) return integer;
+end package;
+
+package body vcodeopt2 is
+
+    function scale(a, b : integer; c : boolean) return integer is
+        variable r : integer;
+    begin
+        r := a * b;
+        if c then
+            r := r + a * b;             -- Reuses the multiplication above
+        end if;
+        return r;
+    end function;
+
+    function pick(x : integer) return integer is
+        variable v : integer;
+    begin
+        v := 2;
+        if x > 0 then
+            case v is                   -- Only the second branch is live
+                when 1 => return x;
+                when 2 => return x + 1;
+                when others => return x + 2;
+            end case;
+        end if;
+        return 0;
+    end function;
+
+    function twice(x : integer) return integer is
+        variable v, w : integer;
+    begin
+        v := x * 2;
+        if x > 0 then
+            w := v + 1;                 -- Load of V forwarded
+        else
+            w := v - 1;                 -- Load of V forwarded
+        end if;
+        return w;
+    end function;
+
+end package body;
@@ -0,0 +1,29 @@
+entity logicvec is
+end entity;
+
+library ieee;
+use ieee.std_logic_1164.all;
+
+architecture test of logicvec is
+
+    constant WIDTH : integer := 64;
+    constant ITERS : integer := 1000000;
+
+    signal s : std_logic_vector(WIDTH - 1 downto 0);
+begin
+
+    process is
+        variable a : std_logic_vector(WIDTH - 1 downto 0) := (others => '1');
+        variable b : std_logic_vector(WIDTH - 1 downto 0) := (others => 'H');
+        variable c : std_logic_vector(WIDTH - 1 downto 0);
+    begin
+        for i in 1 to ITERS loop
+            c := (a and b) or (a xor not b);
+            a := c nand b;
+            b := a nor c;
+        end loop;
+        s <= c;
+        wait;
+    end process;
+
+end architecture;
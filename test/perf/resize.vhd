@@ -0,0 +1,27 @@
+entity resize is
+end entity;
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+architecture test of resize is
+
+    constant ITERS : integer := 1000000;
+
+    signal s : unsigned(63 downto 0);
+begin
+
+    process is
+        variable narrow : unsigned(15 downto 0) := X"abcd";
+        variable wide   : unsigned(63 downto 0);
+    begin
+        for i in 1 to ITERS loop
+            wide := resize(narrow, 64);
+            narrow := resize(wide, 16);
+        end loop;
+        s <= wide;
+        wait;
+    end process;
+
+end architecture;
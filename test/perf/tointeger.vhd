@@ -0,0 +1,30 @@
+entity tointeger is
+end entity;
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+architecture test of tointeger is
+
+    constant WIDTH : integer := 20;
+    constant ITERS : integer := 10;
+
+    signal total : natural;
+begin
+
+    process is
+        variable v   : unsigned(WIDTH - 1 downto 0);
+        variable sum : natural := 0;
+    begin
+        for i in 1 to ITERS loop
+            for j in 0 to integer'(2 ** WIDTH - 1) loop
+                v := to_unsigned(j, WIDTH);
+                sum := (sum + to_integer(v)) mod 1024;
+            end loop;
+        end loop;
+        total <= sum;
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,28 @@
+entity unsignedadd is
+end entity;
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+architecture test of unsignedadd is
+
+    constant WIDTH : integer := 32;
+    constant ITERS : integer := 1000000;
+
+    signal s : unsigned(WIDTH - 1 downto 0);
+begin
+
+    process is
+        variable acc : unsigned(WIDTH - 1 downto 0) := (others => '0');
+        variable inc : unsigned(WIDTH - 1 downto 0) := X"01234567";
+    begin
+        for i in 1 to ITERS loop
+            acc := acc + inc;
+            acc := acc - shift_right(inc, 3);
+        end loop;
+        s <= acc;
+        wait;
+    end process;
+
+end architecture;
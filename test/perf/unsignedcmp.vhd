@@ -0,0 +1,34 @@
+entity unsignedcmp is
+end entity;
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+architecture test of unsignedcmp is
+
+    constant WIDTH : integer := 24;
+    constant ITERS : integer := 20;
+
+    signal count : natural;
+begin
+
+    process is
+        variable limit : unsigned(WIDTH - 1 downto 0) := X"080000";
+        variable n     : natural := 0;
+    begin
+        for i in 1 to ITERS loop
+            for j in 0 to 2 ** 16 - 1 loop
+                if to_unsigned(j * 16, WIDTH) < limit then
+                    n := n + 1;
+                end if;
+                if to_unsigned(j, WIDTH) = limit then
+                    n := n + 1;
+                end if;
+            end loop;
+        end loop;
+        count <= n;
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,28 @@
+entity bounds18 is
+end entity;
+
+architecture test of bounds18 is
+
+    function first(lo, hi : integer) return bit is
+        variable t : bit_vector(lo to hi) := (others => '1');
+        variable k : integer;
+    begin
+        k := lo;
+        if hi < 100 then
+            return t(k);                -- Fails when T is null
+        end if;
+        return '0';
+    end function;
+
+    signal n : integer := 0;
+
+begin
+
+    process is
+    begin
+        assert first(1, 3) = '1';
+        report bit'image(first(1, n));
+        wait;
+    end process;
+
+end architecture;
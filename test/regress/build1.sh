@@ -0,0 +1,32 @@
+# Changing a source file after the design was elaborated must re-run
+# the analysis rule for that file and every rule that depends on it
+
+cat >pack.vhd <<EOT
+package pack is
+    constant VALUE : integer := 1;
+end package;
+EOT
+
+cat >top.vhd <<EOT
+entity build1 is
+end entity;
+
+use work.pack.all;
+
+architecture test of build1 is
+begin
+    process is
+    begin
+        report "VALUE = " & integer'image(VALUE);
+        wait;
+    end process;
+end architecture;
+EOT
+
+nvc -a pack.vhd top.vhd -e build1 -r
+
+# Some file systems only record modification times to the second
+sleep 1
+
+sed -i 's/:= 1;/:= 2;/' pack.vhd
+nvc --build build1 -r
@@ -0,0 +1,52 @@
+# Re-analysing a package body with the same contents as an earlier
+# version hits the object cache: the design must still see the current
+# body and not one inlined from stale bitcode in the library
+
+nvc() {
+    command nvc --cache-dir=cache "$@"
+}
+
+cat >pack.vhd <<EOT
+package pack is
+    function get_value(x : integer) return integer;
+end package;
+
+package body pack is
+    function get_value(x : integer) return integer is
+    begin
+        return x + 1;
+    end function;
+end package body;
+EOT
+
+nvc -a pack.vhd
+
+sed -i.orig 's/return x + 1;/return x + 2;/' pack.vhd
+nvc -a pack.vhd
+
+mv pack.vhd.orig pack.vhd
+nvc -a pack.vhd
+
+cat >top.vhd <<EOT
+entity cache2 is
+end entity;
+
+use work.pack.all;
+
+architecture test of cache2 is
+    signal s : integer := 0;
+begin
+    process is
+    begin
+        report "value is " & integer'image(get_value(s));
+        assert get_value(s) = 1;
+        wait;
+    end process;
+end architecture;
+EOT
+
+nvc -a top.vhd -e cache2 -r
+
+# Objects are only cached in the given directory
+ls cache/_NVC_CACHE.* >/dev/null || exit 1
+! ls work/_NVC_CACHE.* 2>/dev/null
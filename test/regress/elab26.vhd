@@ -0,0 +1,49 @@
+entity elab26_sub is
+    generic ( N : natural );
+    port ( i : in bit_vector(1 to N);
+           o : out bit_vector(1 to N) );
+end entity;
+
+architecture test of elab26_sub is
+begin
+
+    -- Nothing is generated when N is zero
+    g: for j in 1 to N generate
+        signal t : bit;
+    begin
+        t <= not i(j);
+        o(j) <= not t;
+    end generate;
+
+end architecture;
+
+-------------------------------------------------------------------------------
+
+entity elab26 is
+end entity;
+
+architecture test of elab26 is
+    signal none_i, none_o   : bit_vector(1 to 0);
+    signal three_i, three_o : bit_vector(1 to 3);
+begin
+
+    null_i: entity work.elab26_sub
+        generic map ( 0 )
+        port map ( none_i, none_o );
+
+    normal_i: entity work.elab26_sub
+        generic map ( 3 )
+        port map ( three_i, three_o );
+
+    process is
+    begin
+        three_i <= "101";
+        wait for 1 ns;
+        assert three_o = "101";
+        three_i <= "011";
+        wait for 1 ns;
+        assert three_o = "011";
+        wait;
+    end process;
+
+end architecture;
@@ -0,0 +1,40 @@
+# Declarations of builtin functions created while folding constants are
+# shared between units so must survive the collection after elaboration
+
+cat >a.vhd <<EOT
+entity a is
+end entity;
+
+architecture test of a is
+    constant x : string := "hello";
+    constant y : string := "world";
+begin
+    process is
+        variable s : string(1 to 10);
+    begin
+        s := x & y;
+        report s;
+        wait;
+    end process;
+end architecture;
+EOT
+
+cat >b.vhd <<EOT
+entity b is
+end entity;
+
+architecture test of b is
+    constant x : string := "abc";
+    constant y : string := "def";
+begin
+    process is
+        variable s : string(1 to 6);
+    begin
+        s := x & y;
+        report s;
+        wait;
+    end process;
+end architecture;
+EOT
+
+nvc -a a.vhd -e a -a b.vhd -e b -r
@@ -0,0 +1,80 @@
+entity ieee6 is
+end entity;
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+architecture test of ieee6 is
+begin
+
+    process is
+        variable a, b : unsigned(7 downto 0);
+        variable c    : unsigned(3 downto 0);
+        variable w    : unsigned(99 downto 0);
+        variable v, x : std_logic_vector(3 downto 0);
+        variable n    : natural;
+    begin
+        a := X"f0";
+        b := X"21";
+        c := X"3";
+        wait for 0 ns;                  -- Prevent constant folding
+        assert a + b = X"11";
+        assert a - b = X"cf";
+        assert b - a = X"31";
+        assert a + c = X"f3";
+        assert "+"(a, c)'left = 7;
+        assert c + a = X"f3";
+        assert a > b;
+        assert b <= a;
+        assert not (a < b);
+        assert a /= b;
+        assert c < b;
+        assert resize(a, 4) = X"0";
+        assert resize(b, 12) = X"021";
+        assert resize(b, 12)'length = 12;
+        assert to_integer(a) = 240;
+        assert to_unsigned(100, 8) = X"64";
+        assert to_unsigned(100, 8)'left = 7;
+
+        -- Weak values are treated as strong
+        b := "LLHLLLLH";
+        wait for 0 ns;
+        assert b = X"21";
+        assert to_integer(b) = 33;
+
+        -- Metavalues use the VHDL definition
+        b := "0010000X";
+        wait for 0 ns;
+        assert std_logic_vector(a + b) = "XXXXXXXX";
+        assert std_logic_vector(resize(b, 10)) = "000010000X";
+        assert to_integer(b) = 0;
+        assert not (a < b);
+
+        -- Truncation
+        n := 300;
+        wait for 0 ns;
+        assert to_unsigned(n, 8) = X"2c";
+
+        -- Wider than a machine word
+        w := (others => '1');
+        wait for 0 ns;
+        assert w + 1 = 0;
+        assert w - w = 0;
+        assert resize(w, 101) = w;
+        assert resize(w, 101) + w > w;
+
+        v := "01HX";
+        x := "1L1U";
+        wait for 0 ns;
+        assert (v and x) = "001U";
+        assert (v or x) = "111U";
+        assert (v xor x) = "110U";
+        assert (not v) = "100X";
+        assert (v nand x) = "110U";
+        assert "and"(v, x)'left = 1;
+
+        wait;
+    end process;
+
+end architecture;
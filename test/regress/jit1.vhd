@@ -0,0 +1,52 @@
+package pack is
+    function add1(x : integer) return integer;
+    procedure accum(variable acc : inout integer; x : in integer);
+end package;
+
+package body pack is
+    function add1(x : integer) return integer is
+    begin
+        return x + 1;
+    end function;
+
+    procedure accum(variable acc : inout integer; x : in integer) is
+    begin
+        acc := acc + x;
+    end procedure;
+end package body;
+
+-------------------------------------------------------------------------------
+
+entity jit1 is
+end entity;
+
+use work.pack.all;
+
+architecture test of jit1 is
+    signal count : integer := 0;
+    signal clk   : bit := '0';
+begin
+
+    clk <= not clk after 5 ns when count < 10;
+
+    counter: process (clk) is
+    begin
+        if clk'event and clk = '1' then
+            count <= add1(count);
+        end if;
+    end process;
+
+    check: process is
+        variable sum : integer := 0;
+    begin
+        for i in 1 to 10 loop
+            accum(sum, i);
+        end loop;
+        assert sum = 55;
+        wait until count = 10;
+        assert now = 95 ns;
+        report "count is " & integer'image(count);
+        wait;
+    end process;
+
+end architecture;
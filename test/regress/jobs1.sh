@@ -0,0 +1,55 @@
+# Parallel analysis must wait for the files declaring the units that a
+# later file uses and must not lose any entries from the library index
+
+cat >pack1.vhd <<EOT
+package pack1 is
+    function inc(x : integer) return integer;
+end package;
+
+package body pack1 is
+    function inc(x : integer) return integer is
+    begin
+        return x + 1;
+    end function;
+end package body;
+EOT
+
+cat >pack2.vhd <<EOT
+use work.pack1.all;
+
+package pack2 is
+    constant START : integer := inc(41);
+end package;
+EOT
+
+cat >other.vhd <<EOT
+entity other is
+end entity;
+
+architecture test of other is
+begin
+end architecture;
+EOT
+
+cat >top.vhd <<EOT
+entity jobs1 is
+end entity;
+
+library work;
+use work.pack1.all;
+use work.pack2.all;
+
+architecture test of jobs1 is
+    signal s : integer := START;
+begin
+    process is
+    begin
+        report "result is " & integer'image(inc(s));
+        wait;
+    end process;
+end architecture;
+EOT
+
+nvc -a --jobs=3 pack1.vhd other.vhd pack2.vhd top.vhd
+nvc --list | LC_ALL=C sort
+nvc -e jobs1 -r
@@ -0,0 +1,71 @@
+# Generating code in parallel splits the design between several object
+# files: processes, their shared code, package subprograms imported for
+# inlining and package state must all still link into one design
+
+cat >pack.vhd <<EOT
+package pack is
+    function scale(x : integer) return integer;
+    shared variable calls : integer := 0;
+end package;
+
+package body pack is
+    function scale(x : integer) return integer is
+    begin
+        return x * 3;
+    end function;
+end package body;
+EOT
+
+cat >top.vhd <<EOT
+entity sub is
+    port ( i : in integer;
+           o : out integer );
+end entity;
+
+use work.pack.all;
+
+architecture test of sub is
+begin
+    process (i) is
+    begin
+        o <= scale(i);
+        calls := calls + 1;
+    end process;
+end architecture;
+
+-------------------------------------------------------------------------------
+
+entity jobs2 is
+end entity;
+
+use work.pack.all;
+
+architecture test of jobs2 is
+    type int_vec is array (natural range <>) of integer;
+    signal i, o : int_vec(1 to 6) := (others => 0);
+begin
+
+    g: for n in 1 to 6 generate
+        sub_i: entity work.sub port map ( i(n), o(n) );
+    end generate;
+
+    process is
+        variable sum : integer := 0;
+    begin
+        i <= (1, 2, 3, 4, 5, 6);
+        wait for 1 ns;
+        for n in o'range loop
+            sum := sum + o(n);
+        end loop;
+        report "sum is " & integer'image(sum);
+        report "calls is " & integer'image(calls);
+        wait;
+    end process;
+
+end architecture;
+EOT
+
+nvc -a pack.vhd top.vhd -e --jobs=3 jobs2
+set -- work/_WORK.JOBS2.elab.*.o
+echo "$# objects"
+nvc -r jobs2
@@ -0,0 +1,48 @@
+# Identical instances of an architecture share the code generated for
+# their processes while each still drives its own signals
+
+cat >share1.vhd <<EOT
+entity share1_sub is
+    port ( i : in integer;
+           o : out integer );
+end entity;
+
+architecture test of share1_sub is
+begin
+    process (i) is
+        variable acc : integer := 0;
+    begin
+        acc := acc + i;
+        o <= acc * 2;
+    end process;
+end architecture;
+
+-------------------------------------------------------------------------------
+
+entity share1 is
+end entity;
+
+architecture test of share1 is
+    type int_vec is array (natural range <>) of integer;
+    signal i, o : int_vec(1 to 4) := (others => 0);
+begin
+
+    g: for n in 1 to 4 generate
+        sub_i: entity work.share1_sub port map ( i(n), o(n) );
+    end generate;
+
+    process is
+    begin
+        i <= (1, 2, 3, 4);
+        wait for 1 ns;
+        i <= (10, 20, 30, 40);
+        wait for 1 ns;
+        report "o = " & integer'image(o(1)) & " " & integer'image(o(2))
+            & " " & integer'image(o(3)) & " " & integer'image(o(4));
+        wait;
+    end process;
+
+end architecture;
+EOT
+
+nvc -a share1.vhd -e --verbose share1 -r
@@ -0,0 +1,41 @@
+# With --single-image the design and the packages it uses are linked
+# into one shared library so the packages' own libraries are not loaded:
+# inlining is disabled so the call to the package must be linked
+
+cat >pack.vhd <<EOT
+package pack is
+    function get_value(x : integer) return integer;
+    constant START : integer;
+end package;
+
+package body pack is
+    function get_value(x : integer) return integer is
+    begin
+        return x * 2;
+    end function;
+
+    constant START : integer := 21;
+end package body;
+EOT
+
+cat >top.vhd <<EOT
+entity single1 is
+end entity;
+
+use work.pack.all;
+
+architecture test of single1 is
+    signal s : integer := START;
+begin
+    process is
+    begin
+        report "value is " & integer'image(get_value(s));
+        wait;
+    end process;
+end architecture;
+EOT
+
+nvc -a pack.vhd top.vhd -e --single-image --inline-limit=0 single1
+
+rm work/_WORK.PACK-body.so
+nvc -r single1
@@ -60,6 +60,8 @@
 #define F_COVER   (1 << 7)
 #define F_GENERIC (1 << 8)
 #define F_RELAX   (1 << 9)
+#define F_JIT     (1 << 10)
+#define F_SHELL   (1 << 11)
 
 typedef struct test test_t;
 typedef struct generic generic_t;
@@ -306,6 +308,10 @@ static bool parse_test_list(int argc, char **argv)
             test->flags |= F_OPT;
          else if (strcmp(opt, "cover") == 0)
             test->flags |= F_COVER;
+         else if (strcmp(opt, "jit") == 0)
+            test->flags |= F_JIT;
+         else if (strcmp(opt, "shell") == 0)
+            test->flags |= F_SHELL;
          else if (strncmp(opt, "g", 1) == 0) {
             char *value = strchr(opt, '=');
             if (value == NULL) {
@@ -512,45 +518,59 @@ static bool run_test(test_t *test)
    }
 
    arglist_t *args = NULL;
-   push_arg(&args, "%s" PATH_SEP "nvc%s", bin_dir, EXEEXT);
-   push_std(test, &args);
 
-   push_arg(&args, "-a");
-   push_arg(&args, "%s" PATH_SEP "regress" PATH_SEP "%s.vhd",
-            test_dir, test->name);
+   if (test->flags & F_SHELL) {
+      // The script runs in the log directory with the nvc binary under
+      // test first in PATH and the test directory in TESTDIR
+      push_arg(&args, "/bin/sh");
+      push_arg(&args, "%s" PATH_SEP "regress" PATH_SEP "%s.sh",
+               test_dir, test->name);
+   }
+   else {
+      push_arg(&args, "%s" PATH_SEP "nvc%s", bin_dir, EXEEXT);
+      push_std(test, &args);
 
-   if (test->flags & F_RELAX)
-      push_arg(&args, "--relax=%s", test->relax);
+      push_arg(&args, "-a");
+      push_arg(&args, "%s" PATH_SEP "regress" PATH_SEP "%s.vhd",
+               test_dir, test->name);
 
-   push_arg(&args, "-e");
-   push_arg(&args, "%s", test->name);
+      if (test->flags & F_RELAX)
+         push_arg(&args, "--relax=%s", test->relax);
 
-   if (!(test->flags & F_OPT))
-      push_arg(&args, "-O0");
+      push_arg(&args, "-e");
+      push_arg(&args, "%s", test->name);
 
-   if (test->flags & F_COVER)
-      push_arg(&args, "--cover");
+      if (!(test->flags & F_OPT))
+         push_arg(&args, "-O0");
 
-   for (generic_t *g = test->generics; g != NULL; g = g->next)
-      push_arg(&args, "-g%s=%s", g->name, g->value);
+      if (test->flags & F_COVER)
+         push_arg(&args, "--cover");
 
-   if (test->flags & F_FAIL) {
-      if (!run_cmd(outf, &args))
-         goto out_print;
+      if (test->flags & F_JIT)
+         push_arg(&args, "--jit");
 
-      push_arg(&args, "%s/nvc%s", bin_dir, EXEEXT);
-      push_std(test, &args);
-   }
+      for (generic_t *g = test->generics; g != NULL; g = g->next)
+         push_arg(&args, "-g%s=%s", g->name, g->value);
 
-   push_arg(&args, "-r");
+      if (test->flags & F_FAIL) {
+         if (!run_cmd(outf, &args))
+            goto out_print;
 
-   if (test->flags & F_STOP)
-      push_arg(&args, "--stop-time=%s", test->stop);
+         push_arg(&args, "%s/nvc%s", bin_dir, EXEEXT);
+         push_std(test, &args);
+      }
+
+      push_arg(&args, "-r");
+
+      if (test->flags & F_STOP)
+         push_arg(&args, "--stop-time=%s", test->stop);
 
-   if (test->flags & F_VHPI)
-      push_arg(&args, "--load=%s/../lib/%s.so%s", bin_dir, test->name, EXEEXT);
+      if (test->flags & F_VHPI)
+         push_arg(&args, "--load=%s/../lib/%s.so%s",
+                  bin_dir, test->name, EXEEXT);
 
-   push_arg(&args, "%s", test->name);
+      push_arg(&args, "%s", test->name);
+   }
 
    result = run_cmd(outf, &args);
 
@@ -675,6 +695,14 @@ int main(int argc, char **argv)
    setenv("NVC_IMP_LIB", lib_dir, 1);
    setenv("NVC_LIBPATH", lib_dir, 1);
 
+   setenv("TESTDIR", test_dir, 1);
+
+   const char *path = getenv("PATH");
+   char *new_path = malloc(strlen(bin_dir) + (path ? strlen(path) : 0) + 2);
+   sprintf(new_path, "%s%s%s", bin_dir, path ? ":" : "", path ? path : "");
+   setenv("PATH", new_path, 1);
+   free(new_path);
+
    if (getenv("QUICK"))
       return 0;
 
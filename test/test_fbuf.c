@@ -0,0 +1,201 @@
+#include "fbuf.h"
+#include "util.h"
+
+#include <check.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Enough fields to span many compressed blocks
+#define NFIELDS 200000
+
+static char *fname;
+
+static void setup(void)
+{
+   const char *tmp = getenv("TEMP");
+   if (tmp == NULL)
+      tmp = "/tmp";
+
+   fname = xasprintf("%s" PATH_SEP "test_fbuf.%d", tmp, getpid());
+}
+
+static void teardown(void)
+{
+   unsetenv("NVC_FBUF_THREADS");
+
+   remove(fname);
+   free(fname);
+   fname = NULL;
+}
+
+static uint64_t pattern(unsigned i)
+{
+   // Mix values that do not compress with long runs that do
+   return (i % 5 == 0) ? i * UINT64_C(0x9e3779b97f4a7c15) : i / 64;
+}
+
+static size_t write_fields(fbuf_t *f)
+{
+   size_t nbytes = 0;
+
+   for (unsigned i = 0; i < NFIELDS; i++) {
+      switch (i % 4) {
+      case 0:
+         write_u32(pattern(i), f);
+         nbytes += 4;
+         break;
+      case 1:
+         write_u8(pattern(i), f);
+         nbytes += 1;
+         break;
+      case 2:
+         write_u64(pattern(i), f);
+         nbytes += 8;
+         break;
+      case 3:
+         write_u16(pattern(i), f);
+         nbytes += 2;
+         break;
+      }
+   }
+
+   uint32_t array[NFIELDS / 4];
+   for (unsigned i = 0; i < ARRAY_LEN(array); i++)
+      array[i] = pattern(i);
+   write_u32_array(array, ARRAY_LEN(array), f);
+   nbytes += sizeof(array);
+
+   static const char str[] = "end of fields";
+   write_raw(str, sizeof(str), f);
+   nbytes += sizeof(str);
+
+   write_double(1.5, f);
+   nbytes += 8;
+
+   return nbytes;
+}
+
+static void read_fields(fbuf_t *f)
+{
+   for (unsigned i = 0; i < NFIELDS; i++) {
+      switch (i % 4) {
+      case 0:
+         fail_unless(read_u32(f) == (uint32_t)pattern(i));
+         break;
+      case 1:
+         fail_unless(read_u8(f) == (uint8_t)pattern(i));
+         break;
+      case 2:
+         fail_unless(read_u64(f) == pattern(i));
+         break;
+      case 3:
+         fail_unless(read_u16(f) == (uint16_t)pattern(i));
+         break;
+      }
+   }
+
+   uint32_t array[NFIELDS / 4];
+   read_u32_array(array, ARRAY_LEN(array), f);
+   for (unsigned i = 0; i < ARRAY_LEN(array); i++)
+      fail_unless(array[i] == (uint32_t)pattern(i));
+
+   char str[14];
+   read_raw(str, sizeof(str), f);
+   fail_unless(strcmp(str, "end of fields") == 0);
+
+   fail_unless(read_double(f) == 1.5);
+}
+
+static size_t round_trip(fbuf_codec_t codec)
+{
+   fbuf_t *f = fbuf_open(fname, FBUF_OUT, codec);
+   fail_if(f == NULL);
+   const size_t nbytes = write_fields(f);
+   fbuf_close(f);
+
+   // The codec argument is ignored when reading
+   f = fbuf_open(fname, FBUF_IN, FBUF_CODEC_FASTLZ);
+   fail_if(f == NULL);
+   read_fields(f);
+   fbuf_close(f);
+
+   return nbytes;
+}
+
+START_TEST(test_none)
+{
+   const size_t nbytes = round_trip(FBUF_CODEC_NONE);
+
+   // Only the codec byte is added to the data
+   struct stat st;
+   fail_if(stat(fname, &st) != 0);
+   fail_unless((size_t)st.st_size == nbytes + 1);
+}
+END_TEST
+
+START_TEST(test_fastlz)
+{
+   const size_t nbytes = round_trip(FBUF_CODEC_FASTLZ);
+
+   struct stat st;
+   fail_if(stat(fname, &st) != 0);
+   fail_unless((size_t)st.st_size < nbytes);
+}
+END_TEST
+
+START_TEST(test_lz4)
+{
+   const size_t nbytes = round_trip(FBUF_CODEC_LZ4);
+
+   struct stat st;
+   fail_if(stat(fname, &st) != 0);
+   fail_unless((size_t)st.st_size < nbytes);
+}
+END_TEST
+
+START_TEST(test_threads)
+{
+   // Compress blocks on worker threads even with a single CPU
+   setenv("NVC_FBUF_THREADS", "2", 1);
+
+   round_trip(FBUF_CODEC_FASTLZ);
+   round_trip(FBUF_CODEC_LZ4);
+}
+END_TEST
+
+START_TEST(test_digest)
+{
+   fbuf_t *f = fbuf_open_digest();
+   write_fields(f);
+   const uint64_t d1 = fbuf_digest(f);
+   fbuf_close(f);
+
+   f = fbuf_open_digest();
+   write_fields(f);
+   fail_unless(fbuf_digest(f) == d1);
+
+   // Anything written after the digest changes it
+   write_u8(0, f);
+   fail_if(fbuf_digest(f) == d1);
+   fbuf_close(f);
+}
+END_TEST
+
+Suite *get_fbuf_tests(void)
+{
+   Suite *s = suite_create("fbuf");
+
+   TCase *tc_core = tcase_create("Core");
+   tcase_add_checked_fixture(tc_core, setup, teardown);
+   tcase_add_test(tc_core, test_none);
+   tcase_add_test(tc_core, test_fastlz);
+   tcase_add_test(tc_core, test_lz4);
+   tcase_add_test(tc_core, test_threads);
+   tcase_add_test(tc_core, test_digest);
+   suite_add_tcase(s, tc_core);
+
+   return s;
+}
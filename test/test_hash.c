@@ -6,7 +6,7 @@
 #include <string.h>
 #include <time.h>
 
-#define VOIDP(x) ((void *)(uintptr_t)x)
+#define VOIDP(x) ((void *)(uintptr_t)(x))
 
 START_TEST(test_basic)
 {
@@ -69,6 +69,106 @@ START_TEST(test_replace)
 }
 END_TEST;
 
+START_TEST(test_delete)
+{
+   hash_t *h = hash_new(8, true);
+
+   for (int i = 1; i <= 100; i++)
+      hash_put(h, VOIDP(i), VOIDP(i * 2));
+
+   for (int i = 1; i <= 100; i += 2)
+      fail_unless(hash_delete(h, VOIDP(i)));
+
+   fail_if(hash_delete(h, VOIDP(1)));
+   fail_unless(hash_members(h) == 50);
+
+   for (int i = 1; i <= 100; i++) {
+      if (i % 2 == 0)
+         fail_unless(hash_get(h, VOIDP(i)) == VOIDP(i * 2));
+      else
+         fail_unless(hash_get(h, VOIDP(i)) == NULL);
+   }
+
+   hash_free(h);
+}
+END_TEST;
+
+START_TEST(test_multimap_order)
+{
+   hash_t *h = hash_new(8, false);
+
+   // Force several rehashes with interleaved duplicates
+   for (int i = 0; i < 200; i++) {
+      hash_put(h, VOIDP(1 + (i % 3)), VOIDP(i + 1));
+      hash_put(h, VOIDP(1000 + i), VOIDP(i + 1));
+   }
+
+   for (int i = 0; i < 200; i++) {
+      int n = i / 3;
+      fail_unless(hash_get_nth(h, VOIDP(1 + (i % 3)), &n) == VOIDP(i + 1));
+   }
+
+   hash_free(h);
+}
+END_TEST;
+
+START_TEST(test_multimap_delete)
+{
+   hash_t *h = hash_new(8, false);
+
+   for (int i = 0; i < 10; i++) {
+      hash_put(h, VOIDP(1), VOIDP(i + 1));
+      hash_put(h, VOIDP(2), VOIDP(i + 1));
+   }
+
+   fail_unless(hash_delete(h, VOIDP(1)));
+   fail_unless(hash_members(h) == 10);
+   fail_unless(hash_get(h, VOIDP(1)) == NULL);
+   fail_if(hash_delete(h, VOIDP(1)));
+
+   int n = 9;
+   fail_unless(hash_get_nth(h, VOIDP(2), &n) == VOIDP(10));
+
+   hash_free(h);
+}
+END_TEST
+
+START_TEST(test_string)
+{
+   hash_t *h = hash_new_kind(8, true, HASH_STRING);
+
+   char key[16];
+   strcpy(key, "hello");
+
+   hash_put(h, "hello", VOIDP(1));
+   hash_put(h, "world", VOIDP(2));
+
+   fail_unless(hash_get(h, key) == VOIDP(1));
+   fail_unless(hash_get(h, "world") == VOIDP(2));
+   fail_unless(hash_get(h, "hell") == NULL);
+
+   fail_unless(hash_put(h, key, VOIDP(3)));
+   fail_unless(hash_get(h, "hello") == VOIDP(3));
+
+   hash_free(h);
+}
+END_TEST;
+
+START_TEST(test_integer)
+{
+   hash_t *h = hash_new_kind(8, true, HASH_INTEGER);
+
+   hash_put(h, HASH_INT_KEY(0), VOIDP(5));
+   hash_put(h, HASH_INT_KEY(42), VOIDP(6));
+
+   fail_unless(hash_get(h, HASH_INT_KEY(0)) == VOIDP(5));
+   fail_unless(hash_get(h, HASH_INT_KEY(42)) == VOIDP(6));
+   fail_unless(hash_get(h, HASH_INT_KEY(1)) == NULL);
+
+   hash_free(h);
+}
+END_TEST;
+
 Suite *get_hash_tests(void)
 {
    Suite *s = suite_create("hash");
@@ -77,6 +177,11 @@ Suite *get_hash_tests(void)
    tcase_add_test(tc_core, test_basic);
    tcase_add_test(tc_core, test_rand);
    tcase_add_test(tc_core, test_replace);
+   tcase_add_test(tc_core, test_delete);
+   tcase_add_test(tc_core, test_multimap_order);
+   tcase_add_test(tc_core, test_multimap_delete);
+   tcase_add_test(tc_core, test_string);
+   tcase_add_test(tc_core, test_integer);
    suite_add_tcase(s, tc_core);
 
    return s;
@@ -45,6 +45,23 @@ START_TEST(test_istr)
 }
 END_TEST
 
+START_TEST(test_istr_stable)
+{
+   ident_t i1 = ident_new("stable");
+   const char *s1 = istr(i1);
+
+   for (int i = 0; i < 1000; i++) {
+      char buf[32];
+      snprintf(buf, sizeof(buf), "stable%d", i);
+      ident_new(buf);
+   }
+
+   fail_unless(istr(i1) == s1);
+   fail_unless(strcmp(s1, "stable") == 0);
+   fail_unless(ident_new(s1) == i1);
+}
+END_TEST
+
 START_TEST(test_rand)
 {
    for (int i = 0; i < 10000; i++) {
@@ -69,7 +86,7 @@ START_TEST(test_read_write)
    i2 = ident_new("foo");
    i3 = ident_new("foo");
 
-   fbuf_t *f = fbuf_open("test.ident", FBUF_OUT);
+   fbuf_t *f = fbuf_open("test.ident", FBUF_OUT, FBUF_CODEC_FASTLZ);
    fail_if(f == NULL);
 
    ident_wr_ctx_t wctx = ident_write_begin(f);
@@ -82,7 +99,7 @@ START_TEST(test_read_write)
 
    fbuf_close(f);
 
-   f = fbuf_open("test.ident", FBUF_IN);
+   f = fbuf_open("test.ident", FBUF_IN, FBUF_CODEC_FASTLZ);
    fail_if(f == NULL);
 
    ident_rd_ctx_t rctx = ident_read_begin(f);
@@ -292,6 +309,7 @@ Suite *get_ident_tests(void)
    tcase_add_test(tc_core, test_ident_new);
    tcase_add_test(tc_core, test_compare);
    tcase_add_test(tc_core, test_istr);
+   tcase_add_test(tc_core, test_istr_stable);
    tcase_add_test(tc_core, test_rand);
    tcase_add_test(tc_core, test_read_write);
    tcase_add_test(tc_core, test_prefix);
@@ -1,4 +1,5 @@
 #include "lib.h"
+#include "fbuf.h"
 #include "tree.h"
 #include "util.h"
 #include "common.h"
@@ -20,6 +21,8 @@ static void setup(void)
          tmp = "/tmp";
    }
 
+   opt_set_int("lib-format", FBUF_CODEC_FASTLZ);
+
    char *path LOCAL = xasprintf("%s" PATH_SEP "test_lib", tmp);
    work = lib_new("test_lib", path);
    fail_if(work == NULL);
@@ -103,7 +106,7 @@ START_TEST(test_lib_fopen)
 }
 END_TEST
 
-START_TEST(test_lib_save)
+static void save_and_reload(void)
 {
    {
       tree_t ent = tree_new(T_ENTITY);
@@ -266,6 +269,77 @@ START_TEST(test_lib_save)
       fail_unless(type_eq(tree_type(tree_ref(r)), e));
    }
 }
+
+START_TEST(test_lib_save)
+{
+   save_and_reload();
+}
+END_TEST
+
+START_TEST(test_lib_save_none)
+{
+   // Recreate the library so it records the uncompressed format
+   lib_destroy(work);
+   lib_free(work);
+
+   opt_set_int("lib-format", FBUF_CODEC_NONE);
+
+   char *path LOCAL = xasprintf("%s" PATH_SEP "test_lib", tmp);
+   work = lib_new("test_lib", path);
+   fail_if(work == NULL);
+
+   save_and_reload();
+
+   FILE *f = lib_fopen(work, "_NVC_LIB", "r");
+   fail_if(f == NULL);
+   char buf[64];
+   fail_if(fgets(buf, sizeof(buf), f) == NULL);
+   fail_if(fgets(buf, sizeof(buf), f) == NULL);
+   fail_unless(strcmp(buf, "none\n") == 0);
+   fclose(f);
+}
+END_TEST
+
+START_TEST(test_lib_gc)
+{
+   tree_t ent = tree_new(T_ENTITY);
+   tree_set_ident(ent, ident_new("name"));
+   lib_put(work, ent);
+
+   lib_save(work);
+   lib_free(work);
+
+   lib_add_search_path(tmp);
+   work = lib_find(ident_new("test_lib"), false);
+   fail_if(work == NULL);
+
+   ident_t marker_i = ident_new("marker");
+
+   tree_t e1 = lib_get(work, ident_new("name"));
+   fail_if(e1 == NULL);
+   tree_add_attr_int(e1, marker_i, 1);
+
+   // A unit read from a library is kept while anything refers to it
+   tree_t keep = tree_new(T_ARCH);
+   tree_set_ident(keep, ident_new("keep"));
+   tree_set_ident2(keep, ident_new("name"));
+   tree_add_attr_tree(keep, ident_new("entity"), e1);
+
+   tree_gc();
+
+   fail_unless(lib_get(work, ident_new("name")) == e1);
+   fail_unless(tree_attr_int(e1, marker_i, 0) == 1);
+
+   // Otherwise it is released and read again when next requested
+   tree_remove_attr(keep, ident_new("entity"));
+
+   tree_gc();
+
+   tree_t e2 = lib_get(work, ident_new("name"));
+   fail_if(e2 == NULL);
+   fail_unless(tree_ident(e2) == ident_new("name"));
+   fail_unless(tree_attr_int(e2, marker_i, 0) == 0);
+}
 END_TEST
 
 Suite *get_lib_tests(void)
@@ -277,6 +351,8 @@ Suite *get_lib_tests(void)
    tcase_add_test(tc_core, test_lib_new);
    tcase_add_test(tc_core, test_lib_fopen);
    tcase_add_test(tc_core, test_lib_save);
+   tcase_add_test(tc_core, test_lib_save_none);
+   tcase_add_test(tc_core, test_lib_gc);
    suite_add_tcase(s, tc_core);
 
    return s;
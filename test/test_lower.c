@@ -3115,6 +3115,200 @@ START_TEST(test_sum)
 }
 END_TEST
 
+START_TEST(test_intrinsic)
+{
+   input_from_file(TESTDIR "/lower/intrinsic.vhd");
+
+   tree_t e = run_elab();
+   lower_unit(e);
+
+   vcode_unit_t v0 = find_unit(tree_stmt(e, 0));
+   vcode_select_unit(v0);
+
+   int nadd = 0, nint = 0, nand = 0;
+   const int nblocks = vcode_count_blocks();
+   for (int i = 0; i < nblocks; i++) {
+      vcode_select_block(i);
+
+      const int nops = vcode_count_ops();
+      for (int j = 0; j < nops; j++) {
+         if (vcode_get_op(j) != VCODE_OP_INTRINSIC)
+            continue;
+
+         switch (vcode_get_intrinsic(j)) {
+         case INTRINSIC_UNSIGNED_ADD: nadd++; break;
+         case INTRINSIC_UNSIGNED_TO_INTEGER: nint++; break;
+         case INTRINSIC_LOGIC_AND: nand++; break;
+         default:
+            fail("unexpected intrinsic %d", vcode_get_intrinsic(j));
+         }
+
+         // The VHDL definition is still called as a fallback
+         fail_unless(vcode_get_func(j) != NULL);
+      }
+   }
+
+   fail_unless(nadd == 1);
+   fail_unless(nint == 1);
+   fail_unless(nand == 1);
+}
+END_TEST
+
+START_TEST(test_vcodeopt)
+{
+   input_from_file(TESTDIR "/lower/vcodeopt.vhd");
+
+   opt_set_int("optimise", 2);
+
+   tree_t e = run_elab();
+   lower_unit(e);
+
+   vcode_unit_t v0 = find_unit(tree_stmt(e, 0));
+   vcode_select_unit(v0);
+
+   // The load of V in the nested if statement is forwarded from the
+   // store in block 1 and the else branch is removed
+
+   EXPECT_BB(1) = {
+      { VCODE_OP_CONST, .value = 4 },
+      { VCODE_OP_STORE, .name = "V" },
+      { VCODE_OP_LOAD, .name = "resolved_:vcodeopt:x" },
+      { VCODE_OP_LOAD_INDIRECT },
+      { VCODE_OP_CONST, .value = 0 },
+      { VCODE_OP_CMP, .cmp = VCODE_CMP_GT },
+      { VCODE_OP_COND, .target = 2, .target_else = 3 }
+   };
+
+   CHECK_BB(1);
+
+   EXPECT_BB(2) = {
+      { VCODE_OP_JUMP, .target = 4 }
+   };
+
+   CHECK_BB(2);
+
+   EXPECT_BB(4) = {
+      { VCODE_OP_CONST, .value = 5 },
+      { VCODE_OP_STORE, .name = "W" },
+      { VCODE_OP_JUMP, .target = 5 }
+   };
+
+   CHECK_BB(4);
+
+   fail_unless(vcode_count_blocks() == 7);
+}
+END_TEST
+
+START_TEST(test_ranges1)
+{
+   input_from_file(TESTDIR "/lower/ranges1.vhd");
+
+   opt_set_int("optimise", 2);
+
+   tree_t e = run_elab();
+   lower_unit(e);
+
+   vcode_unit_t v0 = find_unit(tree_stmt(e, 0));
+   vcode_select_unit(v0);
+
+   // Every array index and the increment of K are within bounds given
+   // the loop and if statement conditions except for A(Y + 1)
+
+   int nchecks = 0;
+   const int nblocks = vcode_count_blocks();
+   for (int i = 0; i < nblocks; i++) {
+      vcode_select_block(i);
+
+      const int nops = vcode_count_ops();
+      for (int j = 0; j < nops; j++) {
+         const vcode_op_t kind = vcode_get_op(j);
+         if (kind == VCODE_OP_BOUNDS || kind == VCODE_OP_INDEX_CHECK
+             || kind == VCODE_OP_DYNAMIC_BOUNDS)
+            nchecks++;
+      }
+   }
+
+   fail_unless(nchecks == 1);
+}
+END_TEST
+
+START_TEST(test_vcodeopt2)
+{
+   input_from_file(TESTDIR "/lower/vcodeopt2.vhd");
+
+   opt_set_int("optimise", 2);
+
+   tree_t p = parse_check_and_simplify(T_PACKAGE, T_PACK_BODY);
+   lower_unit(p);
+
+   {
+      vcode_unit_t v0 = find_unit(tree_decl(p, 0));
+      vcode_select_unit(v0);
+
+      // The multiplication is reused from the dominating block and the
+      // load of R forwarded from the store before the branch
+
+      EXPECT_BB(1) = {
+         { VCODE_OP_ADD },
+         { VCODE_OP_BOUNDS, .low = INT32_MIN, .high = INT32_MAX },
+         { VCODE_OP_STORE, .name = "R" },
+         { VCODE_OP_JUMP, .target = 2 }
+      };
+
+      CHECK_BB(1);
+   }
+
+   {
+      vcode_unit_t v1 = find_unit(tree_decl(p, 1));
+      vcode_select_unit(v1);
+
+      // The case statement is folded once the load of V is forwarded and
+      // the blocks for the other choices are removed
+
+      EXPECT_BB(1) = {
+         { VCODE_OP_JUMP, .target = 3 }
+      };
+
+      CHECK_BB(1);
+
+      EXPECT_BB(3) = {
+         { VCODE_OP_ADDI, .value = 1 },
+         { VCODE_OP_BOUNDS, .low = INT32_MIN, .high = INT32_MAX },
+         { VCODE_OP_RETURN }
+      };
+
+      CHECK_BB(3);
+
+      fail_unless(vcode_count_blocks() == 4);
+   }
+
+   {
+      vcode_unit_t v2 = find_unit(tree_decl(p, 2));
+      vcode_select_unit(v2);
+
+      // Both branches use the value stored to V in block zero
+
+      EXPECT_BB(1) = {
+         { VCODE_OP_ADDI, .value = 1 },
+         { VCODE_OP_BOUNDS, .low = INT32_MIN, .high = INT32_MAX },
+         { VCODE_OP_STORE, .name = "W" },
+         { VCODE_OP_JUMP, .target = 3 }
+      };
+
+      CHECK_BB(1);
+
+      EXPECT_BB(2) = {
+         { VCODE_OP_ADDI, .value = -1 },
+         { VCODE_OP_BOUNDS, .low = INT32_MIN, .high = INT32_MAX },
+         { VCODE_OP_STORE, .name = "W" },
+         { VCODE_OP_JUMP, .target = 3 }
+      };
+
+      CHECK_BB(2);
+   }
+}
+END_TEST
+
 Suite *get_lower_tests(void)
 {
    Suite *s = suite_create("lower");
@@ -3189,6 +3383,10 @@ Suite *get_lower_tests(void)
    tcase_add_test(tc, test_signal11);
    tcase_add_test(tc, test_access1);
    tcase_add_test(tc, test_sum);
+   tcase_add_test(tc, test_intrinsic);
+   tcase_add_test(tc, test_vcodeopt);
+   tcase_add_test(tc, test_vcodeopt2);
+   tcase_add_test(tc, test_ranges1);
    suite_add_tcase(s, tc);
 
    return s;
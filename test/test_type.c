@@ -0,0 +1,91 @@
+#include "type.h"
+#include "tree.h"
+#include "util.h"
+
+#include <check.h>
+#include <stdlib.h>
+
+static type_t make_int(const char *name)
+{
+   type_t t = type_new(T_INTEGER);
+   type_set_ident(t, ident_new(name));
+   return t;
+}
+
+static type_t make_func(type_t param, type_t result)
+{
+   type_t t = type_new(T_FUNC);
+   type_set_ident(t, ident_new("func"));
+   type_add_param(t, param);
+   type_set_result(t, result);
+   return t;
+}
+
+START_TEST(test_eq_mutate)
+{
+   type_t int_a = make_int("int_a");
+   type_t int_b = make_int("int_b");
+
+   fail_if(type_eq(int_a, int_b));
+
+   type_t f1 = make_func(int_a, int_a);
+   type_t f2 = make_func(int_a, int_a);
+
+   fail_unless(type_eq(f1, f2));
+
+   // Changing either type must not return the remembered result
+   type_add_param(f1, int_b);
+   fail_if(type_eq(f1, f2));
+   fail_if(type_eq(f2, f1));
+
+   type_add_param(f2, int_b);
+   fail_unless(type_eq(f1, f2));
+
+   type_set_result(f2, int_b);
+   fail_if(type_eq(f1, f2));
+   fail_if(type_eq(f2, f1));
+
+   type_set_result(f1, int_b);
+   fail_unless(type_eq(f1, f2));
+}
+END_TEST
+
+START_TEST(test_eq_gc)
+{
+   // Keep the slab alive so the freed slots are reused below
+   tree_t pack = tree_new(T_PACKAGE);
+   tree_set_ident(pack, ident_new("pack"));
+
+   type_t int_a = make_int("int_a");
+   type_t f1 = make_func(int_a, int_a);
+   type_t f2 = make_func(int_a, int_a);
+
+   fail_unless(type_eq(f1, f2));
+   fail_unless(type_eq(f2, f1));
+
+   // Nothing refers to these types so their slots are reused by
+   // the types allocated below
+   tree_gc();
+   fail_unless(tree_ident(pack) == ident_new("pack"));
+
+   type_t int_b = make_int("int_b");
+   type_t g1 = make_func(int_b, int_b);
+   type_t g2 = make_func(int_b, int_b);
+   type_add_param(g2, int_b);
+
+   fail_if(type_eq(g1, g2));
+   fail_if(type_eq(g2, g1));
+}
+END_TEST
+
+Suite *get_type_tests(void)
+{
+   Suite *s = suite_create("type");
+
+   TCase *tc_core = tcase_create("Core");
+   tcase_add_test(tc_core, test_eq_mutate);
+   tcase_add_test(tc_core, test_eq_gc);
+   suite_add_tcase(s, tc_core);
+
+   return s;
+}
@@ -40,11 +40,14 @@ static void setup(void)
    opt_set_int("bootstrap", 0);
    opt_set_int("cover", 0);
    opt_set_int("unit-test", 1);
+   opt_set_int("optimise", 0);
    opt_set_str("dump-vcode", NULL);
    opt_set_int("ignore-time", 0);
    opt_set_int("verbose", 0);
    opt_set_int("synthesis", 0);
    opt_set_int("parse-pragmas", 0);
+   opt_set_int("lib-format", FBUF_CODEC_FASTLZ);
+   opt_set_int("single-image", 0);
    intern_strings();
 }
 
@@ -54,6 +57,7 @@ static void setup_per_test(void)
    lib_set_work(test_lib);
 
    opt_set_int("cover", 0);
+   opt_set_int("optimise", 0);
 
    reset_bounds_errors();
    reset_sem_errors();
@@ -50,6 +50,8 @@ int main(int argc, char **argv)
    nfail += RUN_TESTS(ident);
    nfail += RUN_TESTS(hash);
    nfail += RUN_TESTS(heap);
+   nfail += RUN_TESTS(fbuf);
+   nfail += RUN_TESTS(type);
    nfail += RUN_TESTS(lib);
    nfail += RUN_TESTS(parse);
    nfail += RUN_TESTS(sem);
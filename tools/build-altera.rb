@@ -8,6 +8,7 @@
 #       quartus2/eda_ref_presynth_lib.htm
 #
 
+require 'etc'
 require 'fileutils'
 
 SearchRoot = '/opt/altera'
@@ -31,8 +32,12 @@ $src = "#{quartus}/eda/sim_lib"
 $libdir = "#{File.expand_path '~'}/.nvc/lib"
 FileUtils.mkdir_p $libdir
 
-def run_nvc(lib, file)
-  cmd = "nvc --work=#{$libdir}/#{lib} -a --relax=prefer-explicit #{$src}/#{file}"
+$jobs = Etc.nprocessors
+
+def run_nvc(lib, *files)
+  files = files.collect { |f| "#{$src}/#{f}" }
+  cmd = "nvc --work=#{$libdir}/#{lib} -a --jobs=#{$jobs} " +
+    "--relax=prefer-explicit #{files.join ' '}"
   puts cmd
   exit 1 unless system cmd
 end
@@ -49,84 +54,84 @@ def put_title(what)
 end
 
 put_title 'ALTERA library'
-run_nvc 'altera', 'altera_primitives_components.vhd'
-run_nvc 'altera', 'altera_primitives.vhd'
+run_nvc 'altera', 'altera_primitives_components.vhd',
+        'altera_primitives.vhd'
 
 put_title 'ALTERA_MF library'
-run_nvc 'altera_mf', 'altera_mf_components.vhd'
-run_nvc 'altera_mf', 'altera_mf.vhd'
+run_nvc 'altera_mf', 'altera_mf_components.vhd',
+        'altera_mf.vhd'
 
 put_title 'LPM library'
-run_nvc 'lpm', '220pack.vhd'
-run_nvc 'lpm', '220model.vhd'
+run_nvc 'lpm', '220pack.vhd',
+        '220model.vhd'
 
 put_title 'ALTERA_LNSIM library'
 run_nvc 'altera_lnsim', 'altera_lnsim_components.vhd'
 
 put_title 'SGATE library'
-run_nvc 'sgate', 'sgate_pack.vhd'
-run_nvc 'sgate', 'sgate.vhd'
+run_nvc 'sgate', 'sgate_pack.vhd',
+        'sgate.vhd'
 
 put_title 'ARRIAII library'
-run_nvc 'arriaii', 'arriaii_atoms.vhd'
-run_nvc 'arriaii', 'arriaii_components.vhd'
-run_nvc 'arriaii', 'arriaii_hssi_components.vhd'
+run_nvc 'arriaii', 'arriaii_atoms.vhd',
+        'arriaii_components.vhd',
+        'arriaii_hssi_components.vhd'
 # Broken, at least in 13.0sp1
 #run_nvc 'arriaii', 'arriaii_hssi_atoms.vhd'
 
 put_title 'ARRIAV library'
-run_nvc 'arriav', 'arriav_atoms.vhd'
-run_nvc 'arriav', 'arriav_components.vhd'
-run_nvc 'arriav', 'arriav_hssi_components.vhd'
-run_nvc 'arriav', 'arriav_hssi_atoms.vhd'
+run_nvc 'arriav', 'arriav_atoms.vhd',
+        'arriav_components.vhd',
+        'arriav_hssi_components.vhd',
+        'arriav_hssi_atoms.vhd'
 
 put_title 'ARRIAVGZ library'
-run_nvc 'arriavgz', 'arriavgz_atoms.vhd'
-run_nvc 'arriavgz', 'arriavgz_components.vhd'
-run_nvc 'arriavgz', 'arriavgz_hssi_components.vhd'
-run_nvc 'arriavgz', 'arriavgz_hssi_atoms.vhd'
-run_nvc 'arriavgz', 'arriavgz_pcie_hip_atoms.vhd'
-run_nvc 'arriavgz', 'arriavgz_pcie_hip_components.vhd'
+run_nvc 'arriavgz', 'arriavgz_atoms.vhd',
+        'arriavgz_components.vhd',
+        'arriavgz_hssi_components.vhd',
+        'arriavgz_hssi_atoms.vhd',
+        'arriavgz_pcie_hip_atoms.vhd',
+        'arriavgz_pcie_hip_components.vhd'
 
 put_title 'CYCLONEIII library'
-run_nvc 'cycloneiii', 'cycloneiii_atoms.vhd'
-run_nvc 'cycloneiii', 'cycloneiii_components.vhd'
+run_nvc 'cycloneiii', 'cycloneiii_atoms.vhd',
+        'cycloneiii_components.vhd'
 
 put_title 'CYCLONEIV library'
-run_nvc 'cycloneiv', 'cycloneiv_atoms.vhd'
-run_nvc 'cycloneiv', 'cycloneiv_components.vhd'
-run_nvc 'cycloneiv', 'cycloneiv_hssi_components.vhd'
+run_nvc 'cycloneiv', 'cycloneiv_atoms.vhd',
+        'cycloneiv_components.vhd',
+        'cycloneiv_hssi_components.vhd'
 # Broken, at least in 13.0sp1
 #run_nvc 'cycloneiv', 'cycloneiv_hssi_atoms.vhd'
-run_nvc 'cycloneiv_pcie_hip', 'cycloneiv_pcie_hip_components.vhd'
-run_nvc 'cycloneiv_pcie_hip', 'cycloneiv_pcie_hip_atoms.vhd'
-run_nvc 'cycloneiv', 'cycloneive_atoms.vhd'
-run_nvc 'cycloneiv', 'cycloneive_components.vhd'
+run_nvc 'cycloneiv_pcie_hip', 'cycloneiv_pcie_hip_components.vhd',
+        'cycloneiv_pcie_hip_atoms.vhd'
+run_nvc 'cycloneiv', 'cycloneive_atoms.vhd',
+        'cycloneive_components.vhd'
 
 put_title 'CYCLONEV library'
-run_nvc 'cyclonev', 'cyclonev_atoms.vhd'
-run_nvc 'cyclonev', 'cyclonev_components.vhd'
+run_nvc 'cyclonev', 'cyclonev_atoms.vhd',
+        'cyclonev_components.vhd'
 
 put_title 'MAX library'
-run_nvc 'max', 'max_atoms.vhd'
-run_nvc 'max', 'max_components.vhd'
+run_nvc 'max', 'max_atoms.vhd',
+        'max_components.vhd'
 
 put_title 'MAXII library'
-run_nvc 'maxii', 'maxii_atoms.vhd'
-run_nvc 'maxii', 'maxii_components.vhd'
+run_nvc 'maxii', 'maxii_atoms.vhd',
+        'maxii_components.vhd'
 
 put_title 'MAXV library'
-run_nvc 'maxv', 'maxv_atoms.vhd'
-run_nvc 'maxv', 'maxv_components.vhd'
+run_nvc 'maxv', 'maxv_atoms.vhd',
+        'maxv_components.vhd'
 
 put_title 'STRATIXIII library'
-run_nvc 'stratixiii', 'stratixiii_atoms.vhd'
-run_nvc 'stratixiii', 'stratixiii_components.vhd'
+run_nvc 'stratixiii', 'stratixiii_atoms.vhd',
+        'stratixiii_components.vhd'
 
 put_title 'STRATIXV library'
-run_nvc 'stratixv', 'stratixv_atoms.vhd'
-run_nvc 'stratixv', 'stratixv_components.vhd'
-run_nvc 'stratixv_hssi', 'stratixv_hssi_components.vhd'
-run_nvc 'stratixv_hssi', 'stratixv_hssi_atoms.vhd'
-run_nvc 'stratixv_pcie_hip', 'stratixv_pcie_hip_components.vhd'
-run_nvc 'stratixv_pcie_hip', 'stratixv_pcie_hip_atoms.vhd'
+run_nvc 'stratixv', 'stratixv_atoms.vhd',
+        'stratixv_components.vhd'
+run_nvc 'stratixv_hssi', 'stratixv_hssi_components.vhd',
+        'stratixv_hssi_atoms.vhd'
+run_nvc 'stratixv_pcie_hip', 'stratixv_pcie_hip_components.vhd',
+        'stratixv_pcie_hip_atoms.vhd'
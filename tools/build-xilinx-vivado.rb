@@ -4,6 +4,7 @@
 # Script to compile the Xilinx Vivado simulation libraries
 #
 
+require 'etc'
 require 'fileutils'
 
 xilinx = ENV['XILINX_VIVADO']
@@ -35,9 +36,12 @@ ENV['LD_LIBRARY_PATH'] = nil
 $libdir = "#{File.expand_path '~'}/.nvc/lib"
 FileUtils.mkdir_p $libdir
 
-def run_nvc(lib, file)
-  file = "#{$src}/#{file}" unless file =~ /^\//
-  cmd = "nvc --work=#{$libdir}/#{lib} -a --relax=prefer-explicit,pure-files #{file}"
+$jobs = Etc.nprocessors
+
+def run_nvc(lib, *files)
+  files = files.collect { |f| f =~ /^\// ? f : "#{$src}/#{f}" }
+  cmd = "nvc --work=#{$libdir}/#{lib} -a --jobs=#{$jobs} " +
+    "--relax=prefer-explicit,pure-files #{files.join ' '}"
   puts cmd
   exit 1 unless system cmd
 end
@@ -61,9 +65,7 @@ run_codegen "unisim", "vcomponents"
 
 put_title "UNIMACRO library"
 run_nvc "unimacro", "unimacro/unimacro_VCOMP.vhd"
-Dir.glob "#{$src}/unimacro/*_MACRO.vhd" do |f|
-  run_nvc "unimacro", f
-end
+run_nvc "unimacro", *Dir.glob("#{$src}/unimacro/*_MACRO.vhd")
 
 put_title "Primitives"
 
@@ -73,20 +75,18 @@ unisim_skip = [
 ]
 
 unisim_order = "#{$src}/unisims/primitive/vhdl_analyze_order"
-File.open(unisim_order).each_line do |line|
-  line.chomp!
-  unless line =~ /^ *$/ or unisim_skip.include? line then
-    run_nvc "unisim", "unisims/primitive/#{line}"
-  end
+unisim_files = File.readlines(unisim_order).collect(&:chomp).reject do |line|
+  line =~ /^ *$/ or unisim_skip.include? line
 end
+run_nvc "unisim", *unisim_files.collect { |f| "unisims/primitive/#{f}" }
 
 put_title "UNIFAST library"
 
 unifast_order = "#{$src}/unifast/primitive/vhdl_analyze_order"
-File.open(unifast_order).each_line do |line|
-  line.chomp!
-  run_nvc "unifast", "unifast/primitive/#{line}"
+unifast_files = File.readlines(unifast_order).collect(&:chomp).reject do |line|
+  line =~ /^ *$/
 end
+run_nvc "unifast", *unifast_files.collect { |f| "unifast/primitive/#{f}" }
 
 put_title "Finished"
 puts "Xilinx Vivado libraries installed in #{$libdir}"